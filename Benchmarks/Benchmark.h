@@ -0,0 +1,125 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <cmath>
+#include <iostream>
+
+//where the textures and meshes of the renderer are, the Makefile sets it
+#ifndef ASSET_DIRECTORY
+#define ASSET_DIRECTORY "../DX12TestRenderer/"
+#endif
+
+/**
+ * What the benchmarks in this directory share. They only use the device independent code of the renderer, so they
+ * build and run on Linux (see the Makefile) as well as on windows. Every benchmark checks its results against a
+ * reference first and main returns Benchmark::result(), so a check that fails makes `make run` fail too.
+ */
+class Benchmark
+{
+public:
+	//run pFunction pRepeats times and return the fastest run in seconds, the others are warming up the caches
+	template <typename Function>
+	static double time(Function pFunction, unsigned pRepeats = 3)
+	{
+		double best = 1e30;
+		for (unsigned i = 0; i < pRepeats; ++i) {
+			auto start = std::chrono::high_resolution_clock::now();
+			pFunction();
+			double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+			if (seconds < best)
+				best = seconds;
+		}
+		return best;
+	}
+
+	//count a failed check and say which one it was
+	static bool check(bool pCondition, const std::string& pName)
+	{
+		if (!pCondition) {
+			std::cout << "FAILED: " << pName << std::endl;
+			failures()++;
+		}
+		return pCondition;
+	}
+
+	//what main returns, 0 if every check passed
+	static int result()
+	{
+		if (failures() > 0)
+			std::cout << failures() << " check(s) failed" << std::endl;
+		return failures() > 0 ? 1 : 0;
+	}
+
+	static double megabytes(size_t pBytes)
+	{
+		return pBytes / (1024.0 * 1024.0);
+	}
+
+	//the text of an .obj file like the ones scanning and sculpting tools write: a pGrid x pGrid grid of quads (or twice
+	//as many triangles) over a bumpy surface, with a uv and normal per vertex, "%f" numbers and the lines Mesh::load skips
+	static std::string syntheticObj(unsigned pGrid, bool pQuads)
+	{
+		std::string text;
+		text.reserve((size_t)(pGrid + 1) * (pGrid + 1) * 100 + (size_t)pGrid * pGrid * 70);
+		text += "# synthetic benchmark mesh\nmtllib synthetic.mtl\no Synthetic\n";
+
+		char line[160];
+		unsigned side = pGrid + 1;
+		for (unsigned y = 0; y < side; ++y) {
+			for (unsigned x = 0; x < side; ++x) {
+				float height = 0.25f * std::sin(x * 0.37f) * std::cos(y * 0.23f);
+				snprintf(line, sizeof(line), "v %f %f %f\n", x * 0.01f - 5.0f, height, y * -0.01f + 5.0f);
+				text += line;
+			}
+		}
+		for (unsigned y = 0; y < side; ++y) {
+			for (unsigned x = 0; x < side; ++x) {
+				snprintf(line, sizeof(line), "vt %f %f\n", (float)x / pGrid, (float)y / pGrid);
+				text += line;
+			}
+		}
+		for (unsigned y = 0; y < side; ++y) {
+			for (unsigned x = 0; x < side; ++x) {
+				float nx = -0.09f * std::cos(x * 0.37f) * std::cos(y * 0.23f), nz = 0.06f * std::sin(x * 0.37f) * std::sin(y * 0.23f);
+				float length = std::sqrt(nx * nx + 1.0f + nz * nz);
+				snprintf(line, sizeof(line), "vn %f %f %f\n", nx / length, 1.0f / length, nz / length);
+				text += line;
+			}
+		}
+
+		text += "usemtl Synthetic\ns off\n";
+		for (unsigned y = 0; y < pGrid; ++y) {
+			for (unsigned x = 0; x < pGrid; ++x) {
+				//obj indices are 1 based, every vertex has the uv and normal of the same index
+				unsigned a = y * side + x + 1, b = a + 1, c = a + side + 1, d = a + side;
+				if (pQuads)
+					snprintf(line, sizeof(line), "f %u/%u/%u %u/%u/%u %u/%u/%u %u/%u/%u\n", a, a, a, b, b, b, c, c, c, d, d, d);
+				else
+					snprintf(line, sizeof(line), "f %u/%u/%u %u/%u/%u %u/%u/%u\nf %u/%u/%u %u/%u/%u %u/%u/%u\n", a, a, a, b, b, b, c, c, c, a, a, a, c, c, c, d, d, d);
+				text += line;
+			}
+		}
+		return text;
+	}
+
+	//write pText to pFileName, false if that fails
+	static bool writeFile(const std::string& pFileName, const std::string& pText)
+	{
+		FILE* file = fopen(pFileName.c_str(), "wb");
+		if (file == NULL)
+			return false;
+		bool written = fwrite(pText.data(), 1, pText.size(), file) == pText.size();
+		return (fclose(file) == 0) && written;
+	}
+
+private:
+	static unsigned& failures()
+	{
+		static unsigned count = 0;
+		return count;
+	}
+};
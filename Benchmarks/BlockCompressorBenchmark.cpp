@@ -0,0 +1,137 @@
+#include "Benchmark.h"
+#include "BlockCompressor.h"
+#include "PngDecoder.h"
+#include <algorithm>
+#include <random>
+#include <thread>
+#include <cstring>
+
+using namespace std;
+
+/**
+ * Quality and speed of BlockCompressor. Synthetic blocks first: flat and two color blocks have to come out (nearly)
+ * exact, and mips smaller than a block have to repeat their edge texels. Then every format and quality on the textures
+ * of the renderer, decoded with decompress and measured with psnr: each has a minimum psnr, a higher quality may not be
+ * worse than a lower one and compressing on more threads or at a row pitch has to give the blocks of one thread.
+ * usage: BlockCompressorBenchmark [png files, default the two textures of the scene]
+ */
+namespace {
+	typedef BlockCompressor::Format Format;
+	typedef BlockCompressor::Quality Quality;
+
+	const char* formatNames[] = { "BC1", "BC3", "BC5", "BC7" };
+	const char* qualityNames[] = { "fast", "normal", "high" };
+
+	//the psnr a format has to reach at any quality on the scene textures, about a dB below what it reaches now
+	const double minimumPsnr[] = { 41.0, 42.5, 50.0, 50.0 };
+	//and on blocks of one or two colors
+	const double minimumBlockPsnr[] = { 35.0, 36.0, 1e30, 50.0 };
+
+	double roundTrip(const uint8_t* pPixels, uint32_t pWidth, uint32_t pHeight, Format pFormat, Quality pQuality, vector<uint8_t>& pDecoded)
+	{
+		BlockCompressor::Settings settings = { pFormat, pQuality, 1 };
+		vector<uint8_t> blocks(BlockCompressor::compressedSize(pFormat, pWidth, pHeight));
+		BlockCompressor::compress(pPixels, pWidth, pHeight, pWidth * 4, false, &blocks[0], settings);
+		pDecoded.resize((size_t)pWidth * pHeight * 4);
+		BlockCompressor::decompress(&blocks[0], pWidth, pHeight, pFormat, false, &pDecoded[0]);
+		return BlockCompressor::psnr(pPixels, &pDecoded[0], (size_t)pWidth * pHeight, pFormat, false);
+	}
+
+	void checkBlocks()
+	{
+		mt19937 random(3);
+		for (int f = 0; f < 4; ++f) {
+			for (int q = 0; q < 3; ++q) {
+				double worst = 1e30;
+				vector<uint8_t> decoded;
+				for (int test = 0; test < 2000; ++test) {
+					//flat blocks, then checkerboards of two colors
+					uint8_t pixels[64];
+					uint8_t colors[2][4];
+					for (int c = 0; c < 4; ++c) {
+						colors[0][c] = (uint8_t)random();
+						colors[1][c] = (test % 2) ? (uint8_t)random() : colors[0][c];
+					}
+					for (int i = 0; i < 16; ++i)
+						memcpy(&pixels[i * 4], colors[(i + i / 4) & 1], 4);
+					worst = min(worst, roundTrip(pixels, 4, 4, (Format)f, (Quality)q, decoded));
+				}
+				Benchmark::check(worst >= minimumBlockPsnr[f], string(formatNames[f]) + " " + qualityNames[q] + ": psnr of flat and two color blocks");
+			}
+		}
+
+		//1x1, 2x2 and 3x5 images: the part of the block outside the image repeats the edge, so a flat image stays flat
+		const uint32_t sizes[][2] = { { 1, 1 }, { 2, 2 }, { 3, 5 } };
+		for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+			vector<uint8_t> pixels((size_t)sizes[s][0] * sizes[s][1] * 4);
+			for (size_t i = 0; i < pixels.size(); ++i)
+				pixels[i] = (uint8_t)(60 + (i % 4) * 40);
+			vector<uint8_t> decoded;
+			double psnr = roundTrip(&pixels[0], sizes[s][0], sizes[s][1], BlockCompressor::FormatBC7, BlockCompressor::QualityNormal, decoded);
+			Benchmark::check(psnr >= minimumBlockPsnr[BlockCompressor::FormatBC7], "BC7 of a flat " + to_string(sizes[s][0]) + "x" + to_string(sizes[s][1]) + " image");
+		}
+	}
+
+	void checkImage(const string& pFileName)
+	{
+		PngDecoder::Image image;
+		if (!Benchmark::check(PngDecoder::load(pFileName, image) && (image.format == PngDecoder::FormatRGBA8 || image.format == PngDecoder::FormatBGRA8), "load " + pFileName))
+			return;
+		bool bgra = image.format == PngDecoder::FormatBGRA8;
+		double megapixels = (double)image.width * image.height / 1e6;
+		//at least 4, so the split over threads is checked on any machine
+		unsigned threads = max(4u, thread::hardware_concurrency());
+		printf("%s: %ux%u, 1 and %u threads (%u hardware threads)\n", pFileName.c_str(), image.width, image.height, threads, thread::hardware_concurrency());
+
+		for (int f = 0; f < 4; ++f) {
+			double previousPsnr = 0;
+			for (int q = 0; q < 3; ++q) {
+				string name = string(formatNames[f]) + " " + qualityNames[q];
+				BlockCompressor::Settings settings = { (Format)f, (Quality)q, 1 };
+				size_t size = BlockCompressor::compressedSize(settings.format, image.width, image.height);
+				vector<uint8_t> blocks(size);
+				double seconds = Benchmark::time([&]() { BlockCompressor::compress(&image.pixels[0], image.width, image.height, image.bytesPerRow, bgra, &blocks[0], settings); }, 2);
+
+				settings.threads = threads;
+				vector<uint8_t> threadedBlocks(size);
+				double threadedSeconds = Benchmark::time([&]() { BlockCompressor::compress(&image.pixels[0], image.width, image.height, image.bytesPerRow, bgra, &threadedBlocks[0], settings); }, 2);
+				Benchmark::check(threadedBlocks == blocks, name + ": more threads give the blocks of one thread");
+
+				//at a pitch like an upload heap footprint, with the bytes in between left alone
+				size_t rowBytes = size / ((image.height + 3) / 4), pitch = rowBytes + 256;
+				vector<uint8_t> pitched(pitch * ((image.height + 3) / 4), 0xcd);
+				BlockCompressor::compress(&image.pixels[0], image.width, image.height, image.bytesPerRow, bgra, &pitched[0], pitch, settings);
+				bool samePitched = true;
+				for (size_t row = 0; row < pitched.size() / pitch; ++row) {
+					samePitched &= memcmp(&pitched[row * pitch], &blocks[row * rowBytes], rowBytes) == 0;
+					samePitched &= pitched[row * pitch + rowBytes] == 0xcd && pitched[row * pitch + pitch - 1] == 0xcd;
+				}
+				Benchmark::check(samePitched, name + ": compressing at a row pitch gives the same blocks");
+
+				vector<uint8_t> decoded(image.pixels.size());
+				BlockCompressor::decompress(&blocks[0], image.width, image.height, settings.format, bgra, &decoded[0]);
+				double psnr = BlockCompressor::psnr(&image.pixels[0], &decoded[0], (size_t)image.width * image.height, settings.format, bgra);
+				Benchmark::check(psnr >= minimumPsnr[f], name + ": psnr of " + pFileName);
+				Benchmark::check(psnr >= previousPsnr - 0.05, name + ": at least the psnr of the quality below it");
+				previousPsnr = psnr;
+
+				printf("  %s %-6s  psnr %5.2f dB  %6.2f MP/s  %6.2f MP/s on %u threads\n", formatNames[f], qualityNames[q], psnr,
+					megapixels / seconds, megapixels / threadedSeconds, threads);
+			}
+		}
+	}
+}
+
+int main(int pArgumentCount, char** pArguments)
+{
+	checkBlocks();
+	if (pArgumentCount > 1) {
+		for (int i = 1; i < pArgumentCount; ++i)
+			checkImage(pArguments[i]);
+	}
+	else {
+		checkImage(ASSET_DIRECTORY "MantaRay_Base.png");
+		checkImage(ASSET_DIRECTORY "dive_scooter_Base1k.png");
+	}
+	return Benchmark::result();
+}
@@ -0,0 +1,169 @@
+#include "Benchmark.h"
+#include "HeapAllocator.h"
+#include <map>
+#include <random>
+
+using namespace std;
+
+/**
+ * Checks HeapAllocator against a map of the ranges it handed out: random allocations and releases with 4 KB, 64 KB
+ * and 4 MB alignments must never overlap, leave the range or miss their alignment, and releasing everything has to
+ * merge the range back into one block. Then the edge cases: the whole range at a big alignment, odd sizes, exactly
+ * full and largestFree. Then times release + allocate on heaps with different numbers of live allocations, the way
+ * streaming keeps replacing textures in a ResourceHeap block.
+ */
+namespace {
+	struct Allocation {
+		HeapAllocator::Handle handle;
+		uint64_t offset;
+	};
+
+	void checkChurn()
+	{
+		const uint64_t heapSize = 256ull << 20, granularity = 4096;
+		mt19937_64 random(1);
+		HeapAllocator allocator(heapSize, granularity);
+		vector<Allocation> live;
+		map<uint64_t, uint64_t> ranges;	//offset -> size of what is allocated
+		bool aligned = true, inside = true, separate = true, sized = true;
+
+		auto releaseRandom = [&]() {
+			size_t i = random() % live.size();
+			allocator.release(live[i].handle);
+			ranges.erase(live[i].offset);
+			live[i] = live.back();
+			live.pop_back();
+		};
+
+		for (int operation = 0; operation < 200000; ++operation) {
+			if (!live.empty() && random() % 100 >= 52) {
+				releaseRandom();
+				continue;
+			}
+			uint64_t size = (random() % 4 == 0) ? random() % (4 << 20) + 1 : random() % (64 << 10) + 1;
+			uint64_t alignment = (random() % 3 == 0) ? 65536 : (random() % 5 == 0) ? (4 << 20) : 4096;
+			HeapAllocator::Handle handle = allocator.allocate(size, alignment);
+			if (handle == HeapAllocator::invalidHandle) {
+				if (!live.empty())
+					releaseRandom();
+				continue;
+			}
+
+			uint64_t offset = allocator.getOffset(handle), allocated = allocator.getSize(handle);
+			aligned &= offset % alignment == 0;
+			inside &= offset + allocated <= heapSize;
+			sized &= allocated >= size && allocated % granularity == 0;
+			auto next = ranges.lower_bound(offset);
+			if (next != ranges.end())
+				separate &= next->first >= offset + allocated;
+			if (next != ranges.begin()) {
+				auto previous = prev(next);
+				separate &= previous->first + previous->second <= offset;
+			}
+			ranges[offset] = allocated;
+			Allocation allocation = { handle, offset };
+			live.push_back(allocation);
+		}
+		Benchmark::check(aligned, "churn: every offset is aligned");
+		Benchmark::check(inside, "churn: every allocation is inside the range");
+		Benchmark::check(sized, "churn: every allocation is big enough and a multiple of the granularity");
+		Benchmark::check(separate, "churn: allocations never overlap");
+
+		HeapAllocator::Stats stats = allocator.getStats();
+		uint64_t usedBytes = 0;
+		for (auto i = ranges.begin(); i != ranges.end(); ++i)
+			usedBytes += i->second;
+		Benchmark::check(stats.usedBytes == usedBytes && stats.allocations == live.size(), "churn: stats count what is allocated");
+		printf("churn     %u live  %.1f MB used  %u free blocks  largest %.1f MB  fragmentation %.3f\n", stats.allocations,
+			Benchmark::megabytes((size_t)stats.usedBytes), stats.freeBlocks, Benchmark::megabytes((size_t)stats.largestFree), stats.fragmentation);
+
+		while (!live.empty())
+			releaseRandom();
+		stats = allocator.getStats();
+		Benchmark::check(allocator.empty() && stats.freeBlocks == 1 && stats.largestFree == heapSize, "churn: releasing everything merges the range again");
+	}
+
+	void checkEdges()
+	{
+		HeapAllocator whole(64ull << 20, 4096);
+		HeapAllocator::Handle handle = whole.allocate(64ull << 20, 65536);
+		Benchmark::check(handle != HeapAllocator::invalidHandle && whole.getOffset(handle) == 0, "the whole range at 64 KB alignment");
+
+		//41 granules is in the middle of a size class, the lists above it are empty
+		HeapAllocator odd(41 * 4096, 4096);
+		Benchmark::check(odd.allocate(41 * 4096, 4096) != HeapAllocator::invalidHandle, "the whole range of 41 granules");
+
+		HeapAllocator largest(1 << 20, 4096);
+		HeapAllocator::Handle first = largest.allocate(4096, 4096);
+		largest.allocate(40 * 4096, 4096);
+		largest.release(first);
+		Benchmark::check(largest.allocate(largest.getStats().largestFree, 4096) != HeapAllocator::invalidHandle, "an allocation of largestFree");
+
+		HeapAllocator full(1 << 20, 4096);
+		vector<HeapAllocator::Handle> handles;
+		bool filled = true;
+		for (int i = 0; i < 256; ++i) {
+			handles.push_back(full.allocate(4096, 4096));
+			filled &= handles.back() != HeapAllocator::invalidHandle;
+		}
+		Benchmark::check(filled, "filling the range exactly");
+		Benchmark::check(full.allocate(1, 1) == HeapAllocator::invalidHandle, "nothing fits a full range");
+		for (int i = 0; i < 256; i += 2)
+			full.release(handles[i]);
+		Benchmark::check(full.allocate(8192, 4096) == HeapAllocator::invalidHandle, "two granules don't fit a checkerboard");
+		for (int i = 1; i < 256; i += 2)
+			full.release(handles[i]);
+		Benchmark::check(full.allocate(1 << 20, 4096) != HeapAllocator::invalidHandle, "the whole range after releasing the checkerboard");
+	}
+
+	//replace random allocations of a heap that holds pLive of them, half at 64 KB alignment and a quarter bigger than 64 KB
+	void churn(const char* pName, uint64_t pHeapSize, int pLive)
+	{
+		mt19937_64 random(7);
+		HeapAllocator allocator(pHeapSize, 4096);
+		auto size = [&]() { return (random() % 4 == 0) ? 65536 + random() % (1 << 20) : 512 + random() % (60 << 10); };
+		auto alignment = [&]() { return (random() % 2) ? 65536ull : 4096ull; };
+
+		vector<HeapAllocator::Handle> handles;
+		for (int i = 0; i < pLive; ++i) {
+			HeapAllocator::Handle handle = allocator.allocate(size(), alignment());
+			if (handle != HeapAllocator::invalidHandle)
+				handles.push_back(handle);
+		}
+
+		const int operations = 2000000;
+		int failed = 0;
+		double seconds = Benchmark::time([&]() {
+			for (int i = 0; i < operations; ++i) {
+				size_t replaced = random() % handles.size();
+				allocator.release(handles[replaced]);
+				HeapAllocator::Handle handle = allocator.allocate(size(), alignment());
+				if (handle == HeapAllocator::invalidHandle) {
+					failed++;
+					handle = allocator.allocate(4096, 4096);
+				}
+				if (handle != HeapAllocator::invalidHandle) {
+					handles[replaced] = handle;
+				}
+				else {
+					handles[replaced] = handles.back();
+					handles.pop_back();
+				}
+			}
+		}, 1);
+
+		HeapAllocator::Stats stats = allocator.getStats();
+		printf("%-10s %6u live  %5.1f%% full  %6u free blocks  fragmentation %.3f  %5.0f ns per release + allocate  %d failed\n", pName, stats.allocations,
+			100.0 * stats.usedBytes / stats.size, stats.freeBlocks, stats.fragmentation, seconds * 1e9 / operations, failed);
+	}
+}
+
+int main()
+{
+	checkChurn();
+	checkEdges();
+	churn("256 MB", 256ull << 20, 800);
+	churn("256 MB", 256ull << 20, 1200);
+	churn("4 GB", 4ull << 30, 20000);
+	return Benchmark::result();
+}
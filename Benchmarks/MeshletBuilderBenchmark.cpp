@@ -0,0 +1,236 @@
+#include "Benchmark.h"
+#include "MeshletBuilder.h"
+#include <random>
+#include <algorithm>
+#include <cstdlib>
+
+using namespace std;
+
+/**
+ * Checks MeshletBuilder on a sphere and a grid: the vertex and triangle limits, the triangles that come out against the
+ * index buffer that went in, the bounding spheres against every vertex and isBackfacing and isOutsideFrustum against
+ * testing every triangle and vertex on their own from a few hundred random cameras. Then times build in triangles/s.
+ * usage: MeshletBuilderBenchmark [grid size of the timed mesh, 1000 is 2 million triangles]
+ */
+namespace {
+	//positions with other data in between, like the vertex buffers build gets them from
+	struct Vertex {
+		glm::vec3 position;
+		glm::vec2 uv;
+		float padding;
+	};
+
+	struct TestMesh {
+		vector<Vertex> vertices;
+		vector<uint32_t> indices;
+
+		glm::vec3 position(uint32_t pIndex) const { return vertices[pIndex].position; }
+	};
+
+	//a closed sphere of pRings x pSegments quads, triangles wound so cross(p1 - p0, p2 - p0) points outward
+	TestMesh sphere(unsigned pRings, unsigned pSegments)
+	{
+		TestMesh mesh;
+		for (unsigned r = 0; r <= pRings; ++r) {
+			float theta = 3.14159265f * r / pRings;
+			for (unsigned s = 0; s <= pSegments; ++s) {
+				float phi = 2.0f * 3.14159265f * s / pSegments;
+				Vertex vertex = { glm::vec3(sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi)), glm::vec2((float)s / pSegments, (float)r / pRings), 0.0f };
+				mesh.vertices.push_back(vertex);
+			}
+		}
+		for (unsigned r = 0; r < pRings; ++r) {
+			for (unsigned s = 0; s < pSegments; ++s) {
+				uint32_t a = r * (pSegments + 1) + s, b = a + 1, c = a + pSegments + 2, d = a + pSegments + 1;
+				if (r > 0) {
+					uint32_t triangle[3] = { a, b, d };
+					mesh.indices.insert(mesh.indices.end(), triangle, triangle + 3);
+				}
+				if (r + 1 < pRings) {
+					uint32_t triangle[3] = { b, c, d };
+					mesh.indices.insert(mesh.indices.end(), triangle, triangle + 3);
+				}
+			}
+		}
+		return mesh;
+	}
+
+	//a flat pGrid x pGrid grid in the xz plane, facing up
+	TestMesh grid(unsigned pGrid)
+	{
+		TestMesh mesh;
+		unsigned side = pGrid + 1;
+		for (unsigned z = 0; z < side; ++z) {
+			for (unsigned x = 0; x < side; ++x) {
+				Vertex vertex = { glm::vec3(x - pGrid * 0.5f, 0.0f, z - pGrid * 0.5f), glm::vec2((float)x / pGrid, (float)z / pGrid), 0.0f };
+				mesh.vertices.push_back(vertex);
+			}
+		}
+		for (unsigned z = 0; z < pGrid; ++z) {
+			for (unsigned x = 0; x < pGrid; ++x) {
+				uint32_t a = z * side + x, b = a + 1, c = a + side + 1, d = a + side;
+				uint32_t triangles[6] = { a, d, c, a, c, b };
+				mesh.indices.insert(mesh.indices.end(), triangles, triangles + 6);
+			}
+		}
+		return mesh;
+	}
+
+	void build(const TestMesh& pMesh, MeshletBuilder::MeshletData& pData, unsigned pMaxVertices, unsigned pMaxTriangles)
+	{
+		MeshletBuilder::build(&pMesh.indices[0], pMesh.indices.size(), &pMesh.vertices[0].position, sizeof(Vertex), pMesh.vertices.size(), pData, pMaxVertices, pMaxTriangles);
+	}
+
+	uint32_t meshIndex(const MeshletBuilder::MeshletData& pData, const MeshletBuilder::Meshlet& pMeshlet, uint32_t pTriangle, int pCorner)
+	{
+		return pData.vertices[pMeshlet.vertexOffset + pData.triangles[pMeshlet.triangleOffset + pTriangle * 3 + pCorner]];
+	}
+
+	//the limits hold, the triangles come out in index buffer order and no meshlet could have taken the next triangle
+	void checkLimits(const string& pName, const TestMesh& pMesh, unsigned pMaxVertices, unsigned pMaxTriangles)
+	{
+		MeshletBuilder::MeshletData data;
+		build(pMesh, data, pMaxVertices, pMaxTriangles);
+		string name = pName + " " + to_string(pMaxVertices) + "/" + to_string(pMaxTriangles);
+
+		bool withinLimits = true, localIndices = true, uniqueVertices = true, full = true;
+		vector<uint32_t> indices;
+		for (size_t m = 0; m < data.meshlets.size(); ++m) {
+			const MeshletBuilder::Meshlet& meshlet = data.meshlets[m];
+			withinLimits &= meshlet.vertexCount >= 1 && meshlet.vertexCount <= pMaxVertices && meshlet.triangleCount >= 1 && meshlet.triangleCount <= pMaxTriangles;
+			for (uint32_t i = 0; i < meshlet.triangleCount * 3; ++i)
+				localIndices &= data.triangles[meshlet.triangleOffset + i] < meshlet.vertexCount;
+			for (uint32_t t = 0; t < meshlet.triangleCount && localIndices; ++t) {
+				for (int c = 0; c < 3; ++c)
+					indices.push_back(meshIndex(data, meshlet, t, c));
+			}
+			vector<uint32_t> vertices(data.vertices.begin() + meshlet.vertexOffset, data.vertices.begin() + meshlet.vertexOffset + meshlet.vertexCount);
+			sort(vertices.begin(), vertices.end());
+			uniqueVertices &= adjacent_find(vertices.begin(), vertices.end()) == vertices.end();
+
+			if (m + 1 < data.meshlets.size()) {
+				//the first triangle of the next meshlet didn't fit
+				const MeshletBuilder::Meshlet& next = data.meshlets[m + 1];
+				uint32_t corners[3] = { meshIndex(data, next, 0, 0), meshIndex(data, next, 0, 1), meshIndex(data, next, 0, 2) };
+				unsigned newVertices = 0;
+				for (int c = 0; c < 3; ++c) {
+					bool seen = binary_search(vertices.begin(), vertices.end(), corners[c]);
+					for (int previous = 0; previous < c; ++previous)
+						seen |= corners[previous] == corners[c];
+					newVertices += !seen;
+				}
+				full &= meshlet.vertexCount + newVertices > pMaxVertices || meshlet.triangleCount + 1 > pMaxTriangles;
+			}
+		}
+		Benchmark::check(withinLimits, name + ": meshlets within the vertex and triangle limits");
+		Benchmark::check(localIndices, name + ": local indices within the meshlet");
+		Benchmark::check(uniqueVertices, name + ": every vertex once per meshlet");
+		Benchmark::check(full, name + ": a meshlet only ends when the next triangle doesn't fit");
+		Benchmark::check(indices == pMesh.indices, name + ": meshlets give back the index buffer in order");
+	}
+
+	//every vertex is in the bounding sphere, and every triangle normal in the cone
+	void checkBounds(const string& pName, const TestMesh& pMesh)
+	{
+		MeshletBuilder::MeshletData data;
+		build(pMesh, data, MeshletBuilder::defaultMaxVertices, MeshletBuilder::defaultMaxTriangles);
+
+		bool inSphere = true, inCone = true;
+		for (size_t m = 0; m < data.meshlets.size(); ++m) {
+			const MeshletBuilder::Meshlet& meshlet = data.meshlets[m];
+			for (uint32_t v = 0; v < meshlet.vertexCount; ++v)
+				inSphere &= glm::length(pMesh.position(data.vertices[meshlet.vertexOffset + v]) - meshlet.center) <= meshlet.radius * 1.0001f + 1e-6f;
+			if (meshlet.coneCutoff >= 1.0f)
+				continue;
+			//a cutoff below 1 is the sine of the angle to the normal furthest from the axis, so its cosine is the lowest dot
+			float minimumDot = sqrtf(1.0f - meshlet.coneCutoff * meshlet.coneCutoff);
+			for (uint32_t t = 0; t < meshlet.triangleCount; ++t) {
+				glm::vec3 p0 = pMesh.position(meshIndex(data, meshlet, t, 0));
+				glm::vec3 normal = glm::cross(pMesh.position(meshIndex(data, meshlet, t, 1)) - p0, pMesh.position(meshIndex(data, meshlet, t, 2)) - p0);
+				if (glm::length(normal) > 0.0f)
+					inCone &= glm::dot(glm::normalize(normal), meshlet.coneAxis) >= minimumDot - 1e-4f;
+			}
+		}
+		Benchmark::check(inSphere, pName + ": every vertex is in the bounding sphere of its meshlet");
+		Benchmark::check(inCone, pName + ": every triangle normal is in the cone of its meshlet");
+	}
+
+	//from random cameras: a meshlet that is backfacing has no triangle that faces the camera (the dot of its normal with
+	//the view direction is never negative), a meshlet outside the frustum has every vertex outside the same clip plane
+	void checkCulling(const string& pName, const TestMesh& pMesh)
+	{
+		MeshletBuilder::MeshletData data;
+		build(pMesh, data, MeshletBuilder::defaultMaxVertices, MeshletBuilder::defaultMaxTriangles);
+		mt19937 random(1234);
+		uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+		size_t backfacing = 0, outside = 0, tests = 0;
+		bool backfacingCorrect = true, outsideCorrect = true;
+		for (int camera = 0; camera < 300; ++camera) {
+			glm::vec3 eye(unit(random) * 6.0f, unit(random) * 6.0f, unit(random) * 6.0f);
+			glm::vec3 target(unit(random), unit(random), unit(random));
+			glm::mat4 viewProjection = glm::perspective(1.0f, 16.0f / 9.0f, 0.1f, 20.0f) * glm::lookAt(eye, target, glm::vec3(0.0f, 1.0f, 0.0f));
+			glm::vec4 planes[6];
+			MeshletBuilder::extractFrustumPlanes(viewProjection, planes);
+
+			for (size_t m = 0; m < data.meshlets.size(); ++m) {
+				const MeshletBuilder::Meshlet& meshlet = data.meshlets[m];
+				tests++;
+				if (MeshletBuilder::isBackfacing(meshlet, eye)) {
+					backfacing++;
+					for (uint32_t t = 0; t < meshlet.triangleCount; ++t) {
+						glm::vec3 p0 = pMesh.position(meshIndex(data, meshlet, t, 0));
+						glm::vec3 normal = glm::cross(pMesh.position(meshIndex(data, meshlet, t, 1)) - p0, pMesh.position(meshIndex(data, meshlet, t, 2)) - p0);
+						backfacingCorrect &= glm::dot(normal, p0 - eye) >= -1e-5f;
+					}
+				}
+				if (MeshletBuilder::isOutsideFrustum(meshlet, planes)) {
+					outside++;
+					//x >= -w, x <= w, y >= -w, y <= w, z >= 0, z <= w
+					bool planeOutside[6] = { true, true, true, true, true, true };
+					for (uint32_t v = 0; v < meshlet.vertexCount; ++v) {
+						glm::vec4 clip = viewProjection * glm::vec4(pMesh.position(data.vertices[meshlet.vertexOffset + v]), 1.0f);
+						float inside[6] = { clip.x + clip.w, clip.w - clip.x, clip.y + clip.w, clip.w - clip.y, clip.z, clip.w - clip.z };
+						for (int p = 0; p < 6; ++p)
+							planeOutside[p] &= inside[p] < 1e-5f;
+					}
+					bool anyPlane = false;
+					for (int p = 0; p < 6; ++p)
+						anyPlane |= planeOutside[p];
+					outsideCorrect &= anyPlane;
+				}
+			}
+		}
+		Benchmark::check(backfacingCorrect, pName + ": isBackfacing only culls meshlets without a front facing triangle");
+		Benchmark::check(outsideCorrect, pName + ": isOutsideFrustum only culls meshlets outside a clip plane");
+		Benchmark::check(backfacing > 0 && backfacing < tests, pName + ": isBackfacing culls some meshlets but not all");
+		Benchmark::check(outside > 0 && outside < tests, pName + ": isOutsideFrustum culls some meshlets but not all");
+		printf("%-6s %5zu meshlets  %4.1f%% backfacing  %4.1f%% outside the frustum\n", pName.c_str(), data.meshlets.size(), 100.0 * backfacing / tests, 100.0 * outside / tests);
+	}
+}
+
+int main(int pArgumentCount, char** pArguments)
+{
+	unsigned timedGrid = (pArgumentCount > 1) ? (unsigned)atoi(pArguments[1]) : 1000;
+
+	TestMesh testSphere = sphere(48, 96);
+	TestMesh testGrid = grid(64);
+	const unsigned limits[][2] = { { MeshletBuilder::defaultMaxVertices, MeshletBuilder::defaultMaxTriangles }, { 3, 1 }, { 4, 124 }, { 32, 32 }, { 256, 512 } };
+	for (size_t i = 0; i < sizeof(limits) / sizeof(limits[0]); ++i) {
+		checkLimits("sphere", testSphere, limits[i][0], limits[i][1]);
+		checkLimits("grid", testGrid, limits[i][0], limits[i][1]);
+	}
+	//more than 256 is clamped, local indices are 8 bit
+	checkLimits("sphere", testSphere, 256, 1024);
+	checkBounds("sphere", testSphere);
+	checkBounds("grid", testGrid);
+	checkCulling("sphere", testSphere);
+	checkCulling("grid", testGrid);
+
+	TestMesh timed = grid(timedGrid);
+	MeshletBuilder::MeshletData data;
+	double seconds = Benchmark::time([&]() { build(timed, data, MeshletBuilder::defaultMaxVertices, MeshletBuilder::defaultMaxTriangles); });
+	size_t triangles = timed.indices.size() / 3;
+	printf("build  %zu triangles  %zu meshlets  %.1f M triangles/s\n", triangles, data.meshlets.size(), triangles / seconds / 1e6);
+	return Benchmark::result();
+}
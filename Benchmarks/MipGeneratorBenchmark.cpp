@@ -0,0 +1,178 @@
+#include "Benchmark.h"
+#include "MipGenerator.h"
+#include "PngDecoder.h"
+#include "ParallelFor.h"
+#include <random>
+#include <algorithm>
+
+using namespace std;
+
+/**
+ * Mip chain speed of MipGenerator on the textures of the scene, in ms per megapixel of level 0. The box filter is checked
+ * against a plain reference first: every texel of a level is the area weighted average of the texels of the level above
+ * it covers, in double precision linear space, and the 8 bit results may differ by one step at most. Both filters have
+ * to give the same bytes on one thread and on all of them and keep a flat image flat. An odd sized random image covers
+ * levels that don't halve evenly.
+ * usage: MipGeneratorBenchmark [png files, default the two textures of the scene]
+ */
+namespace {
+	double toLinear(uint8_t pValue, bool pSrgb)
+	{
+		double value = pValue / 255.0;
+		if (!pSrgb)
+			return value;
+		return (value <= 0.04045) ? value / 12.92 : pow((value + 0.055) / 1.055, 2.4);
+	}
+
+	uint8_t fromLinear(double pValue, bool pSrgb)
+	{
+		double value = min(max(pValue, 0.0), 1.0);
+		if (pSrgb)
+			value = (value <= 0.0031308) ? value * 12.92 : 1.055 * pow(value, 1.0 / 2.4) - 0.055;
+		return (uint8_t)(value * 255.0 + 0.5);
+	}
+
+	//how much of input texel pTexel the output texel pOutput covers, for pInput texels going to pOutputSize
+	double coverage(uint32_t pTexel, uint32_t pOutput, uint32_t pInputSize, uint32_t pOutputSize)
+	{
+		double scale = (double)pInputSize / pOutputSize;
+		double low = pOutput * scale, high = (pOutput + 1) * scale;
+		return max(0.0, min(pTexel + 1.0, high) - max((double)pTexel, low));
+	}
+
+	//the box filtered chain, every level from the unrounded level above like MipGenerator does. returns the chain bytes
+	vector<uint8_t> referenceBox(const uint8_t* pPixels, uint32_t pWidth, uint32_t pHeight, bool pSrgb)
+	{
+		uint32_t levelCount = MipGenerator::levelCount(pWidth, pHeight);
+		vector<MipGenerator::Level> levels = MipGenerator::levels(pWidth, pHeight, levelCount);
+		vector<uint8_t> chain(levels.back().offset + (size_t)levels.back().width * levels.back().height * 4);
+		copy(pPixels, pPixels + (size_t)pWidth * pHeight * 4, chain.begin());
+
+		vector<double> above((size_t)pWidth * pHeight * 4), level;
+		for (size_t i = 0; i < above.size(); ++i)
+			above[i] = toLinear(pPixels[i], pSrgb && i % 4 != 3);
+		for (uint32_t l = 1; l < levelCount; ++l) {
+			uint32_t inputWidth = levels[l - 1].width, inputHeight = levels[l - 1].height, width = levels[l].width, height = levels[l].height;
+			level.assign((size_t)width * height * 4, 0.0);
+			for (uint32_t y = 0; y < height; ++y) {
+				for (uint32_t x = 0; x < width; ++x) {
+					double* texel = &level[((size_t)y * width + x) * 4];
+					double area = 0.0;
+					//the texels it covers start at y * scale, the one before can't overlap
+					for (uint32_t inputY = y * inputHeight / height; inputY < inputHeight; ++inputY) {
+						double coverY = coverage(inputY, y, inputHeight, height);
+						if (coverY == 0.0)
+							break;
+						for (uint32_t inputX = x * inputWidth / width; inputX < inputWidth; ++inputX) {
+							double weight = coverY * coverage(inputX, x, inputWidth, width);
+							if (weight == 0.0)
+								break;
+							for (int c = 0; c < 4; ++c)
+								texel[c] += weight * above[((size_t)inputY * inputWidth + inputX) * 4 + c];
+							area += weight;
+						}
+					}
+					for (int c = 0; c < 4; ++c) {
+						texel[c] /= area;
+						chain[levels[l].offset + ((size_t)y * width + x) * 4 + c] = fromLinear(texel[c], pSrgb && c != 3);
+					}
+				}
+			}
+			above.swap(level);
+		}
+		return chain;
+	}
+
+	//the most two chains differ by in one channel
+	int maxDifference(const vector<uint8_t>& pA, const vector<uint8_t>& pB)
+	{
+		int difference = 0;
+		for (size_t i = 0; i < min(pA.size(), pB.size()); ++i)
+			difference = max(difference, abs((int)pA[i] - (int)pB[i]));
+		return difference;
+	}
+
+	vector<uint8_t> generate(const uint8_t* pPixels, uint32_t pWidth, uint32_t pHeight, MipGenerator::Filter pFilter, bool pSrgb, unsigned pThreads)
+	{
+		vector<uint8_t> chain(pPixels, pPixels + (size_t)pWidth * pHeight * 4);
+		MipGenerator::Settings settings = { pFilter, pSrgb, pThreads };
+		MipGenerator::generate(chain, pWidth, pHeight, settings);
+		return chain;
+	}
+
+	void checkImage(const uint8_t* pPixels, uint32_t pWidth, uint32_t pHeight, const string& pName)
+	{
+		vector<uint8_t> reference = referenceBox(pPixels, pWidth, pHeight, true);
+		vector<uint8_t> box = generate(pPixels, pWidth, pHeight, MipGenerator::FilterBox, true, 0);
+		Benchmark::check(box.size() == reference.size() && maxDifference(box, reference) <= 1, pName + ": box filter within one step of the reference");
+		vector<uint8_t> linearReference = referenceBox(pPixels, pWidth, pHeight, false);
+		Benchmark::check(maxDifference(generate(pPixels, pWidth, pHeight, MipGenerator::FilterBox, false, 0), linearReference) <= 1,
+			pName + ": box filter without srgb within one step of the reference");
+
+		Benchmark::check(generate(pPixels, pWidth, pHeight, MipGenerator::FilterBox, true, 1) == box, pName + ": box filter gives the same bytes on one thread");
+		Benchmark::check(generate(pPixels, pWidth, pHeight, MipGenerator::FilterKaiser, true, 1) == generate(pPixels, pWidth, pHeight, MipGenerator::FilterKaiser, true, 0),
+			pName + ": kaiser filter gives the same bytes on one thread");
+	}
+
+	void checkFlat()
+	{
+		//odd sides, the kaiser lobes reach over the edges
+		vector<uint8_t> flat((size_t)37 * 23 * 4);
+		for (size_t i = 0; i < flat.size(); ++i)
+			flat[i] = (uint8_t)(40 + i % 4 * 50);
+		bool stays = true;
+		for (int filter = MipGenerator::FilterBox; filter <= MipGenerator::FilterKaiser; ++filter) {
+			vector<uint8_t> chain = generate(&flat[0], 37, 23, (MipGenerator::Filter)filter, true, 0);
+			for (size_t i = 0; i < chain.size(); ++i)
+				stays &= chain[i] == flat[i % 4];
+		}
+		Benchmark::check(stays, "a flat image stays flat in every level");
+	}
+
+	void timeImage(const uint8_t* pPixels, uint32_t pWidth, uint32_t pHeight, const string& pName)
+	{
+		double megapixels = (double)pWidth * pHeight / 1e6;
+		printf("%s: %ux%u, %u levels\n", pName.c_str(), pWidth, pHeight, MipGenerator::levelCount(pWidth, pHeight));
+		const char* filterNames[] = { "box", "kaiser" };
+		for (int filter = MipGenerator::FilterBox; filter <= MipGenerator::FilterKaiser; ++filter) {
+			//level 0 stays as it is, every run writes the same smaller levels again
+			vector<uint8_t> chain(pPixels, pPixels + (size_t)pWidth * pHeight * 4);
+			MipGenerator::Settings settings = { (MipGenerator::Filter)filter, true, 1 };
+			double single = Benchmark::time([&]() { MipGenerator::generate(chain, pWidth, pHeight, settings); }, 5);
+			settings.threads = 0;
+			double all = Benchmark::time([&]() { MipGenerator::generate(chain, pWidth, pHeight, settings); }, 5);
+			printf("  %-6s  %6.2f ms/MP on one thread  %6.2f ms/MP on %u threads\n", filterNames[filter], single * 1e3 / megapixels, all * 1e3 / megapixels,
+				parallelThreadCount(0));
+		}
+	}
+}
+
+int main(int pArgumentCount, char** pArguments)
+{
+	checkFlat();
+
+	mt19937 random(5);
+	vector<uint8_t> noise((size_t)300 * 77 * 4);
+	for (size_t i = 0; i < noise.size(); ++i)
+		noise[i] = (uint8_t)random();
+	checkImage(&noise[0], 300, 77, "random 300x77");
+
+	vector<string> fileNames;
+	for (int i = 1; i < pArgumentCount; ++i)
+		fileNames.push_back(pArguments[i]);
+	if (fileNames.empty()) {
+		fileNames.push_back(ASSET_DIRECTORY "MantaRay_Base.png");
+		fileNames.push_back(ASSET_DIRECTORY "dive_scooter_Base1k.png");
+	}
+	for (size_t i = 0; i < fileNames.size(); ++i) {
+		PngDecoder::Image image;
+		if (!Benchmark::check(PngDecoder::load(fileNames[i], image), "load " + fileNames[i]))
+			continue;
+		//TextureMaterial generates mips for 8 bit rgba only, the scene textures are
+		if (!Benchmark::check(image.format == PngDecoder::FormatBGRA8, fileNames[i] + ": bgra8"))
+			continue;
+		checkImage(&image.pixels[0], image.width, image.height, fileNames[i]);
+		timeImage(&image.pixels[0], image.width, image.height, fileNames[i]);
+	}
+	return Benchmark::result();
+}
@@ -0,0 +1,113 @@
+#include "Benchmark.h"
+#include "ObjParser.h"
+#include "MappedFile.h"
+#include <fstream>
+#include <cstring>
+#include <cstdlib>
+
+using namespace std;
+
+/**
+ * Throughput of mapping and parsing an .obj file (MappedFile + ObjParser::parse), against the getline and sscanf loop
+ * Mesh::load used before. Both run on the same synthetic files, of triangles and of quads, and have to produce the
+ * same ObjData.
+ * usage: ObjParserBenchmark [grid size, 500 writes files of about 40 and 50 MB]
+ */
+namespace {
+	//the line loop Mesh::load used to read files with, collecting what it read the same way ObjParser does
+	bool parseWithSscanf(const string& pFileName, ObjData& pData)
+	{
+		ifstream file(pFileName.c_str());
+		if (!file.is_open())
+			return false;
+
+		string line;
+		while (getline(file, line)) {
+			char cmd[10];
+			cmd[0] = 0;
+			sscanf(line.c_str(), "%9s", cmd);
+
+			if (strcmp(cmd, "v") == 0) {
+				glm::vec3 vertex(0.0f);
+				sscanf(line.c_str(), "%9s %f %f %f ", cmd, &vertex.x, &vertex.y, &vertex.z);
+				pData.vertices.push_back(vertex);
+			}
+			else if (strcmp(cmd, "vn") == 0) {
+				glm::vec3 normal(0.0f);
+				sscanf(line.c_str(), "%9s %f %f %f ", cmd, &normal.x, &normal.y, &normal.z);
+				pData.normals.push_back(normal);
+			}
+			else if (strcmp(cmd, "vt") == 0) {
+				glm::vec2 uv(0.0f);
+				sscanf(line.c_str(), "%9s %f %f ", cmd, &uv.x, &uv.y);
+				uv.y = 1 - uv.y;
+				pData.uvs.push_back(uv);
+			}
+			else if (strcmp(cmd, "f") == 0) {
+				ObjFace face = {};
+				int count = sscanf(line.c_str(), "%9s %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d", cmd,
+					&face.v[0], &face.uv[0], &face.n[0], &face.v[1], &face.uv[1], &face.n[1],
+					&face.v[2], &face.uv[2], &face.n[2], &face.v[3], &face.uv[3], &face.n[3]);
+				if (count != 10 && count != 13)
+					return false;
+				face.count = (count - 1) / 3;
+				pData.faces.push_back(face);
+			}
+		}
+		return true;
+	}
+
+	template <typename T>
+	bool sameBytes(const vector<T>& pA, const vector<T>& pB)
+	{
+		return pA.size() == pB.size() && (pA.empty() || memcmp(&pA[0], &pB[0], pA.size() * sizeof(T)) == 0);
+	}
+
+	bool sameData(const ObjData& pA, const ObjData& pB)
+	{
+		return sameBytes(pA.vertices, pB.vertices) && sameBytes(pA.uvs, pB.uvs) && sameBytes(pA.normals, pB.normals) && sameBytes(pA.faces, pB.faces);
+	}
+
+	void run(unsigned pGrid, bool pQuads)
+	{
+		const char* name = pQuads ? "quads" : "triangles";
+		string fileName = string("synthetic_") + name + ".obj";
+		if (!Benchmark::check(Benchmark::writeFile(fileName, Benchmark::syntheticObj(pGrid, pQuads)), "write " + fileName))
+			return;
+
+		//the file is mapped again every run, that is part of what loading costs
+		ObjData mapped;
+		size_t fileSize = 0;
+		bool parsed = true;
+		double mappedSeconds = Benchmark::time([&]() {
+			mapped.clear();
+			MappedFile file;
+			parsed = file.open(fileName) && ObjParser::parse(file.data(), file.data() + file.size(), mapped);
+			fileSize = file.size();
+		});
+
+		ObjData scanned;
+		bool scannedOk = true;
+		double scannedSeconds = Benchmark::time([&]() {
+			scanned.clear();
+			scannedOk = parseWithSscanf(fileName, scanned);
+		}, 1);
+		remove(fileName.c_str());
+
+		Benchmark::check(parsed && scannedOk, string("parse ") + name);
+		Benchmark::check(sameData(mapped, scanned), string("ObjParser matches getline/sscanf on ") + name);
+		Benchmark::check(mapped.faces.size() == (size_t)pGrid * pGrid * (pQuads ? 1 : 2), string("face count of ") + name);
+
+		double megabytes = Benchmark::megabytes(fileSize);
+		printf("%-9s %7.1f MB  %8zu faces  ObjParser %7.1f MB/s  getline/sscanf %6.1f MB/s  %5.1fx\n", name, megabytes, mapped.faces.size(),
+			megabytes / mappedSeconds, megabytes / scannedSeconds, scannedSeconds / mappedSeconds);
+	}
+}
+
+int main(int pArgumentCount, char** pArguments)
+{
+	unsigned grid = (pArgumentCount > 1) ? (unsigned)atoi(pArguments[1]) : 500;
+	run(grid, false);
+	run(grid, true);
+	return Benchmark::result();
+}
@@ -0,0 +1,133 @@
+#include "Benchmark.h"
+#include "ObjParser.h"
+#include "MappedFile.h"
+#include "TripletHashMap.h"
+#include <thread>
+#include <cstring>
+#include <cstdlib>
+
+using namespace std;
+
+/**
+ * Scaling of ObjParser::parseParallel from 1 to N threads on a mapped synthetic .obj file. Every thread count has to
+ * give exactly the bytes ObjParser::parse gives, both the ObjData and the vertex and index buffers built from it the
+ * way Mesh::_build builds _vertexData and _indices (without the tangents, those only depend on the same positions and uvs).
+ * usage: ParallelParseBenchmark [grid size, 700 is a file of about 95 MB] [threads, default all hardware threads and at least 4]
+ */
+namespace {
+	struct Vertex {
+		glm::vec3 position;
+		glm::vec2 uv;
+		glm::vec3 normal;
+	};
+
+	struct Buffers {
+		vector<Vertex> vertexData;
+		vector<uint32_t> indices;
+	};
+
+	//the corner dedup of Mesh::_build, quads split in the triangles 0,1,2 and 0,2,3
+	void build(const ObjData& pData, Buffers& pBuffers)
+	{
+		static const int cornerOrder[6] = { 0, 1, 2, 0, 2, 3 };
+		TripletHashMap mappedTriplets(pData.faces.size());
+		pBuffers.vertexData.clear();
+		pBuffers.indices.clear();
+		for (size_t f = 0; f < pData.faces.size(); ++f) {
+			const ObjFace& face = pData.faces[f];
+			int vertCount = (face.count == 4) ? 6 : 3;
+			for (int i = 0; i < vertCount; ++i) {
+				int corner = cornerOrder[i];
+				bool isNew;
+				unsigned index = mappedTriplets.findOrInsert(face.v[corner], face.uv[corner], face.n[corner], (unsigned)mappedTriplets.size(), isNew);
+				pBuffers.indices.push_back(index);
+				if (isNew) {
+					Vertex vertex = { pData.vertices[face.v[corner] - 1], pData.uvs[face.uv[corner] - 1], pData.normals[face.n[corner] - 1] };
+					pBuffers.vertexData.push_back(vertex);
+				}
+			}
+		}
+	}
+
+	template <typename T>
+	bool sameBytes(const vector<T>& pA, const vector<T>& pB)
+	{
+		return pA.size() == pB.size() && (pA.empty() || memcmp(&pA[0], &pB[0], pA.size() * sizeof(T)) == 0);
+	}
+
+	bool sameData(const ObjData& pA, const ObjData& pB)
+	{
+		return sameBytes(pA.vertices, pB.vertices) && sameBytes(pA.uvs, pB.uvs) && sameBytes(pA.normals, pB.normals) && sameBytes(pA.faces, pB.faces);
+	}
+
+	//chunk splits on small files, without a newline at the end, with empty lines and windows line endings
+	void checkSplits()
+	{
+		const char* texts[] = {
+			"v 0 0 0\nv 1 0 0\nv 1 1 0\nvt 0 0\nvt 1 0\nvt 1 1\nvn 0 0 1\nf 1/1/1 2/2/1 3/3/1",
+			"v 0 0 0\r\nv 1 0 0\r\nv 1 1 0\r\n\r\nvt 0 0\r\nvt 1 0\r\nvt 1 1\r\nvn 0 0 1\r\n\r\nf 1/1/1 2/2/1 3/3/1\r\n",
+			"\n\n\n",
+			""
+		};
+		for (size_t t = 0; t < sizeof(texts) / sizeof(texts[0]); ++t) {
+			const char* text = texts[t];
+			ObjData reference;
+			ObjParser::parse(text, text + strlen(text), reference);
+			for (unsigned threads = 1; threads <= 16; ++threads) {
+				ObjData data;
+				bool parsed = ObjParser::parseParallel(text, text + strlen(text), data, threads);
+				Benchmark::check(parsed && sameData(data, reference), "small file " + to_string(t) + " on " + to_string(threads) + " threads");
+			}
+		}
+	}
+}
+
+int main(int pArgumentCount, char** pArguments)
+{
+	unsigned grid = (pArgumentCount > 1) ? (unsigned)atoi(pArguments[1]) : 700;
+	unsigned maxThreads = (pArgumentCount > 2) ? (unsigned)atoi(pArguments[2]) : max(4u, thread::hardware_concurrency());
+
+	checkSplits();
+
+	const string fileName = "synthetic_parallel.obj";
+	if (!Benchmark::check(Benchmark::writeFile(fileName, Benchmark::syntheticObj(grid, false)), "write " + fileName))
+		return Benchmark::result();
+	MappedFile file;
+	if (!Benchmark::check(file.open(fileName), "map " + fileName))
+		return Benchmark::result();
+	const char* begin = file.data();
+	const char* end = begin + file.size();
+	double megabytes = Benchmark::megabytes(file.size());
+
+	ObjData reference;
+	Buffers referenceBuffers;
+	Benchmark::check(ObjParser::parse(begin, end, reference), "parse");
+	build(reference, referenceBuffers);
+	double singleSeconds = Benchmark::time([&]() {
+		ObjData data;
+		ObjParser::parse(begin, end, data);
+	});
+	printf("%.1f MB, %zu faces, %zu vertices, %u hardware threads\n", megabytes, reference.faces.size(), referenceBuffers.vertexData.size(), thread::hardware_concurrency());
+	printf("parse          %7.1f MB/s\n", megabytes / singleSeconds);
+
+	for (unsigned threads = 1; threads <= maxThreads; ++threads) {
+		ObjData data;
+		bool parsed = true;
+		double seconds = Benchmark::time([&]() {
+			data.clear();
+			parsed = ObjParser::parseParallel(begin, end, data, threads);
+		});
+
+		Buffers buffers;
+		build(data, buffers);
+		string name = to_string(threads) + " threads";
+		Benchmark::check(parsed && sameData(data, reference), "ObjData on " + name + " is identical to parse");
+		Benchmark::check(sameBytes(buffers.vertexData, referenceBuffers.vertexData) && sameBytes(buffers.indices, referenceBuffers.indices),
+			"vertex and index buffers on " + name + " are identical to parse");
+		printf("%2u threads     %7.1f MB/s  %5.2fx\n", threads, megabytes / seconds, singleSeconds / seconds);
+	}
+
+	file.close();
+	remove(fileName.c_str());
+	return Benchmark::result();
+}
@@ -0,0 +1,101 @@
+#include "Benchmark.h"
+#include "PngDecoder.h"
+#include "MappedFile.h"
+#include <algorithm>
+#include <random>
+#include <cstring>
+
+using namespace std;
+
+/**
+ * Decode speed of PngDecoder on the textures of the scene, without a device or WIC. Checks that they come out in the
+ * format and row size the WIC path gives them, that decoding at a row pitch (into an upload heap) gives the same rows
+ * and that truncated files fail instead of decoding garbage. The unfilter step is checked and timed on its own against
+ * unfilterScalar for every pixel size.
+ * usage: PngDecoderBenchmark [png files, default the two textures of the scene]
+ */
+namespace {
+	void checkUnfilter()
+	{
+		mt19937 random(3);
+		const uint32_t pixelSizes[] = { 1, 2, 3, 4, 6, 8 };
+		for (size_t p = 0; p < sizeof(pixelSizes) / sizeof(pixelSizes[0]); ++p) {
+			uint32_t bytesPerPixel = pixelSizes[p];
+			//rows of 1024 pixels, every row with a random filter type
+			size_t rowBytes = 1024 * bytesPerPixel, rows = 512;
+			vector<uint8_t> scanlines((rowBytes + 1) * rows);
+			for (size_t i = 0; i < scanlines.size(); ++i)
+				scanlines[i] = (uint8_t)random();
+			for (size_t row = 0; row < rows; ++row)
+				scanlines[row * (rowBytes + 1)] = (uint8_t)(random() % 5);
+
+			vector<uint8_t> simd(scanlines), scalar(scanlines);
+			bool unfiltered = PngDecoder::unfilter(&simd[0], rowBytes, rows, bytesPerPixel) && PngDecoder::unfilterScalar(&scalar[0], rowBytes, rows, bytesPerPixel);
+			Benchmark::check(unfiltered && simd == scalar, "unfilter of " + to_string(bytesPerPixel) + " byte pixels gives the bytes of unfilterScalar");
+
+			double seconds = Benchmark::time([&]() { simd = scanlines; PngDecoder::unfilter(&simd[0], rowBytes, rows, bytesPerPixel); }, 5);
+			double scalarSeconds = Benchmark::time([&]() { scalar = scanlines; PngDecoder::unfilterScalar(&scalar[0], rowBytes, rows, bytesPerPixel); }, 5);
+			printf("unfilter %u byte pixels  %6.2f GB/s  scalar %6.2f GB/s\n", bytesPerPixel, scanlines.size() / seconds / 1e9, scanlines.size() / scalarSeconds / 1e9);
+		}
+	}
+
+	void checkImage(const string& pFileName)
+	{
+		MappedFile file;
+		if (!Benchmark::check(file.open(pFileName), "open " + pFileName))
+			return;
+
+		PngDecoder::Image image;
+		bool decoded = true;
+		double seconds = Benchmark::time([&]() { decoded = PngDecoder::decode(file.data(), file.size(), image); }, 10);
+		if (!Benchmark::check(decoded, "decode " + pFileName))
+			return;
+		//the scene textures are 8 bit rgba, WIC gives them as 32bppBGRA
+		Benchmark::check(image.format == PngDecoder::FormatBGRA8 && image.bytesPerRow == image.width * 4 && image.pixels.size() == (size_t)image.bytesPerRow * image.height,
+			pFileName + ": bgra8 with tightly packed rows like the WIC path");
+
+		//rows at a pitch like an upload heap footprint, the bytes in between are left alone
+		size_t pitch = (image.bytesPerRow + 255) & ~(size_t)255;
+		if (pitch == image.bytesPerRow)
+			pitch += 256;
+		vector<uint8_t> pitched(pitch * image.height, 0xcd);
+		double pitchedSeconds = Benchmark::time([&]() { decoded = PngDecoder::decode(file.data(), file.size(), &pitched[0], pitch); }, 10);
+		bool samePitched = decoded;
+		for (uint32_t row = 0; row < image.height && samePitched; ++row) {
+			samePitched &= memcmp(&pitched[row * pitch], &image.pixels[(size_t)row * image.bytesPerRow], image.bytesPerRow) == 0;
+			samePitched &= pitched[row * pitch + image.bytesPerRow] == 0xcd && pitched[row * pitch + pitch - 1] == 0xcd;
+		}
+		Benchmark::check(samePitched, pFileName + ": decoding at a row pitch gives the same rows");
+
+		//cut inside the chunks, some tools write bytes after IEND and a file cut there still holds the whole image
+		const uint8_t* data = (const uint8_t*)file.data();
+		const char end[] = "IEND";
+		size_t chunksSize = search(data, data + file.size(), end, end + 4) - data;
+		bool truncatedFails = true;
+		const double cuts[] = { 0.0, 0.01, 0.5, 0.99 };
+		for (size_t c = 0; c < sizeof(cuts) / sizeof(cuts[0]); ++c) {
+			PngDecoder::Image truncated;
+			truncatedFails &= !PngDecoder::decode(data, (size_t)(chunksSize * cuts[c]), truncated);
+		}
+		Benchmark::check(truncatedFails, pFileName + ": truncated files fail");
+
+		double megapixels = (double)image.width * image.height / 1e6;
+		printf("%s: %ux%u, %.2f MB png\n", pFileName.c_str(), image.width, image.height, Benchmark::megabytes(file.size()));
+		printf("  decode            %6.2f ms  %7.1f MP/s  %7.1f MB/s of pixels\n", seconds * 1e3, megapixels / seconds, Benchmark::megabytes(image.pixels.size()) / seconds);
+		printf("  decode at a pitch %6.2f ms  %7.1f MP/s\n", pitchedSeconds * 1e3, megapixels / pitchedSeconds);
+	}
+}
+
+int main(int pArgumentCount, char** pArguments)
+{
+	checkUnfilter();
+	if (pArgumentCount > 1) {
+		for (int i = 1; i < pArgumentCount; ++i)
+			checkImage(pArguments[i]);
+	}
+	else {
+		checkImage(ASSET_DIRECTORY "MantaRay_Base.png");
+		checkImage(ASSET_DIRECTORY "dive_scooter_Base1k.png");
+	}
+	return Benchmark::result();
+}
@@ -0,0 +1,139 @@
+#include "Benchmark.h"
+#include "RingAllocator.h"
+#include <random>
+#include <deque>
+
+using namespace std;
+
+/**
+ * Runs RingAllocator without a device, with fence values that are just numbers. Checks alignment, an allocation that
+ * doesn't fit at the end of the ring going to its start, reclaim freeing only the frames whose fence value was reached,
+ * grow in the middle of a frame and the high water marks. Then a few thousand frames of random allocations with the gpu
+ * two frames behind: nothing handed out may overlap what a frame in flight still uses.
+ */
+namespace {
+	const uint64_t invalid = RingAllocator::invalidOffset;
+
+	void checkAlignment()
+	{
+		RingAllocator ring(4096);
+		Benchmark::check(ring.allocate(1, 1) == 0 && ring.allocate(1, 256) == 256 && ring.allocate(3, 16) == 272, "allocations start at their alignment");
+		Benchmark::check(ring.allocate(5000, 1) == invalid, "more than the capacity fails");
+		//aligned to the capacity it would go to the start of the ring, where the first frame still is
+		Benchmark::check(ring.allocate(1, 4096) == invalid, "an allocation that needs the start of a full ring fails");
+		Benchmark::check(ring.getStats().usedBytes == 275 && ring.getStats().allocations == 3, "usedBytes counts the alignment");
+	}
+
+	void checkWrapAndReclaim()
+	{
+		RingAllocator ring(1024);
+		Benchmark::check(ring.allocate(600, 4) == 0, "wrap: first frame at 0");
+		ring.finishFrame(1);
+		Benchmark::check(ring.allocate(300, 4) == 600, "wrap: second frame after the first");
+
+		//200 bytes don't fit in the 124 at the end, the start of the ring is still used by frame 1
+		Benchmark::check(ring.allocate(200, 4) == invalid, "wrap: fails while the start of the ring is in flight");
+		ring.reclaim(0);
+		Benchmark::check(ring.allocate(200, 4) == invalid && ring.getStats().framesInFlight == 1, "wrap: reclaim before the fence frees nothing");
+		ring.reclaim(1);
+		Benchmark::check(ring.allocate(200, 4) == 0, "wrap: the allocation goes to the start of the ring, not across its end");
+		RingAllocator::Stats stats = ring.getStats();
+		Benchmark::check(stats.usedBytes == 300 + 124 + 200, "wrap: usedBytes counts the skipped end");
+
+		ring.finishFrame(2);
+		ring.finishFrame(3);
+		stats = ring.getStats();
+		Benchmark::check(stats.frameBytes == 0 && stats.frameHighWater == 624 && stats.highWater == 900, "frameBytes, frameHighWater and highWater");
+
+		//frame 2 is done, frame 3 (which allocated nothing) is not
+		ring.reclaim(2);
+		Benchmark::check(ring.getStats().framesInFlight == 1 && ring.getOldestFrameFence() == 3 && ring.getStats().usedBytes == 0, "reclaim frees the frames up to its fence value");
+		ring.releaseOldestFrame();
+		Benchmark::check(ring.getFramesInFlight() == 0, "releaseOldestFrame");
+	}
+
+	void checkGrow()
+	{
+		RingAllocator ring(1024);
+		ring.allocate(512, 4);
+		ring.finishFrame(1);
+		Benchmark::check(ring.allocate(400, 4) == 512 && ring.allocate(400, 4) == invalid, "grow: the old ring is full");
+
+		//the frame goes on in a new ring, the frames in flight are left to the old one
+		ring.grow(4096);
+		RingAllocator::Stats stats = ring.getStats();
+		Benchmark::check(ring.getCapacity() == 4096 && stats.framesInFlight == 0 && stats.usedBytes == 0 && stats.grows == 1, "grow: starts over with an empty ring");
+		Benchmark::check(ring.allocate(400, 4) == 0, "grow: the rest of the frame goes to the new ring");
+		ring.finishFrame(2);
+		stats = ring.getStats();
+		Benchmark::check(stats.frameBytes == 800 && stats.frameHighWater == 800, "grow: the frame counts its bytes in both rings");
+		Benchmark::check(stats.highWater == 912, "grow: highWater keeps the most of the old ring");
+		ring.reclaim(2);
+		Benchmark::check(ring.getStats().usedBytes == 0, "grow: the frame is freed in the new ring");
+	}
+
+	struct Range {
+		uint64_t offset;
+		uint64_t size;
+	};
+
+	//frames of random allocations, reclaimed two frames late like a gpu that is behind
+	void checkRandomFrames()
+	{
+		const uint64_t capacity = 1 << 16;
+		const uint64_t alignments[] = { 1, 4, 16, 256 };
+		RingAllocator ring(capacity);
+		mt19937 random(7);
+		deque<pair<uint64_t, vector<Range> > > inFlight;
+		vector<Range> current;
+		bool inside = true, aligned = true, separate = true;
+		unsigned failed = 0, allocated = 0;
+		uint64_t mostUsed = 0;
+
+		for (uint64_t fence = 1; fence <= 4000; ++fence) {
+			unsigned count = random() % 12;
+			for (unsigned i = 0; i < count; ++i) {
+				uint64_t size = 1 + random() % 4000, alignment = alignments[random() % 4];
+				uint64_t offset = ring.allocate(size, alignment);
+				if (offset == invalid) {
+					failed++;
+					continue;
+				}
+				allocated++;
+				inside &= offset + size <= capacity;
+				aligned &= offset % alignment == 0;
+				for (size_t f = 0; f < inFlight.size(); ++f)
+					for (size_t r = 0; r < inFlight[f].second.size(); ++r)
+						separate &= offset + size <= inFlight[f].second[r].offset || inFlight[f].second[r].offset + inFlight[f].second[r].size <= offset;
+				for (size_t r = 0; r < current.size(); ++r)
+					separate &= offset + size <= current[r].offset || current[r].offset + current[r].size <= offset;
+				Range range = { offset, size };
+				current.push_back(range);
+			}
+			ring.finishFrame(fence);
+			inFlight.push_back(make_pair(fence, current));
+			current.clear();
+
+			mostUsed = max(mostUsed, ring.getStats().usedBytes);
+			ring.reclaim(fence - 2);
+			while (!inFlight.empty() && inFlight.front().first + 2 <= fence)
+				inFlight.pop_front();
+		}
+		RingAllocator::Stats stats = ring.getStats();
+		Benchmark::check(inside && aligned, "random frames: allocations are aligned and inside the ring");
+		Benchmark::check(separate, "random frames: nothing overlaps a frame in flight");
+		Benchmark::check(stats.allocations == allocated && stats.framesInFlight == 2 && stats.highWater >= mostUsed && stats.highWater <= capacity,
+			"random frames: stats");
+		printf("random frames: %u allocations, %u failed, high water %.1f KB, frame high water %.1f KB\n", allocated, failed,
+			stats.highWater / 1024.0, stats.frameHighWater / 1024.0);
+	}
+}
+
+int main()
+{
+	checkAlignment();
+	checkWrapAndReclaim();
+	checkGrow();
+	checkRandomFrames();
+	return Benchmark::result();
+}
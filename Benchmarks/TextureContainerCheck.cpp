@@ -0,0 +1,238 @@
+#include "Benchmark.h"
+#include "TextureContainer.h"
+#include "TextureLayout.h"
+#include <cstring>
+
+using namespace std;
+
+/**
+ * Checks TextureContainer::parse and TextureLayout::copyableFootprints on dds and ktx2 files written in memory: a legacy
+ * bgra8 3x5 image (1036 bytes in the upload buffer, like GetCopyableFootprints), a DX10 BC7 64x32 texture with 7 mips
+ * and 3 slices, a legacy DXT1 cubemap and a ktx2 rgba8 array with its levels stored smallest first. copySubresources has
+ * to put every row of the file at its footprint. Truncated files, cubemaps with missing faces and hostile sizes fail.
+ */
+namespace {
+	const uint32_t formatRGBA8 = 28;	//DXGI_FORMAT_R8G8B8A8_UNORM
+	const uint32_t formatBC1 = 71;		//DXGI_FORMAT_BC1_UNORM
+	const uint32_t formatBGRA8 = 87;	//DXGI_FORMAT_B8G8R8A8_UNORM
+	const uint32_t formatBC7 = 98;		//DXGI_FORMAT_BC7_UNORM
+
+	void write32(vector<uint8_t>& pFile, size_t pOffset, uint32_t pValue)
+	{
+		memcpy(&pFile[pOffset], &pValue, 4);
+	}
+
+	void write64(vector<uint8_t>& pFile, size_t pOffset, uint64_t pValue)
+	{
+		memcpy(&pFile[pOffset], &pValue, 8);
+	}
+
+	uint32_t fourCC(const char* pCode)
+	{
+		uint32_t value;
+		memcpy(&value, pCode, 4);
+		return value;
+	}
+
+	//the bytes of every subresource of pFormat, all slices with all their mips like dds stores them
+	size_t payloadBytes(uint32_t pFormat, uint32_t pWidth, uint32_t pHeight, uint32_t pMipLevels, uint32_t pArraySize)
+	{
+		size_t bytes = 0;
+		for (uint32_t mip = 0; mip < pMipLevels; ++mip) {
+			uint32_t rowBytes, rows;
+			TextureLayout::surfaceSize(pFormat, max(pWidth >> mip, 1u), max(pHeight >> mip, 1u), rowBytes, rows);
+			bytes += (size_t)rowBytes * rows;
+		}
+		return bytes * pArraySize;
+	}
+
+	//a dds header, the DX10 one if pDX10Format isn't 0. the payload is numbered bytes so copied rows can be told apart
+	vector<uint8_t> dds(uint32_t pWidth, uint32_t pHeight, uint32_t pMipLevels, size_t pPayload, uint32_t pDX10Format = 0, uint32_t pArraySize = 1, uint32_t pMisc = 0)
+	{
+		size_t header = 4 + 124 + (pDX10Format ? 20 : 0);
+		vector<uint8_t> file(header + pPayload, 0);
+		memcpy(&file[0], "DDS ", 4);
+		write32(file, 4, 124);
+		write32(file, 12, pHeight);
+		write32(file, 16, pWidth);
+		write32(file, 28, pMipLevels);
+		write32(file, 76, 32);
+		if (pDX10Format) {
+			write32(file, 80, 0x4);
+			write32(file, 84, fourCC("DX10"));
+			write32(file, 128, pDX10Format);
+			write32(file, 132, 3);	//texture 2d
+			write32(file, 136, pMisc);
+			write32(file, 140, pArraySize);
+		}
+		for (size_t i = header; i < file.size(); ++i)
+			file[i] = (uint8_t)(i * 7 + i / 251);
+		return file;
+	}
+
+	//copy the file into an upload buffer at its footprints, false if a row isn't where the footprint says
+	bool checkCopy(const vector<uint8_t>& pFile, const TextureContainer::Description& pDescription)
+	{
+		vector<TextureLayout::Footprint> footprints(pDescription.subresources.size());
+		uint64_t size = TextureLayout::copyableFootprints(pDescription.format, pDescription.width, pDescription.height, pDescription.mipLevels, pDescription.arraySize, &footprints[0]);
+		vector<uint8_t> buffer((size_t)size, 0);
+		if (size == 0 || !TextureContainer::copySubresources(&pFile[0], pDescription, &footprints[0], &buffer[0]))
+			return false;
+		for (size_t i = 0; i < footprints.size(); ++i) {
+			const TextureContainer::Subresource& subresource = pDescription.subresources[i];
+			const TextureLayout::Footprint& footprint = footprints[i];
+			if (footprint.offset % TextureLayout::placementAlignment != 0 || footprint.rowPitch % TextureLayout::rowPitchAlignment != 0)
+				return false;
+			for (uint32_t row = 0; row < footprint.rows; ++row) {
+				if (memcmp(&buffer[(size_t)(footprint.offset + (uint64_t)row * footprint.rowPitch)], &pFile[(size_t)(subresource.offset + (uint64_t)row * subresource.rowBytes)], subresource.rowBytes) != 0)
+					return false;
+			}
+		}
+		return true;
+	}
+
+	//every size short of the whole file fails
+	bool truncatedFails(const vector<uint8_t>& pFile)
+	{
+		TextureContainer::Description description;
+		bool fails = true;
+		for (size_t size = 0; size < pFile.size(); size += (size < 256) ? 1 : 97)
+			fails &= !TextureContainer::parse(&pFile[0], size, description);
+		return fails && !TextureContainer::parse(&pFile[0], pFile.size() - 1, description);
+	}
+
+	void checkBGRA8()
+	{
+		vector<uint8_t> file = dds(3, 5, 1, 3 * 5 * 4);
+		write32(file, 80, 0x40 | 0x1);	//rgb with alpha
+		write32(file, 88, 32);
+		write32(file, 92, 0xff0000);
+		write32(file, 96, 0xff00);
+		write32(file, 100, 0xff);
+		write32(file, 104, 0xff000000);
+
+		TextureContainer::Description description;
+		bool parsed = TextureContainer::parse(&file[0], file.size(), description);
+		Benchmark::check(parsed && description.type == TextureContainer::TypeDDS && description.format == formatBGRA8 && description.width == 3 && description.height == 5
+			&& description.mipLevels == 1 && description.arraySize == 1 && description.subresources.size() == 1 && description.subresources[0].offset == 128,
+			"bgra8 3x5: header");
+
+		TextureLayout::Footprint footprint;
+		uint64_t size = TextureLayout::copyableFootprints(formatBGRA8, 3, 5, 1, 1, &footprint);
+		Benchmark::check(size == 1036 && footprint.offset == 0 && footprint.rowPitch == 256 && footprint.rowBytes == 12 && footprint.rows == 5, "bgra8 3x5: 1036 bytes like d3d");
+		Benchmark::check(parsed && checkCopy(file, description), "bgra8 3x5: copied rows");
+		Benchmark::check(truncatedFails(file), "bgra8 3x5: truncated files fail");
+	}
+
+	void checkBC7Array()
+	{
+		vector<uint8_t> file = dds(64, 32, 7, payloadBytes(formatBC7, 64, 32, 7, 3), formatBC7, 3);
+		TextureContainer::Description description;
+		bool parsed = TextureContainer::parse(&file[0], file.size(), description);
+		Benchmark::check(parsed && description.format == formatBC7 && description.mipLevels == 7 && description.arraySize == 3 && !description.cubemap
+			&& description.subresources.size() == 21, "DX10 BC7 64x32, 7 mips, 3 slices: header");
+		//a slice has all its mips before the next slice, 2768 bytes of blocks
+		Benchmark::check(parsed && description.subresources[1].offset == 148 + 2048 && description.subresources[7].offset == 148 + 2768
+			&& description.subresources[6].rowBytes == 16 && description.subresources[6].rows == 1, "DX10 BC7: subresources in the file");
+
+		//mip 0 is 8 rows of 256 bytes, then every level starts 512 byte aligned with rows 256 bytes apart
+		vector<TextureLayout::Footprint> footprints(21);
+		uint64_t size = TextureLayout::copyableFootprints(formatBC7, 64, 32, 7, 3, &footprints[0]);
+		const uint64_t offsets[] = { 0, 2048, 3072, 3584, 4096, 4608, 5120, 5632 };
+		bool sameOffsets = true;
+		for (size_t i = 0; i < sizeof(offsets) / sizeof(offsets[0]); ++i)
+			sameOffsets &= footprints[i].offset == offsets[i];
+		Benchmark::check(sameOffsets && size == 2 * 5632 + 5136 && footprints[1].rowPitch == 256 && footprints[1].rowBytes == 128 && footprints[1].rows == 4,
+			"DX10 BC7: footprints like d3d");
+		Benchmark::check(parsed && checkCopy(file, description), "DX10 BC7: copied rows");
+		Benchmark::check(truncatedFails(file), "DX10 BC7: truncated files fail");
+
+		uint64_t packed = TextureLayout::packedFootprints(formatBC7, 64, 32, 7, 3, &footprints[0]);
+		Benchmark::check(packed == 3 * 2768 && footprints[7].offset == 2768 && footprints[1].rowPitch == 128, "DX10 BC7: packed footprints");
+	}
+
+	void checkCubemap()
+	{
+		vector<uint8_t> file = dds(16, 16, 5, payloadBytes(formatBC1, 16, 16, 5, 6));
+		write32(file, 80, 0x4);
+		write32(file, 84, fourCC("DXT1"));
+		write32(file, 112, 0x200 | 0xFC00);
+		TextureContainer::Description description;
+		bool parsed = TextureContainer::parse(&file[0], file.size(), description);
+		Benchmark::check(parsed && description.format == formatBC1 && description.cubemap && description.arraySize == 6 && description.subresources.size() == 30,
+			"DXT1 cubemap: 6 slices");
+		Benchmark::check(parsed && checkCopy(file, description), "DXT1 cubemap: copied rows");
+		Benchmark::check(truncatedFails(file), "DXT1 cubemap: truncated files fail");
+
+		write32(file, 112, 0x200 | 0x0C00);
+		Benchmark::check(!TextureContainer::parse(&file[0], file.size(), description), "a cubemap with missing faces fails");
+	}
+
+	void checkKTX2()
+	{
+		//2 layers of 8x4 rgba8 with 3 levels, stored smallest first like ktx2 writers do
+		const uint32_t levels = 3, layers = 2;
+		size_t levelBytes[levels];
+		size_t headerBytes = 80 + 24 * levels, payload = 0;
+		for (uint32_t mip = 0; mip < levels; ++mip) {
+			levelBytes[mip] = (size_t)max(8u >> mip, 1u) * max(4u >> mip, 1u) * 4 * layers;
+			payload += levelBytes[mip];
+		}
+		vector<uint8_t> file(headerBytes + payload, 0);
+		const uint8_t identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+		memcpy(&file[0], identifier, 12);
+		write32(file, 12, 37);	//VK_FORMAT_R8G8B8A8_UNORM
+		write32(file, 20, 8);
+		write32(file, 24, 4);
+		write32(file, 32, layers);
+		write32(file, 36, 1);
+		write32(file, 40, levels);
+		size_t offset = headerBytes;
+		for (uint32_t mip = levels; mip-- > 0;) {
+			write64(file, 80 + 24 * mip, offset);
+			write64(file, 80 + 24 * mip + 8, levelBytes[mip]);
+			offset += levelBytes[mip];
+		}
+		for (size_t i = headerBytes; i < file.size(); ++i)
+			file[i] = (uint8_t)(i * 13);
+
+		TextureContainer::Description description;
+		bool parsed = TextureContainer::parse(&file[0], file.size(), description);
+		//level 2 (2x1) comes first, then level 1 (4x2) and level 0 (8x4). the layers of a level follow each other
+		size_t level2 = headerBytes, level1 = level2 + levelBytes[2], level0 = level1 + levelBytes[1];
+		Benchmark::check(parsed && description.type == TextureContainer::TypeKTX2 && description.format == formatRGBA8 && description.arraySize == 2 && description.mipLevels == 3
+			&& description.subresources[0].offset == level0 && description.subresources[3].offset == level0 + 128 && description.subresources[2].offset == level2
+			&& description.subresources[4].offset == level1 + 32, "ktx2 rgba8 array: levels stored smallest first");
+		Benchmark::check(parsed && checkCopy(file, description), "ktx2 rgba8 array: copied rows");
+		Benchmark::check(truncatedFails(file), "ktx2 rgba8 array: truncated files fail");
+	}
+
+	void checkHostile()
+	{
+		TextureContainer::Description description;
+		//sides past D3D12_REQ_TEXTURE2D_U_OR_V_DIMENSION, their rows would overflow 32 bits
+		vector<uint8_t> wide = dds(0x40000001, 1, 1, 64, formatRGBA8);
+		Benchmark::check(!TextureContainer::parse(&wide[0], wide.size(), description), "a side above 16384 fails");
+		vector<uint8_t> largest = dds(16384, 1, 1, 16384 * 4, formatRGBA8);
+		Benchmark::check(TextureContainer::parse(&largest[0], largest.size(), description), "a side of 16384 is fine");
+
+		//0x2AAAAAAB cubes are 2 slices after multiplying by 6 in 32 bits
+		vector<uint8_t> cubes = dds(4, 4, 1, 4096, formatRGBA8, 0x2AAAAAAB, 0x4);
+		Benchmark::check(!TextureContainer::parse(&cubes[0], cubes.size(), description), "a cube count that wraps around fails");
+
+		vector<uint8_t> mips = dds(4, 4, 40, 4096, formatRGBA8);
+		Benchmark::check(!TextureContainer::parse(&mips[0], mips.size(), description), "more mips than the size has fails");
+		vector<uint8_t> unknown = dds(4, 4, 1, 4096, 1000);
+		Benchmark::check(!TextureContainer::parse(&unknown[0], unknown.size(), description), "an unknown format fails");
+	}
+}
+
+int main()
+{
+	checkBGRA8();
+	checkBC7Array();
+	checkCubemap();
+	checkKTX2();
+	checkHostile();
+	return Benchmark::result();
+}
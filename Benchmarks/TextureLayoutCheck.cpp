@@ -0,0 +1,120 @@
+#include "Benchmark.h"
+#include "TextureLayout.h"
+#include "PngDecoder.h"
+#include "MappedFile.h"
+#include <cstring>
+
+using namespace std;
+
+/**
+ * Checks TextureLayout::copyRows, the copy of tightly packed rows into an upload buffer footprint that every texture
+ * upload goes through. Mip chains of odd sized rgba8 and BC7 textures are copied from their packedFootprints into their
+ * copyableFootprints: every row has to land at its footprint and the padding between rows and subresources is left alone.
+ * The png textures of the scene are then copied from their tight decode and compared with PngDecoder::decode straight
+ * into the same footprint (the pitch decode on its own is checked and timed in PngDecoderBenchmark).
+ * usage: TextureLayoutCheck [png files, default the two textures of the scene]
+ */
+namespace {
+	const uint32_t formatRGBA8 = 28;	//DXGI_FORMAT_R8G8B8A8_UNORM
+	const uint32_t formatBGRA8 = 87;	//DXGI_FORMAT_B8G8R8A8_UNORM
+	const uint32_t formatBC7 = 98;		//DXGI_FORMAT_BC7_UNORM
+	const uint8_t padding = 0xcd;
+
+	//copy a numbered mip chain from its packed layout into its upload layout and check every byte of the buffer
+	void checkChain(uint32_t pFormat, uint32_t pWidth, uint32_t pHeight, uint32_t pArraySize, const string& pName)
+	{
+		uint32_t mipLevels = TextureLayout::maxMipLevels(pWidth, pHeight);
+		vector<TextureLayout::Footprint> packed(mipLevels * pArraySize), footprints(mipLevels * pArraySize);
+		uint64_t packedBytes = TextureLayout::packedFootprints(pFormat, pWidth, pHeight, mipLevels, pArraySize, &packed[0]);
+		uint64_t bufferBytes = TextureLayout::copyableFootprints(pFormat, pWidth, pHeight, mipLevels, pArraySize, &footprints[0]);
+
+		vector<uint8_t> source((size_t)packedBytes);
+		for (size_t i = 0; i < source.size(); ++i)
+			source[i] = (uint8_t)(i * 7 + i / 251);
+		vector<uint8_t> buffer((size_t)bufferBytes, padding);
+		for (size_t i = 0; i < footprints.size(); ++i)
+			TextureLayout::copyRows(&source[(size_t)packed[i].offset], packed[i].rowBytes, footprints[i], &buffer[0]);
+
+		//what the buffer has to hold: the rows at their footprint, padding everywhere else
+		vector<uint8_t> expected((size_t)bufferBytes, padding);
+		bool aligned = true;
+		for (size_t i = 0; i < footprints.size(); ++i) {
+			const TextureLayout::Footprint& footprint = footprints[i];
+			aligned &= footprint.offset % TextureLayout::placementAlignment == 0 && footprint.rowPitch % TextureLayout::rowPitchAlignment == 0;
+			aligned &= footprint.rowBytes == packed[i].rowBytes && footprint.rows == packed[i].rows;
+			for (uint32_t row = 0; row < footprint.rows; ++row)
+				memcpy(&expected[(size_t)(footprint.offset + (uint64_t)row * footprint.rowPitch)], &source[(size_t)(packed[i].offset + (uint64_t)row * packed[i].rowBytes)], footprint.rowBytes);
+		}
+		Benchmark::check(aligned, pName + ": footprints are aligned and hold the packed rows");
+		Benchmark::check(buffer == expected, pName + ": copyRows puts every row at its footprint and leaves the padding alone");
+	}
+
+	//a footprint without padding takes the single copy, it has to give the same bytes
+	void checkTight()
+	{
+		TextureLayout::Footprint footprint;
+		TextureLayout::packedFootprints(formatRGBA8, 64, 16, 1, 1, &footprint);
+		footprint.offset = 512;
+		vector<uint8_t> source((size_t)footprint.rowBytes * footprint.rows), buffer(512 + source.size() + 16, padding);
+		for (size_t i = 0; i < source.size(); ++i)
+			source[i] = (uint8_t)(i * 13);
+		TextureLayout::copyRows(&source[0], footprint.rowBytes, footprint, &buffer[0]);
+		bool same = memcmp(&buffer[512], &source[0], source.size()) == 0 && footprint.rowPitch == footprint.rowBytes;
+		for (size_t i = 0; i < 512; ++i)
+			same &= buffer[i] == padding;
+		for (size_t i = 512 + source.size(); i < buffer.size(); ++i)
+			same &= buffer[i] == padding;
+		Benchmark::check(same, "tight footprint: one copy of all rows, nothing around it touched");
+	}
+
+	//the two ways a png gets into an upload heap: decoded tight and copied, or decoded at the pitch of the footprint
+	void checkImage(const string& pFileName)
+	{
+		MappedFile file;
+		if (!Benchmark::check(file.open(pFileName), "open " + pFileName))
+			return;
+		PngDecoder::Image image;
+		if (!Benchmark::check(PngDecoder::decode(file.data(), file.size(), image) && image.format == PngDecoder::FormatBGRA8, "decode " + pFileName))
+			return;
+
+		TextureLayout::Footprint footprint;
+		uint64_t bufferBytes = TextureLayout::copyableFootprints(formatBGRA8, image.width, image.height, 1, 1, &footprint);
+		Benchmark::check(footprint.rowBytes == image.bytesPerRow && footprint.rows == image.height, pFileName + ": the footprint fits the decoded rows");
+
+		vector<uint8_t> copied((size_t)bufferBytes, padding), decoded((size_t)bufferBytes, padding);
+		double copySeconds = Benchmark::time([&]() { TextureLayout::copyRows(&image.pixels[0], image.bytesPerRow, footprint, &copied[0]); }, 10);
+		bool pitchDecoded = PngDecoder::decode(file.data(), file.size(), &decoded[(size_t)footprint.offset], footprint.rowPitch);
+		Benchmark::check(pitchDecoded && copied == decoded, pFileName + ": copyRows of the tight decode gives the bytes of decoding at the footprint pitch");
+
+		//power of 2 textures have no padding, the same at a pitch one alignment wider so the rows are copied one by one
+		footprint.rowPitch += TextureLayout::rowPitchAlignment;
+		size_t paddedBytes = (size_t)footprint.offset + (size_t)footprint.rowPitch * footprint.rows;
+		copied.assign(paddedBytes, padding);
+		decoded.assign(paddedBytes, padding);
+		TextureLayout::copyRows(&image.pixels[0], image.bytesPerRow, footprint, &copied[0]);
+		pitchDecoded = PngDecoder::decode(file.data(), file.size(), &decoded[(size_t)footprint.offset], footprint.rowPitch);
+		Benchmark::check(pitchDecoded && copied == decoded, pFileName + ": the same with padded rows");
+
+		printf("%s: %ux%u\n", pFileName.c_str(), image.width, image.height);
+		printf("  copyRows %6.2f ms  %7.1f MB/s\n", copySeconds * 1e3, Benchmark::megabytes(image.pixels.size()) / copySeconds);
+	}
+}
+
+int main(int pArgumentCount, char** pArguments)
+{
+	//sides that aren't a multiple of the pitch alignment, of a block, or of 2
+	checkChain(formatRGBA8, 100, 37, 1, "rgba8 100x37");
+	checkChain(formatRGBA8, 1, 300, 2, "rgba8 1x300 array");
+	checkChain(formatBC7, 130, 66, 1, "BC7 130x66");
+	checkChain(formatBC7, 1024, 1024, 3, "BC7 1024x1024 array");
+	checkTight();
+	if (pArgumentCount > 1) {
+		for (int i = 1; i < pArgumentCount; ++i)
+			checkImage(pArguments[i]);
+	}
+	else {
+		checkImage(ASSET_DIRECTORY "MantaRay_Base.png");
+		checkImage(ASSET_DIRECTORY "dive_scooter_Base1k.png");
+	}
+	return Benchmark::result();
+}
@@ -0,0 +1,190 @@
+#include "Benchmark.h"
+#include "TextureStreamer.h"
+#include "TextureLayout.h"
+
+using namespace std;
+
+/**
+ * Runs the TextureStreamer policy headless against a simulated budget, with the scene of the commit that added it: three
+ * 1024x1024 rgba8 textures and a 2048x2048 BC7 one under 8 MB. Checks the idle state, a single request, contention with
+ * the least recently used texture evicted first, a shrinking budget, maxLoadsPerFrame, locked and unstreamed textures,
+ * and after every update that the stats add up to the levels that are resident and stay within the budget.
+ */
+namespace {
+	const uint32_t formatRGBA8 = 28;	//DXGI_FORMAT_R8G8B8A8_UNORM
+	const uint32_t formatBC7 = 98;		//DXGI_FORMAT_BC7_UNORM
+
+	struct TestTexture {
+		uint32_t format;
+		uint32_t size;
+		uint32_t mipLevels;
+	};
+
+	//textures 0 to 2 are rgba8, 3 is BC7
+	const TestTexture scene[] = { { formatRGBA8, 1024, 11 }, { formatRGBA8, 1024, 11 }, { formatRGBA8, 1024, 11 }, { formatBC7, 2048, 12 } };
+	const size_t sceneCount = sizeof(scene) / sizeof(scene[0]);
+
+	TextureStreamer::Settings settings(uint64_t pBudget, uint32_t pMaxLoads)
+	{
+		TextureStreamer::Settings streamerSettings = { pBudget, 64, pMaxLoads };
+		return streamerSettings;
+	}
+
+	//the bytes of pTexture from pMip down to its smallest level
+	uint64_t chainBytes(const TestTexture& pTexture, uint32_t pMip)
+	{
+		uint64_t bytes = 0;
+		for (uint32_t mip = pMip; mip < pTexture.mipLevels; ++mip) {
+			uint32_t side = max(pTexture.size >> mip, 1u), rowBytes, rows;
+			TextureLayout::surfaceSize(pTexture.format, side, side, rowBytes, rows);
+			bytes += (uint64_t)rowBytes * rows;
+		}
+		return bytes;
+	}
+
+	uint32_t pinnedMip(const TestTexture& pTexture)
+	{
+		return TextureStreamer::pinnedMip(pTexture.format, pTexture.size, pTexture.size, pTexture.mipLevels, 64);
+	}
+
+	void addScene(TextureStreamer& pStreamer)
+	{
+		for (size_t i = 0; i < sceneCount; ++i)
+			pStreamer.add((TextureStreamer::Id)i, scene[i].format, scene[i].size, scene[i].size, scene[i].mipLevels, 1, true);
+	}
+
+	//what every update has to keep: the books match the resident levels and stay within the budget
+	void checkBooks(const TextureStreamer& pStreamer, const string& pName)
+	{
+		uint64_t resident = 0;
+		for (size_t i = 0; i < sceneCount; ++i)
+			resident += chainBytes(scene[i], pStreamer.getResidentMip((TextureStreamer::Id)i));
+		const TextureStreamer::Stats& stats = pStreamer.getStats();
+		Benchmark::check(stats.residentBytes == resident, pName + ": residentBytes is the sum of the resident levels");
+		Benchmark::check(stats.residentBytes <= stats.budgetBytes, pName + ": within the budget");
+	}
+
+	void checkIdle()
+	{
+		TextureStreamer streamer(settings(8 << 20, 0));
+		addScene(streamer);
+		streamer.update();
+		const TextureStreamer::Stats& stats = streamer.getStats();
+		bool pinned = true;
+		uint64_t pinnedBytes = 0;
+		for (size_t i = 0; i < sceneCount; ++i) {
+			pinned &= streamer.getResidentMip((TextureStreamer::Id)i) == pinnedMip(scene[i]);
+			pinnedBytes += chainBytes(scene[i], pinnedMip(scene[i]));
+		}
+		Benchmark::check(pinned && pinnedMip(scene[0]) == 4 && pinnedMip(scene[3]) == 5, "idle: the textures are resident from their 64x64 mip");
+		Benchmark::check(stats.textures == 4 && stats.streamed == 4 && stats.loads == 0 && stats.evictions == 0 && stats.residentBytes == pinnedBytes,
+			"idle: nothing loads without a request");
+		checkBooks(streamer, "idle");
+		printf("idle        %6.1f KB resident\n", stats.residentBytes / 1024.0);
+	}
+
+	void checkRequests()
+	{
+		TextureStreamer streamer(settings(8 << 20, 0));
+		addScene(streamer);
+
+		//one texture asks for its top level, the 4 levels above the pinned ones load in one update
+		streamer.request(0, 0.0f);
+		vector<TextureStreamer::Change> changes = streamer.update();
+		const TextureStreamer::Stats& stats = streamer.getStats();
+		Benchmark::check(stats.loads == 4 && stats.starved == 0 && stats.pending == 0 && streamer.getResidentMip(0) == 0, "single request: 4 levels load");
+		Benchmark::check(changes.size() == 1 && changes[0].texture == 0 && changes[0].residentMip == 0 && changes[0].previousMip == 4, "single request: one change");
+		checkBooks(streamer, "single request");
+		printf("request     %6.1f KB resident, %u loads\n", stats.residentBytes / 1024.0, stats.loads);
+
+		//the other two rgba8 textures want their top level: texture 0 wasn't requested, it is evicted before they starve.
+		//both don't fit in 8 MB, so one of them starves at mip 1
+		streamer.request(1, 0.0f);
+		streamer.request(2, 0.0f);
+		streamer.update();
+		Benchmark::check(streamer.getResidentMip(0) == pinnedMip(scene[0]) && stats.evictions == 4, "contention: the least recently used texture is evicted");
+		Benchmark::check(stats.starved == 1 && min(streamer.getResidentMip(1), streamer.getResidentMip(2)) == 0 && max(streamer.getResidentMip(1), streamer.getResidentMip(2)) == 1,
+			"contention: one texture gets its top level, the other starves one level short");
+		checkBooks(streamer, "contention");
+		printf("contention  %6.1f KB resident, %u loads, %u evicted, %u starved\n", stats.residentBytes / 1024.0, stats.loads, stats.evictions, stats.starved);
+
+		//a budget below what is resident evicts requested levels too
+		streamer.setSettings(settings(2 << 20, 0));
+		streamer.request(1, 0.0f);
+		streamer.request(2, 0.0f);
+		streamer.update();
+		Benchmark::check(stats.evictions > 0 && streamer.getResidentMip(1) > 0 && streamer.getResidentMip(2) > 0, "shrinking budget: requested levels are evicted");
+		checkBooks(streamer, "shrinking budget");
+		printf("shrink      %6.1f KB resident, %u evicted\n", stats.residentBytes / 1024.0, stats.evictions);
+
+		//levels that are not requested are evicted only to make room, an unchanged budget keeps them
+		streamer.update();
+		Benchmark::check(stats.evictions == 0 && stats.loads == 0, "unrequested levels stay while they fit");
+		checkBooks(streamer, "no requests");
+	}
+
+	void checkMaxLoads()
+	{
+		TextureStreamer streamer(settings(8 << 20, 2));
+		addScene(streamer);
+		streamer.request(0, 0.0f);
+		streamer.update();
+		const TextureStreamer::Stats& stats = streamer.getStats();
+		Benchmark::check(stats.loads == 2 && stats.pending == 1 && streamer.getResidentMip(0) == 2, "maxLoadsPerFrame: 2 levels in the first frame");
+		streamer.request(0, 0.0f);
+		streamer.update();
+		Benchmark::check(stats.loads == 2 && stats.pending == 0 && streamer.getResidentMip(0) == 0, "maxLoadsPerFrame: the rest in the next frame");
+		checkBooks(streamer, "maxLoadsPerFrame");
+	}
+
+	void checkLocked()
+	{
+		TextureStreamer streamer(settings(8 << 20, 0));
+		addScene(streamer);
+		streamer.request(0, 0.0f);
+		streamer.update();
+
+		//a locked texture neither loads nor loses levels, even when the budget shrinks below it
+		streamer.setLocked(0, true);
+		streamer.setLocked(1, true);
+		streamer.setSettings(settings(1 << 20, 0));
+		streamer.request(1, 0.0f);
+		streamer.update();
+		const TextureStreamer::Stats& stats = streamer.getStats();
+		Benchmark::check(streamer.getResidentMip(0) == 0 && streamer.getResidentMip(1) == pinnedMip(scene[1]) && stats.evictions == 0 && stats.loads == 0 && stats.pending == 1,
+			"locked textures keep their levels");
+
+		//unlocked, the budget takes the levels of texture 0 again
+		streamer.setLocked(0, false);
+		streamer.setLocked(1, false);
+		streamer.update();
+		Benchmark::check(streamer.getResidentMip(0) > 0 && stats.evictions > 0 && stats.residentBytes <= (1 << 20), "unlocked textures are evicted for the budget");
+	}
+
+	void checkUnstreamed()
+	{
+		//decoded images have no file to load mips from later, they are fully resident and count to the budget
+		TextureStreamer streamer(settings(8 << 20, 0));
+		uint32_t residentMip = streamer.add(0, formatRGBA8, 1024, 1024, 11, 1, false);
+		streamer.request(0, 5.0f);
+		streamer.update();
+		const TextureStreamer::Stats& stats = streamer.getStats();
+		Benchmark::check(residentMip == 0 && streamer.getResidentMip(0) == 0 && stats.streamed == 0 && stats.residentBytes == chainBytes(scene[0], 0),
+			"unstreamed textures are fully resident");
+
+		//the pinned mip of a block compressed texture stays a whole number of blocks
+		Benchmark::check(TextureStreamer::pinnedMip(formatBC7, 128, 64, 8, 16) == 3 && TextureStreamer::pinnedMip(formatBC7, 100, 60, 7, 16) == 0,
+			"pinnedMip keeps block compressed levels whole blocks");
+		Benchmark::check(TextureStreamer::desiredMip(1024.0f, 256.0f) == 2.0f && TextureStreamer::desiredMip(100.0f, 400.0f) == 0.0f, "desiredMip");
+	}
+}
+
+int main()
+{
+	checkIdle();
+	checkRequests();
+	checkMaxLoads();
+	checkLocked();
+	checkUnstreamed();
+	return Benchmark::result();
+}
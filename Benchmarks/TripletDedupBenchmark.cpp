@@ -0,0 +1,118 @@
+#include "Benchmark.h"
+#include "ObjParser.h"
+#include "TripletHashMap.h"
+#include <map>
+#include <cstring>
+#include <cstdlib>
+
+using namespace std;
+
+/**
+ * Face corner deduplication the way Mesh::_build does it (a TripletHashMap sized from the face count) against the
+ * std::map<FaceIndexTriplet> it replaced, on large grids of triangles. Both have to number the unique v/vt/vn triplets
+ * the same, in the order they are first seen, so they have to produce the same index buffer.
+ * usage: TripletDedupBenchmark [grid size, 1000 is 2 million triangles]
+ */
+namespace {
+	//the map key Mesh used before, ordered by memcmp
+	struct FaceIndexTriplet {
+		unsigned v;
+		unsigned uv;
+		unsigned n;
+		FaceIndexTriplet(unsigned pV, unsigned pUV, unsigned pN) : v(pV), uv(pUV), n(pN) {}
+		bool operator<(const FaceIndexTriplet pOther) const {
+			return memcmp((const void*)this, (const void*)&pOther, sizeof(FaceIndexTriplet)) > 0;
+		}
+	};
+
+	//the triangles of a pGrid x pGrid grid of quads, smooth has a uv and normal per vertex like Benchmark::syntheticObj,
+	//otherwise every face has a normal of its own (flat shading) so most corners are unique
+	void gridFaces(unsigned pGrid, bool pSmooth, vector<ObjFace>& pFaces)
+	{
+		pFaces.clear();
+		pFaces.reserve((size_t)pGrid * pGrid * 2);
+		unsigned side = pGrid + 1;
+		for (unsigned y = 0; y < pGrid; ++y) {
+			for (unsigned x = 0; x < pGrid; ++x) {
+				unsigned a = y * side + x + 1, b = a + 1, c = a + side + 1, d = a + side;
+				unsigned triangles[2][3] = { { a, b, c }, { a, c, d } };
+				for (int t = 0; t < 2; ++t) {
+					ObjFace face = {};
+					face.count = 3;
+					for (int i = 0; i < 3; ++i) {
+						face.v[i] = face.uv[i] = triangles[t][i];
+						face.n[i] = pSmooth ? triangles[t][i] : (int)pFaces.size() + 1;
+					}
+					pFaces.push_back(face);
+				}
+			}
+		}
+	}
+
+	size_t mapDedup(const vector<ObjFace>& pFaces, vector<unsigned>& pIndices)
+	{
+		map<FaceIndexTriplet, unsigned> mappedTriplets;
+		pIndices.clear();
+		pIndices.reserve(pFaces.size() * 3);
+		for (size_t f = 0; f < pFaces.size(); ++f) {
+			const ObjFace& face = pFaces[f];
+			for (int i = 0; i < face.count; ++i) {
+				FaceIndexTriplet triplet(face.v[i], face.uv[i], face.n[i]);
+				auto found = mappedTriplets.find(triplet);
+				if (found == mappedTriplets.end()) {
+					unsigned index = (unsigned)mappedTriplets.size();
+					mappedTriplets[triplet] = index;
+					pIndices.push_back(index);
+				}
+				else {
+					pIndices.push_back(found->second);
+				}
+			}
+		}
+		return mappedTriplets.size();
+	}
+
+	size_t hashDedup(const vector<ObjFace>& pFaces, vector<unsigned>& pIndices)
+	{
+		TripletHashMap mappedTriplets(pFaces.size());
+		pIndices.clear();
+		pIndices.reserve(pFaces.size() * 3);
+		for (size_t f = 0; f < pFaces.size(); ++f) {
+			const ObjFace& face = pFaces[f];
+			for (int i = 0; i < face.count; ++i) {
+				bool isNew;
+				pIndices.push_back(mappedTriplets.findOrInsert(face.v[i], face.uv[i], face.n[i], (unsigned)mappedTriplets.size(), isNew));
+			}
+		}
+		return mappedTriplets.size();
+	}
+
+	void run(unsigned pGrid, bool pSmooth)
+	{
+		const char* name = pSmooth ? "smooth" : "flat";
+		vector<ObjFace> faces;
+		gridFaces(pGrid, pSmooth, faces);
+		size_t corners = faces.size() * 3;
+
+		vector<unsigned> mapIndices, hashIndices;
+		size_t mapUnique = 0, hashUnique = 0;
+		double mapSeconds = Benchmark::time([&]() { mapUnique = mapDedup(faces, mapIndices); }, 1);
+		double hashSeconds = Benchmark::time([&]() { hashUnique = hashDedup(faces, hashIndices); });
+
+		size_t side = pGrid + 1;
+		Benchmark::check(hashUnique == mapUnique, string("unique triplets of ") + name);
+		Benchmark::check(hashUnique == (pSmooth ? side * side : corners), string("expected unique triplets of ") + name);
+		Benchmark::check(hashIndices == mapIndices, string("TripletHashMap matches std::map on ") + name);
+
+		printf("%-6s %8zu corners %8zu unique  std::map %6.1f M/s  TripletHashMap %6.1f M/s  %5.1fx\n", name, corners, hashUnique,
+			corners / mapSeconds / 1e6, corners / hashSeconds / 1e6, mapSeconds / hashSeconds);
+	}
+}
+
+int main(int pArgumentCount, char** pArguments)
+{
+	unsigned grid = (pArgumentCount > 1) ? (unsigned)atoi(pArguments[1]) : 1000;
+	run(grid, true);
+	run(grid, false);
+	return Benchmark::result();
+}
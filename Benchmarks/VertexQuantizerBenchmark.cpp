@@ -0,0 +1,130 @@
+#include "Benchmark.h"
+#include "VertexQuantizer.h"
+#include "ObjParser.h"
+#include <random>
+#include <cstring>
+#include <cstdlib>
+
+using namespace std;
+
+/**
+ * Error and speed of VertexQuantizer::encode, which packs the vertices of VertexFormatCompact meshes. The vertices are
+ * built from a parsed Benchmark::syntheticObj the way Mesh::load builds them, with the tangent and bitangent of every
+ * triangle from its uv derivatives, plus random orthonormal frames over the whole sphere. The encode has to give the
+ * bytes of encodeScalar and stay within the precision of its formats (measureError): half float uvs, 16 bit octahedral
+ * normals and 8 bit octahedral tangents.
+ * usage: VertexQuantizerBenchmark [grid size, default 700]
+ */
+namespace {
+	typedef VertexQuantizer::FloatVertex FloatVertex;
+
+	void normalize(float* pVector)
+	{
+		float length = sqrtf(pVector[0] * pVector[0] + pVector[1] * pVector[1] + pVector[2] * pVector[2]);
+		for (int c = 0; c < 3; ++c)
+			pVector[c] /= length;
+	}
+
+	//a vertex for every corner of every triangle, like Mesh::load before its triplets are deduplicated
+	bool meshVertices(unsigned pGrid, vector<FloatVertex>& pVertices)
+	{
+		string text = Benchmark::syntheticObj(pGrid, false);
+		ObjData data;
+		if (!ObjParser::parse(text.data(), text.data() + text.size(), data))
+			return false;
+
+		pVertices.clear();
+		pVertices.reserve(data.faces.size() * 3);
+		for (size_t f = 0; f < data.faces.size(); ++f) {
+			const ObjFace& face = data.faces[f];
+			const glm::vec3& v0 = data.vertices[face.v[0] - 1];
+			const glm::vec3& v1 = data.vertices[face.v[1] - 1];
+			const glm::vec3& v2 = data.vertices[face.v[2] - 1];
+			const glm::vec2& uv0 = data.uvs[face.uv[0] - 1];
+			const glm::vec2& uv1 = data.uvs[face.uv[1] - 1];
+			const glm::vec2& uv2 = data.uvs[face.uv[2] - 1];
+			float edge1[3] = { v1.x - v0.x, v1.y - v0.y, v1.z - v0.z }, edge2[3] = { v2.x - v0.x, v2.y - v0.y, v2.z - v0.z };
+			float deltaUV1[2] = { uv1.x - uv0.x, uv1.y - uv0.y }, deltaUV2[2] = { uv2.x - uv0.x, uv2.y - uv0.y };
+			float r = 1.0f / (deltaUV1[0] * deltaUV2[1] - deltaUV2[0] * deltaUV1[1]);
+
+			FloatVertex vertex;
+			for (int c = 0; c < 3; ++c) {
+				vertex.tangent[c] = r * (deltaUV2[1] * edge1[c] - deltaUV1[1] * edge2[c]);
+				vertex.bitangent[c] = r * (-deltaUV2[0] * edge1[c] + deltaUV1[0] * edge2[c]);
+			}
+			normalize(vertex.tangent);
+			normalize(vertex.bitangent);
+			for (int corner = 0; corner < 3; ++corner) {
+				memcpy(vertex.pos, &data.vertices[face.v[corner] - 1], sizeof(vertex.pos));
+				memcpy(vertex.uv, &data.uvs[face.uv[corner] - 1], sizeof(vertex.uv));
+				memcpy(vertex.normal, &data.normals[face.n[corner] - 1], sizeof(vertex.normal));
+				pVertices.push_back(vertex);
+			}
+		}
+		return true;
+	}
+
+	//orthonormal frames pointing anywhere, with both handednesses and uvs that repeat a few times
+	vector<FloatVertex> randomVertices(size_t pCount)
+	{
+		mt19937 random(11);
+		normal_distribution<float> gaussian;
+		uniform_real_distribution<float> uniform(-4.0f, 4.0f);
+		vector<FloatVertex> vertices(pCount);
+		for (size_t i = 0; i < pCount; ++i) {
+			FloatVertex& vertex = vertices[i];
+			float other[3];
+			for (int c = 0; c < 3; ++c) {
+				vertex.pos[c] = uniform(random);
+				vertex.normal[c] = gaussian(random);
+				other[c] = gaussian(random);
+			}
+			vertex.uv[0] = uniform(random);
+			vertex.uv[1] = uniform(random);
+			normalize(vertex.normal);
+			float along = other[0] * vertex.normal[0] + other[1] * vertex.normal[1] + other[2] * vertex.normal[2];
+			for (int c = 0; c < 3; ++c)
+				vertex.tangent[c] = other[c] - along * vertex.normal[c];
+			normalize(vertex.tangent);
+			float sign = (random() & 1) ? 1.0f : -1.0f;
+			vertex.bitangent[0] = sign * (vertex.normal[1] * vertex.tangent[2] - vertex.normal[2] * vertex.tangent[1]);
+			vertex.bitangent[1] = sign * (vertex.normal[2] * vertex.tangent[0] - vertex.normal[0] * vertex.tangent[2]);
+			vertex.bitangent[2] = sign * (vertex.normal[0] * vertex.tangent[1] - vertex.normal[1] * vertex.tangent[0]);
+		}
+		return vertices;
+	}
+
+	//pMaxUv is what half floats give at the largest uv of the vertices, 2^-11 relative
+	void checkVertices(const vector<FloatVertex>& pVertices, float pMaxUv, bool pOrthogonal, const string& pName)
+	{
+		vector<VertexQuantizer::PackedVertex> packed(pVertices.size()), scalar(pVertices.size());
+		double seconds = Benchmark::time([&]() { VertexQuantizer::encode(&pVertices[0], pVertices.size(), &packed[0]); }, 5);
+		double scalarSeconds = Benchmark::time([&]() { VertexQuantizer::encodeScalar(&pVertices[0], pVertices.size(), &scalar[0]); }, 5);
+		Benchmark::check(memcmp(&packed[0], &scalar[0], packed.size() * sizeof(packed[0])) == 0, pName + ": encode gives the bytes of encodeScalar");
+
+		VertexQuantizer::Error error = VertexQuantizer::measureError(&pVertices[0], &packed[0], pVertices.size());
+		Benchmark::check(error.maxUv <= pMaxUv * (1.0f / 2048.0f), pName + ": uv within half float precision");
+		//an octahedral snorm16 normal is off by about 0.01 degrees, but measureError takes the angle with a float acos, which
+		//can't tell angles below a few hundredths of a degree apart. snorm8 tangents are off by up to a degree
+		Benchmark::check(error.maxNormalDegrees < 0.05f && error.meanNormalDegrees < 0.01f, pName + ": normals within 0.05 degrees");
+		Benchmark::check(error.maxTangentDegrees < 1.5f, pName + ": tangents within 1.5 degrees");
+		//cross(normal, tangent) * w is only the original bitangent for orthogonal frames
+		if (pOrthogonal)
+			Benchmark::check(error.maxBitangentDegrees < 1.5f, pName + ": rebuilt bitangents within 1.5 degrees");
+
+		printf("%s: %zu vertices, %u -> %u bytes\n", pName.c_str(), pVertices.size(), (unsigned)sizeof(FloatVertex), (unsigned)sizeof(VertexQuantizer::PackedVertex));
+		printf("  encode %6.2f ms  %7.1f M vertices/s  scalar %7.1f M vertices/s\n", seconds * 1e3, pVertices.size() / seconds / 1e6, pVertices.size() / scalarSeconds / 1e6);
+		printf("  max error: uv %g, normal %.4f deg (mean %.4f), tangent %.3f deg (mean %.3f), bitangent %.3f deg (mean %.3f)\n", error.maxUv,
+			error.maxNormalDegrees, error.meanNormalDegrees, error.maxTangentDegrees, error.meanTangentDegrees, error.maxBitangentDegrees, error.meanBitangentDegrees);
+	}
+}
+
+int main(int pArgumentCount, char** pArguments)
+{
+	unsigned grid = (pArgumentCount > 1) ? (unsigned)atoi(pArguments[1]) : 700;
+	vector<FloatVertex> vertices;
+	if (Benchmark::check(meshVertices(grid, vertices), "parse the synthetic mesh"))
+		checkVertices(vertices, 1.0f, false, "synthetic " + to_string(grid) + "x" + to_string(grid) + " mesh");
+	checkVertices(randomVertices(1 << 20), 4.0f, true, "random frames");
+	return Benchmark::result();
+}
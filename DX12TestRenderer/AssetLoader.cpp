@@ -0,0 +1,348 @@
+#include "AssetLoader.h"
+#include <chrono>
+#include <iostream>
+#include <algorithm>
+
+using namespace std;
+
+AssetLoader::MeshAsset::~MeshAsset()
+{
+	//a mesh that never made it to the registry is still ours
+	if (state != StateReady)
+		delete mesh;
+}
+
+AssetLoader::TextureAsset::~TextureAsset()
+{
+	delete upload;
+	delete material;
+}
+
+AssetLoader::AssetLoader(MeshRegistry* pRegistry, TextureRegistry* pTextures, unsigned pThreadCount)
+	: _registry(pRegistry), _textures(pTextures), _busy(0), _stopping(false), _device(NULL), _commandList(NULL), _ready(0), _failed(0), _loadSeconds(0)
+{
+	unsigned threads = pThreadCount;
+	if (threads == 0) {
+		//hardware_concurrency is 0 if it is unknown
+		unsigned hardwareThreads = thread::hardware_concurrency();
+		threads = (hardwareThreads > 1) ? hardwareThreads - 1 : 1;
+	}
+	for (unsigned i = 0; i < threads; ++i)
+		_threads.push_back(thread(&AssetLoader::_worker, this));
+}
+
+AssetLoader::~AssetLoader()
+{
+	{
+		lock_guard<mutex> lock(_mutex);
+		_stopping = true;
+	}
+	_jobAvailable.notify_all();
+	for (size_t i = 0; i < _threads.size(); ++i)
+		_threads[i].join();
+}
+
+AssetLoader::MeshHandle AssetLoader::loadMesh(const string& pFileName)
+{
+	string path = MeshRegistry::normalizePath(pFileName);
+	MeshHandle asset;
+	{
+		//a path that is loading already shares that load, two loads would parse the file twice and race on its cache file
+		lock_guard<mutex> lock(_mutex);
+		auto loading = _meshLoads.find(path);
+		if (loading != _meshLoads.end()) {
+			//the caller releases the mesh of this handle too, _meshDone acquires a reference for it
+			loading->second->requests++;
+			return loading->second;
+		}
+
+		asset = make_shared<MeshAsset>();
+		asset->fileName = pFileName;
+		//shared meshes that are loaded already don't need a worker. looked up with the lock held, a load adopts its mesh
+		//before it leaves _meshLoads
+		asset->mesh = _registry->acquireLoaded(pFileName);
+		if (asset->mesh != NULL) {
+			asset->state = StateReady;
+			return asset;
+		}
+		_meshLoads[path] = asset;
+	}
+
+	_queue([this, asset]() {
+		auto loadStart = chrono::high_resolution_clock::now();
+		//cpu only, the buffers are created by Mesh::Upload on the render thread
+		Mesh* mesh = Mesh::load(asset->fileName, NULL, NULL, false);
+		asset->loadSeconds = chrono::duration<double>(chrono::high_resolution_clock::now() - loadStart).count();
+		asset->mesh = mesh;
+		if (mesh == NULL) {
+			cout << "Could not load mesh " << asset->fileName << endl;
+			asset->state = StateFailed;
+			_meshDone(asset);
+			_finished(asset->loadSeconds, nullptr);
+			return;
+		}
+
+		//loaded before the upload is queued, the render thread may pick it up right away
+		asset->state = StateLoaded;
+		_finished(asset->loadSeconds, [this, asset]() {
+			//adopt first, a mesh that turns out to be a duplicate is deleted before it is uploaded
+			Mesh* mesh = asset->mesh;
+			asset->mesh = _registry->adopt(asset->fileName, mesh, asset->loadSeconds);
+			if (asset->mesh == mesh)
+				mesh->Upload(_device, _commandList);
+			asset->state = StateReady;
+			_meshDone(asset);
+			return true;
+		});
+	});
+	return asset;
+}
+
+AssetLoader::TextureHandle AssetLoader::loadTexture(const wstring& pFileName)
+{
+	string path = TextureRegistry::pathKey(pFileName);
+	TextureHandle asset;
+	TextureRegistry::Handle shared;
+	{
+		//the same as for meshes, a path that is loading already shares that load
+		lock_guard<mutex> lock(_mutex);
+		auto loading = _textureLoads.find(path);
+		if (loading != _textureLoads.end())
+			return loading->second;
+
+		asset = make_shared<TextureAsset>();
+		asset->fileName = pFileName;
+		shared = _textures ? _textures->acquireLoaded(pFileName) : TextureRegistry::invalidHandle;
+		if (shared == TextureRegistry::invalidHandle)
+			_textureLoads[path] = asset;
+	}
+
+	//shared textures that are loaded already don't need a worker, only the material is created on the render thread
+	if (shared != TextureRegistry::invalidHandle) {
+		asset->state = StateLoaded;
+		_finished(0, [this, asset, shared]() {
+			asset->material = new TextureMaterial(_device, _commandList, _textures, shared);
+			asset->state = StateReady;
+			return true;
+		});
+		return asset;
+	}
+
+	_queue([this, asset]() {
+		auto loadStart = chrono::high_resolution_clock::now();
+		bool loaded = true;
+		bool container = TextureRegistry::openContainer(asset->fileName, asset->container, asset->containerDescription);
+		if (container) {
+			//hashing reads the whole payload here, so the copy on the render thread doesn't wait for the disk
+			asset->data.contentHash = TextureRegistry::contentHash(asset->container.data(), asset->containerDescription);
+		}
+		else if (_textures == NULL)
+			loaded = TextureMaterial::LoadTextureData(asset->fileName.c_str(), asset->data);
+		else
+			loaded = TextureMaterial::ReadTextureInfo(asset->fileName.c_str(), asset->data);
+		asset->loadSeconds = chrono::duration<double>(chrono::high_resolution_clock::now() - loadStart).count();
+		if (!loaded) {
+			wcout << L"Could not load texture " << asset->fileName << endl;
+			asset->state = StateFailed;
+			_textureDone(asset);
+			_finished(asset->loadSeconds, nullptr);
+			return;
+		}
+
+		//loaded before the upload is queued, the render thread may pick it up right away
+		asset->state = StateLoaded;
+		if (!container) {
+			_finished(asset->loadSeconds, [this, asset]() { return _beginTextureUpload(asset); });
+			return;
+		}
+		_finished(asset->loadSeconds, [this, asset]() {
+			//a path or content that is loaded already is shared, only new textures are uploaded
+			TextureRegistry::Handle texture = _textures->adoptContainer(asset->fileName, asset->container.data(), asset->containerDescription, asset->data.contentHash, asset->loadSeconds);
+			asset->container.close();
+			if (texture == TextureRegistry::invalidHandle) {
+				_textureFailed(asset, L"Could not create texture ");
+				return false;
+			}
+			asset->material = new TextureMaterial(_device, _commandList, _textures, texture);
+			asset->state = StateReady;
+			_textureDone(asset);
+			return true;
+		});
+	});
+	return asset;
+}
+
+bool AssetLoader::_beginTextureUpload(TextureHandle pAsset)
+{
+	//the file is hashed already, a texture with the same content is shared before anything is decoded
+	TextureRegistry::Handle shared = _textures->acquireShared(pAsset->fileName, pAsset->data.contentHash);
+	if (shared != TextureRegistry::invalidHandle) {
+		pAsset->material = new TextureMaterial(_device, _commandList, _textures, shared);
+		pAsset->state = StateReady;
+		_textureDone(pAsset);
+		return true;
+	}
+
+	//the texture and its mapped upload heap are created here, the image is decoded into it on a worker
+	pAsset->upload = _textures->beginUpload(pAsset->data);
+	pAsset->state = StateLoading;
+	_queue([this, pAsset]() { _decodeTexture(pAsset); });
+	return false;
+}
+
+void AssetLoader::_decodeTexture(TextureHandle pAsset)
+{
+	auto loadStart = chrono::high_resolution_clock::now();
+	bool loaded = TextureMaterial::LoadTextureInto(pAsset->fileName.c_str(), pAsset->data, pAsset->upload->data, &pAsset->upload->footprints[0]);
+	double seconds = chrono::duration<double>(chrono::high_resolution_clock::now() - loadStart).count();
+	pAsset->loadSeconds += seconds;
+	if (!loaded) {
+		//the texture and upload heap are released on the render thread, with the device
+		_finished(seconds, [this, pAsset]() {
+			delete pAsset->upload;
+			pAsset->upload = NULL;
+			_textureFailed(pAsset, L"Could not load texture ");
+			return false;
+		});
+		return;
+	}
+
+	pAsset->state = StateLoaded;
+	_finished(seconds, [this, pAsset]() { return _endTextureUpload(pAsset); });
+}
+
+bool AssetLoader::_endTextureUpload(TextureHandle pAsset)
+{
+	//the registry takes the upload, if the texture got loaded in the meantime it is dropped and the loaded one shared
+	TextureRegistry::Handle texture = _textures->endUpload(pAsset->fileName, pAsset->upload, pAsset->data.contentHash, pAsset->loadSeconds);
+	pAsset->upload = NULL;
+	if (texture == TextureRegistry::invalidHandle) {
+		_textureFailed(pAsset, L"Could not create texture ");
+		return false;
+	}
+	pAsset->material = new TextureMaterial(_device, _commandList, _textures, texture);
+	pAsset->state = StateReady;
+	_textureDone(pAsset);
+	return true;
+}
+
+void AssetLoader::_textureFailed(TextureHandle pAsset, const wchar_t* pMessage)
+{
+	wcout << pMessage << pAsset->fileName << endl;
+	pAsset->state = StateFailed;
+	_textureDone(pAsset);
+	lock_guard<mutex> lock(_mutex);
+	_failed++;
+}
+
+void AssetLoader::_meshDone(const MeshHandle& pAsset)
+{
+	//with the lock held, no request can join the load between counting the references and leaving _meshLoads
+	lock_guard<mutex> lock(_mutex);
+	_meshLoads.erase(MeshRegistry::normalizePath(pAsset->fileName));
+	if (pAsset->state == StateReady) {
+		for (unsigned i = 1; i < pAsset->requests; ++i)
+			_registry->acquireLoaded(pAsset->fileName);
+	}
+}
+
+void AssetLoader::_textureDone(const TextureHandle& pAsset)
+{
+	lock_guard<mutex> lock(_mutex);
+	_textureLoads.erase(TextureRegistry::pathKey(pAsset->fileName));
+}
+
+unsigned AssetLoader::processUploads(ID3D12Device* pDevice, ID3D12GraphicsCommandList* pCommandList, unsigned pMaxUploads)
+{
+	//the upload jobs run on this thread, outside the lock so the workers can keep queueing
+	deque<function<bool()> > uploads;
+	{
+		lock_guard<mutex> lock(_mutex);
+		size_t count = (pMaxUploads == 0) ? _uploads.size() : min((size_t)pMaxUploads, _uploads.size());
+		uploads.assign(_uploads.begin(), _uploads.begin() + count);
+		_uploads.erase(_uploads.begin(), _uploads.begin() + count);
+	}
+	if (uploads.empty())
+		return 0;
+
+	_device = pDevice;
+	_commandList = pCommandList;
+	unsigned ready = 0;
+	for (size_t i = 0; i < uploads.size(); ++i) {
+		if (uploads[i]())
+			ready++;
+	}
+	_device = NULL;
+	_commandList = NULL;
+
+	lock_guard<mutex> lock(_mutex);
+	_ready += ready;
+	return ready;
+}
+
+void AssetLoader::waitIdle()
+{
+	unique_lock<mutex> lock(_mutex);
+	_idle.wait(lock, [this]() { return _jobs.empty() && _busy == 0; });
+}
+
+bool AssetLoader::isIdle()
+{
+	lock_guard<mutex> lock(_mutex);
+	return _jobs.empty() && _busy == 0 && _uploads.empty();
+}
+
+AssetLoader::Stats AssetLoader::getStats()
+{
+	lock_guard<mutex> lock(_mutex);
+	Stats stats = {};
+	stats.queued = (unsigned)_jobs.size() + _busy;
+	stats.uploads = (unsigned)_uploads.size();
+	stats.ready = _ready;
+	stats.failed = _failed;
+	stats.loadSeconds = _loadSeconds;
+	return stats;
+}
+
+void AssetLoader::_worker()
+{
+	for (;;) {
+		function<void()> job;
+		{
+			unique_lock<mutex> lock(_mutex);
+			_jobAvailable.wait(lock, [this]() { return _stopping || !_jobs.empty(); });
+			if (_stopping)
+				return;
+			job = _jobs.front();
+			_jobs.pop_front();
+			_busy++;
+		}
+
+		job();
+
+		{
+			lock_guard<mutex> lock(_mutex);
+			_busy--;
+		}
+		_idle.notify_all();
+	}
+}
+
+void AssetLoader::_queue(function<void()> pJob)
+{
+	{
+		lock_guard<mutex> lock(_mutex);
+		_jobs.push_back(pJob);
+	}
+	_jobAvailable.notify_one();
+}
+
+void AssetLoader::_finished(double pLoadSeconds, function<bool()> pUpload)
+{
+	lock_guard<mutex> lock(_mutex);
+	_loadSeconds += pLoadSeconds;
+	if (pUpload)
+		_uploads.push_back(pUpload);
+	else
+		_failed++;
+}
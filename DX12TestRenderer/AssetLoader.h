@@ -0,0 +1,161 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <unordered_map>
+#include "Mesh.h"
+#include "MeshRegistry.h"
+#include "TextureMaterial.h"
+#include "TextureRegistry.h"
+
+/**
+ * Loads meshes and textures on a pool of worker threads, so startup (and loading later on) doesn't block the render thread.
+ * The workers only do the cpu side: reading, parsing and cooking meshes (Mesh::load without buffering) and decoding
+ * images (dds and ktx2 files are only mapped and hashed). The results are queued for the render thread, which calls processUploads
+ * while its command list is recording to create the gpu resources and record their uploads. Meshes and textures
+ * are shared through a MeshRegistry and a TextureRegistry, paths that are loaded already skip the workers.
+ * Images go back and forth: a worker reads the header and hashes the file (TextureMaterial::ReadTextureInfo), the render
+ * thread shares a texture with the same content or creates the texture and maps its upload heap, a worker decodes and
+ * processes the image straight into the upload heap (TextureMaterial::LoadTextureInto) and the render thread records the copy.
+ *
+ * A load returns a handle right away, its state tells how far the load got. Handles are shared, the loader and the
+ * caller both keep one until the load is done. A path that is loading already gets the handle of that load, so a file
+ * is only read and parsed once however often it is requested. A mesh handle holds a registry reference for every loadMesh
+ * that returned it, so every caller releases its mesh once; a texture handle shares one material, which is deleted with
+ * the handle. Without a device (tools, headless runs) waitIdle waits for all the cpu work and the handles stay in
+ * StateLoaded with the cpu data in them. Headless still means windows: Mesh.h and TextureMaterial.h need the d3d12 and
+ * DirectXMath headers, so unlike the parsers and decoders it uses, the loader isn't part of the Benchmarks build.
+ */
+class AssetLoader
+{
+public:
+	enum State {
+		StateLoading,	//queued or being loaded by a worker
+		StateLoaded,	//cpu data is ready, waiting for processUploads
+		StateReady,		//gpu resources are created and their upload is recorded
+		StateFailed
+	};
+
+	struct MeshAsset {
+		std::string fileName;
+		std::atomic<int> state;
+		//loaded mesh, owned by the asset until it is ready, then a reference in the registry that has to be released
+		Mesh* mesh;
+		double loadSeconds;
+		//the loadMesh calls that returned this handle, it holds a reference for each of them once it is ready
+		unsigned requests;
+
+		MeshAsset() : state(StateLoading), mesh(NULL), loadSeconds(0), requests(1) {}
+		~MeshAsset();
+		bool isReady() const { return state == StateReady; }
+	};
+
+	struct TextureAsset {
+		std::wstring fileName;
+		std::atomic<int> state;
+		//size and format of the image, only headless loads (without a texture registry) decode the pixels into it
+		TextureMaterial::TextureData data;
+		//the texture an image is decoded into, owned by the asset until its copy is recorded
+		TextureRegistry::Upload* upload;
+		//dds and ktx2 files aren't decoded, they stay mapped until their payload is copied to the upload heap.
+		//their content hash is in data.contentHash
+		MappedFile container;
+		TextureContainer::Description containerDescription;
+		TextureMaterial* material;			//owned by the asset
+		double loadSeconds;
+
+		TextureAsset() : state(StateLoading), upload(NULL), material(NULL), loadSeconds(0) {}
+		~TextureAsset();
+		bool isReady() const { return state == StateReady; }
+	};
+
+	typedef std::shared_ptr<MeshAsset> MeshHandle;
+	typedef std::shared_ptr<TextureAsset> TextureHandle;
+
+	struct Stats {
+		unsigned queued;		//loads waiting for or running on a worker
+		unsigned uploads;		//loads waiting for processUploads
+		unsigned ready;
+		unsigned failed;
+		double loadSeconds;		//worker time spent loading, summed over all workers
+	};
+
+	//meshes are shared through pRegistry, which can be a registry without a device when nothing is uploaded.
+	//textures through pTextures, which is only used by processUploads and can be NULL when nothing is uploaded.
+	//pThreadCount workers, 0 uses all hardware threads but one (that one renders)
+	AssetLoader(MeshRegistry* pRegistry, TextureRegistry* pTextures, unsigned pThreadCount = 0);
+	//waits for the loads in flight, queued loads and results that never got uploaded are dropped
+	~AssetLoader();
+
+	//start loading a mesh. a path that is already in the registry is ready right away, a path that is loading returns
+	//the handle of that load
+	MeshHandle loadMesh(const std::string& pFileName);
+
+	//start loading and decoding a texture, it becomes a TextureMaterial in processUploads. a path that is already in
+	//the texture registry is not loaded again, it still becomes ready in processUploads (the material needs the device).
+	//a path that is loading returns the handle of that load
+	TextureHandle loadTexture(const std::wstring& pFileName);
+
+	//render thread: create the gpu resources of at most pMaxUploads loaded assets (0 is all of them) and record their
+	//upload on pCommandList. returns the number of assets that became ready this call, images that are decoded into
+	//their upload heap go back to a worker first and become ready in a later call
+	unsigned processUploads(ID3D12Device* pDevice, ID3D12GraphicsCommandList* pCommandList, unsigned pMaxUploads = 0);
+
+	//block until the workers have nothing left to do, for headless use. finished loads are left in StateLoaded (or StateFailed),
+	//call processUploads to still upload them (until isIdle, for the images that are decoded into their upload heap)
+	void waitIdle();
+
+	//true if nothing is queued, loading or waiting for processUploads
+	bool isIdle();
+
+	Stats getStats();
+
+private:
+	void _worker();
+	void _queue(std::function<void()> pJob);
+	//queue the render thread part of a load, an empty pUpload counts a failed load. pUpload returns true if the asset
+	//became ready, false if it failed or has more to do
+	void _finished(double pLoadSeconds, std::function<bool()> pUpload);
+
+	//the stages of an image that is decoded into its upload heap, see above
+	bool _beginTextureUpload(TextureHandle pAsset);
+	void _decodeTexture(TextureHandle pAsset);
+	bool _endTextureUpload(TextureHandle pAsset);
+	//count a load that failed in an upload job
+	void _textureFailed(TextureHandle pAsset, const wchar_t* pMessage);
+	//a load is ready or failed, a new load of its path starts over (or finds it in the registry). a ready mesh gets a
+	//reference for every other request of its path
+	void _meshDone(const MeshHandle& pAsset);
+	void _textureDone(const TextureHandle& pAsset);
+
+	MeshRegistry* _registry;
+	TextureRegistry* _textures;
+	std::vector<std::thread> _threads;
+
+	std::mutex _mutex;
+	std::condition_variable _jobAvailable;
+	std::condition_variable _idle;
+	std::deque<std::function<void()> > _jobs;
+	//render thread work of finished loads, in the order they finished
+	std::deque<std::function<bool()> > _uploads;
+	unsigned _busy;
+	bool _stopping;
+	//the loads in flight by registry path key
+	std::unordered_map<std::string, MeshHandle> _meshLoads;
+	std::unordered_map<std::string, TextureHandle> _textureLoads;
+
+	//set by processUploads for the upload jobs
+	ID3D12Device* _device;
+	ID3D12GraphicsCommandList* _commandList;
+
+	unsigned _ready;
+	unsigned _failed;
+	double _loadSeconds;
+};
@@ -0,0 +1,824 @@
+#include "BlockCompressor.h"
+#include "ParallelFor.h"
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+#include <cstring>
+#include <limits>
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BLOCK_SSE2
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+namespace {
+	//blocks per thread below which an image is compressed on the calling thread only
+	const size_t parallelBlocks = 1024;
+
+	//bc7 interpolation weights out of 64 for 2 and 4 bit indices
+	const int weights2[4] = { 0, 21, 43, 64 };
+	const int weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	//position of every index between the endpoints, for the least squares fits
+	const float rampWeights4[4] = { 0.0f, 1.0f / 3.0f, 2.0f / 3.0f, 1.0f };
+	const float rampWeights8[8] = { 0.0f, 1.0f / 7.0f, 2.0f / 7.0f, 3.0f / 7.0f, 4.0f / 7.0f, 5.0f / 7.0f, 6.0f / 7.0f, 1.0f };
+	const float bc7RampWeights2[4] = { 0.0f, 21.0f / 64.0f, 43.0f / 64.0f, 1.0f };
+	const float bc7RampWeights4[16] = { 0.0f, 4.0f / 64.0f, 9.0f / 64.0f, 13.0f / 64.0f, 17.0f / 64.0f, 21.0f / 64.0f, 26.0f / 64.0f, 30.0f / 64.0f,
+		34.0f / 64.0f, 38.0f / 64.0f, 43.0f / 64.0f, 47.0f / 64.0f, 51.0f / 64.0f, 55.0f / 64.0f, 60.0f / 64.0f, 1.0f };
+
+	//channel masks for the error of a palette entry
+	const float channelsRgb[4] = { 1.0f, 1.0f, 1.0f, 0.0f };
+	const float channelsRgba[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+
+	//the 16 pixels of a block as floats, one array per channel so 4 pixels fill an sse register
+	struct Block {
+		alignas(16) float channels[4][16];
+	};
+
+	//bc7 blocks are one 128 bit little endian bit stream, fields are written from the lowest bit up
+	struct BitWriter {
+		uint8_t* block;
+		unsigned position;
+
+		BitWriter(uint8_t* pBlock) : block(pBlock), position(0) { memset(pBlock, 0, 16); }
+		void write(uint32_t pValue, unsigned pBits) {
+			for (unsigned i = 0; i < pBits; ++i, ++position) {
+				if ((pValue >> i) & 1)
+					block[position >> 3] |= (uint8_t)(1 << (position & 7));
+			}
+		}
+	};
+
+	struct BitReader {
+		const uint8_t* block;
+		unsigned position;
+
+		BitReader(const uint8_t* pBlock) : block(pBlock), position(0) {}
+		uint32_t read(unsigned pBits) {
+			uint32_t value = 0;
+			for (unsigned i = 0; i < pBits; ++i, ++position)
+				value |= (uint32_t)((block[position >> 3] >> (position & 7)) & 1) << i;
+			return value;
+		}
+	};
+
+	float clampColor(float pValue) {
+		return min(max(pValue, 0.0f), 255.0f);
+	}
+
+	//nearest palette entry (over the channels that are non zero in pChannels) for every pixel, returns the summed squared error
+	float selectIndices(const Block& pBlock, const float (*pPalette)[4], unsigned pCount, const float* pChannels, uint8_t* pIndices) {
+		//only the channels that count are compared
+		int channels[4];
+		int channelCount = 0;
+		for (int c = 0; c < 4; ++c) {
+			if (pChannels[c] != 0.0f)
+				channels[channelCount++] = c;
+		}
+#ifdef BLOCK_SSE2
+		__m128 total = _mm_setzero_ps();
+		for (int group = 0; group < 16; group += 4) {
+			__m128 pixels[4];
+			for (int k = 0; k < channelCount; ++k)
+				pixels[k] = _mm_load_ps(&pBlock.channels[channels[k]][group]);
+			__m128 best = _mm_set1_ps(FLT_MAX);
+			__m128i bestIndex = _mm_setzero_si128();
+			for (unsigned i = 0; i < pCount; ++i) {
+				__m128 distance = _mm_setzero_ps();
+				for (int k = 0; k < channelCount; ++k) {
+					__m128 difference = _mm_sub_ps(pixels[k], _mm_set1_ps(pPalette[i][channels[k]]));
+					distance = _mm_add_ps(distance, _mm_mul_ps(difference, difference));
+				}
+				__m128i closer = _mm_castps_si128(_mm_cmplt_ps(distance, best));
+				best = _mm_min_ps(distance, best);
+				bestIndex = _mm_or_si128(_mm_andnot_si128(closer, bestIndex), _mm_and_si128(closer, _mm_set1_epi32((int)i)));
+			}
+			total = _mm_add_ps(total, best);
+			alignas(16) int indices[4];
+			_mm_store_si128((__m128i*)indices, bestIndex);
+			for (int k = 0; k < 4; ++k)
+				pIndices[group + k] = (uint8_t)indices[k];
+		}
+		alignas(16) float sums[4];
+		_mm_store_ps(sums, total);
+		return sums[0] + sums[1] + sums[2] + sums[3];
+#else
+		float total = 0.0f;
+		for (int p = 0; p < 16; ++p) {
+			float best = FLT_MAX;
+			for (unsigned i = 0; i < pCount; ++i) {
+				float distance = 0.0f;
+				for (int k = 0; k < channelCount; ++k) {
+					float difference = pBlock.channels[channels[k]][p] - pPalette[i][channels[k]];
+					distance += difference * difference;
+				}
+				if (distance < best) {
+					best = distance;
+					pIndices[p] = (uint8_t)i;
+				}
+			}
+			total += best;
+		}
+		return total;
+#endif
+	}
+
+	//endpoints at the ends of the principal axis (power iteration on the covariance) of the channels in pChannels
+	void fitEndpoints(const Block& pBlock, const float* pChannels, float* pEndpoint0, float* pEndpoint1) {
+		float mean[4] = {};
+		for (int c = 0; c < 4; ++c) {
+			for (int p = 0; p < 16; ++p)
+				mean[c] += pBlock.channels[c][p];
+			mean[c] /= 16.0f;
+		}
+
+		float covariance[4][4] = {};
+		for (int a = 0; a < 4; ++a) {
+			for (int b = a; b < 4; ++b) {
+				if (pChannels[a] == 0.0f || pChannels[b] == 0.0f)
+					continue;
+				float sum = 0.0f;
+				for (int p = 0; p < 16; ++p)
+					sum += (pBlock.channels[a][p] - mean[a]) * (pBlock.channels[b][p] - mean[b]);
+				covariance[a][b] = covariance[b][a] = sum;
+			}
+		}
+
+		//start from the row of the channel with the largest variance, it can't be orthogonal to the principal axis
+		int start = 0;
+		for (int c = 1; c < 4; ++c) {
+			if (covariance[c][c] > covariance[start][start])
+				start = c;
+		}
+		float axis[4];
+		for (int c = 0; c < 4; ++c)
+			axis[c] = covariance[start][c];
+		for (int iteration = 0; iteration < 8; ++iteration) {
+			float next[4] = {};
+			float largest = 0.0f;
+			for (int a = 0; a < 4; ++a) {
+				for (int b = 0; b < 4; ++b)
+					next[a] += covariance[a][b] * axis[b];
+				largest = max(largest, fabsf(next[a]));
+			}
+			if (largest == 0.0f)
+				break;
+			for (int c = 0; c < 4; ++c)
+				axis[c] = next[c] / largest;
+		}
+		float length = sqrtf(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2] + axis[3] * axis[3]);
+		if (length > 0.0f) {
+			for (int c = 0; c < 4; ++c)
+				axis[c] /= length;
+		}
+
+		float low = 0.0f;
+		float high = 0.0f;
+		for (int p = 0; p < 16; ++p) {
+			float t = 0.0f;
+			for (int c = 0; c < 4; ++c)
+				t += (pBlock.channels[c][p] - mean[c]) * axis[c];
+			low = min(low, t);
+			high = max(high, t);
+		}
+		for (int c = 0; c < 4; ++c) {
+			pEndpoint0[c] = clampColor(mean[c] + low * axis[c]);
+			pEndpoint1[c] = clampColor(mean[c] + high * axis[c]);
+		}
+	}
+
+	//least squares endpoints for pixels interpolated with pRamp[index] (0 at endpoint 0, 1 at endpoint 1).
+	//false if every pixel has the same weight, then the endpoints aren't determined
+	bool refitEndpoints(const Block& pBlock, const uint8_t* pIndices, const float* pRamp, float* pEndpoint0, float* pEndpoint1) {
+		float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+		float ax[4] = {};
+		float bx[4] = {};
+		for (int p = 0; p < 16; ++p) {
+			float b = pRamp[pIndices[p]];
+			float a = 1.0f - b;
+			aa += a * a;
+			ab += a * b;
+			bb += b * b;
+			for (int c = 0; c < 4; ++c) {
+				ax[c] += a * pBlock.channels[c][p];
+				bx[c] += b * pBlock.channels[c][p];
+			}
+		}
+		float determinant = aa * bb - ab * ab;
+		if (fabsf(determinant) < 1e-6f)
+			return false;
+		for (int c = 0; c < 4; ++c) {
+			pEndpoint0[c] = clampColor((ax[c] * bb - bx[c] * ab) / determinant);
+			pEndpoint1[c] = clampColor((bx[c] * aa - ax[c] * ab) / determinant);
+		}
+		return true;
+	}
+
+	int refitCount(BlockCompressor::Quality pQuality) {
+		return (pQuality == BlockCompressor::QualityFast) ? 0 : (pQuality == BlockCompressor::QualityNormal) ? 2 : 4;
+	}
+
+	// BC1 //
+
+	uint16_t packRgb565(const float* pColor) {
+		int r = (int)(clampColor(pColor[0]) * 31.0f / 255.0f + 0.5f);
+		int g = (int)(clampColor(pColor[1]) * 63.0f / 255.0f + 0.5f);
+		int b = (int)(clampColor(pColor[2]) * 31.0f / 255.0f + 0.5f);
+		return (uint16_t)((r << 11) | (g << 5) | b);
+	}
+
+	void unpackRgb565(uint16_t pColor, int* pRgb) {
+		int r = pColor >> 11;
+		int g = (pColor >> 5) & 63;
+		int b = pColor & 31;
+		pRgb[0] = (r << 3) | (r >> 2);
+		pRgb[1] = (g << 2) | (g >> 4);
+		pRgb[2] = (b << 3) | (b >> 2);
+	}
+
+	//the 4 colors of a BC1 block in ramp order: endpoint 0, 1/3, 2/3, endpoint 1
+	void colorPalette(uint16_t pColor0, uint16_t pColor1, float (*pPalette)[4]) {
+		int color0[3], color1[3];
+		unpackRgb565(pColor0, color0);
+		unpackRgb565(pColor1, color1);
+		for (int c = 0; c < 3; ++c) {
+			pPalette[0][c] = (float)color0[c];
+			pPalette[1][c] = (float)((2 * color0[c] + color1[c] + 1) / 3);
+			pPalette[2][c] = (float)((color0[c] + 2 * color1[c] + 1) / 3);
+			pPalette[3][c] = (float)color1[c];
+		}
+		for (int i = 0; i < 4; ++i)
+			pPalette[i][3] = 255.0f;
+	}
+
+	//BC1 color block in 4 color mode, also the color half of BC3
+	void encodeColor(const Block& pBlock, BlockCompressor::Quality pQuality, uint8_t* pOutput) {
+		float endpoint0[4], endpoint1[4];
+		fitEndpoints(pBlock, channelsRgb, endpoint0, endpoint1);
+
+		float bestError = FLT_MAX;
+		uint16_t best0 = 0, best1 = 0;
+		uint8_t bestIndices[16] = {};
+		int refits = refitCount(pQuality);
+		for (int pass = 0; ; ++pass) {
+			uint16_t color0 = packRgb565(endpoint0);
+			uint16_t color1 = packRgb565(endpoint1);
+			float palette[4][4];
+			colorPalette(color0, color1, palette);
+			uint8_t indices[16];
+			float error = selectIndices(pBlock, palette, 4, channelsRgb, indices);
+			if (error < bestError) {
+				bestError = error;
+				best0 = color0;
+				best1 = color1;
+				memcpy(bestIndices, indices, 16);
+			}
+			if (pass == refits || !refitEndpoints(pBlock, indices, rampWeights4, endpoint0, endpoint1))
+				break;
+		}
+
+		//4 color mode needs color 0 > color 1, equal colors decode every index to color 0
+		if (best0 < best1) {
+			swap(best0, best1);
+			for (int p = 0; p < 16; ++p)
+				bestIndices[p] = (uint8_t)(3 - bestIndices[p]);
+		}
+		static const uint32_t codes[4] = { 0, 2, 3, 1 };
+		uint32_t bits = 0;
+		if (best0 != best1) {
+			for (int p = 0; p < 16; ++p)
+				bits |= codes[bestIndices[p]] << (2 * p);
+		}
+		pOutput[0] = (uint8_t)best0;
+		pOutput[1] = (uint8_t)(best0 >> 8);
+		pOutput[2] = (uint8_t)best1;
+		pOutput[3] = (uint8_t)(best1 >> 8);
+		for (int i = 0; i < 4; ++i)
+			pOutput[4 + i] = (uint8_t)(bits >> (8 * i));
+	}
+
+	void decodeColor(const uint8_t* pInput, bool pFourColors, uint8_t* pPixels) {
+		uint16_t color0 = (uint16_t)(pInput[0] | (pInput[1] << 8));
+		uint16_t color1 = (uint16_t)(pInput[2] | (pInput[3] << 8));
+		int palette[4][4];
+		int rgb0[3], rgb1[3];
+		unpackRgb565(color0, rgb0);
+		unpackRgb565(color1, rgb1);
+		for (int c = 0; c < 3; ++c) {
+			palette[0][c] = rgb0[c];
+			palette[1][c] = rgb1[c];
+			if (pFourColors || color0 > color1) {
+				palette[2][c] = (2 * rgb0[c] + rgb1[c] + 1) / 3;
+				palette[3][c] = (rgb0[c] + 2 * rgb1[c] + 1) / 3;
+			}
+			else {
+				palette[2][c] = (rgb0[c] + rgb1[c]) / 2;
+				palette[3][c] = 0;
+			}
+		}
+		for (int i = 0; i < 4; ++i)
+			palette[i][3] = 255;
+		if (!pFourColors && color0 <= color1)
+			palette[3][3] = 0;
+
+		uint32_t bits = pInput[4] | (pInput[5] << 8) | (pInput[6] << 16) | ((uint32_t)pInput[7] << 24);
+		for (int p = 0; p < 16; ++p) {
+			for (int c = 0; c < 4; ++c)
+				pPixels[p * 4 + c] = (uint8_t)palette[(bits >> (2 * p)) & 3][c];
+		}
+	}
+
+	// BC4, the 8 value blocks of BC3 alpha and BC5 //
+
+	//the 8 values of a block in ramp order from value 0 to value 1, in channel pChannel of the palette
+	void valuePalette(int pValue0, int pValue1, int pChannel, float (*pPalette)[4]) {
+		for (int t = 0; t < 8; ++t) {
+			for (int c = 0; c < 4; ++c)
+				pPalette[t][c] = 0.0f;
+			pPalette[t][pChannel] = (float)(((7 - t) * pValue0 + t * pValue1 + 3) / 7);
+		}
+	}
+
+	void encodeValues(const Block& pBlock, int pChannel, BlockCompressor::Quality pQuality, uint8_t* pOutput) {
+		float channels[4] = {};
+		channels[pChannel] = 1.0f;
+		float endpoint0[4] = {}, endpoint1[4] = {};
+		endpoint0[pChannel] = 255.0f;
+		for (int p = 0; p < 16; ++p) {
+			endpoint0[pChannel] = min(endpoint0[pChannel], pBlock.channels[pChannel][p]);
+			endpoint1[pChannel] = max(endpoint1[pChannel], pBlock.channels[pChannel][p]);
+		}
+
+		float bestError = FLT_MAX;
+		int best0 = 0, best1 = 0;
+		uint8_t bestIndices[16] = {};
+		int refits = refitCount(pQuality);
+		for (int pass = 0; ; ++pass) {
+			int value0 = (int)(endpoint0[pChannel] + 0.5f);
+			int value1 = (int)(endpoint1[pChannel] + 0.5f);
+			float palette[8][4];
+			valuePalette(value0, value1, pChannel, palette);
+			uint8_t indices[16];
+			float error = selectIndices(pBlock, palette, 8, channels, indices);
+			if (error < bestError) {
+				bestError = error;
+				best0 = value0;
+				best1 = value1;
+				memcpy(bestIndices, indices, 16);
+			}
+			if (error == 0.0f || pass == refits || !refitEndpoints(pBlock, indices, rampWeights8, endpoint0, endpoint1))
+				break;
+		}
+
+		//8 value mode needs value 0 > value 1, equal values decode every index to value 0
+		if (best0 < best1) {
+			swap(best0, best1);
+			for (int p = 0; p < 16; ++p)
+				bestIndices[p] = (uint8_t)(7 - bestIndices[p]);
+		}
+		uint64_t bits = 0;
+		if (best0 != best1) {
+			for (int p = 0; p < 16; ++p) {
+				uint64_t code = (bestIndices[p] == 0) ? 0 : (bestIndices[p] == 7) ? 1 : bestIndices[p] + 1;
+				bits |= code << (3 * p);
+			}
+		}
+		pOutput[0] = (uint8_t)best0;
+		pOutput[1] = (uint8_t)best1;
+		for (int i = 0; i < 6; ++i)
+			pOutput[2 + i] = (uint8_t)(bits >> (8 * i));
+	}
+
+	void decodeValues(const uint8_t* pInput, uint8_t* pPixels, int pChannel) {
+		int value0 = pInput[0];
+		int value1 = pInput[1];
+		int values[8] = { value0, value1 };
+		if (value0 > value1) {
+			for (int k = 2; k < 8; ++k)
+				values[k] = ((8 - k) * value0 + (k - 1) * value1 + 3) / 7;
+		}
+		else {
+			for (int k = 2; k < 6; ++k)
+				values[k] = ((6 - k) * value0 + (k - 1) * value1 + 2) / 5;
+			values[6] = 0;
+			values[7] = 255;
+		}
+		uint64_t bits = 0;
+		for (int i = 0; i < 6; ++i)
+			bits |= (uint64_t)pInput[2 + i] << (8 * i);
+		for (int p = 0; p < 16; ++p)
+			pPixels[p * 4 + pChannel] = (uint8_t)values[(bits >> (3 * p)) & 7];
+	}
+
+	// BC7 //
+
+	struct Mode6 {
+		int endpoints[2][4];	//8 bit, the lowest bit is the p-bit of the endpoint
+		uint8_t indices[16];
+		float error;
+	};
+
+	struct Mode5 {
+		int rotation;			//channel swapped with alpha: 0 none, 1 red, 2 green, 3 blue
+		int colors[2][3];		//7 bit
+		int alphas[2];
+		uint8_t colorIndices[16];
+		uint8_t alphaIndices[16];
+		float error;
+	};
+
+	//nearest 7 bit value with the given p-bit below it
+	void quantizeMode6(const float* pEndpoint, int pPBit, int* pValues) {
+		for (int c = 0; c < 4; ++c) {
+			int value = (int)((clampColor(pEndpoint[c]) - pPBit) * 0.5f + 0.5f);
+			pValues[c] = (min(max(value, 0), 127) << 1) | pPBit;
+		}
+	}
+
+	float quantizationError(const float* pEndpoint, const int* pValues) {
+		float error = 0.0f;
+		for (int c = 0; c < 4; ++c)
+			error += (pEndpoint[c] - pValues[c]) * (pEndpoint[c] - pValues[c]);
+		return error;
+	}
+
+	void encodeMode6(const Block& pBlock, BlockCompressor::Quality pQuality, Mode6& pMode) {
+		float endpoint0[4], endpoint1[4];
+		fitEndpoints(pBlock, channelsRgba, endpoint0, endpoint1);
+
+		pMode.error = FLT_MAX;
+		int refits = refitCount(pQuality);
+		for (int pass = 0; ; ++pass) {
+			//every p-bit combination, or the one that keeps each endpoint closest
+			int pBits[4][2];
+			int combinations = 0;
+			if (pQuality == BlockCompressor::QualityHigh) {
+				for (int i = 0; i < 4; ++i) {
+					pBits[i][0] = i & 1;
+					pBits[i][1] = i >> 1;
+				}
+				combinations = 4;
+			}
+			else {
+				for (int e = 0; e < 2; ++e) {
+					const float* endpoint = e ? endpoint1 : endpoint0;
+					int even[4], odd[4];
+					quantizeMode6(endpoint, 0, even);
+					quantizeMode6(endpoint, 1, odd);
+					pBits[0][e] = (quantizationError(endpoint, odd) < quantizationError(endpoint, even)) ? 1 : 0;
+				}
+				combinations = 1;
+			}
+
+			uint8_t passIndices[16];
+			float passError = FLT_MAX;
+			for (int i = 0; i < combinations; ++i) {
+				int values[2][4];
+				quantizeMode6(endpoint0, pBits[i][0], values[0]);
+				quantizeMode6(endpoint1, pBits[i][1], values[1]);
+				float palette[16][4];
+				for (int k = 0; k < 16; ++k) {
+					for (int c = 0; c < 4; ++c)
+						palette[k][c] = (float)(((64 - weights4[k]) * values[0][c] + weights4[k] * values[1][c] + 32) >> 6);
+				}
+				uint8_t indices[16];
+				float error = selectIndices(pBlock, palette, 16, channelsRgba, indices);
+				if (error < passError) {
+					passError = error;
+					memcpy(passIndices, indices, 16);
+				}
+				if (error < pMode.error) {
+					pMode.error = error;
+					memcpy(pMode.endpoints, values, sizeof(values));
+					memcpy(pMode.indices, indices, 16);
+				}
+			}
+			if (pMode.error == 0.0f || pass == refits || !refitEndpoints(pBlock, passIndices, bc7RampWeights4, endpoint0, endpoint1))
+				break;
+		}
+	}
+
+	void writeMode6(Mode6 pMode, uint8_t* pOutput) {
+		//the highest index bit of pixel 0 isn't stored, it has to be 0
+		if (pMode.indices[0] >= 8) {
+			for (int c = 0; c < 4; ++c)
+				swap(pMode.endpoints[0][c], pMode.endpoints[1][c]);
+			for (int p = 0; p < 16; ++p)
+				pMode.indices[p] = (uint8_t)(15 - pMode.indices[p]);
+		}
+		BitWriter writer(pOutput);
+		writer.write(1 << 6, 7);
+		for (int c = 0; c < 4; ++c) {
+			writer.write(pMode.endpoints[0][c] >> 1, 7);
+			writer.write(pMode.endpoints[1][c] >> 1, 7);
+		}
+		writer.write(pMode.endpoints[0][0] & 1, 1);
+		writer.write(pMode.endpoints[1][0] & 1, 1);
+		for (int p = 0; p < 16; ++p)
+			writer.write(pMode.indices[p], (p == 0) ? 3 : 4);
+	}
+
+	//endpoints of one part of a mode 5 block (color or alpha) with 2 bit indices, pBits bits per endpoint channel
+	float encodeMode5Part(const Block& pBlock, const float* pChannels, int pBits, BlockCompressor::Quality pQuality, int* pValue0, int* pValue1, uint8_t* pIndices) {
+		float endpoint0[4], endpoint1[4];
+		fitEndpoints(pBlock, pChannels, endpoint0, endpoint1);
+
+		float bestError = FLT_MAX;
+		int maximum = (1 << pBits) - 1;
+		int refits = refitCount(pQuality);
+		for (int pass = 0; ; ++pass) {
+			int values[2][4] = {};
+			int expanded[2][4] = {};
+			for (int c = 0; c < 4; ++c) {
+				if (pChannels[c] == 0.0f)
+					continue;
+				for (int e = 0; e < 2; ++e) {
+					values[e][c] = (int)(clampColor(e ? endpoint1[c] : endpoint0[c]) * maximum / 255.0f + 0.5f);
+					expanded[e][c] = (pBits == 8) ? values[e][c] : (values[e][c] << (8 - pBits)) | (values[e][c] >> (2 * pBits - 8));
+				}
+			}
+			float palette[4][4];
+			for (int k = 0; k < 4; ++k) {
+				for (int c = 0; c < 4; ++c)
+					palette[k][c] = (float)(((64 - weights2[k]) * expanded[0][c] + weights2[k] * expanded[1][c] + 32) >> 6);
+			}
+			uint8_t indices[16];
+			float error = selectIndices(pBlock, palette, 4, pChannels, indices);
+			if (error < bestError) {
+				bestError = error;
+				memcpy(pValue0, values[0], sizeof(values[0]));
+				memcpy(pValue1, values[1], sizeof(values[1]));
+				memcpy(pIndices, indices, 16);
+			}
+			if (error == 0.0f || pass == refits || !refitEndpoints(pBlock, indices, bc7RampWeights2, endpoint0, endpoint1))
+				break;
+		}
+		return bestError;
+	}
+
+	void encodeMode5(const Block& pBlock, BlockCompressor::Quality pQuality, Mode5& pMode) {
+		static const float channelsAlpha[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+		pMode.error = FLT_MAX;
+		for (int rotation = 0; rotation < 4; ++rotation) {
+			//the rotation swaps a color channel with alpha before encoding, the decoder swaps them back
+			Block rotated = pBlock;
+			if (rotation != 0) {
+				memcpy(rotated.channels[rotation - 1], pBlock.channels[3], sizeof(rotated.channels[3]));
+				memcpy(rotated.channels[3], pBlock.channels[rotation - 1], sizeof(rotated.channels[3]));
+			}
+			Mode5 mode;
+			mode.rotation = rotation;
+			int colors[2][4], alphas[2][4];
+			mode.error = encodeMode5Part(rotated, channelsRgb, 7, pQuality, colors[0], colors[1], mode.colorIndices);
+			mode.error += encodeMode5Part(rotated, channelsAlpha, 8, pQuality, alphas[0], alphas[1], mode.alphaIndices);
+			if (mode.error < pMode.error) {
+				for (int e = 0; e < 2; ++e) {
+					for (int c = 0; c < 3; ++c)
+						mode.colors[e][c] = colors[e][c];
+					mode.alphas[e] = alphas[e][3];
+				}
+				pMode = mode;
+			}
+		}
+	}
+
+	void writeMode5(Mode5 pMode, uint8_t* pOutput) {
+		//the highest index bit of pixel 0 isn't stored for both index sets
+		if (pMode.colorIndices[0] >= 2) {
+			for (int c = 0; c < 3; ++c)
+				swap(pMode.colors[0][c], pMode.colors[1][c]);
+			for (int p = 0; p < 16; ++p)
+				pMode.colorIndices[p] = (uint8_t)(3 - pMode.colorIndices[p]);
+		}
+		if (pMode.alphaIndices[0] >= 2) {
+			swap(pMode.alphas[0], pMode.alphas[1]);
+			for (int p = 0; p < 16; ++p)
+				pMode.alphaIndices[p] = (uint8_t)(3 - pMode.alphaIndices[p]);
+		}
+		BitWriter writer(pOutput);
+		writer.write(1 << 5, 6);
+		writer.write(pMode.rotation, 2);
+		for (int c = 0; c < 3; ++c) {
+			writer.write(pMode.colors[0][c], 7);
+			writer.write(pMode.colors[1][c], 7);
+		}
+		writer.write(pMode.alphas[0], 8);
+		writer.write(pMode.alphas[1], 8);
+		for (int p = 0; p < 16; ++p)
+			writer.write(pMode.colorIndices[p], (p == 0) ? 1 : 2);
+		for (int p = 0; p < 16; ++p)
+			writer.write(pMode.alphaIndices[p], (p == 0) ? 1 : 2);
+	}
+
+	void encodeBC7(const Block& pBlock, BlockCompressor::Quality pQuality, uint8_t* pOutput) {
+		Mode6 mode6;
+		encodeMode6(pBlock, pQuality, mode6);
+		if (pQuality == BlockCompressor::QualityHigh && mode6.error > 0.0f) {
+			Mode5 mode5;
+			encodeMode5(pBlock, pQuality, mode5);
+			if (mode5.error < mode6.error) {
+				writeMode5(mode5, pOutput);
+				return;
+			}
+		}
+		writeMode6(mode6, pOutput);
+	}
+
+	void decodeBC7(const uint8_t* pInput, uint8_t* pPixels) {
+		BitReader reader(pInput);
+		int mode = 0;
+		while (mode < 8 && reader.read(1) == 0)
+			mode++;
+
+		if (mode == 6) {
+			int endpoints[2][4];
+			for (int c = 0; c < 4; ++c) {
+				endpoints[0][c] = reader.read(7) << 1;
+				endpoints[1][c] = reader.read(7) << 1;
+			}
+			int pBit0 = reader.read(1);
+			int pBit1 = reader.read(1);
+			for (int c = 0; c < 4; ++c) {
+				endpoints[0][c] |= pBit0;
+				endpoints[1][c] |= pBit1;
+			}
+			for (int p = 0; p < 16; ++p) {
+				int weight = weights4[reader.read((p == 0) ? 3 : 4)];
+				for (int c = 0; c < 4; ++c)
+					pPixels[p * 4 + c] = (uint8_t)(((64 - weight) * endpoints[0][c] + weight * endpoints[1][c] + 32) >> 6);
+			}
+		}
+		else if (mode == 5) {
+			int rotation = reader.read(2);
+			int endpoints[2][4];
+			for (int c = 0; c < 3; ++c) {
+				for (int e = 0; e < 2; ++e) {
+					int value = reader.read(7);
+					endpoints[e][c] = (value << 1) | (value >> 6);
+				}
+			}
+			endpoints[0][3] = reader.read(8);
+			endpoints[1][3] = reader.read(8);
+			int colorIndices[16], alphaIndices[16];
+			for (int p = 0; p < 16; ++p)
+				colorIndices[p] = reader.read((p == 0) ? 1 : 2);
+			for (int p = 0; p < 16; ++p)
+				alphaIndices[p] = reader.read((p == 0) ? 1 : 2);
+			for (int p = 0; p < 16; ++p) {
+				uint8_t* pixel = pPixels + p * 4;
+				for (int c = 0; c < 4; ++c) {
+					int weight = weights2[(c == 3) ? alphaIndices[p] : colorIndices[p]];
+					pixel[c] = (uint8_t)(((64 - weight) * endpoints[0][c] + weight * endpoints[1][c] + 32) >> 6);
+				}
+				if (rotation != 0)
+					swap(pixel[rotation - 1], pixel[3]);
+			}
+		}
+		else
+			memset(pPixels, 0, 64);
+	}
+}
+
+uint32_t BlockCompressor::blockBytes(Format pFormat)
+{
+	return (pFormat == FormatBC1) ? 8 : 16;
+}
+
+size_t BlockCompressor::compressedSize(Format pFormat, uint32_t pWidth, uint32_t pHeight)
+{
+	return (size_t)((pWidth + 3) / 4) * ((pHeight + 3) / 4) * blockBytes(pFormat);
+}
+
+void BlockCompressor::compressBlock(const uint8_t* pPixels, Format pFormat, Quality pQuality, uint8_t* pBlock)
+{
+	Block block;
+	for (int p = 0; p < 16; ++p) {
+		for (int c = 0; c < 4; ++c)
+			block.channels[c][p] = pPixels[p * 4 + c];
+	}
+
+	switch (pFormat) {
+	case FormatBC1:
+		encodeColor(block, pQuality, pBlock);
+		break;
+	case FormatBC3:
+		encodeValues(block, 3, pQuality, pBlock);
+		encodeColor(block, pQuality, pBlock + 8);
+		break;
+	case FormatBC5:
+		encodeValues(block, 0, pQuality, pBlock);
+		encodeValues(block, 1, pQuality, pBlock + 8);
+		break;
+	case FormatBC7:
+		encodeBC7(block, pQuality, pBlock);
+		break;
+	}
+}
+
+void BlockCompressor::compress(const uint8_t* pPixels, uint32_t pWidth, uint32_t pHeight, size_t pRowBytes, bool pBgra, uint8_t* pBlocks, const Settings& pSettings)
+{
+	compress(pPixels, pWidth, pHeight, pRowBytes, pBgra, pBlocks, (size_t)((pWidth + 3) / 4) * blockBytes(pSettings.format), pSettings);
+}
+
+void BlockCompressor::compress(const uint8_t* pPixels, uint32_t pWidth, uint32_t pHeight, size_t pRowBytes, bool pBgra, uint8_t* pBlocks, size_t pBlockRowPitch, const Settings& pSettings)
+{
+	uint32_t blocksWide = (pWidth + 3) / 4;
+	uint32_t blocksHigh = (pHeight + 3) / 4;
+	uint32_t bytes = blockBytes(pSettings.format);
+	unsigned threads = parallelThreadCount(pSettings.threads);
+	threads = (unsigned)min((size_t)threads, max((size_t)1, (size_t)blocksWide * blocksHigh / parallelBlocks));
+
+	parallelFor(blocksHigh, threads, [&](size_t pBegin, size_t pEnd) {
+		uint8_t pixels[64];
+		uint8_t block[16];
+		for (size_t blockY = pBegin; blockY < pEnd; ++blockY) {
+			for (uint32_t blockX = 0; blockX < blocksWide; ++blockX) {
+				//gather the block in rgba, repeating the last row and column past the edge
+				for (uint32_t y = 0; y < 4; ++y) {
+					uint32_t sourceY = min((uint32_t)blockY * 4 + y, pHeight - 1);
+					for (uint32_t x = 0; x < 4; ++x) {
+						uint32_t sourceX = min(blockX * 4 + x, pWidth - 1);
+						const uint8_t* source = pPixels + sourceY * pRowBytes + sourceX * 4;
+						uint8_t* pixel = pixels + (y * 4 + x) * 4;
+						pixel[0] = source[pBgra ? 2 : 0];
+						pixel[1] = source[1];
+						pixel[2] = source[pBgra ? 0 : 2];
+						pixel[3] = source[3];
+					}
+				}
+				//encoded on the stack, the bc7 bit writer reads what it wrote so far and the target may be write combined memory
+				compressBlock(pixels, pSettings.format, pSettings.quality, block);
+				memcpy(pBlocks + blockY * pBlockRowPitch + blockX * bytes, block, bytes);
+			}
+		}
+	});
+}
+
+void BlockCompressor::decompress(const uint8_t* pBlocks, uint32_t pWidth, uint32_t pHeight, Format pFormat, bool pBgra, uint8_t* pPixels)
+{
+	uint32_t blocksWide = (pWidth + 3) / 4;
+	uint32_t blocksHigh = (pHeight + 3) / 4;
+	uint32_t bytes = blockBytes(pFormat);
+	uint8_t pixels[64];
+	for (uint32_t blockY = 0; blockY < blocksHigh; ++blockY) {
+		for (uint32_t blockX = 0; blockX < blocksWide; ++blockX) {
+			const uint8_t* block = pBlocks + ((size_t)blockY * blocksWide + blockX) * bytes;
+			switch (pFormat) {
+			case FormatBC1:
+				decodeColor(block, false, pixels);
+				break;
+			case FormatBC3:
+				decodeColor(block + 8, true, pixels);
+				decodeValues(block, pixels, 3);
+				break;
+			case FormatBC5:
+				for (int p = 0; p < 16; ++p) {
+					pixels[p * 4 + 2] = 0;
+					pixels[p * 4 + 3] = 255;
+				}
+				decodeValues(block, pixels, 0);
+				decodeValues(block + 8, pixels, 1);
+				break;
+			case FormatBC7:
+				decodeBC7(block, pixels);
+				break;
+			}
+
+			for (uint32_t y = 0; y < 4 && blockY * 4 + y < pHeight; ++y) {
+				for (uint32_t x = 0; x < 4 && blockX * 4 + x < pWidth; ++x) {
+					const uint8_t* pixel = pixels + (y * 4 + x) * 4;
+					uint8_t* target = pPixels + (((size_t)blockY * 4 + y) * pWidth + blockX * 4 + x) * 4;
+					target[0] = pixel[pBgra ? 2 : 0];
+					target[1] = pixel[1];
+					target[2] = pixel[pBgra ? 0 : 2];
+					target[3] = pixel[3];
+				}
+			}
+		}
+	}
+}
+
+double BlockCompressor::psnr(const uint8_t* pOriginal, const uint8_t* pDecoded, size_t pPixelCount, Format pFormat, bool pBgra)
+{
+	//the channels the format stores, in the memory order of the images
+	bool channels[4] = { true, true, true, pFormat == FormatBC3 || pFormat == FormatBC7 };
+	if (pFormat == FormatBC5) {
+		channels[pBgra ? 0 : 2] = false;
+	}
+	double squaredError = 0.0;
+	size_t samples = 0;
+	for (int c = 0; c < 4; ++c) {
+		if (!channels[c])
+			continue;
+		for (size_t i = 0; i < pPixelCount; ++i) {
+			double difference = (double)pOriginal[i * 4 + c] - pDecoded[i * 4 + c];
+			squaredError += difference * difference;
+		}
+		samples += pPixelCount;
+	}
+	if (squaredError == 0.0)
+		return numeric_limits<double>::infinity();
+	return 10.0 * log10(255.0 * 255.0 * samples / squaredError);
+}
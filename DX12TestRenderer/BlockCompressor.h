@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * Compresses 8 bit, 4 channel images to the d3d block compressed formats on the cpu, so textures take 4 to 8 times less
+ * memory and bandwidth on the gpu than rgba8. Every 4x4 block is encoded on its own, the image is split over threads by
+ * block rows. Endpoints start on the principal axis of the block colors and are refined by least squares fits of the
+ * chosen indices, the index search compares 4 pixels at a time to every palette entry in sse registers.
+ * - BC1: rgb, 4 bits per pixel, always in 4 color mode (opaque)
+ * - BC3: BC1 color plus an 8 value alpha block, 8 bits per pixel
+ * - BC5: two 8 value blocks for red and green, 8 bits per pixel. for normal maps, blue and alpha are dropped
+ * - BC7: rgba, 8 bits per pixel, mode 6 (one 7777.1 endpoint pair, 16 step indices) and with QualityHigh also mode 5
+ *   (color and alpha with separate indices, with the 4 channel rotations). the partitioned modes are not used
+ * Blocks that reach past the edge of the image (mips smaller than 4 texels) repeat the edge texels.
+ */
+class BlockCompressor
+{
+public:
+	enum Format {
+		FormatBC1,		//DXGI_FORMAT_BC1_UNORM
+		FormatBC3,		//DXGI_FORMAT_BC3_UNORM
+		FormatBC5,		//DXGI_FORMAT_BC5_UNORM
+		FormatBC7		//DXGI_FORMAT_BC7_UNORM
+	};
+
+	enum Quality {
+		QualityFast,	//endpoints from the principal axis only
+		QualityNormal,	//plus a least squares refit of the endpoints
+		QualityHigh		//more refits, every p-bit combination and for BC7 also mode 5
+	};
+
+	struct Settings {
+		Format format;
+		Quality quality;
+		unsigned threads;	//0 uses all hardware threads
+	};
+
+	//size of one 4x4 block in bytes (8 or 16)
+	static uint32_t blockBytes(Format pFormat);
+
+	//bytes of a compressed image, whole blocks per row times block rows
+	static size_t compressedSize(Format pFormat, uint32_t pWidth, uint32_t pHeight);
+
+	//compress an image of 4 byte pixels with rows pRowBytes apart, rgba or bgra (pBgra). pBlocks gets compressedSize bytes,
+	//the blocks of a row are next to each other and block rows are tightly packed
+	static void compress(const uint8_t* pPixels, uint32_t pWidth, uint32_t pHeight, size_t pRowBytes, bool pBgra, uint8_t* pBlocks, const Settings& pSettings);
+
+	//the same with block rows pBlockRowPitch bytes apart, to compress straight into the footprint of an upload heap.
+	//blocks are only written, never read back
+	static void compress(const uint8_t* pPixels, uint32_t pWidth, uint32_t pHeight, size_t pRowBytes, bool pBgra, uint8_t* pBlocks, size_t pBlockRowPitch, const Settings& pSettings);
+
+	//compress one block of 16 rgba pixels, row by row
+	static void compressBlock(const uint8_t* pPixels, Format pFormat, Quality pQuality, uint8_t* pBlock);
+
+	//decode blocks back to rgba (or bgra) pixels, pWidth * 4 bytes per row, to measure the quality. BC7 blocks are decoded
+	//for the modes compress writes (5 and 6), blocks in other modes come out black. BC1 and BC5 give opaque pixels
+	static void decompress(const uint8_t* pBlocks, uint32_t pWidth, uint32_t pHeight, Format pFormat, bool pBgra, uint8_t* pPixels);
+
+	//peak signal to noise ratio in dB of two tightly packed images in the same channel order, over the channels the
+	//format stores (rgb for BC1, rg for BC5). infinite if the images are the same
+	static double psnr(const uint8_t* pOriginal, const uint8_t* pDecoded, size_t pPixelCount, Format pFormat, bool pBgra);
+};
@@ -0,0 +1,145 @@
+#include "Bounds.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BOUNDS_SSE2
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+namespace {
+	inline glm::vec3 loadPosition(const unsigned char* pPositions, size_t pStride, size_t pIndex) {
+		glm::vec3 position;
+		memcpy(&position, pPositions + pStride * pIndex, sizeof(position));
+		return position;
+	}
+
+	void emptyBounds(Bounds::Box& pBox, Bounds::Sphere& pSphere) {
+		pBox.min = pBox.max = glm::vec3(0.0f);
+		pSphere.center = glm::vec3(0.0f);
+		pSphere.radius = 0.0f;
+	}
+
+#ifdef BOUNDS_SSE2
+	//x, y, z of a position in the low 3 lanes. reading 4 floats is only safe if there is another float behind the position
+	inline __m128 loadPosition4(const unsigned char* pPosition) {
+		return _mm_loadu_ps((const float*)pPosition);
+	}
+
+	inline __m128 loadPosition3(const unsigned char* pPosition) {
+		__m128 xy = _mm_castpd_ps(_mm_load_sd((const double*)pPosition));
+		__m128 z = _mm_load_ss((const float*)pPosition + 2);
+		return _mm_movelh_ps(xy, z);
+	}
+#endif
+}
+
+void Bounds::compute(const void* pPositions, size_t pStride, size_t pCount, Box& pBox, Sphere& pSphere)
+{
+#ifdef BOUNDS_SSE2
+	if (pCount == 0) {
+		emptyBounds(pBox, pSphere);
+		return;
+	}
+	const unsigned char* positions = (const unsigned char*)pPositions;
+	//every position but the last has at least one float behind it, the 4th lane is ignored
+	size_t fullLoads = pCount - 1;
+
+	//two sets of accumulators so the min/max chains don't wait on each other
+	__m128 first = loadPosition3(positions);
+	__m128 min0 = first, max0 = first, min1 = first, max1 = first;
+	size_t i = 0;
+	for (; i + 2 <= fullLoads; i += 2) {
+		__m128 p0 = loadPosition4(positions + pStride * i);
+		__m128 p1 = loadPosition4(positions + pStride * (i + 1));
+		min0 = _mm_min_ps(min0, p0);
+		max0 = _mm_max_ps(max0, p0);
+		min1 = _mm_min_ps(min1, p1);
+		max1 = _mm_max_ps(max1, p1);
+	}
+	for (; i < pCount; ++i) {
+		__m128 p = (i < fullLoads) ? loadPosition4(positions + pStride * i) : loadPosition3(positions + pStride * i);
+		min0 = _mm_min_ps(min0, p);
+		max0 = _mm_max_ps(max0, p);
+	}
+	min0 = _mm_min_ps(min0, min1);
+	max0 = _mm_max_ps(max0, max1);
+
+	float boxMin[4], boxMax[4];
+	_mm_storeu_ps(boxMin, min0);
+	_mm_storeu_ps(boxMax, max0);
+	pBox.min = glm::vec3(boxMin[0], boxMin[1], boxMin[2]);
+	pBox.max = glm::vec3(boxMax[0], boxMax[1], boxMax[2]);
+	pSphere.center = (pBox.min + pBox.max) * 0.5f;
+
+	//largest squared distance to the center, the 4th lane is masked off before the horizontal sum
+	const __m128 xyzMask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+	__m128 center = _mm_setr_ps(pSphere.center.x, pSphere.center.y, pSphere.center.z, 0.0f);
+	__m128 radiusSquared = _mm_setzero_ps();
+	for (i = 0; i < pCount; ++i) {
+		__m128 p = (i < fullLoads) ? loadPosition4(positions + pStride * i) : loadPosition3(positions + pStride * i);
+		__m128 offset = _mm_and_ps(_mm_sub_ps(p, center), xyzMask);
+		__m128 squared = _mm_mul_ps(offset, offset);
+		//x + y + z in every lane
+		squared = _mm_add_ps(squared, _mm_shuffle_ps(squared, squared, _MM_SHUFFLE(2, 3, 0, 1)));
+		squared = _mm_add_ps(squared, _mm_shuffle_ps(squared, squared, _MM_SHUFFLE(1, 0, 3, 2)));
+		radiusSquared = _mm_max_ss(radiusSquared, squared);
+	}
+	pSphere.radius = sqrtf(_mm_cvtss_f32(radiusSquared));
+#else
+	computeScalar(pPositions, pStride, pCount, pBox, pSphere);
+#endif
+}
+
+void Bounds::computeScalar(const void* pPositions, size_t pStride, size_t pCount, Box& pBox, Sphere& pSphere)
+{
+	if (pCount == 0) {
+		emptyBounds(pBox, pSphere);
+		return;
+	}
+	const unsigned char* positions = (const unsigned char*)pPositions;
+
+	pBox.min = pBox.max = loadPosition(positions, pStride, 0);
+	for (size_t i = 1; i < pCount; ++i) {
+		glm::vec3 position = loadPosition(positions, pStride, i);
+		pBox.min = glm::min(pBox.min, position);
+		pBox.max = glm::max(pBox.max, position);
+	}
+	pSphere.center = (pBox.min + pBox.max) * 0.5f;
+
+	float radiusSquared = 0.0f;
+	for (size_t i = 0; i < pCount; ++i) {
+		glm::vec3 offset = loadPosition(positions, pStride, i) - pSphere.center;
+		radiusSquared = max(radiusSquared, (offset.x * offset.x + offset.y * offset.y) + offset.z * offset.z);
+	}
+	pSphere.radius = sqrtf(radiusSquared);
+}
+
+Bounds::Box Bounds::transform(const Box& pBox, const glm::mat4& pTransform)
+{
+	glm::vec3 center = (pBox.min + pBox.max) * 0.5f;
+	glm::vec3 extent = (pBox.max - pBox.min) * 0.5f;
+
+	glm::vec3 worldCenter = glm::vec3(pTransform * glm::vec4(center, 1.0f));
+	glm::vec3 worldExtent = glm::abs(glm::vec3(pTransform[0])) * extent.x
+		+ glm::abs(glm::vec3(pTransform[1])) * extent.y
+		+ glm::abs(glm::vec3(pTransform[2])) * extent.z;
+
+	Box box;
+	box.min = worldCenter - worldExtent;
+	box.max = worldCenter + worldExtent;
+	return box;
+}
+
+Bounds::Sphere Bounds::transform(const Sphere& pSphere, const glm::mat4& pTransform)
+{
+	float scale = max(glm::length(glm::vec3(pTransform[0])), max(glm::length(glm::vec3(pTransform[1])), glm::length(glm::vec3(pTransform[2]))));
+
+	Sphere sphere;
+	sphere.center = glm::vec3(pTransform * glm::vec4(pSphere.center, 1.0f));
+	sphere.radius = pSphere.radius * scale;
+	return sphere;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include "glm.h"
+
+/**
+ * Bounding volumes: an axis aligned box and a sphere around a set of positions, and how to move them into world space.
+ * The box is the tight one for culling against planes, the sphere is cheaper to test and does not change with rotation.
+ * The min/max reduction runs with sse2 where available, the scalar path gives the exact same result.
+ * Everything here is cpu only and device independent.
+ */
+class Bounds
+{
+public:
+	struct Box {
+		glm::vec3 min;
+		glm::vec3 max;
+	};
+
+	struct Sphere {
+		glm::vec3 center;
+		float radius;
+	};
+
+	//bounds of pCount positions, pPositions points to the first float3 position, pStride is the number of bytes between positions.
+	//the sphere is centered on the box, no positions gives an empty box and sphere at the origin
+	static void compute(const void* pPositions, size_t pStride, size_t pCount, Box& pBox, Sphere& pSphere);
+	static void computeScalar(const void* pPositions, size_t pStride, size_t pCount, Box& pBox, Sphere& pSphere);
+
+	//the box around pBox after pTransform, without transforming the 8 corners:
+	//the center is transformed as a point and the half size by the absolute values of the matrix (Arvo 1990)
+	static Box transform(const Box& pBox, const glm::mat4& pTransform);
+
+	//the sphere around pSphere after pTransform, the radius grows with the largest axis scale
+	static Sphere transform(const Sphere& pSphere, const glm::mat4& pTransform);
+};
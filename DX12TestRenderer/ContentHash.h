@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+/**
+ * 64 bit non cryptographic hash of a block of memory, used to identify asset contents
+ * (cooked meshes, textures). It reads 8 bytes per step so hashing is close to memory speed.
+ */
+inline uint64_t hashContent(const void* pData, size_t pSize, uint64_t pSeed = 0)
+{
+	const uint64_t prime1 = 0x9e3779b185ebca87ull;
+	const uint64_t prime2 = 0xc2b2ae3d27d4eb4full;
+
+	const unsigned char* bytes = (const unsigned char*)pData;
+	uint64_t hash = pSeed ^ (pSize * prime1);
+
+	size_t i = 0;
+	for (; i + 8 <= pSize; i += 8) {
+		uint64_t word;
+		memcpy(&word, bytes + i, 8);
+		word *= prime2;
+		word = (word << 31) | (word >> 33);
+		word *= prime1;
+		hash ^= word;
+		hash = ((hash << 27) | (hash >> 37)) * prime1 + 0x85ebca77c2b2ae63ull;
+	}
+	for (; i < pSize; ++i) {
+		hash ^= bytes[i] * prime2;
+		hash = ((hash << 11) | (hash >> 53)) * prime1;
+	}
+
+	//final avalanche
+	hash ^= hash >> 33;
+	hash *= prime2;
+	hash ^= hash >> 29;
+	hash *= prime1;
+	hash ^= hash >> 32;
+	return hash;
+}
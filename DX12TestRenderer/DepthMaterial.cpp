@@ -0,0 +1,85 @@
+#include "DepthMaterial.h"
+
+DepthMaterial::DepthMaterial(ID3D12Device* pDevice, ID3D12GraphicsCommandList* pCommandList) : device(pDevice), commandList(pCommandList)
+{
+	//create root signature, only the constant buffer with the wvp matrix
+	D3D12_ROOT_DESCRIPTOR rootCBVDescriptor;
+	rootCBVDescriptor.RegisterSpace = 0;
+	rootCBVDescriptor.ShaderRegister = 0;
+
+	D3D12_ROOT_PARAMETER rootParameters[1];
+	rootParameters[0].ParameterType = D3D12_ROOT_PARAMETER_TYPE_CBV;
+	rootParameters[0].Descriptor = rootCBVDescriptor;
+	rootParameters[0].ShaderVisibility = D3D12_SHADER_VISIBILITY_VERTEX;
+
+	CD3DX12_ROOT_SIGNATURE_DESC rootSignatureDesc;
+	rootSignatureDesc.Init(
+		_countof(rootParameters),
+		rootParameters,
+		0, //no samplers
+		nullptr,
+		D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT |
+		D3D12_ROOT_SIGNATURE_FLAG_DENY_HULL_SHADER_ROOT_ACCESS |
+		D3D12_ROOT_SIGNATURE_FLAG_DENY_DOMAIN_SHADER_ROOT_ACCESS |
+		D3D12_ROOT_SIGNATURE_FLAG_DENY_GEOMETRY_SHADER_ROOT_ACCESS |
+		D3D12_ROOT_SIGNATURE_FLAG_DENY_PIXEL_SHADER_ROOT_ACCESS
+	);
+
+	ID3DBlob* errorBuffer; //a buffer holding the error data if any
+	ID3DBlob* signature;
+	ThrowIfFailed(D3D12SerializeRootSignature(&rootSignatureDesc, D3D_ROOT_SIGNATURE_VERSION_1, &signature, &errorBuffer));
+	ThrowIfFailed(device->CreateRootSignature(0, signature->GetBufferPointer(), signature->GetBufferSize(), IID_PPV_ARGS(&rootSignature)));
+
+	//compile the vertex shader, there is no pixel shader, depth is written by the output merger
+	ID3DBlob* vertexShader;
+	HRESULT hr = D3DCompileFromFile(L"DepthVertexShader.hlsl", nullptr, nullptr, "main", "vs_5_0", D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION, 0, &vertexShader, &errorBuffer);
+	if (FAILED(hr)) {
+		OutputDebugStringA((char*)errorBuffer->GetBufferPointer());
+		ThrowIfFailed(hr);
+	}
+
+	D3D12_SHADER_BYTECODE vertexShaderBytecode = {};
+	vertexShaderBytecode.BytecodeLength = vertexShader->GetBufferSize();
+	vertexShaderBytecode.pShaderBytecode = vertexShader->GetBufferPointer();
+
+	DXGI_SAMPLE_DESC sampleDesc = {};
+	sampleDesc.Count = 1;
+
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDesc = {};
+	psoDesc.pRootSignature = rootSignature;
+	psoDesc.VS = vertexShaderBytecode;
+	psoDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+	psoDesc.NumRenderTargets = 0;
+	psoDesc.SampleDesc = sampleDesc;
+	psoDesc.SampleMask = 0xffffffff;
+	psoDesc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
+	psoDesc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
+	psoDesc.DepthStencilState = CD3DX12_DEPTH_STENCIL_DESC(D3D12_DEFAULT);
+	psoDesc.DSVFormat = DXGI_FORMAT_D32_FLOAT;
+
+	//a pso per mesh vertex layout, all reading only the position stream
+	for (int layout = 0; layout < Mesh::vertexLayoutCount; ++layout) {
+		D3D12_INPUT_ELEMENT_DESC inputElements[Mesh::maxInputElements];
+		psoDesc.InputLayout = Mesh::getInputLayout(layout, Mesh::StreamPosition, inputElements);
+		ThrowIfFailed(device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&pipelineStateObjects[layout])));
+	}
+}
+
+void DepthMaterial::Render(Mesh* pMesh, D3D12_GPU_VIRTUAL_ADDRESS pGPUAddress, int pLod)
+{
+	pMesh->SetVertexIndexBuffers(Mesh::StreamPosition);
+
+	commandList->SetGraphicsRootSignature(rootSignature);
+	commandList->SetPipelineState(pipelineStateObjects[pMesh->getVertexLayout()]);
+	commandList->SetGraphicsRootConstantBufferView(0, pGPUAddress);
+
+	pMesh->Draw(pLod);
+}
+
+DepthMaterial::~DepthMaterial()
+{
+	for (int layout = 0; layout < Mesh::vertexLayoutCount; ++layout) {
+		if (pipelineStateObjects[layout]) pipelineStateObjects[layout]->Release();
+	}
+	if (rootSignature) rootSignature->Release();
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN             // Exclude rarely-used stuff from Windows headers.
+#endif
+
+#include "d3dx12.h"
+#include <d3d12.h>
+#include <D3Dcompiler.h>
+#include "Debug.h"
+#include "Mesh.h"
+
+/**
+ * Renders only the depth of a mesh, for a depth prepass or shadow maps.
+ * Only the position stream is bound, so meshes with split streams fetch 12 bytes per vertex.
+ * Expects a depth buffer (DXGI_FORMAT_D32_FLOAT) and no render targets to be bound.
+ */
+class DepthMaterial
+{
+public:
+	DepthMaterial(ID3D12Device* pDevice, ID3D12GraphicsCommandList* pCommandList);
+	//draw the given lod of the mesh
+	void Render(Mesh* pMesh, D3D12_GPU_VIRTUAL_ADDRESS pGPUAddress, int pLod = 0);
+	~DepthMaterial();
+protected:
+	ID3D12Device * device;
+	ID3D12GraphicsCommandList* commandList;
+
+	ID3D12PipelineState* pipelineStateObjects[Mesh::vertexLayoutCount]; //pso per mesh vertex layout
+
+	ID3D12RootSignature* rootSignature; //a single constant buffer with the wvp matrix
+};
@@ -0,0 +1,14 @@
+struct VS_INPUT{
+	float3 pos : POSITION;
+};
+
+cbuffer ConstantBuffer : register(b0)
+{
+	float4x4 wvpMat;
+}
+
+float4 main(VS_INPUT i) : SV_POSITION
+{
+	// same transform as VertexShader.hlsl, so the depth is exactly the same as in the color pass
+	return mul(float4(i.pos,1.0f),wvpMat);
+}
@@ -1,10 +1,9 @@
 #include "GameObject.h"
+#include "TextureStreamer.h"
 
-int GameObject::_gameobjects = 0;
-
-GameObject::GameObject(std::string pName, vec3 pPosition) : _transform(glm::translate(glm::mat4(1), pPosition)), _constantBufferID(_gameobjects)
+GameObject::GameObject(std::string pName, vec3 pPosition) : _transform(glm::translate(glm::mat4(1), pPosition)),
+	_parent(NULL), _mesh(NULL), _material(NULL), _lod(0), _worldBoundsValid(false)
 {
-	_gameobjects++;
 }
 
 
@@ -25,6 +24,7 @@ TextureMaterial * GameObject::GetMaterial() const
 void GameObject::SetMesh(Mesh * pMesh)
 {
 	_mesh = pMesh;
+	_invalidateWorldBounds();
 }
 
 Mesh * GameObject::GetMesh() const
@@ -40,11 +40,75 @@ glm::mat4 GameObject::GetTransform() const
 void GameObject::SetTransform(mat4 pTransform)
 {
 	_transform = pTransform;
+	_invalidateWorldBounds();
 }
 
 void GameObject::scale(vec3 pScale)
 {
 	_transform = glm::scale(_transform, pScale);
+	_invalidateWorldBounds();
+}
+
+glm::mat4 GameObject::GetWorldTransform() const
+{
+	if (_parent != NULL)
+		return _parent->GetWorldTransform() * _transform;
+	return _transform;
+}
+
+const Bounds::Box& GameObject::GetWorldBounds() const
+{
+	if (!_worldBoundsValid)
+		_updateWorldBounds();
+	return _worldBounds;
+}
+
+const Bounds::Sphere& GameObject::GetWorldBoundingSphere() const
+{
+	if (!_worldBoundsValid)
+		_updateWorldBounds();
+	return _worldBoundingSphere;
+}
+
+int GameObject::SelectLod(const glm::vec3& pCameraPosition, float pPixelsPerUnit, float pMaxPixels)
+{
+	_lod = 0;
+	if (_mesh == NULL)
+		return _lod;
+
+	//the error is in mesh units, scale it like the mesh is scaled
+	glm::mat4 worldTransform = GetWorldTransform();
+	float scale = glm::max(glm::length(glm::vec3(worldTransform[0])), glm::max(glm::length(glm::vec3(worldTransform[1])), glm::length(glm::vec3(worldTransform[2]))));
+	const Bounds::Sphere& sphere = GetWorldBoundingSphere();
+	float distance = glm::max(glm::length(sphere.center - pCameraPosition) - sphere.radius, 0.0001f);
+	float pixelsPerError = scale * pPixelsPerUnit / distance;
+
+	//the levels get coarser and their error only grows
+	for (int lod = 1; lod < _mesh->getLodCount(); ++lod) {
+		if (_mesh->getLod(lod).error * pixelsPerError > pMaxPixels)
+			break;
+		_lod = lod;
+	}
+	return _lod;
+}
+
+int GameObject::GetLod() const
+{
+	return _lod;
+}
+
+float GameObject::SelectTextureMip(const glm::vec3& pCameraPosition, float pPixelsPerUnit, uint32_t pTextureSize) const
+{
+	if (_mesh == NULL)
+		return 0.0f;
+
+	//the uvs are spread over the mesh units, scale them like the mesh is scaled
+	glm::mat4 worldTransform = GetWorldTransform();
+	float scale = glm::max(glm::length(glm::vec3(worldTransform[0])), glm::max(glm::length(glm::vec3(worldTransform[1])), glm::length(glm::vec3(worldTransform[2]))));
+	const Bounds::Sphere& sphere = GetWorldBoundingSphere();
+	float distance = glm::max(glm::length(sphere.center - pCameraPosition) - sphere.radius, 0.0001f);
+	float texelsPerUnit = pTextureSize * _mesh->getUvDensity() / scale;
+	return TextureStreamer::desiredMip(texelsPerUnit, pPixelsPerUnit / distance);
 }
 
 void GameObject::Add(GameObject * pChild)
@@ -59,6 +123,7 @@ void GameObject::SetParent(GameObject * pParent)
 		_parent->_innerRemove(this);
 		_parent = NULL;
 	}
+	_invalidateWorldBounds();
 
 	//set new parent
 	if (pParent != NULL) {
@@ -83,3 +148,26 @@ void GameObject::_innerRemove(GameObject* pChild) {
 		}
 	}
 }
+
+void GameObject::_invalidateWorldBounds()
+{
+	//the world transform of the children includes this one
+	_worldBoundsValid = false;
+	for (auto i = _children.begin(); i != _children.end(); ++i)
+		(*i)->_invalidateWorldBounds();
+}
+
+void GameObject::_updateWorldBounds() const
+{
+	glm::mat4 worldTransform = GetWorldTransform();
+	if (_mesh != NULL) {
+		_worldBounds = Bounds::transform(_mesh->getBounds(), worldTransform);
+		_worldBoundingSphere = Bounds::transform(_mesh->getBoundingSphere(), worldTransform);
+	}
+	else {
+		_worldBounds.min = _worldBounds.max = glm::vec3(worldTransform[3]);
+		_worldBoundingSphere.center = glm::vec3(worldTransform[3]);
+		_worldBoundingSphere.radius = 0.0f;
+	}
+	_worldBoundsValid = true;
+}
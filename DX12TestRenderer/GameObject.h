@@ -23,13 +23,32 @@ public:
 	void scale(vec3 pScale);
 	void Add(GameObject* pChild);
 	void SetParent(GameObject* pParent);
-	const int _constantBufferID;
+
+	//the transform of the object combined with the transforms of its parents
+	glm::mat4 GetWorldTransform() const;
+
+	//world space bounds of the mesh, cached and only recomputed after the transform (or a parent transform) or mesh changed.
+	//without a mesh these are empty, at the world position of the object
+	const Bounds::Box& GetWorldBounds() const;
+	const Bounds::Sphere& GetWorldBoundingSphere() const;
+
+	//pick the coarsest lod of the mesh whose geometric error covers at most pMaxPixels on screen, at the point of
+	//the bounding sphere closest to the camera. pPixelsPerUnit is the size in pixels of one unit at distance 1
+	//(viewport height / (2 * tan(fov / 2))). returns the selected lod, also see GetLod
+	int SelectLod(const glm::vec3& pCameraPosition, float pPixelsPerUnit, float pMaxPixels = 1.0f);
+	int GetLod() const;
+
+	//the mip of a texture pTextureSize texels wide that gives about a texel per pixel at the same point as SelectLod,
+	//from the uv density of the mesh. for TextureRegistry::requestMip
+	float SelectTextureMip(const glm::vec3& pCameraPosition, float pPixelsPerUnit, uint32_t pTextureSize) const;
 
 protected:
-	static int _gameobjects;
 	// update children list administration
 	void _innerAdd(GameObject* pChild);
 	void _innerRemove(GameObject* pChild);
+	// the world bounds of this object and its children are out of date
+	void _invalidateWorldBounds();
+	void _updateWorldBounds() const;
 
 	std::vector<GameObject*> _children;
 	GameObject* _parent;
@@ -38,5 +57,11 @@ protected:
 	Mesh* _mesh;
 	TextureMaterial* _material;
 
+	int _lod;
+
+	mutable Bounds::Box _worldBounds;
+	mutable Bounds::Sphere _worldBoundingSphere;
+	mutable bool _worldBoundsValid;
+
 };
 
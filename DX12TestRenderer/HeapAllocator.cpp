@@ -0,0 +1,282 @@
+#include "HeapAllocator.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+using namespace std;
+
+namespace {
+	//index of the lowest and the highest set bit, pBits isn't 0
+	unsigned lowestBit(uint64_t pBits) {
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward64(&index, pBits);
+		return (unsigned)index;
+#else
+		return (unsigned)__builtin_ctzll(pBits);
+#endif
+	}
+
+	unsigned highestBit(uint64_t pBits) {
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanReverse64(&index, pBits);
+		return (unsigned)index;
+#else
+		return 63 - (unsigned)__builtin_clzll(pBits);
+#endif
+	}
+}
+
+HeapAllocator::HeapAllocator(uint64_t pSize, uint64_t pGranularity)
+	: _size(pSize), _granularity(pGranularity), _granularityShift(lowestBit(pGranularity)), _usedBytes(0), _allocations(0), _firstLevelBits(0)
+{
+	for (unsigned first = 0; first < firstLevels; ++first) {
+		_secondLevelBits[first] = 0;
+		for (unsigned second = 0; second < secondLevels; ++second)
+			_freeLists[first][second] = invalidHandle;
+	}
+
+	//the whole range is one free block
+	uint32_t all = _newBlock();
+	_blocks[all].offset = 0;
+	_blocks[all].size = pSize;
+	if (pSize > 0)
+		_insertFree(all);
+}
+
+HeapAllocator::Handle HeapAllocator::allocate(uint64_t pSize, uint64_t pAlignment)
+{
+	uint64_t alignment = (pAlignment > _granularity) ? pAlignment : _granularity;
+	uint64_t size = (((pSize > 0) ? pSize : 1) + _granularity - 1) & ~(_granularity - 1);
+	if (size > _size)
+		return invalidHandle;
+
+	//the first block of the smallest list that fits the size, if it is aligned well enough. otherwise any block of
+	//size + alignment - granularity has an aligned offset with size after it
+	uint32_t found = _findFree(size >> _granularityShift);
+	if (found != invalidHandle && !_fits(found, size, alignment)) {
+		uint64_t searchSize = size + alignment - _granularity;
+		found = (searchSize <= _size) ? _findFree(searchSize >> _granularityShift) : invalidHandle;
+	}
+	//the lists only hold blocks that are certain to fit from the next list up, the blocks that fit with the slack
+	//they really need can be in the lists below that
+	if (found == invalidHandle)
+		found = _findFitting(size, alignment);
+	if (found == invalidHandle)
+		return invalidHandle;
+	_removeFree(found);
+
+	//the part in front of the aligned offset stays free. the block before it is in use, or it would have been merged
+	uint64_t aligned = (_blocks[found].offset + alignment - 1) & ~(alignment - 1);
+	if (aligned > _blocks[found].offset) {
+		uint32_t front = _newBlock();
+		Block& block = _blocks[found];
+		Block& frontBlock = _blocks[front];
+		frontBlock.offset = block.offset;
+		frontBlock.size = aligned - block.offset;
+		frontBlock.previous = block.previous;
+		frontBlock.next = found;
+		if (block.previous != invalidHandle)
+			_blocks[block.previous].next = front;
+		block.previous = front;
+		block.offset = aligned;
+		block.size -= frontBlock.size;
+		_insertFree(front);
+	}
+
+	//and so does the part after it
+	if (_blocks[found].size > size) {
+		uint32_t back = _newBlock();
+		Block& block = _blocks[found];
+		Block& backBlock = _blocks[back];
+		backBlock.offset = block.offset + size;
+		backBlock.size = block.size - size;
+		backBlock.previous = found;
+		backBlock.next = block.next;
+		if (block.next != invalidHandle)
+			_blocks[block.next].previous = back;
+		block.next = back;
+		block.size = size;
+		_insertFree(back);
+	}
+
+	_blocks[found].free = false;
+	_usedBytes += size;
+	_allocations++;
+	return found;
+}
+
+void HeapAllocator::release(Handle pAllocation)
+{
+	if (pAllocation >= _blocks.size() || _blocks[pAllocation].free)
+		return;
+	_usedBytes -= _blocks[pAllocation].size;
+	_allocations--;
+
+	//merge with the free blocks on both sides, the merged ones are reused
+	uint32_t previous = _blocks[pAllocation].previous;
+	if (previous != invalidHandle && _blocks[previous].free) {
+		_removeFree(previous);
+		Block& block = _blocks[pAllocation];
+		block.offset = _blocks[previous].offset;
+		block.size += _blocks[previous].size;
+		block.previous = _blocks[previous].previous;
+		if (block.previous != invalidHandle)
+			_blocks[block.previous].next = pAllocation;
+		_unusedBlocks.push_back(previous);
+	}
+	uint32_t next = _blocks[pAllocation].next;
+	if (next != invalidHandle && _blocks[next].free) {
+		_removeFree(next);
+		Block& block = _blocks[pAllocation];
+		block.size += _blocks[next].size;
+		block.next = _blocks[next].next;
+		if (block.next != invalidHandle)
+			_blocks[block.next].previous = pAllocation;
+		_unusedBlocks.push_back(next);
+	}
+	_insertFree(pAllocation);
+}
+
+uint64_t HeapAllocator::getOffset(Handle pAllocation) const
+{
+	return _blocks[pAllocation].offset;
+}
+
+uint64_t HeapAllocator::getSize(Handle pAllocation) const
+{
+	return _blocks[pAllocation].size;
+}
+
+bool HeapAllocator::empty() const
+{
+	return _allocations == 0;
+}
+
+HeapAllocator::Stats HeapAllocator::getStats() const
+{
+	Stats stats = {};
+	stats.size = _size;
+	stats.usedBytes = _usedBytes;
+	stats.allocations = _allocations;
+	for (size_t i = 0; i < _blocks.size(); ++i) {
+		const Block& block = _blocks[i];
+		if (!block.free)
+			continue;
+		stats.freeBlocks++;
+		if (block.size > stats.largestFree)
+			stats.largestFree = block.size;
+	}
+	uint64_t freeBytes = _size - _usedBytes;
+	stats.fragmentation = (freeBytes > 0) ? 1.0 - (double)stats.largestFree / freeBytes : 0.0;
+	return stats;
+}
+
+void HeapAllocator::_mapping(uint64_t pSize, unsigned& pFirst, unsigned& pSecond)
+{
+	//sizes below secondLevels granules have a list each, above that every power of 2 is split in secondLevels lists
+	if (pSize < secondLevels) {
+		pFirst = 0;
+		pSecond = (unsigned)pSize;
+		return;
+	}
+	unsigned power = highestBit(pSize);
+	pFirst = power - secondLevelBits + 1;
+	pSecond = (unsigned)(pSize >> (power - secondLevelBits)) - secondLevels;
+}
+
+uint32_t HeapAllocator::_newBlock()
+{
+	Block block = { 0, 0, invalidHandle, invalidHandle, invalidHandle, invalidHandle, false };
+	if (!_unusedBlocks.empty()) {
+		uint32_t index = _unusedBlocks.back();
+		_unusedBlocks.pop_back();
+		_blocks[index] = block;
+		return index;
+	}
+	_blocks.push_back(block);
+	return (uint32_t)(_blocks.size() - 1);
+}
+
+void HeapAllocator::_insertFree(uint32_t pBlock)
+{
+	unsigned first, second;
+	_mapping(_blocks[pBlock].size >> _granularityShift, first, second);
+	Block& block = _blocks[pBlock];
+	block.free = true;
+	block.previousFree = invalidHandle;
+	block.nextFree = _freeLists[first][second];
+	if (block.nextFree != invalidHandle)
+		_blocks[block.nextFree].previousFree = pBlock;
+	_freeLists[first][second] = pBlock;
+	_firstLevelBits |= 1ull << first;
+	_secondLevelBits[first] |= 1u << second;
+}
+
+void HeapAllocator::_removeFree(uint32_t pBlock)
+{
+	unsigned first, second;
+	_mapping(_blocks[pBlock].size >> _granularityShift, first, second);
+	Block& block = _blocks[pBlock];
+	if (block.previousFree != invalidHandle)
+		_blocks[block.previousFree].nextFree = block.nextFree;
+	else
+		_freeLists[first][second] = block.nextFree;
+	if (block.nextFree != invalidHandle)
+		_blocks[block.nextFree].previousFree = block.previousFree;
+
+	if (_freeLists[first][second] == invalidHandle) {
+		_secondLevelBits[first] &= ~(1u << second);
+		if (_secondLevelBits[first] == 0)
+			_firstLevelBits &= ~(1ull << first);
+	}
+	block.free = false;
+}
+
+bool HeapAllocator::_fits(uint32_t pBlock, uint64_t pSize, uint64_t pAlignment) const
+{
+	const Block& block = _blocks[pBlock];
+	uint64_t aligned = (block.offset + pAlignment - 1) & ~(pAlignment - 1);
+	return aligned + pSize <= block.offset + block.size;
+}
+
+uint32_t HeapAllocator::_findFitting(uint64_t pSize, uint64_t pAlignment) const
+{
+	unsigned first, second;
+	_mapping(pSize >> _granularityShift, first, second);
+	for (; first < firstLevels; ++first, second = 0) {
+		uint32_t secondBits = _secondLevelBits[first] & (~0u << second);
+		while (secondBits != 0) {
+			for (uint32_t block = _freeLists[first][lowestBit(secondBits)]; block != invalidHandle; block = _blocks[block].nextFree) {
+				if (_fits(block, pSize, pAlignment))
+					return block;
+			}
+			secondBits &= secondBits - 1;
+		}
+	}
+	return invalidHandle;
+}
+
+uint32_t HeapAllocator::_findFree(uint64_t pSize) const
+{
+	//round up to the next list, every block in it is at least that big
+	if (pSize >= secondLevels)
+		pSize += (1ull << (highestBit(pSize) - secondLevelBits)) - 1;
+	unsigned first, second;
+	_mapping(pSize, first, second);
+	if (first >= firstLevels)
+		return invalidHandle;
+
+	//a bigger list of the same power of 2, otherwise the smallest list of a bigger one
+	uint32_t secondBits = _secondLevelBits[first] & (~0u << second);
+	if (secondBits == 0) {
+		uint64_t firstBits = (first + 1 < firstLevels) ? _firstLevelBits & (~0ull << (first + 1)) : 0;
+		if (firstBits == 0)
+			return invalidHandle;
+		first = lowestBit(firstBits);
+		secondBits = _secondLevelBits[first];
+	}
+	return _freeLists[first][lowestBit(secondBits)];
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * Suballocates offsets in a range of memory with a two level segregated fit allocator (TLSF, Masmano et al. 2004).
+ * Free blocks are kept in lists by size class: the first level is the power of 2 of the size, the second level splits
+ * every power of 2 in 16 classes. Two levels of bitmaps find the first list with blocks that are certain to fit in
+ * constant time, a block that is bigger than needed is split and a released block is merged with the free blocks
+ * next to it, so allocate and release cost the same however many blocks there are.
+ * Sizes and offsets are multiples of the granularity. An alignment above it is searched for with the alignment added
+ * to the size, unless the first block that fits the size is aligned already, the space in front of the aligned offset
+ * goes back to the free lists. When the lists that are certain to fit are empty, the smaller lists are searched block
+ * by block, so any free block that is big enough is found.
+ * The block bookkeeping lives in cpu memory, so the range doesn't have to be addressable (a gpu heap, see ResourceHeap).
+ * Device independent.
+ */
+class HeapAllocator
+{
+public:
+	typedef uint32_t Handle;
+	static const Handle invalidHandle = 0xffffffff;
+
+	struct Stats {
+		uint64_t size;			//of the range
+		uint64_t usedBytes;		//allocated, rounded up to the granularity
+		unsigned allocations;
+		unsigned freeBlocks;
+		uint64_t largestFree;	//the largest free block, an allocation of its size at the granularity succeeds
+		double fragmentation;	//1 - largestFree / free bytes, 0 if the free bytes are one block
+	};
+
+	//pGranularity is a power of 2, pSize a multiple of it
+	HeapAllocator(uint64_t pSize, uint64_t pGranularity);
+
+	//allocate pSize bytes at an offset that is a multiple of pAlignment (a power of 2, anything up to the granularity
+	//is the granularity). invalidHandle if no free block is big enough
+	Handle allocate(uint64_t pSize, uint64_t pAlignment);
+	void release(Handle pAllocation);
+
+	uint64_t getOffset(Handle pAllocation) const;
+	uint64_t getSize(Handle pAllocation) const;
+
+	bool empty() const;
+	Stats getStats() const;
+
+private:
+	static const unsigned firstLevels = 64;
+	static const unsigned secondLevelBits = 4;
+	static const unsigned secondLevels = 1 << secondLevelBits;
+
+	struct Block {
+		uint64_t offset;
+		uint64_t size;
+		uint32_t previous;		//the blocks before and after it in the range
+		uint32_t next;
+		uint32_t previousFree;	//the blocks before and after it in its free list
+		uint32_t nextFree;
+		bool free;
+	};
+
+	//the list a free block of pSize granules goes to
+	static void _mapping(uint64_t pSize, unsigned& pFirst, unsigned& pSecond);
+
+	uint32_t _newBlock();
+	void _insertFree(uint32_t pBlock);
+	void _removeFree(uint32_t pBlock);
+	//the first free block in a list whose every block is at least pSize granules, invalidHandle if there is none
+	uint32_t _findFree(uint64_t pSize) const;
+	//whether pSize bytes fit in a free block at pAlignment
+	bool _fits(uint32_t pBlock, uint64_t pSize, uint64_t pAlignment) const;
+	//the first free block in the lists from the one of pSize bytes up that fits it at pAlignment, checking every block.
+	//for when the lists that are certain to fit are empty
+	uint32_t _findFitting(uint64_t pSize, uint64_t pAlignment) const;
+
+	uint64_t _size;
+	uint64_t _granularity;
+	unsigned _granularityShift;
+	uint64_t _usedBytes;
+	unsigned _allocations;
+
+	std::vector<Block> _blocks;
+	std::vector<uint32_t> _unusedBlocks;	//entries of _blocks that can be reused
+	uint64_t _firstLevelBits;
+	uint32_t _secondLevelBits[firstLevels];
+	uint32_t _freeLists[firstLevels][secondLevels];
+};
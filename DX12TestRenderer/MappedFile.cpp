@@ -0,0 +1,126 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN             // Exclude rarely-used stuff from Windows headers.
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile() : _data(nullptr), _size(0), _open(false),
+#ifdef _WIN32
+	_file(INVALID_HANDLE_VALUE), _mapping(NULL)
+#else
+	_file(-1)
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+bool MappedFile::open(const std::string& pFileName)
+{
+	close();
+
+#ifdef _WIN32
+	//sequential scan lets the cache manager read ahead aggressively, which is what the parsers do
+	_file = CreateFileA(pFileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (_file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(_file, &fileSize)) {
+		close();
+		return false;
+	}
+	_size = (size_t)fileSize.QuadPart;
+	_open = true;
+
+	//a zero sized file cannot be mapped, but it is still a valid (empty) file
+	if (_size == 0)
+		return true;
+
+	_mapping = CreateFileMappingA(_file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (_mapping == NULL) {
+		close();
+		return false;
+	}
+
+	_data = (const char*)MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0);
+	if (_data == nullptr) {
+		close();
+		return false;
+	}
+#else
+	_file = ::open(pFileName.c_str(), O_RDONLY);
+	if (_file < 0)
+		return false;
+
+	struct stat fileStat;
+	if (fstat(_file, &fileStat) != 0) {
+		close();
+		return false;
+	}
+	_size = (size_t)fileStat.st_size;
+	_open = true;
+
+	if (_size == 0)
+		return true;
+
+	void* view = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, _file, 0);
+	if (view == MAP_FAILED) {
+		close();
+		return false;
+	}
+	madvise(view, _size, MADV_SEQUENTIAL);
+	_data = (const char*)view;
+#endif
+
+	return true;
+}
+
+void MappedFile::close()
+{
+#ifdef _WIN32
+	if (_data != nullptr)
+		UnmapViewOfFile(_data);
+	if (_mapping != NULL)
+		CloseHandle(_mapping);
+	if (_file != INVALID_HANDLE_VALUE)
+		CloseHandle(_file);
+	_mapping = NULL;
+	_file = INVALID_HANDLE_VALUE;
+#else
+	if (_data != nullptr)
+		munmap((void*)_data, _size);
+	if (_file >= 0)
+		::close(_file);
+	_file = -1;
+#endif
+	_data = nullptr;
+	_size = 0;
+	_open = false;
+}
+
+bool MappedFile::isOpen() const
+{
+	return _open;
+}
+
+const char* MappedFile::data() const
+{
+	return _data;
+}
+
+size_t MappedFile::size() const
+{
+	return _size;
+}
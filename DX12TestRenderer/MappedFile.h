@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+/**
+ * A read only memory mapping of a whole file.
+ * The file contents can be read straight from data() without copying them into
+ * a string or vector first. The mapping stays valid until close() or destruction.
+ * Works on windows (CreateFileMapping) and posix (mmap) so the asset code using it
+ * does not need a d3d device or window.
+ */
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	//map the file, returns false if the file could not be opened or mapped
+	bool open(const std::string& pFileName);
+	void close();
+
+	bool isOpen() const;
+	const char* data() const;
+	size_t size() const;
+
+private:
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	const char* _data;
+	size_t _size;
+	bool _open;
+
+#ifdef _WIN32
+	void* _file;	//HANDLE of the opened file
+	void* _mapping;	//HANDLE of the file mapping object
+#else
+	int _file;
+#endif
+};
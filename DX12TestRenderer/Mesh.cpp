@@ -1,25 +1,139 @@
 #include "Mesh.h"
 #include <iostream>
-#include <map>
 #include <string>
-#include <fstream>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include "MappedFile.h"
+#include "TripletHashMap.h"
+#include "MeshBinary.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "ObjStreamImporter.h"
+#include "ContentHash.h"
+#include "VertexQuantizer.h"
+#include "TextureStreamer.h"
 
 using namespace std;
 
+namespace {
+	//the obj parser is device independent and uses glm, the vertex data uses directxmath.
+	//both are plain float structs so the data can be used as is.
+	static_assert(sizeof(glm::vec3) == sizeof(XMFLOAT3), "glm::vec3 and XMFLOAT3 need the same layout");
+	static_assert(sizeof(glm::vec2) == sizeof(XMFLOAT2), "glm::vec2 and XMFLOAT2 need the same layout");
+
+	inline const XMFLOAT3& toXMFloat3(const glm::vec3& pVector) {
+		return reinterpret_cast<const XMFLOAT3&>(pVector);
+	}
+
+	inline const XMFLOAT2& toXMFloat2(const glm::vec2& pVector) {
+		return reinterpret_cast<const XMFLOAT2&>(pVector);
+	}
+
+	//the quantizer reads Vertex through its own plain float mirror of it
+	static_assert(sizeof(Vertex) == sizeof(VertexQuantizer::FloatVertex), "Vertex and VertexQuantizer::FloatVertex need the same layout");
+	static_assert(offsetof(Vertex, texCoord) == offsetof(VertexQuantizer::FloatVertex, uv), "Vertex and VertexQuantizer::FloatVertex need the same layout");
+	static_assert(offsetof(Vertex, normal) == offsetof(VertexQuantizer::FloatVertex, normal), "Vertex and VertexQuantizer::FloatVertex need the same layout");
+	static_assert(offsetof(Vertex, tangent) == offsetof(VertexQuantizer::FloatVertex, tangent), "Vertex and VertexQuantizer::FloatVertex need the same layout");
+	static_assert(offsetof(Vertex, bitangent) == offsetof(VertexQuantizer::FloatVertex, bitangent), "Vertex and VertexQuantizer::FloatVertex need the same layout");
+
+	//an input element of a vertex format: the stream (input slot when split) it belongs to,
+	//and its offset in the interleaved vertex and in its own stream
+	struct StreamElement {
+		const char* semantic;
+		DXGI_FORMAT format;
+		UINT stream;
+		UINT interleavedOffset;
+		UINT streamOffset;
+	};
+
+	//where a stream is in the interleaved vertex
+	struct StreamSpan {
+		UINT offset;
+		UINT size;
+	};
+
+	const StreamElement fullElements[] = {
+		{ "POSITION", DXGI_FORMAT_R32G32B32_FLOAT, 0, offsetof(Vertex, pos), 0 },
+		{ "TEXCOORD", DXGI_FORMAT_R32G32_FLOAT, 1, offsetof(Vertex, texCoord), 0 },
+		{ "NORMAL", DXGI_FORMAT_R32G32B32_FLOAT, 2, offsetof(Vertex, normal), 0 },
+		{ "TANGENT", DXGI_FORMAT_R32G32B32_FLOAT, 2, offsetof(Vertex, tangent), sizeof(XMFLOAT3) },
+		{ "BINORMAL", DXGI_FORMAT_R32G32B32_FLOAT, 2, offsetof(Vertex, bitangent), 2 * sizeof(XMFLOAT3) }
+	};
+	const StreamSpan fullStreams[] = { { offsetof(Vertex, pos), 12 }, { offsetof(Vertex, texCoord), 8 }, { offsetof(Vertex, normal), 36 } };
+
+	//the ia expands the halfs and snorms to floats, shaders that use the normal and tangent decode them from the octahedron
+	const StreamElement compactElements[] = {
+		{ "POSITION", DXGI_FORMAT_R32G32B32_FLOAT, 0, offsetof(VertexQuantizer::PackedVertex, pos), 0 },
+		{ "TEXCOORD", DXGI_FORMAT_R16G16_FLOAT, 1, offsetof(VertexQuantizer::PackedVertex, uv), 0 },
+		{ "NORMAL", DXGI_FORMAT_R16G16_SNORM, 2, offsetof(VertexQuantizer::PackedVertex, normal), 0 },
+		{ "TANGENT", DXGI_FORMAT_R8G8B8A8_SNORM, 2, offsetof(VertexQuantizer::PackedVertex, tangent), 4 }
+	};
+	const StreamSpan compactStreams[] = { { offsetof(VertexQuantizer::PackedVertex, pos), 12 }, { offsetof(VertexQuantizer::PackedVertex, uv), 4 }, { offsetof(VertexQuantizer::PackedVertex, normal), 8 } };
+
+	static_assert(sizeof(fullStreams) / sizeof(StreamSpan) == Mesh::streamCount, "a span for every stream");
+	static_assert(sizeof(compactStreams) / sizeof(StreamSpan) == Mesh::streamCount, "a span for every stream");
+	static_assert(sizeof(fullElements) / sizeof(StreamElement) <= Mesh::maxInputElements, "maxInputElements is too small");
+	static_assert(sizeof(compactElements) / sizeof(StreamElement) <= Mesh::maxInputElements, "maxInputElements is too small");
+
+	//a buffer placed in pHeap, or a committed one without a heap
+	ID3D12Resource* createBuffer(ID3D12Device* pDevice, ResourceHeap* pHeap, D3D12_HEAP_TYPE pType, UINT64 pSize, D3D12_RESOURCE_STATES pState) {
+		if (pHeap != nullptr)
+			return pHeap->create(CD3DX12_RESOURCE_DESC::Buffer(pSize), pState);
+		ID3D12Resource* buffer;
+		ThrowIfFailed(pDevice->CreateCommittedResource(
+			&CD3DX12_HEAP_PROPERTIES(pType),
+			D3D12_HEAP_FLAG_NONE,
+			&CD3DX12_RESOURCE_DESC::Buffer(pSize),
+			pState,
+			nullptr,
+			IID_PPV_ARGS(&buffer)));
+		return buffer;
+	}
+
+	void releaseBuffer(ResourceHeap* pHeap, ID3D12Resource* pBuffer) {
+		if (pHeap != nullptr)
+			pHeap->release(pBuffer);
+		else
+			pBuffer->Release();
+	}
+}
+
+unsigned Mesh::loadThreadCount = 0;
+bool Mesh::optimizeOnLoad = true;
+Mesh::VertexFormat Mesh::vertexFormat = Mesh::VertexFormatCompact;
+bool Mesh::splitStreams = true;
+bool Mesh::buildMeshlets = true;
+uint64_t Mesh::streamImportThreshold = 1024ull * 1024 * 1024;
+size_t Mesh::streamImportBudget = 512 * 1024 * 1024;
+std::vector<float> Mesh::lodTriangleRatios = { 0.5f, 0.25f, 0.125f };
+Mesh::CpuResidency Mesh::cpuResidency = Mesh::CpuResidencyPositions;
+Mesh::FetchStats Mesh::fetchStats = {};
+ResourceHeap* Mesh::bufferHeap = nullptr;
+ResourceHeap* Mesh::uploadHeap = nullptr;
 
 Mesh::Mesh(string pId, ID3D12Device* pDevice, ID3D12GraphicsCommandList* pCommandList)
 	: _id(pId), _indexBufferId(0), _vertexBufferId(0), _normalBufferId(0), _uvBufferId(0), _tangentBufferId(0), _bitangentBufferId(0),
-	_vertices(), _indices(), _vertexData(), device(pDevice), commandList(pCommandList){
+	_vertices(), _indices(), _vertexData(), device(pDevice), commandList(pCommandList), numIndices(0), _contentHash(0), _uvDensity(0), _gpuBytes(0), _vertexFormat(VertexFormatFull), _splitStreams(false),
+	_cpuResidency(cpuResidency), _uploadPending(false), _uploadFence(nullptr), _uploadFenceValue(0), _vertexCount(0), _boundStride(0),
+	vertexBuffer(nullptr), vertexBufferUploadHeap(nullptr), indexBuffer(nullptr), indexBufferUploadHeap(nullptr) {
 	//ctor
+	Bounds::compute(nullptr, 0, 0, _bounds, _boundingSphere);
 }
 
 Mesh::~Mesh() {
-	//dtor
+	//the gpu must be done with the mesh before it is deleted
+	if (vertexBuffer) releaseBuffer(bufferHeap, vertexBuffer);
+	if (vertexBufferUploadHeap) releaseBuffer(uploadHeap, vertexBufferUploadHeap);
+	if (indexBuffer) releaseBuffer(bufferHeap, indexBuffer);
+	if (indexBufferUploadHeap) releaseBuffer(uploadHeap, indexBufferUploadHeap);
 }
 
 /**
- * Load reads the obj data into a new mesh using C++ combined with c style coding.
- * The result is an indexed mesh for use with glDrawElements.
+ * Load reads the obj data into a new mesh. The file is memory mapped and tokenized in place by
+ * the ObjParser (no getline/sscanf per line), after which _build turns it into an indexed mesh.
  * Expects a obj file with following layout v/vt/vn/f eg
  *
  * For example the obj file for a simple plane describes two triangles, based on
@@ -63,241 +177,384 @@ Mesh::~Mesh() {
  * So the basic process is, read ALL data into separate arrays, then use the faces to
  * create unique entries in a new set of arrays and create the indexbuffer to go along with it.
  *
- * Note that loading this mesh isn't cached like we do with texturing, this is an exercise left for the students.
+ * Note that load always loads a new mesh, use a MeshRegistry to share meshes that are used more than once.
  */
 Mesh* Mesh::load(string pFileName, ID3D12Device* pDevice, ID3D12GraphicsCommandList* pCommandList, bool pDoBuffer) {
 	//cout << "Loading " << pFileName << "...";
+	auto loadStart = chrono::high_resolution_clock::now();
 
 	Mesh* mesh = new Mesh(pFileName, pDevice, pCommandList);
 
-	ifstream file(pFileName, ios::in);
-
-	if (file.is_open()) {
-		//these three vectors will contains data as taken from the obj file
-		//in the order it is encountered in the object file
-		vector<XMFLOAT3> vertices;
-		vector<XMFLOAT3> fs;
-		vector<XMFLOAT2> uvs;
-		vector<XMFLOAT3> normals;
-
-		//in addition we create a map to store the triplets found under the f(aces) section in the
-		//object file and map them to an index for our index buffer (just number them sequentially
-		//as we encounter them and store references to the pack
-		map <FaceIndexTriplet, unsigned int> mappedTriplets;
-
-		string line; // to store each line in
-		while (getline(file, line)) {
-
-			// c-type string to store cmd read from obj file (cmd is v, vt, vn, f)
-			char cmd[10];
-			cmd[0] = 0;
-
-			//get the first string in the line of max 10 chars (c-style)
-			sscanf(line.c_str(), "%10s", cmd);
-
-			//note that although the if statements below seem to imply that we can
-			//read these different line types (eg vertex, normal, uv) in any order,
-			//this is just convenience coding for us (instead of multiple while loops)
-			//we assume the obj file to list ALL v lines first, then ALL vt lines,
-			//then ALL vn lines and last but not least ALL f lines last
-
-			//so... start processing lines
-			//are we reading a vertex line? straightforward copy into local vertices vector
-			if (strcmp(cmd, "v") == 0) {
-				XMFLOAT3 vertex;
-				sscanf(line.c_str(), "%10s %f %f %f ", cmd, &vertex.x, &vertex.y, &vertex.z);
-				vertices.push_back(vertex);
-
-				//or are we reading a normal line? straightforward copy into local normal vector
-			}
-			else if (strcmp(cmd, "vn") == 0) {
-				XMFLOAT3 normal;
-				sscanf(line.c_str(), "%10s %f %f %f ", cmd, &normal.x, &normal.y, &normal.z);
-				normals.push_back(normal);
+	//first try the cooked version of this mesh, it is only used if it was cooked from the current source file
+	string cookedFileName = pFileName + ".meshbin";
+	MeshBinary::SourceStamp sourceStamp;
+	bool hasSource = MeshBinary::getSourceStamp(pFileName, sourceStamp);
+	uint32_t cookFlags = optimizeOnLoad ? MeshBinary::FlagVertexCacheOptimized : 0;
+	if (mesh->_loadCooked(cookedFileName, hasSource ? &sourceStamp : nullptr, cookFlags, pDoBuffer))
+		return mesh;
 
-				//or are we reading a uv line? straightforward copy into local uv vector
-			}
-			else if (strcmp(cmd, "vt") == 0) {
-				XMFLOAT2 uv;
-				sscanf(line.c_str(), "%10s %f %f ", cmd, &uv.x, &uv.y);
+	//sources that are too big to load in memory are cooked in bounded memory and then loaded like any cooked mesh
+	if (hasSource && streamImportThreshold != 0 && sourceStamp.size >= streamImportThreshold) {
+		ObjStreamImporter::Stats stats;
+		if (!ObjStreamImporter::import(pFileName, cookedFileName, sourceStamp, cookFlags, _lodSettings(), streamImportBudget, loadThreadCount, stats) ||
+			!mesh->_loadCooked(cookedFileName, &sourceStamp, cookFlags, pDoBuffer)) {
+			delete mesh;
+			return NULL;
+		}
+		return mesh;
+	}
 
-				//TODO this is a fix for the convertion from opengl to directX, might be a better solution for this
-				uv.y = 1 - uv.y;
-				uvs.push_back(uv);
+	//map the whole file so we can tokenize it in place, without reading it line by line into strings
+	MappedFile file;
+	if (!file.open(pFileName)) {
+		cout << "Could not read " << pFileName << endl;
+		delete mesh;
+		return NULL;
+	}
 
-				//this is where it gets nasty. After having read all vertices, normals and uvs into
-				//their own buffer
-			}
-			else if (strcmp(cmd, "f") == 0) {
-
-				//an f lines looks like
-				//f 2/1/1 1/2/1 3/3/1
-				//in other words
-				//f v1/u1/n1 v2/u2/n2 v3/u3/n3
-				//for each triplet like that we need to check whether we already encountered it
-				//and update our administration based on that
-				XMINT4 vertexIndex;
-				XMINT4 normalIndex;
-				XMINT4 uvIndex;
-
-				int count = sscanf(line.c_str(), "%10s %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d", cmd, &vertexIndex.x, &uvIndex.x, &normalIndex.x, &vertexIndex.y, &uvIndex.y, &normalIndex.y, &vertexIndex.z, &uvIndex.z, &normalIndex.z, &vertexIndex.w, &uvIndex.w, &normalIndex.w);
-
-				//Have we read exactly 10 elements?
-				if (count == 10 || count == 13) {
-					//process 3 triplets, one for each vertex (which is first element of the triplet)
-					//cout << count << endl;
-					int vertCount = (vertexIndex.w) ? 6 : 3;
-
-					XMFLOAT3 edge1;
-					XMStoreFloat3(&edge1, XMLoadFloat3(&vertices[vertexIndex.y - 1]) - XMLoadFloat3(&vertices[vertexIndex.x - 1]));
-					XMFLOAT3 edge2;
-					XMStoreFloat3(&edge2, XMLoadFloat3(&vertices[vertexIndex.z - 1]) - XMLoadFloat3(&vertices[vertexIndex.x - 1]));
-					XMFLOAT2 deltaUV1;
-					XMStoreFloat2(&deltaUV1, XMLoadFloat2(&uvs[uvIndex.y - 1]) - XMLoadFloat2(&uvs[uvIndex.x - 1]));
-					XMFLOAT2 deltaUV2;
-					XMStoreFloat2(&deltaUV2, XMLoadFloat2(&uvs[uvIndex.z - 1]) - XMLoadFloat2(&uvs[uvIndex.x - 1]));
-
-					float f = 1.0f / (deltaUV1.x * deltaUV2.y - deltaUV2.x * deltaUV1.y);
-
-					XMFLOAT3 tangent;
-					XMFLOAT3 bitangent;
-					tangent.x = f * (deltaUV2.y * edge1.x - deltaUV1.y * edge2.x);
-					tangent.y = f * (deltaUV2.y * edge1.y - deltaUV1.y * edge2.y);
-					tangent.z = f * (deltaUV2.y * edge1.z - deltaUV1.y * edge2.z);
-					XMStoreFloat3(&tangent, XMVector3Normalize(XMLoadFloat3(&tangent)));
-
-					bitangent.x = f * (-deltaUV2.x * edge1.x + deltaUV1.x * edge2.x);
-					bitangent.y = f * (-deltaUV2.x * edge1.y + deltaUV1.x * edge2.y);
-					bitangent.z = f * (-deltaUV2.x * edge1.z + deltaUV1.x * edge2.z);
-					XMStoreFloat3(&bitangent, XMVector3Normalize(XMLoadFloat3(&bitangent)));
-
-					for (int i = 0; i < vertCount; ++i) {
-						int vindex;
-						int uIndex;
-						int nIndex;
-						switch (i) {
-						case 0:
-						case 3:
-							vindex = vertexIndex.x;
-							uIndex = uvIndex.x;
-							nIndex = normalIndex.x;
-							break;
-						case 1:
-							vindex = vertexIndex.y;
-							uIndex = uvIndex.y;
-							nIndex = normalIndex.y;
-							break;
-						case 2:
-						case 4:
-							vindex = vertexIndex.z;
-							uIndex = uvIndex.z;
-							nIndex = normalIndex.z;
-							break;
-						case 5:
-							vindex = vertexIndex.w;
-							uIndex = uvIndex.w;
-							nIndex = normalIndex.w;
-							break;
-						}
-
-						/*vertexIndex[newIndex] = (vertexIndex[newIndex] < 0) ? vertices.size() + vertexIndex[newIndex] + 1 : vertexIndex[newIndex];
-						uvIndex[newIndex] = (uvIndex[newIndex] < 0) ? uvs.size() + uvIndex[newIndex] + 1 : uvIndex[newIndex];
-						normalIndex[newIndex] = (normalIndex[newIndex] < 0) ? normals.size() + normalIndex[newIndex] + 1 : normalIndex[newIndex];*/
-
-						if (vindex > vertices.size() || uIndex > uvs.size() || nIndex > normals.size()) {
-							//If we read a different amount, something is wrong
-							cout << "Error reading obj: cannot work with negative indices" << endl;
-							delete mesh;
-							return NULL;
-
-						}
-						//create key out of the triplet and check if we already encountered this before
-						FaceIndexTriplet triplet(vindex, uIndex, nIndex);
-						map<FaceIndexTriplet, unsigned int>::iterator found = mappedTriplets.find(triplet);
-
-						//if iterator points at the end, we haven't found it
-						if (found == mappedTriplets.end()) {
-							//so create a new index value, and map our triplet to it
-							unsigned int index = mappedTriplets.size();
-							mappedTriplets[triplet] = index;
-
-							//now record this index
-							mesh->_indices.push_back(index);
-							//and store the corresponding vertex/normal/uv values into our own buffers
-							//note the -1 is required since all values in the f triplets in the .obj file
-							//are 1 based, but our vectors are 0 based
-							mesh->_vertexData.push_back(Vertex(vertices[vindex - 1], uvs[uIndex - 1], normals[nIndex - 1], tangent, bitangent));
-							mesh->_vertices.push_back(vertices[vindex - 1]);
-							//mesh->_normals.push_back(normals[nIndex - 1]);
-							//mesh->_tangents.push_back(tangent);
-							//mesh->_bitangents.push_back(bitangent);
-							//mesh->_uvs.push_back(uvs[uIndex - 1]);
-						}
-						else {
-							//if the key was already present, get the index value for it
-							unsigned int index = found->second;
-							//and update our index buffer with it
-							mesh->_indices.push_back(index);
-						}
-					}
-				}
-				else {
-					//If we read a different amount, something is wrong
-					cout << "Error reading obj, needing v,vn,vt" << endl;
-					delete mesh;
-					return NULL;
-				}
-			}
+	//this will contain the data as taken from the obj file
+	//in the order it is encountered in the object file
+	ObjData data;
+	//big files are split in line aligned chunks that are parsed in parallel and merged in file order
+	if (!ObjParser::parseParallel(file.data(), file.data() + file.size(), data, loadThreadCount)) {
+		delete mesh;
+		return NULL;
+	}
+	auto parseEnd = chrono::high_resolution_clock::now();
 
-		}
+	if (!mesh->_build(data)) {
+		delete mesh;
+		return NULL;
+	}
+	auto buildEnd = chrono::high_resolution_clock::now();
+
+	double parseSeconds = chrono::duration<double>(parseEnd - loadStart).count();
+	double buildSeconds = chrono::duration<double>(buildEnd - parseEnd).count();
+	double megaBytes = file.size() / (1024.0 * 1024.0);
+	file.close();
+
+	unsigned threads = (loadThreadCount != 0) ? loadThreadCount : max(1u, thread::hardware_concurrency());
+	cout << "Loaded " << pFileName << ": " << megaBytes << " MB parsed in " << parseSeconds * 1000.0 << " ms (" << megaBytes / parseSeconds << " MB/s, " << threads << " threads), "
+		<< data.faces.size() << " faces indexed in " << buildSeconds * 1000.0 << " ms" << endl;
+
+	if (optimizeOnLoad)
+		mesh->_optimize();
+
+	if (!mesh->_vertexData.empty())
+		mesh->_computeBounds(&mesh->_vertexData[0], (UINT)mesh->_vertexData.size());
+	if (!mesh->_indices.empty())
+		mesh->_uvDensity = TextureStreamer::uvDensity(&mesh->_vertexData[0], sizeof(Vertex), offsetof(Vertex, texCoord), (const uint32_t*)&mesh->_indices[0], mesh->_indices.size());
 
-		file.close();
+	//after optimizing, the meshlets follow the final triangle order of the full mesh
+	if (buildMeshlets && !mesh->_indices.empty())
+		mesh->_buildMeshlets(&mesh->_vertexData[0], (UINT)mesh->_vertexData.size(), (const uint32_t*)&mesh->_indices[0], (UINT)mesh->_indices.size());
+
+	mesh->_generateLods();
+
+	//cook the result so the next run can skip parsing and building
+	if (!mesh->_indices.empty()) {
+		mesh->_contentHash = MeshBinary::hashData(&mesh->_vertexData[0], sizeof(Vertex) * mesh->_vertexData.size(), (const uint32_t*)&mesh->_indices[0], (uint32_t)mesh->_indices.size());
+
+		if (hasSource && !MeshBinary::write(cookedFileName, sourceStamp, cookFlags, &mesh->_vertexData[0], sizeof(Vertex), (uint32_t)mesh->_vertexData.size(), (const uint32_t*)&mesh->_indices[0], (uint32_t)mesh->_indices.size(),
+			&mesh->_lods[0], (uint32_t)mesh->_lods.size(), _lodSettings()))
+			cout << "Could not write " << cookedFileName << endl;
+	}
 
+	if (pDoBuffer)
 		mesh->_buffer();
 
-		//cout << "Mesh loaded and buffered:" << (mesh->_indices.size() / 3.0f) << " triangles." << endl;
-		return mesh;
+	//cout << "Mesh loaded and buffered:" << (mesh->_indices.size() / 3.0f) << " triangles." << endl;
+	return mesh;
+}
+
+bool Mesh::_loadCooked(const string& pCookedFileName, const MeshBinary::SourceStamp* pSource, uint32_t pFlags, bool pDoBuffer) {
+	auto loadStart = chrono::high_resolution_clock::now();
+	MeshBinary cooked;
+	if (!cooked.open(pCookedFileName, pSource, pFlags, sizeof(Vertex)) || cooked.header().lodSettings != _lodSettings())
+		return false;
+
+	const MeshBinary::Header& header = cooked.header();
+	_contentHash = header.contentHash;
+	_lods.assign(cooked.lods(), cooked.lods() + header.lodCount);
+	_computeBounds(cooked.vertices(), header.vertexCount);
+	if (!_lods.empty())
+		_uvDensity = TextureStreamer::uvDensity(cooked.vertices(), sizeof(Vertex), offsetof(Vertex, texCoord), cooked.indices(), _lods[0].indexCount);
+	if (buildMeshlets && !_lods.empty())
+		_buildMeshlets(cooked.vertices(), header.vertexCount, cooked.indices(), _lods[0].indexCount);
+	//upload straight from the mapped file and only copy what the residency policy keeps, or everything without an upload
+	const Vertex* vertices = (const Vertex*)cooked.vertices();
+	if (!pDoBuffer || _cpuResidency == CpuResidencyAll)
+		_vertexData.assign(vertices, vertices + header.vertexCount);
+	if (!pDoBuffer || _cpuResidency != CpuResidencyNone) {
+		_vertices.resize(header.vertexCount);
+		for (uint32_t i = 0; i < header.vertexCount; ++i)
+			_vertices[i] = vertices[i].pos;
+		_indices.assign(cooked.indices(), cooked.indices() + header.indexCount);
 	}
-	else {
-		cout << "Could not read " << pFileName << endl;
-		delete mesh;
-		return NULL;
+	if (pDoBuffer)
+		_buffer(cooked.vertices(), header.vertexCount, cooked.indices(), header.indexCount);
+
+	double seconds = chrono::duration<double>(chrono::high_resolution_clock::now() - loadStart).count();
+	cout << "Loaded " << pCookedFileName << ": " << cooked.fileSize() / (1024.0 * 1024.0) << " MB in " << seconds * 1000.0 << " ms" << endl;
+	return true;
+}
+
+bool Mesh::_build(const ObjData& pData) {
+	//we create a map to store the triplets found under the f(aces) section in the
+	//object file and map them to an index for our index buffer (just number them sequentially
+	//as we encounter them and store references to the pack.
+	//most meshes end up with roughly one unique vertex per face, so that is what we size the table for
+	TripletHashMap mappedTriplets(pData.faces.size());
+	_vertexData.reserve(pData.faces.size());
+	_vertices.reserve(pData.faces.size());
+	_indices.reserve(pData.faces.size() * 3);
+
+	//a quad is split into the triangles 0,1,2 and 0,2,3
+	static const int cornerOrder[6] = { 0, 1, 2, 0, 2, 3 };
+
+	for (size_t f = 0; f < pData.faces.size(); ++f) {
+		const ObjFace& face = pData.faces[f];
+
+		//for each triplet we need to check whether we already encountered it
+		//and update our administration based on that
+		for (int i = 0; i < face.count; ++i) {
+			if (face.v[i] < 1 || face.v[i] > (int)pData.vertices.size() ||
+				face.uv[i] < 1 || face.uv[i] > (int)pData.uvs.size() ||
+				face.n[i] < 1 || face.n[i] > (int)pData.normals.size()) {
+				//If we read a different amount, something is wrong
+				cout << "Error reading obj: cannot work with negative indices" << endl;
+				return false;
+			}
+		}
+
+		//process 3 triplets, one for each vertex (which is first element of the triplet)
+		int vertCount = (face.count == 4) ? 6 : 3;
+
+		const XMFLOAT3& v0 = toXMFloat3(pData.vertices[face.v[0] - 1]);
+		const XMFLOAT3& v1 = toXMFloat3(pData.vertices[face.v[1] - 1]);
+		const XMFLOAT3& v2 = toXMFloat3(pData.vertices[face.v[2] - 1]);
+		const XMFLOAT2& uv0 = toXMFloat2(pData.uvs[face.uv[0] - 1]);
+		const XMFLOAT2& uv1 = toXMFloat2(pData.uvs[face.uv[1] - 1]);
+		const XMFLOAT2& uv2 = toXMFloat2(pData.uvs[face.uv[2] - 1]);
+
+		XMFLOAT3 edge1;
+		XMStoreFloat3(&edge1, XMLoadFloat3(&v1) - XMLoadFloat3(&v0));
+		XMFLOAT3 edge2;
+		XMStoreFloat3(&edge2, XMLoadFloat3(&v2) - XMLoadFloat3(&v0));
+		XMFLOAT2 deltaUV1;
+		XMStoreFloat2(&deltaUV1, XMLoadFloat2(&uv1) - XMLoadFloat2(&uv0));
+		XMFLOAT2 deltaUV2;
+		XMStoreFloat2(&deltaUV2, XMLoadFloat2(&uv2) - XMLoadFloat2(&uv0));
+
+		float r = 1.0f / (deltaUV1.x * deltaUV2.y - deltaUV2.x * deltaUV1.y);
+
+		XMFLOAT3 tangent;
+		XMFLOAT3 bitangent;
+		tangent.x = r * (deltaUV2.y * edge1.x - deltaUV1.y * edge2.x);
+		tangent.y = r * (deltaUV2.y * edge1.y - deltaUV1.y * edge2.y);
+		tangent.z = r * (deltaUV2.y * edge1.z - deltaUV1.y * edge2.z);
+		XMStoreFloat3(&tangent, XMVector3Normalize(XMLoadFloat3(&tangent)));
+
+		bitangent.x = r * (-deltaUV2.x * edge1.x + deltaUV1.x * edge2.x);
+		bitangent.y = r * (-deltaUV2.x * edge1.y + deltaUV1.x * edge2.y);
+		bitangent.z = r * (-deltaUV2.x * edge1.z + deltaUV1.x * edge2.z);
+		XMStoreFloat3(&bitangent, XMVector3Normalize(XMLoadFloat3(&bitangent)));
+
+		for (int i = 0; i < vertCount; ++i) {
+			int corner = cornerOrder[i];
+			int vindex = face.v[corner];
+			int uIndex = face.uv[corner];
+			int nIndex = face.n[corner];
+
+			//check if we already encountered this triplet before, if not it gets the next free index
+			bool isNew;
+			unsigned int index = mappedTriplets.findOrInsert(vindex, uIndex, nIndex, (unsigned int)mappedTriplets.size(), isNew);
+
+			//now record this index
+			_indices.push_back(index);
+
+			if (isNew) {
+				//and store the corresponding vertex/normal/uv values into our own buffers
+				//note the -1 is required since all values in the f triplets in the .obj file
+				//are 1 based, but our vectors are 0 based
+				const XMFLOAT3& position = toXMFloat3(pData.vertices[vindex - 1]);
+				_vertexData.push_back(Vertex(position, toXMFloat2(pData.uvs[uIndex - 1]), toXMFloat3(pData.normals[nIndex - 1]), tangent, bitangent));
+				_vertices.push_back(position);
+			}
+		}
 	}
+
+	return true;
+}
+
+void Mesh::_optimize() {
+	if (_indices.empty())
+		return;
+
+	auto optimizeStart = chrono::high_resolution_clock::now();
+	uint32_t* indices = (uint32_t*)&_indices[0];
+	size_t vertexCount = _vertexData.size();
+
+	MeshOptimizer::VertexCacheStats before = MeshOptimizer::analyzeVertexCache(indices, _indices.size(), vertexCount);
+
+	//triangle order for the vertex cache, then clusters of it for overdraw, then vertex order for fetching
+	MeshOptimizer::optimizeVertexCache(indices, _indices.size(), vertexCount);
+	size_t clusters = MeshOptimizer::optimizeOverdraw(indices, _indices.size(), &_vertexData[0].pos, sizeof(Vertex), vertexCount);
+	MeshOptimizer::optimizeVertexFetch(&_vertexData[0], vertexCount, sizeof(Vertex), indices, _indices.size());
+
+	MeshOptimizer::VertexCacheStats after = MeshOptimizer::analyzeVertexCache(indices, _indices.size(), vertexCount);
+
+	//the positions follow the new vertex order
+	for (size_t i = 0; i < vertexCount; ++i)
+		_vertices[i] = _vertexData[i].pos;
+
+	double seconds = chrono::duration<double>(chrono::high_resolution_clock::now() - optimizeStart).count();
+	cout << "Optimized " << _id << " in " << seconds * 1000.0 << " ms: ACMR " << before.acmr << " -> " << after.acmr
+		<< ", ATVR " << before.atvr << " -> " << after.atvr << ", " << clusters << " overdraw clusters" << endl;
+}
+
+void Mesh::_generateLods() {
+	_lods.clear();
+	if (_indices.empty())
+		return;
+
+	MeshBinary::Lod full = { 0, (uint32_t)_indices.size(), 0.0f };
+	_lods.push_back(full);
+
+	size_t vertexCount = _vertexData.size();
+	size_t fullIndexCount = _indices.size();
+	std::vector<uint32_t> levelIndices(fullIndexCount);
+
+	for (size_t level = 0; level < lodTriangleRatios.size(); ++level) {
+		auto lodStart = chrono::high_resolution_clock::now();
+
+		//every level is simplified from the full mesh, so its error is measured against the full mesh too
+		size_t targetIndexCount = (size_t)(fullIndexCount / 3 * lodTriangleRatios[level]) * 3;
+		float error = 0.0f;
+		size_t indexCount = MeshSimplifier::simplify(&levelIndices[0], &_indices[0], fullIndexCount, &_vertexData[0].pos, sizeof(Vertex), vertexCount, targetIndexCount, error);
+		if (indexCount == 0 || indexCount >= _lods.back().indexCount)
+			break;	//locked seams and borders don't allow simplifying any further
+		levelIndices.resize(indexCount);
+		MeshOptimizer::optimizeVertexCache(&levelIndices[0], indexCount, vertexCount);
+
+		//the levels are ranges in the same index buffer, using the same vertices. SelectLod expects the errors to grow
+		MeshBinary::Lod lod = { (uint32_t)_indices.size(), (uint32_t)indexCount, max(error, _lods.back().error) };
+		_lods.push_back(lod);
+		_indices.insert(_indices.end(), levelIndices.begin(), levelIndices.end());
+
+		double seconds = chrono::duration<double>(chrono::high_resolution_clock::now() - lodStart).count();
+		cout << "Lod " << _lods.size() - 1 << " of " << _id << ": " << indexCount / 3 << " triangles (" << 100.0 * indexCount / fullIndexCount << "%), error " << lod.error
+			<< " in " << seconds * 1000.0 << " ms" << endl;
+	}
+}
+
+uint32_t Mesh::_lodSettings() {
+	if (lodTriangleRatios.empty())
+		return 0;
+	return (uint32_t)hashContent(&lodTriangleRatios[0], sizeof(float) * lodTriangleRatios.size());
+}
+
+void Mesh::_computeBounds(const void* pVertices, UINT pVertexCount) {
+	Bounds::compute(pVertices, sizeof(Vertex), pVertexCount, _bounds, _boundingSphere);
+}
+
+void Mesh::_buildMeshlets(const void* pVertices, UINT pVertexCount, const uint32_t* pIndices, UINT pIndexCount) {
+	auto buildStart = chrono::high_resolution_clock::now();
+	MeshletBuilder::build(pIndices, pIndexCount, pVertices, sizeof(Vertex), pVertexCount, _meshlets);
+	double seconds = chrono::duration<double>(chrono::high_resolution_clock::now() - buildStart).count();
+
+	size_t meshletCount = _meshlets.meshlets.size();
+	double triangles = pIndexCount / 3.0;
+	cout << "Built " << meshletCount << " meshlets for " << _id << " in " << seconds * 1000.0 << " ms (" << triangles / seconds / 1000000.0 << " M triangles/s), "
+		<< (meshletCount ? triangles / meshletCount : 0.0) << " triangles and " << (meshletCount ? (double)_meshlets.vertices.size() / meshletCount : 0.0) << " vertices per meshlet" << endl;
 }
 
 void Mesh::_buffer() {
-	//std::vector<Vertex> vList = _vertexData;
+	_buffer(&_vertexData[0], (UINT)_vertexData.size(), &_indices[0], (UINT)_indices.size());
+}
+
+void Mesh::_buffer(const void* pVertices, UINT pVertexCount, const void* pIndices, UINT pIndexCount) {
+	_vertexFormat = vertexFormat;
+	_splitStreams = splitStreams;
+	_vertexCount = pVertexCount;
+
+	//pack the vertices, the packed copy only lives until it is in the upload heap
+	std::vector<VertexQuantizer::PackedVertex> packedVertices;
+	UINT vertexStride = sizeof(Vertex);
+	if (_vertexFormat == VertexFormatCompact) {
+		//the packing error is measured in Benchmarks/VertexQuantizerBenchmark, not on every load
+		packedVertices.resize(pVertexCount);
+		VertexQuantizer::encode((const VertexQuantizer::FloatVertex*)pVertices, pVertexCount, &packedVertices[0]);
+		pVertices = &packedVertices[0];
+		vertexStride = sizeof(VertexQuantizer::PackedVertex);
+	}
 
-	int vBufferSize = _vertexData.size() * sizeof(Vertex);
-	ID3D12Resource* vBufferUploadHeap;
+	int vBufferSize = pVertexCount * vertexStride;
+
+	//split the interleaved vertices into one block per stream, all in the same buffer
+	const StreamSpan* streams = (_vertexFormat == VertexFormatCompact) ? compactStreams : fullStreams;
+	std::vector<unsigned char> splitVertices;
+	UINT streamOffsets[streamCount] = {};
+	if (_splitStreams) {
+		splitVertices.resize(vBufferSize);
+		UINT streamOffset = 0;
+		for (int s = 0; s < streamCount; ++s) {
+			const unsigned char* source = (const unsigned char*)pVertices + streams[s].offset;
+			unsigned char* destination = &splitVertices[streamOffset];
+			for (UINT v = 0; v < pVertexCount; ++v)
+				memcpy(destination + v * streams[s].size, source + v * vertexStride, streams[s].size);
+			streamOffsets[s] = streamOffset;
+			streamOffset += streams[s].size * pVertexCount;
+		}
+		pVertices = &splitVertices[0];
+	}
 
 	//create the default buffer for the vertex data and upload the data using an upload buffer.
-	vertexBuffer = CreateDefaultBuffer(device, commandList, &_vertexData[0], vBufferSize, vBufferUploadHeap);
+	vertexBuffer = CreateDefaultBuffer(device, commandList, pVertices, vBufferSize, vertexBufferUploadHeap);
 
 	////transition the vertex buffer data from copy destination state to vertex buffer state
 	commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(vertexBuffer, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER));
 
-	//create index buffer
-	//std::vector <DWORD> iList = _indices;
+	//create index buffer, 16 bit indices halve its size whenever every vertex can be addressed with them
+	std::vector<uint16_t> shortIndices;
+	DXGI_FORMAT indexFormat = DXGI_FORMAT_R32_UINT;
+	UINT indexSize = sizeof(DWORD);
+	if (pVertexCount <= 65536) {
+		shortIndices.resize(pIndexCount);
+		VertexQuantizer::packIndices((const uint32_t*)pIndices, pIndexCount, &shortIndices[0]);
+		pIndices = &shortIndices[0];
+		indexFormat = DXGI_FORMAT_R16_UINT;
+		indexSize = sizeof(uint16_t);
+	}
+	int iBufferSize = indexSize * pIndexCount;
 
-	int iBufferSize = sizeof(DWORD) * _indices.size();
+	_uploadPending = true;
+	numIndices = pIndexCount; //the number of indeces we want to draw (size of the (iList)/(size of one float3) i think)
 
-	numIndices = _indices.size(); //the number of indeces we want to draw (size of the (iList)/(size of one float3) i think)
+	indexBuffer = CreateDefaultBuffer(device, commandList, pIndices, iBufferSize, indexBufferUploadHeap);
 
-	ID3D12Resource* iBufferUploadHeap;
-	indexBuffer = CreateDefaultBuffer(device, commandList, &_indices[0], iBufferSize, iBufferUploadHeap);
+	_gpuBytes = vBufferSize + iBufferSize;
 
 	//transition index buffer data from copy to index buffer state
 	commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(indexBuffer, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_INDEX_BUFFER));
 
 	//create a vertex buffer view for the triangle. we get the gpu memory address to the vertex pointer using the GetGPUVirtualAddress() method
-	vertexBufferView.BufferLocation = vertexBuffer->GetGPUVirtualAddress();
-	vertexBufferView.StrideInBytes = sizeof(Vertex);
-	vertexBufferView.SizeInBytes = vBufferSize;
+	if (_splitStreams) {
+		for (int s = 0; s < streamCount; ++s) {
+			vertexBufferViews[s].BufferLocation = vertexBuffer->GetGPUVirtualAddress() + streamOffsets[s];
+			vertexBufferViews[s].StrideInBytes = streams[s].size;
+			vertexBufferViews[s].SizeInBytes = streams[s].size * pVertexCount;
+		}
+	}
+	else {
+		vertexBufferViews[0].BufferLocation = vertexBuffer->GetGPUVirtualAddress();
+		vertexBufferViews[0].StrideInBytes = vertexStride;
+		vertexBufferViews[0].SizeInBytes = vBufferSize;
+	}
 
 	//create a index buffer view for the triangle. gets the gpu memory address to the pointer.
 	indexBufferView.BufferLocation = indexBuffer->GetGPUVirtualAddress();
-	indexBufferView.Format = DXGI_FORMAT_R32_UINT;
+	indexBufferView.Format = indexFormat;
 	indexBufferView.SizeInBytes = iBufferSize;
 }
 
@@ -400,15 +657,39 @@ void Mesh::instanceToOpenGL(int pVerticesAttrib, int pNormalsAttrib, int pUVsAtt
 	//_verticesattrb = pVerticesAttrib;
 }
 
-void Mesh::SetVertexIndexBuffers()
+void Mesh::SetVertexIndexBuffers(unsigned pStreams)
 {
-	commandList->IASetVertexBuffers(0, 1, &vertexBufferView);
+	if (_splitStreams) {
+		//only bind what the material reads, the other streams are never fetched
+		_boundStride = 0;
+		for (int s = 0; s < streamCount; ++s) {
+			if (pStreams & (1u << s)) {
+				commandList->IASetVertexBuffers(s, 1, &vertexBufferViews[s]);
+				_boundStride += vertexBufferViews[s].StrideInBytes;
+			}
+		}
+	}
+	else {
+		commandList->IASetVertexBuffers(0, 1, &vertexBufferViews[0]);
+		_boundStride = vertexBufferViews[0].StrideInBytes;
+	}
 	commandList->IASetIndexBuffer(&indexBufferView);
 }
 
-void Mesh::Draw()
+void Mesh::Draw(int pLod)
 {
-	commandList->DrawIndexedInstanced(numIndices, 1, 0, 0, 0);
+	//the index buffer holds every level after the full mesh, a level past the last draws the coarsest one
+	if (!_lods.empty()) {
+		const MeshBinary::Lod& lod = _lods[min(max(pLod, 0), (int)_lods.size() - 1)];
+		commandList->DrawIndexedInstanced(lod.indexCount, 1, lod.indexOffset, 0, 0);
+	}
+	else {
+		commandList->DrawIndexedInstanced(numIndices, 1, 0, 0, 0);
+	}
+
+	fetchStats.draws++;
+	fetchStats.bytes += (uint64_t)_vertexCount * _boundStride;
+	fetchStats.interleavedBytes += (uint64_t)_vertexCount * sizeof(Vertex);
 }
 
 void Mesh::DisableVertexAttribArrays()
@@ -460,6 +741,159 @@ std::vector<DWORD>* Mesh::getVertextIndices()
 	return &_indices;
 }
 
+uint64_t Mesh::getContentHash() const
+{
+	return _contentHash;
+}
+
+size_t Mesh::getGpuBytes() const
+{
+	return _gpuBytes;
+}
+
+size_t Mesh::getCpuBytes() const
+{
+	return sizeof(XMFLOAT3) * _vertices.capacity() + sizeof(Vertex) * _vertexData.capacity() + sizeof(DWORD) * _indices.capacity() +
+		sizeof(MeshBinary::Lod) * _lods.capacity() + sizeof(MeshletBuilder::Meshlet) * _meshlets.meshlets.capacity() +
+		sizeof(uint32_t) * _meshlets.vertices.capacity() + _meshlets.triangles.capacity();
+}
+
+void Mesh::setCpuResidency(CpuResidency pResidency)
+{
+	//data that is gone stays gone
+	if (pResidency < _cpuResidency)
+		return;
+	_cpuResidency = pResidency;
+	if (!_uploadPending)
+		_applyCpuResidency();
+}
+
+Mesh::CpuResidency Mesh::getCpuResidency() const
+{
+	return _cpuResidency;
+}
+
+void Mesh::Upload(ID3D12Device* pDevice, ID3D12GraphicsCommandList* pCommandList)
+{
+	//already buffered, or nothing to buffer
+	if (_vertexCount != 0 || _vertexData.empty() || _indices.empty())
+		return;
+	device = pDevice;
+	commandList = pCommandList;
+	_buffer();
+}
+
+void Mesh::SetUploadFence(ID3D12Fence* pFence, UINT64 pFenceValue)
+{
+	//a later fence would work too, but keeps moving the release further away when it is set every frame
+	if (!_uploadPending || _uploadFence != nullptr)
+		return;
+	_uploadFence = pFence;
+	_uploadFenceValue = pFenceValue;
+}
+
+bool Mesh::ReleaseUploadData()
+{
+	if (!_uploadPending)
+		return true;
+	if (_uploadFence == nullptr || _uploadFence->GetCompletedValue() < _uploadFenceValue)
+		return false;
+
+	//the copies into the default buffers are done, the upload heaps and the data they were filled from can go
+	if (vertexBufferUploadHeap) releaseBuffer(uploadHeap, vertexBufferUploadHeap);
+	if (indexBufferUploadHeap) releaseBuffer(uploadHeap, indexBufferUploadHeap);
+	vertexBufferUploadHeap = nullptr;
+	indexBufferUploadHeap = nullptr;
+	_uploadFence = nullptr;
+	_uploadPending = false;
+
+	_applyCpuResidency();
+	return true;
+}
+
+void Mesh::_applyCpuResidency()
+{
+	//swap with an empty vector, clear keeps the memory
+	if (_cpuResidency != CpuResidencyAll)
+		std::vector<Vertex>().swap(_vertexData);
+	if (_cpuResidency == CpuResidencyNone) {
+		std::vector<XMFLOAT3>().swap(_vertices);
+		std::vector<DWORD>().swap(_indices);
+		//the meshlets go too, the lods stay: Draw picks its index range from them
+		_meshlets = MeshletBuilder::MeshletData();
+	}
+}
+
+Mesh::VertexFormat Mesh::getVertexFormat() const
+{
+	return _vertexFormat;
+}
+
+int Mesh::getLodCount() const
+{
+	return (int)_lods.size();
+}
+
+const MeshBinary::Lod& Mesh::getLod(int pLod) const
+{
+	return _lods[pLod];
+}
+
+const Bounds::Box& Mesh::getBounds() const
+{
+	return _bounds;
+}
+
+const Bounds::Sphere& Mesh::getBoundingSphere() const
+{
+	return _boundingSphere;
+}
+
+float Mesh::getUvDensity() const
+{
+	return _uvDensity;
+}
+
+const MeshletBuilder::MeshletData& Mesh::getMeshlets() const
+{
+	return _meshlets;
+}
+
+int Mesh::getVertexLayout() const
+{
+	return getVertexLayout(_vertexFormat, _splitStreams);
+}
+
+int Mesh::getVertexLayout(VertexFormat pFormat, bool pSplit)
+{
+	return (int)pFormat * 2 + (pSplit ? 1 : 0);
+}
+
+D3D12_INPUT_LAYOUT_DESC Mesh::getInputLayout(int pVertexLayout, unsigned pStreams, D3D12_INPUT_ELEMENT_DESC* pElements)
+{
+	bool compact = (pVertexLayout / 2) == VertexFormatCompact;
+	bool split = (pVertexLayout % 2) != 0;
+	const StreamElement* elements = compact ? compactElements : fullElements;
+	size_t elementCount = compact ? _countof(compactElements) : _countof(fullElements);
+
+	D3D12_INPUT_LAYOUT_DESC inputLayoutDesc = {};
+	inputLayoutDesc.pInputElementDescs = pElements;
+	for (size_t i = 0; i < elementCount; ++i) {
+		const StreamElement& element = elements[i];
+		if (!(pStreams & (1u << element.stream)))
+			continue;
+
+		D3D12_INPUT_ELEMENT_DESC& desc = pElements[inputLayoutDesc.NumElements++];
+		desc.SemanticName = element.semantic;
+		desc.SemanticIndex = 0;
+		desc.Format = element.format;
+		desc.InputSlot = split ? element.stream : 0;
+		desc.AlignedByteOffset = split ? element.streamOffset : element.interleavedOffset;
+		desc.InputSlotClass = D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA;
+		desc.InstanceDataStepRate = 0;
+	}
+	return inputLayoutDesc;
+}
 
 ID3D12Resource* Mesh::CreateDefaultBuffer(
 	ID3D12Device* device,
@@ -471,23 +905,11 @@ ID3D12Resource* Mesh::CreateDefaultBuffer(
 	ID3D12Resource* defaultBuffer;
 
 	// Create the actual default buffer resource.
-	ThrowIfFailed(device->CreateCommittedResource(
-		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
-		D3D12_HEAP_FLAG_NONE,
-		&CD3DX12_RESOURCE_DESC::Buffer(byteSize),
-		D3D12_RESOURCE_STATE_COMMON,
-		nullptr,
-		IID_PPV_ARGS(&defaultBuffer)));
+	defaultBuffer = createBuffer(device, bufferHeap, D3D12_HEAP_TYPE_DEFAULT, byteSize, D3D12_RESOURCE_STATE_COMMON);
 
 	// In order to copy CPU memory data into our default buffer, we need to create
 	// an intermediate upload heap. 
-	ThrowIfFailed(device->CreateCommittedResource(
-		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
-		D3D12_HEAP_FLAG_NONE,
-		&CD3DX12_RESOURCE_DESC::Buffer(byteSize),
-		D3D12_RESOURCE_STATE_GENERIC_READ,
-		nullptr,
-		IID_PPV_ARGS(&uploadBuffer)));
+	uploadBuffer = createBuffer(device, uploadHeap, D3D12_HEAP_TYPE_UPLOAD, byteSize, D3D12_RESOURCE_STATE_GENERIC_READ);
 
 
 	// Describe the data we want to copy into the default buffer.
@@ -6,6 +6,7 @@
 #endif
 
 #include <vector>
+#include <cstdint>
 #include <DirectXMath.h>
 #include <windows.h>
 #include "d3dx12.h"
@@ -13,6 +14,11 @@
 #include <dxgi1_4.h>
 #include <D3Dcompiler.h>
 #include "Debug.h"
+#include "ObjParser.h"
+#include "MeshletBuilder.h"
+#include "MeshBinary.h"
+#include "Bounds.h"
+#include "ResourceHeap.h"
 
 using namespace DirectX; // we will be using the directxmath library
 
@@ -45,8 +51,92 @@ class Mesh
          * Loads a mesh from an .obj file. The file has to have:
          * vertexes, uvs, normals and face indexes. See load source
          * for more format information.
+         * The loaded mesh is cooked to <pFileName>.meshbin, which is used instead of the .obj
+         * until the .obj changes. Meshes loaded from a .meshbin are uploaded straight from the
+         * mapped file and don't keep the cpu side _vertices/_vertexData/_indices copies.
+         * Files of streamImportThreshold bytes or more are cooked by ObjStreamImporter first,
+         * so the whole .obj is never in memory.
          */
 		static Mesh* load(std::string pFileName, ID3D12Device* pDevice, ID3D12GraphicsCommandList* pCommandList, bool pDoBuffer = true);
+
+		//number of threads load uses to parse a file, 0 means one per hardware thread and 1 disables threading.
+		//the result is the same for every thread count.
+		static unsigned loadThreadCount;
+
+		//reorder triangles and vertices after loading for better vertex cache use and less overdraw (see MeshOptimizer)
+		static bool optimizeOnLoad;
+
+		//.obj files of at least this many bytes are cooked in bounded memory by ObjStreamImporter instead of being loaded
+		//in memory, those meshes are optimized per window and get no lod chain. 0 never streams
+		static uint64_t streamImportThreshold;
+
+		//the memory ObjStreamImporter may use for its buffers
+		static size_t streamImportBudget;
+
+		//split meshes into meshlets with culling bounds after loading (see MeshletBuilder)
+		static bool buildMeshlets;
+
+		//what a mesh keeps in cpu memory once its upload is done (see ReleaseUploadData)
+		enum CpuResidency {
+			CpuResidencyAll,		//_vertexData, _vertices, _indices and _meshlets
+			CpuResidencyPositions,	//_vertices, _indices and _meshlets, enough for picking and collision
+			CpuResidencyNone		//only the lod table Draw needs, the mesh lives on the gpu
+		};
+
+		//the residency meshes are loaded with, see setCpuResidency to change it for one mesh
+		static CpuResidency cpuResidency;
+
+		//the lod chain made after loading: the triangle count of every level relative to the full mesh.
+		//each level is simplified from the previous one (see MeshSimplifier), empty means no lods
+		static std::vector<float> lodTriangleRatios;
+
+		//vertex layouts a mesh can be uploaded in
+		enum VertexFormat {
+			VertexFormatFull,		//Vertex, 56 bytes of floats
+			VertexFormatCompact		//VertexQuantizer::PackedVertex, 24 bytes: half uvs, octahedral normal and tangent with handedness
+		};
+
+		//the format meshes are uploaded in. the cpu side _vertexData always stays in the full format
+		static VertexFormat vertexFormat;
+
+		//the vertex attributes grouped in the streams they are stored in. interleaved meshes have all of them in one
+		//stream, split meshes have a stream per group, so passes that only need positions (depth, shadows) fetch only those
+		enum VertexStream {
+			StreamPosition = 1,
+			StreamUv = 2,
+			StreamNormalTangent = 4,	//normal, tangent and bitangent (the handedness in the compact format)
+			StreamAll = StreamPosition | StreamUv | StreamNormalTangent
+		};
+		static const int streamCount = 3;
+
+		//upload meshes as separate position, uv and normal/tangent streams instead of one interleaved stream
+		static bool splitStreams;
+
+		//a vertex layout is a vertex format in either interleaved or split streams, materials keep a pso per layout
+		static const int vertexLayoutCount = 4;
+		static int getVertexLayout(VertexFormat pFormat, bool pSplit);
+
+		//the most input elements getInputLayout writes
+		static const int maxInputElements = 5;
+
+		//the input layout that reads pStreams from meshes in the given vertex layout, the elements are written to pElements.
+		//split layouts read every stream from its own input slot: position 0, uv 1, normal/tangent 2
+		static D3D12_INPUT_LAYOUT_DESC getInputLayout(int pVertexLayout, unsigned pStreams, D3D12_INPUT_ELEMENT_DESC* pElements);
+
+		//vertex fetch accounting over all draws, a vertex is counted once per draw at the stride of the bound streams.
+		//an interleaved stream counts its full stride, whatever the shader reads of it ends up in the cache anyway
+		struct FetchStats {
+			unsigned draws;
+			uint64_t bytes;				//vertex bytes fetched
+			uint64_t interleavedBytes;	//what the same draws fetch from interleaved full format vertices
+		};
+		static FetchStats fetchStats;
+
+		//the heaps the vertex and index buffers and their upload buffers are placed in, committed resources when NULL.
+		//set before the first mesh is uploaded and keep them until the last one is deleted
+		static ResourceHeap* bufferHeap;
+		static ResourceHeap* uploadHeap;
+
 		//void _sendDataToOpenGL(glm::mat4 pProjectionMatrix, glm::mat4 pViewMatrix, std::vector<GameObject*> pGameObjects);
 
         /**
@@ -56,9 +146,23 @@ class Mesh
 
 		void instanceToOpenGL(int pVerticesAttrib, int pNormalsAttrib, int pUVsAttrib, int pTangentAttrib, int pBitangentAttrib);
 
-		void SetVertexIndexBuffers();
+		//bind the index buffer and the vertex streams in pStreams (see VertexStream)
+		void SetVertexIndexBuffers(unsigned pStreams = StreamAll);
 
-		void Draw();
+		//create the gpu buffers of a mesh loaded with pDoBuffer false and record its upload on pCommandList.
+		//lets meshes be loaded on another thread and uploaded on the thread that owns the command list
+		void Upload(ID3D12Device* pDevice, ID3D12GraphicsCommandList* pCommandList);
+
+		//the upload recorded on the command list by load is done once pFence reaches pFenceValue.
+		//call it after signalling the fence that follows the upload, only the first fence after the upload is kept
+		void SetUploadFence(ID3D12Fence* pFence, UINT64 pFenceValue);
+
+		//once the upload is done, release the upload heaps and the cpu data the residency policy does not keep.
+		//returns true if there is no upload in flight (anymore), false if the gpu is still copying
+		bool ReleaseUploadData();
+
+		//draw the given level of detail, 0 is the full mesh
+		void Draw(int pLod = 0);
 
 		void DisableVertexAttribArrays();
 
@@ -70,11 +174,47 @@ class Mesh
 		std::vector<XMFLOAT3>*  getVerticies();
 		std::vector<DWORD>* getVertextIndices();
 
+		//hash of the final vertex and index data, meshes with the same hash are identical
+		uint64_t getContentHash() const;
+
+		//size of the vertex and index buffers in gpu memory
+		size_t getGpuBytes() const;
+
+		//cpu memory held by the mesh data: vertices, indices, lods and meshlets. the upload heaps are not included
+		size_t getCpuBytes() const;
+
+		//changing the residency only ever drops data, what is dropped can't be brought back without loading the mesh again.
+		//the data is dropped right away, or when the upload is done if it is still in flight
+		void setCpuResidency(CpuResidency pResidency);
+		CpuResidency getCpuResidency() const;
+
+		//the format the vertex buffer was uploaded in
+		VertexFormat getVertexFormat() const;
+
+		//the layout the vertex buffer was uploaded in, see getVertexLayout(VertexFormat, bool)
+		int getVertexLayout() const;
+
+		//levels of detail, level 0 is the full mesh. they are ranges of the same index buffer
+		int getLodCount() const;
+		const MeshBinary::Lod& getLod(int pLod) const;
+
+		//object space bounds of the vertex positions, computed when the mesh is loaded
+		const Bounds::Box& getBounds() const;
+		const Bounds::Sphere& getBoundingSphere() const;
+
+		//uv units per mesh unit over the full mesh (see TextureStreamer::uvDensity), computed when the mesh is loaded.
+		//a texture of n texels wide gets n * getUvDensity() texels per mesh unit
+		float getUvDensity() const;
+
+		//the meshlets of the mesh, empty unless buildMeshlets was set when it was loaded (or after CpuResidencyNone dropped them).
+		//meshlet vertices are indices into the vertex buffer, their triangles follow the index buffer order
+		const MeshletBuilder::MeshletData& getMeshlets() const;
+
 		//the actual data
 		std::vector<XMFLOAT3> _vertices;	//vec3 with 3d coords for all vertices
 		std::vector<Vertex> _vertexData;	//full vertex data
 
-		//references to the vertices/normals & uvs in previous vectors
+		//references to the vertices/normals & uvs in previous vectors, the full mesh followed by the lod levels (see getLod)
 		std::vector<DWORD> _indices;
 
 	protected:
@@ -97,43 +237,63 @@ class Mesh
 
 		int numIndices;
 
+		uint64_t _contentHash;
+		float _uvDensity;
+		size_t _gpuBytes;
+		VertexFormat _vertexFormat;
+		MeshletBuilder::MeshletData _meshlets;
+		Bounds::Box _bounds;
+		Bounds::Sphere _boundingSphere;
+		std::vector<MeshBinary::Lod> _lods;
+		bool _splitStreams;
+		CpuResidency _cpuResidency;
+		bool _uploadPending;		//the upload heaps are still needed
+		ID3D12Fence* _uploadFence;
+		UINT64 _uploadFenceValue;
+		UINT _vertexCount;
+		UINT _boundStride;	//bytes per vertex of the streams bound by the last SetVertexIndexBuffers
+
 		ID3D12Resource* vertexBuffer; //a default buffer in gpu memory that we will load the vertex data into
+		ID3D12Resource* vertexBufferUploadHeap; //upload buffer the vertex data is copied from
 
-		D3D12_VERTEX_BUFFER_VIEW vertexBufferView; //a structure containing a pointer to the vertex data in gpu memory (to be used by the driver), 
-												   //the total size of the buffer, and the size of each element
+		D3D12_VERTEX_BUFFER_VIEW vertexBufferViews[streamCount]; //structures containing a pointer to the vertex data in gpu memory (to be used by the driver),
+																  //the total size of the buffer, and the size of each element. one per stream when split, else only the first
 
 		ID3D12Resource* indexBuffer; //a default buffer in gpu memory that we will load index data into
+		ID3D12Resource* indexBufferUploadHeap; //upload buffer the index data is copied from
 
 		D3D12_INDEX_BUFFER_VIEW indexBufferView; //a stucture holding info about the index buffer
 
-        //buffer vertices, normals, and uv's
+        //buffer vertices, normals, and uv's. the vertices are packed first if vertexFormat is compact,
+		//and the indices are uploaded as 16 bit whenever the vertex count allows it
 		void _buffer();
+		void _buffer(const void* pVertices, UINT pVertexCount, const void* pIndices, UINT pIndexCount);
 
-        //Please read the "load" function documentation on the .obj file format first.
-        //FaceVertexTriplet  is a helper class for loading and converting to obj file to
-        //indexed arrays.
-        //If we list all the unique v/uv/vn triplets under the faces
-        //section in an object file sequentially and assign them a number
-        //it would be a map of FaceVertexTriplet. Each FaceVertexTriplet refers
-        //to an index with the originally loaded vertex list, normal list and uv list
-        //and is only used during conversion (unpacking) of the facevertextriplet list
-        //to a format that OpenGL can handle.
-        //So for a vertex index a FaceVertexTriplet contains the index for uv and n as well.
-		class FaceIndexTriplet {
-			public:
-				unsigned v; //vertex
-				unsigned uv;//uv
-				unsigned n; //normal
-				FaceIndexTriplet( unsigned pV, unsigned pUV, unsigned pN )
-				:	v(pV),uv(pUV),n(pN) {
-				}
-				//needed for use as key in map
-				bool operator<(const FaceIndexTriplet other) const{
-					return memcmp((void*)this, (void*)&other, sizeof(FaceIndexTriplet))>0;
-				}
-		};
+		//free the cpu data _cpuResidency does not keep
+		void _applyCpuResidency();
+
+		//load the cooked mesh if it is valid for pSource (nullptr skips that check), pFlags and the lod settings
+		bool _loadCooked(const std::string& pCookedFileName, const MeshBinary::SourceStamp* pSource, uint32_t pFlags, bool pDoBuffer);
+
+		//turn the parsed obj data into unique vertices, tangents and indices. returns false on invalid face indices
+		bool _build(const ObjData& pData);
+
+		//reorder the indices and vertices for the gpu, reports the simulated vertex cache miss ratios before and after
+		void _optimize();
+
+		//append the lod chain to _indices and fill _lods, reports the triangle count and error of every level
+		void _generateLods();
+
+		//identifies lodTriangleRatios, stored with cooked meshes
+		static uint32_t _lodSettings();
+
+		//compute _bounds and _boundingSphere from full format vertices
+		void _computeBounds(const void* pVertices, UINT pVertexCount);
+
+		//build _meshlets from full format vertices and 32 bit indices, reports how long it took
+		void _buildMeshlets(const void* pVertices, UINT pVertexCount, const uint32_t* pIndices, UINT pIndexCount);
 
-		//upload data to constant buffer
+		//upload data to constant buffer, placed in bufferHeap and uploadHeap
 		static ID3D12Resource* CreateDefaultBuffer(
 			ID3D12Device* device,
 			ID3D12GraphicsCommandList* cmdList,
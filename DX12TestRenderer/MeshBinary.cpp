@@ -0,0 +1,367 @@
+#include "MeshBinary.h"
+#include "ContentHash.h"
+#include <cstdio>
+#include <cstring>
+#include <cfloat>
+#include <algorithm>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+namespace {
+	const char meshBinaryMagic[4] = { 'M', 'B', 'I', 'N' };
+
+	//the header is written as is, make sure it has the same layout for every compiler we use
+	static_assert(sizeof(MeshBinary::Header) == 80, "MeshBinary::Header layout changed, bump formatVersion");
+	static_assert(sizeof(MeshBinary::Lod) == 12, "MeshBinary::Lod layout changed, bump formatVersion");
+
+	//the content hash is chained over blocks of this size, the Writer writes in blocks of the same size
+	const size_t hashBlockSize = 1024 * 1024;
+
+	uint64_t hashBlocks(const void* pData, size_t pSize, uint64_t pHash) {
+		const unsigned char* bytes = (const unsigned char*)pData;
+		for (size_t offset = 0; offset < pSize; offset += hashBlockSize)
+			pHash = hashContent(bytes + offset, std::min(hashBlockSize, pSize - offset), pHash);
+		return pHash;
+	}
+
+	void resetBounds(MeshBinary::Header& pHeader) {
+		for (int axis = 0; axis < 3; ++axis) {
+			pHeader.boundsMin[axis] = FLT_MAX;
+			pHeader.boundsMax[axis] = -FLT_MAX;
+		}
+	}
+
+	//grow the header bounds by the positions of pVertexCount vertices
+	void growBounds(MeshBinary::Header& pHeader, const void* pVertices, uint32_t pVertexStride, size_t pVertexCount) {
+		const unsigned char* vertex = (const unsigned char*)pVertices;
+		for (size_t i = 0; i < pVertexCount; ++i, vertex += pVertexStride) {
+			float position[3];
+			memcpy(position, vertex, sizeof(position));
+			for (int axis = 0; axis < 3; ++axis) {
+				if (position[axis] < pHeader.boundsMin[axis]) pHeader.boundsMin[axis] = position[axis];
+				if (position[axis] > pHeader.boundsMax[axis]) pHeader.boundsMax[axis] = position[axis];
+			}
+		}
+	}
+
+	//empty meshes get empty bounds at the origin
+	void finishBounds(MeshBinary::Header& pHeader) {
+		if (pHeader.vertexCount != 0)
+			return;
+		for (int axis = 0; axis < 3; ++axis)
+			pHeader.boundsMin[axis] = pHeader.boundsMax[axis] = 0.0f;
+	}
+
+	bool seekFile(FILE* pFile, uint64_t pOffset) {
+#ifdef _WIN32
+		return _fseeki64(pFile, (long long)pOffset, SEEK_SET) == 0;
+#else
+		return fseeko(pFile, (off_t)pOffset, SEEK_SET) == 0;
+#endif
+	}
+
+	//move the written temporary file to its final name
+	bool replaceFile(const std::string& pTempFileName, const std::string& pFileName) {
+		//rename does not replace an existing file on windows
+		remove(pFileName.c_str());
+		if (rename(pTempFileName.c_str(), pFileName.c_str()) != 0) {
+			remove(pTempFileName.c_str());
+			return false;
+		}
+		return true;
+	}
+}
+
+MeshBinary::MeshBinary() : _header(nullptr)
+{
+}
+
+bool MeshBinary::getSourceStamp(const std::string& pFileName, SourceStamp& pStamp)
+{
+#ifdef _WIN32
+	struct _stat64 fileStat;
+	if (_stat64(pFileName.c_str(), &fileStat) != 0)
+		return false;
+#else
+	struct stat fileStat;
+	if (stat(pFileName.c_str(), &fileStat) != 0)
+		return false;
+#endif
+	pStamp.size = (uint64_t)fileStat.st_size;
+	pStamp.modifiedTime = (int64_t)fileStat.st_mtime;
+	return true;
+}
+
+uint64_t MeshBinary::hashData(const void* pVertices, size_t pVertexBytes, const uint32_t* pIndices, uint32_t pIndexCount)
+{
+	return hashBlocks(pIndices, sizeof(uint32_t) * pIndexCount, hashBlocks(pVertices, pVertexBytes, 0));
+}
+
+bool MeshBinary::write(const std::string& pFileName, const SourceStamp& pSource, uint32_t pFlags, const void* pVertices, uint32_t pVertexStride, uint32_t pVertexCount, const uint32_t* pIndices, uint32_t pIndexCount,
+	const Lod* pLods, uint32_t pLodCount, uint32_t pLodSettings)
+{
+	size_t vertexBytes = (size_t)pVertexStride * pVertexCount;
+	size_t indexBytes = sizeof(uint32_t) * pIndexCount;
+	size_t lodBytes = sizeof(Lod) * pLodCount;
+
+	Header header = {};
+	memcpy(header.magic, meshBinaryMagic, sizeof(header.magic));
+	header.version = formatVersion;
+	header.vertexStride = pVertexStride;
+	header.vertexCount = pVertexCount;
+	header.indexCount = pIndexCount;
+	header.flags = pFlags;
+	header.source = pSource;
+	header.contentHash = hashData(pVertices, vertexBytes, pIndices, pIndexCount);
+	header.lodCount = pLodCount;
+	header.lodSettings = pLodSettings;
+
+	//bounds of the positions
+	resetBounds(header);
+	growBounds(header, pVertices, pVertexStride, pVertexCount);
+	finishBounds(header);
+
+	std::string tempFileName = pFileName + ".tmp";
+	FILE* file = fopen(tempFileName.c_str(), "wb");
+	if (file == nullptr)
+		return false;
+
+	bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+		(vertexBytes == 0 || fwrite(pVertices, vertexBytes, 1, file) == 1) &&
+		(indexBytes == 0 || fwrite(pIndices, indexBytes, 1, file) == 1) &&
+		(lodBytes == 0 || fwrite(pLods, lodBytes, 1, file) == 1);
+	written = (fclose(file) == 0) && written;
+
+	if (!written) {
+		remove(tempFileName.c_str());
+		return false;
+	}
+
+	return replaceFile(tempFileName, pFileName);
+}
+
+MeshBinary::Writer::Writer() : _file(nullptr), _indexFile(nullptr), _header(), _vertexHash(0), _failed(false)
+{
+}
+
+MeshBinary::Writer::~Writer()
+{
+	cancel();
+}
+
+bool MeshBinary::Writer::open(const std::string& pFileName, uint32_t pVertexStride)
+{
+	cancel();
+	_fileName = pFileName;
+	_failed = false;
+	_vertexHash = 0;
+
+	_header = Header();
+	memcpy(_header.magic, meshBinaryMagic, sizeof(_header.magic));
+	_header.version = formatVersion;
+	_header.vertexStride = pVertexStride;
+	resetBounds(_header);
+
+	_file = fopen((pFileName + ".tmp").c_str(), "wb");
+	_indexFile = fopen((pFileName + ".indices.tmp").c_str(), "w+b");
+	if (_file == nullptr || _indexFile == nullptr) {
+		cancel();
+		return false;
+	}
+
+	//the header is written last, when everything in it is known
+	_vertexBlock.reserve(hashBlockSize);
+	_indexBlock.reserve(hashBlockSize);
+	_failed = fwrite(&_header, sizeof(_header), 1, _file) != 1;
+	return !_failed;
+}
+
+bool MeshBinary::Writer::appendVertices(const void* pVertices, uint32_t pVertexCount)
+{
+	if (_file == nullptr || _failed || pVertexCount > UINT32_MAX - _header.vertexCount)
+		return false;
+	growBounds(_header, pVertices, _header.vertexStride, pVertexCount);
+	_header.vertexCount += pVertexCount;
+	return _write(_vertexBlock, _file, &_vertexHash, pVertices, (size_t)_header.vertexStride * pVertexCount);
+}
+
+bool MeshBinary::Writer::appendIndices(const uint32_t* pIndices, uint32_t pIndexCount)
+{
+	if (_file == nullptr || _failed || pIndexCount > UINT32_MAX - _header.indexCount)
+		return false;
+	_header.indexCount += pIndexCount;
+	//the index hash continues from the vertex hash, so the indices are hashed in finish
+	return _write(_indexBlock, _indexFile, nullptr, pIndices, sizeof(uint32_t) * pIndexCount);
+}
+
+bool MeshBinary::Writer::finish(const SourceStamp& pSource, uint32_t pFlags, const Lod* pLods, uint32_t pLodCount, uint32_t pLodSettings)
+{
+	if (_file == nullptr || _failed || !_flush(_vertexBlock, _file, &_vertexHash) || !_flush(_indexBlock, _indexFile, nullptr)) {
+		cancel();
+		return false;
+	}
+
+	//copy the spilled indices behind the vertices, in the blocks the hash is chained over
+	uint64_t hash = _vertexHash;
+	bool written = fflush(_indexFile) == 0 && seekFile(_indexFile, 0);
+	_vertexBlock.resize(hashBlockSize);
+	uint64_t remaining = sizeof(uint32_t) * (uint64_t)_header.indexCount;
+	while (written && remaining > 0) {
+		size_t size = (size_t)std::min<uint64_t>(hashBlockSize, remaining);
+		written = fread(&_vertexBlock[0], size, 1, _indexFile) == 1 && fwrite(&_vertexBlock[0], size, 1, _file) == 1;
+		hash = hashContent(&_vertexBlock[0], size, hash);
+		remaining -= size;
+	}
+
+	_header.flags = pFlags;
+	_header.source = pSource;
+	_header.contentHash = hash;
+	_header.lodCount = pLodCount;
+	_header.lodSettings = pLodSettings;
+	finishBounds(_header);
+
+	written = written && (pLodCount == 0 || fwrite(pLods, sizeof(Lod) * pLodCount, 1, _file) == 1) &&
+		seekFile(_file, 0) && fwrite(&_header, sizeof(_header), 1, _file) == 1;
+	written = (fclose(_file) == 0) && written;
+	_file = nullptr;
+
+	if (!written) {
+		cancel();
+		return false;
+	}
+	//only the spilled indices are left to clean up, the temporary file becomes the cooked mesh
+	std::string fileName = _fileName;
+	_fileName.clear();
+	fclose(_indexFile);
+	_indexFile = nullptr;
+	remove((fileName + ".indices.tmp").c_str());
+	cancel();
+	return replaceFile(fileName + ".tmp", fileName);
+}
+
+void MeshBinary::Writer::cancel()
+{
+	if (_file != nullptr) {
+		fclose(_file);
+		_file = nullptr;
+	}
+	if (_indexFile != nullptr) {
+		fclose(_indexFile);
+		_indexFile = nullptr;
+	}
+	if (!_fileName.empty()) {
+		remove((_fileName + ".tmp").c_str());
+		remove((_fileName + ".indices.tmp").c_str());
+	}
+	_vertexBlock = std::vector<unsigned char>();
+	_indexBlock = std::vector<unsigned char>();
+}
+
+uint32_t MeshBinary::Writer::vertexCount() const
+{
+	return _header.vertexCount;
+}
+
+uint32_t MeshBinary::Writer::indexCount() const
+{
+	return _header.indexCount;
+}
+
+bool MeshBinary::Writer::_write(std::vector<unsigned char>& pBlock, FILE* pFile, uint64_t* pHash, const void* pData, size_t pSize)
+{
+	const unsigned char* bytes = (const unsigned char*)pData;
+	while (pSize > 0) {
+		size_t size = std::min(pSize, hashBlockSize - pBlock.size());
+		pBlock.insert(pBlock.end(), bytes, bytes + size);
+		bytes += size;
+		pSize -= size;
+		if (pBlock.size() == hashBlockSize && !_flush(pBlock, pFile, pHash))
+			return false;
+	}
+	return true;
+}
+
+bool MeshBinary::Writer::_flush(std::vector<unsigned char>& pBlock, FILE* pFile, uint64_t* pHash)
+{
+	if (pBlock.empty())
+		return true;
+	if (pHash != nullptr)
+		*pHash = hashContent(&pBlock[0], pBlock.size(), *pHash);
+	_failed = _failed || fwrite(&pBlock[0], pBlock.size(), 1, pFile) != 1;
+	pBlock.clear();
+	return !_failed;
+}
+
+bool MeshBinary::open(const std::string& pFileName, const SourceStamp* pSource, uint32_t pFlags, uint32_t pVertexStride)
+{
+	close();
+
+	if (!_file.open(pFileName) || _file.size() < sizeof(Header))
+		return false;
+
+	//the mapping is page aligned, so the header and the data after it are properly aligned
+	const Header* header = (const Header*)_file.data();
+
+	bool valid = memcmp(header->magic, meshBinaryMagic, sizeof(header->magic)) == 0 &&
+		header->version == formatVersion &&
+		header->vertexStride == pVertexStride &&
+		header->flags == pFlags &&
+		_file.size() == sizeof(Header) + (size_t)header->vertexStride * header->vertexCount + sizeof(uint32_t) * (size_t)header->indexCount + sizeof(Lod) * (size_t)header->lodCount;
+
+	//the lods have to be ranges of the index buffer
+	const Lod* lods = (const Lod*)((const unsigned char*)_file.data() + _file.size() - sizeof(Lod) * (valid ? header->lodCount : 0));
+	for (uint32_t i = 0; valid && i < header->lodCount; ++i)
+		valid = lods[i].indexOffset <= header->indexCount && lods[i].indexCount <= header->indexCount - lods[i].indexOffset;
+
+	if (valid && pSource != nullptr)
+		valid = header->source.size == pSource->size && header->source.modifiedTime == pSource->modifiedTime;
+
+	//the indices go to the gpu as they are, one past the vertices would read outside the vertex buffer. a max over the
+	//indices is much cheaper than checking the content hash, and the upload reads these pages anyway
+	if (valid && header->indexCount > 0) {
+		const uint32_t* indices = (const uint32_t*)((const unsigned char*)_file.data() + sizeof(Header) + (size_t)header->vertexStride * header->vertexCount);
+		uint32_t largest = 0;
+		for (uint32_t i = 0; i < header->indexCount; ++i)
+			largest = std::max(largest, indices[i]);
+		valid = largest < header->vertexCount;
+	}
+
+	if (!valid) {
+		close();
+		return false;
+	}
+
+	_header = header;
+	return true;
+}
+
+void MeshBinary::close()
+{
+	_file.close();
+	_header = nullptr;
+}
+
+const MeshBinary::Header& MeshBinary::header() const
+{
+	return *_header;
+}
+
+const void* MeshBinary::vertices() const
+{
+	return _file.data() + sizeof(Header);
+}
+
+const uint32_t* MeshBinary::indices() const
+{
+	return (const uint32_t*)(_file.data() + sizeof(Header) + (size_t)_header->vertexStride * _header->vertexCount);
+}
+
+const MeshBinary::Lod* MeshBinary::lods() const
+{
+	return (const Lod*)(indices() + _header->indexCount);
+}
+
+size_t MeshBinary::fileSize() const
+{
+	return _file.size();
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include "MappedFile.h"
+
+/**
+ * A cooked mesh (.meshbin): the final interleaved vertex array and index buffer exactly as
+ * they are uploaded to the gpu, so loading it is a memory map and a header check, no parsing.
+ *
+ * Layout: Header, vertexCount * vertexStride bytes of vertex data, indexCount 32 bit indices, lodCount Lods.
+ * The header remembers the size and modification time of the source file it was cooked from,
+ * so a cooked mesh is only used as long as its source did not change.
+ * Meshes that don't fit in memory are written in pieces with a Writer.
+ */
+class MeshBinary
+{
+public:
+	//bump this whenever the vertex layout or the way meshes are built changes, old files are then re-cooked
+	static const uint32_t formatVersion = 4;
+
+	//processing steps that change the cooked data, a cooked mesh is only used if they match
+	enum Flags {
+		FlagVertexCacheOptimized = 1
+	};
+
+	//identifies a version of a source file
+	struct SourceStamp {
+		uint64_t size;
+		int64_t modifiedTime;
+	};
+
+	//a level of detail: a range of the index buffer, all levels use the same vertices
+	struct Lod {
+		uint32_t indexOffset;
+		uint32_t indexCount;
+		float error;			//geometric error of the level in mesh units, 0 for the full detail mesh
+	};
+
+	struct Header {
+		char magic[4];			//"MBIN"
+		uint32_t version;
+		uint32_t vertexStride;
+		uint32_t vertexCount;
+		uint32_t indexCount;
+		uint32_t flags;			//how the mesh was processed, see Flags
+		SourceStamp source;
+		uint64_t contentHash;	//hash of the vertex and index data
+		float boundsMin[3];		//object space bounds of the vertex positions (first float3 of every vertex)
+		float boundsMax[3];
+		uint32_t lodCount;
+		uint32_t lodSettings;	//identifies the settings the lods were made with, so changed settings re-cook
+	};
+
+	MeshBinary();
+
+	//get the size and modification time of a file, returns false if the file does not exist
+	static bool getSourceStamp(const std::string& pFileName, SourceStamp& pStamp);
+
+	//the content hash stored in the header for this vertex and index data.
+	//it is chained over fixed size blocks, so a mesh written in pieces gets the same hash as one written at once
+	static uint64_t hashData(const void* pVertices, size_t pVertexBytes, const uint32_t* pIndices, uint32_t pIndexCount);
+
+	//write a cooked mesh. the file is written under a temporary name first, so a half written file is never picked up.
+	//the position of every vertex is expected to be the first 3 floats of the vertex.
+	static bool write(const std::string& pFileName, const SourceStamp& pSource, uint32_t pFlags, const void* pVertices, uint32_t pVertexStride, uint32_t pVertexCount, const uint32_t* pIndices, uint32_t pIndexCount,
+		const Lod* pLods, uint32_t pLodCount, uint32_t pLodSettings);
+
+	/**
+	 * Writes a cooked mesh whose vertices and indices arrive in pieces, in any order, so the whole mesh never
+	 * has to be in memory. Vertices go straight to the file, indices to a spill file (<pFileName>.indices.tmp)
+	 * that finish copies behind them. Memory use is two write blocks, whatever the size of the mesh.
+	 * Nothing is visible under pFileName until finish succeeds, an unfinished file is removed on destruction.
+	 */
+	class Writer
+	{
+	public:
+		Writer();
+		~Writer();
+
+		bool open(const std::string& pFileName, uint32_t pVertexStride);
+
+		//the position of every vertex is expected to be the first 3 floats of the vertex
+		bool appendVertices(const void* pVertices, uint32_t pVertexCount);
+		bool appendIndices(const uint32_t* pIndices, uint32_t pIndexCount);
+
+		//complete the file and move it to pFileName, the writer is closed afterwards
+		bool finish(const SourceStamp& pSource, uint32_t pFlags, const Lod* pLods, uint32_t pLodCount, uint32_t pLodSettings);
+		void cancel();
+
+		uint32_t vertexCount() const;
+		uint32_t indexCount() const;
+
+	private:
+		Writer(const Writer&) = delete;
+		Writer& operator=(const Writer&) = delete;
+
+		bool _write(std::vector<unsigned char>& pBlock, FILE* pFile, uint64_t* pHash, const void* pData, size_t pSize);
+		bool _flush(std::vector<unsigned char>& pBlock, FILE* pFile, uint64_t* pHash);
+
+		std::string _fileName;
+		FILE* _file;
+		FILE* _indexFile;
+		Header _header;
+		uint64_t _vertexHash;
+		std::vector<unsigned char> _vertexBlock;
+		std::vector<unsigned char> _indexBlock;
+		bool _failed;
+	};
+
+	//map a cooked mesh. fails if the file is missing, broken (sizes, lod ranges or an index past the vertices), from another
+	//format version, vertex layout or flags, or if it was cooked from a different version of the source (pass nullptr to
+	//skip the source check)
+	bool open(const std::string& pFileName, const SourceStamp* pSource, uint32_t pFlags, uint32_t pVertexStride);
+	void close();
+
+	const Header& header() const;
+	const void* vertices() const;
+	const uint32_t* indices() const;
+	const Lod* lods() const;
+	size_t fileSize() const;
+
+private:
+	MappedFile _file;
+	const Header* _header;
+};
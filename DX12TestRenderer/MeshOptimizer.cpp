@@ -0,0 +1,279 @@
+#include "MeshOptimizer.h"
+#include "glm.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+namespace {
+	//fifo cache simulation. a vertex is in the cache if fewer than cacheSize misses happened since it was loaded.
+	//flush() empties the cache in O(1) by jumping the miss counter ahead.
+	class FifoCache {
+	public:
+		FifoCache(size_t pVertexCount, unsigned pCacheSize)
+			: _loadedAt(pVertexCount, 0), _cacheSize(pCacheSize), _time(pCacheSize + 1) {
+		}
+
+		//returns true on a miss
+		bool access(uint32_t pVertex) {
+			if (_time - _loadedAt[pVertex] < _cacheSize)
+				return false;
+			_loadedAt[pVertex] = ++_time;
+			return true;
+		}
+
+		void flush() {
+			_time += _cacheSize + 1;
+		}
+
+	private:
+		vector<uint64_t> _loadedAt;
+		uint64_t _cacheSize;
+		uint64_t _time;
+	};
+
+	inline glm::vec3 loadPosition(const unsigned char* pPositions, size_t pStride, uint32_t pIndex) {
+		glm::vec3 position;
+		memcpy(&position, pPositions + pStride * pIndex, sizeof(position));
+		return position;
+	}
+}
+
+MeshOptimizer::VertexCacheStats MeshOptimizer::analyzeVertexCache(const uint32_t* pIndices, size_t pIndexCount, size_t pVertexCount, unsigned pCacheSize)
+{
+	VertexCacheStats stats = {};
+	FifoCache cache(pVertexCount, pCacheSize);
+	vector<char> referenced(pVertexCount, 0);
+
+	for (size_t i = 0; i < pIndexCount; ++i) {
+		uint32_t vertex = pIndices[i];
+		if (cache.access(vertex))
+			stats.misses++;
+		if (!referenced[vertex]) {
+			referenced[vertex] = 1;
+			stats.vertices++;
+		}
+	}
+
+	stats.triangles = (unsigned)(pIndexCount / 3);
+	stats.acmr = stats.triangles ? (float)stats.misses / stats.triangles : 0.0f;
+	stats.atvr = stats.vertices ? (float)stats.misses / stats.vertices : 0.0f;
+	return stats;
+}
+
+void MeshOptimizer::optimizeVertexCache(uint32_t* pIndices, size_t pIndexCount, size_t pVertexCount, unsigned pCacheSize)
+{
+	size_t triangleCount = pIndexCount / 3;
+	if (triangleCount == 0)
+		return;
+
+	//vertex -> triangle adjacency, and the number of not yet emitted triangles per vertex
+	vector<unsigned> live(pVertexCount, 0);
+	for (size_t i = 0; i < triangleCount * 3; ++i)
+		live[pIndices[i]]++;
+
+	vector<unsigned> offsets(pVertexCount + 1, 0);
+	for (size_t v = 0; v < pVertexCount; ++v)
+		offsets[v + 1] = offsets[v] + live[v];
+
+	vector<unsigned> adjacency(triangleCount * 3);
+	{
+		vector<unsigned> fill(offsets.begin(), offsets.end() - 1);
+		for (size_t i = 0; i < triangleCount * 3; ++i)
+			adjacency[fill[pIndices[i]]++] = (unsigned)(i / 3);
+	}
+
+	//time stamps of when each vertex entered the (simulated) cache
+	vector<unsigned> cacheTime(pVertexCount, 0);
+	unsigned time = pCacheSize + 1;
+
+	vector<char> emitted(triangleCount, 0);
+	vector<uint32_t> deadEnd;
+	deadEnd.reserve(triangleCount * 3);
+	vector<uint32_t> candidates;
+	vector<uint32_t> output;
+	output.reserve(triangleCount * 3);
+
+	size_t cursor = 0;
+	long long fanning = pIndices[0];
+
+	while (fanning >= 0) {
+		//emit all remaining triangles around the fanning vertex
+		candidates.clear();
+		for (unsigned k = offsets[(size_t)fanning]; k < offsets[(size_t)fanning + 1]; ++k) {
+			unsigned triangle = adjacency[k];
+			if (emitted[triangle])
+				continue;
+			emitted[triangle] = 1;
+
+			for (int c = 0; c < 3; ++c) {
+				uint32_t vertex = pIndices[triangle * 3 + c];
+				output.push_back(vertex);
+				deadEnd.push_back(vertex);
+				candidates.push_back(vertex);
+				live[vertex]--;
+				if (time - cacheTime[vertex] > pCacheSize)
+					cacheTime[vertex] = time++;
+			}
+		}
+
+		//pick the next fanning vertex: the oldest candidate that will still be in the cache after its own fan
+		fanning = -1;
+		int bestPriority = -1;
+		for (size_t i = 0; i < candidates.size(); ++i) {
+			uint32_t vertex = candidates[i];
+			if (live[vertex] == 0)
+				continue;
+			int priority = 0;
+			if (time - cacheTime[vertex] + 2 * live[vertex] <= pCacheSize)
+				priority = (int)(time - cacheTime[vertex]);
+			if (priority > bestPriority) {
+				bestPriority = priority;
+				fanning = vertex;
+			}
+		}
+
+		//no candidate left, try the most recently used vertices
+		while (fanning < 0 && !deadEnd.empty()) {
+			uint32_t vertex = deadEnd.back();
+			deadEnd.pop_back();
+			if (live[vertex] > 0)
+				fanning = vertex;
+		}
+
+		//still nothing, continue with the next vertex in index order that has triangles left
+		while (fanning < 0 && cursor < pVertexCount) {
+			if (live[cursor] > 0)
+				fanning = (long long)cursor;
+			else
+				++cursor;
+		}
+	}
+
+	memcpy(pIndices, &output[0], output.size() * sizeof(uint32_t));
+}
+
+size_t MeshOptimizer::optimizeOverdraw(uint32_t* pIndices, size_t pIndexCount, const void* pPositions, size_t pStride, size_t pVertexCount, float pThreshold, unsigned pCacheSize)
+{
+	size_t triangleCount = pIndexCount / 3;
+	if (triangleCount == 0)
+		return 0;
+
+	//hard boundaries: triangles where the cache order restarts anyway (all three vertices miss)
+	vector<size_t> hardBoundaries;
+	{
+		FifoCache cache(pVertexCount, pCacheSize);
+		for (size_t t = 0; t < triangleCount; ++t) {
+			int misses = cache.access(pIndices[t * 3]) + cache.access(pIndices[t * 3 + 1]) + cache.access(pIndices[t * 3 + 2]);
+			if (misses == 3)
+				hardBoundaries.push_back(t);
+		}
+		hardBoundaries.push_back(triangleCount);
+	}
+
+	//soft boundaries: split a hard cluster as soon as the part so far (starting with a cold cache)
+	//is within pThreshold of the cache miss ratio of the whole hard cluster
+	vector<size_t> clusters;
+	FifoCache cache(pVertexCount, pCacheSize);
+	for (size_t h = 0; h + 1 < hardBoundaries.size(); ++h) {
+		size_t begin = hardBoundaries[h];
+		size_t end = hardBoundaries[h + 1];
+
+		cache.flush();
+		unsigned hardMisses = 0;
+		for (size_t i = begin * 3; i < end * 3; ++i)
+			hardMisses += cache.access(pIndices[i]);
+		float hardAcmr = (float)hardMisses / (end - begin);
+
+		cache.flush();
+		clusters.push_back(begin);
+		size_t clusterStart = begin;
+		unsigned misses = 0;
+		for (size_t t = begin; t < end; ++t) {
+			misses += cache.access(pIndices[t * 3]) + cache.access(pIndices[t * 3 + 1]) + cache.access(pIndices[t * 3 + 2]);
+			size_t clusterTriangles = t + 1 - clusterStart;
+			if (t + 1 < end && misses <= pThreshold * hardAcmr * clusterTriangles) {
+				clusters.push_back(t + 1);
+				clusterStart = t + 1;
+				misses = 0;
+				cache.flush();
+			}
+		}
+	}
+	clusters.push_back(triangleCount);
+
+	//area weighted centroid and normal per cluster, and the centroid of the whole mesh
+	const unsigned char* positions = (const unsigned char*)pPositions;
+	size_t clusterCount = clusters.size() - 1;
+	vector<glm::vec3> clusterCentroids(clusterCount), clusterNormals(clusterCount);
+	glm::vec3 meshCentroid(0.0f);
+	float meshArea = 0.0f;
+
+	for (size_t c = 0; c < clusterCount; ++c) {
+		glm::vec3 centroid(0.0f), normal(0.0f);
+		float area = 0.0f;
+		for (size_t t = clusters[c]; t < clusters[c + 1]; ++t) {
+			glm::vec3 p0 = loadPosition(positions, pStride, pIndices[t * 3]);
+			glm::vec3 p1 = loadPosition(positions, pStride, pIndices[t * 3 + 1]);
+			glm::vec3 p2 = loadPosition(positions, pStride, pIndices[t * 3 + 2]);
+			glm::vec3 cross = glm::cross(p1 - p0, p2 - p0);
+			float triangleArea = glm::length(cross);
+			centroid += (p0 + p1 + p2) * (triangleArea / 3.0f);
+			normal += cross;
+			area += triangleArea;
+		}
+		meshCentroid += centroid;
+		meshArea += area;
+		clusterCentroids[c] = (area > 0.0f) ? centroid / area : centroid;
+		float normalLength = glm::length(normal);
+		clusterNormals[c] = (normalLength > 0.0f) ? normal / normalLength : normal;
+	}
+	if (meshArea > 0.0f)
+		meshCentroid /= meshArea;
+
+	//clusters facing away from the center the most are the most likely to be in front, draw those first
+	vector<float> sortKeys(clusterCount);
+	vector<size_t> order(clusterCount);
+	for (size_t c = 0; c < clusterCount; ++c) {
+		sortKeys[c] = glm::dot(clusterCentroids[c] - meshCentroid, clusterNormals[c]);
+		order[c] = c;
+	}
+	stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return sortKeys[a] > sortKeys[b]; });
+
+	vector<uint32_t> output;
+	output.reserve(triangleCount * 3);
+	for (size_t i = 0; i < clusterCount; ++i) {
+		size_t c = order[i];
+		output.insert(output.end(), pIndices + clusters[c] * 3, pIndices + clusters[c + 1] * 3);
+	}
+	memcpy(pIndices, &output[0], output.size() * sizeof(uint32_t));
+
+	return clusterCount;
+}
+
+void MeshOptimizer::optimizeVertexFetch(void* pVertices, size_t pVertexCount, size_t pStride, uint32_t* pIndices, size_t pIndexCount)
+{
+	if (pVertexCount == 0)
+		return;
+
+	//number the vertices in the order they are first used
+	const uint32_t unused = 0xffffffffu;
+	vector<uint32_t> remap(pVertexCount, unused);
+	uint32_t next = 0;
+	for (size_t i = 0; i < pIndexCount; ++i) {
+		uint32_t& target = remap[pIndices[i]];
+		if (target == unused)
+			target = next++;
+		pIndices[i] = target;
+	}
+	for (size_t v = 0; v < pVertexCount; ++v) {
+		if (remap[v] == unused)
+			remap[v] = next++;
+	}
+
+	unsigned char* vertices = (unsigned char*)pVertices;
+	vector<unsigned char> reordered(pVertexCount * pStride);
+	for (size_t v = 0; v < pVertexCount; ++v)
+		memcpy(&reordered[remap[v] * pStride], vertices + v * pStride, pStride);
+	memcpy(vertices, &reordered[0], reordered.size());
+}
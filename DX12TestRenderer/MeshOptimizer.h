@@ -0,0 +1,41 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * Reorders the triangles and vertices of an indexed triangle list so the gpu does less work:
+ * - optimizeVertexCache reorders triangles for post transform vertex cache reuse (Tipsify, Sander et al. 2007)
+ * - optimizeOverdraw splits that order in clusters and puts outward facing clusters first, so near
+ *   geometry tends to be drawn before what it occludes, without giving up much of the cache reuse
+ * - optimizeVertexFetch renumbers the vertices in the order the index buffer uses them, so vertex fetch reads memory linearly
+ * analyzeVertexCache simulates a fifo vertex cache on the cpu to measure the result without a gpu.
+ */
+class MeshOptimizer
+{
+public:
+	struct VertexCacheStats {
+		unsigned triangles;
+		unsigned vertices;	//referenced vertices
+		unsigned misses;	//vertex shader invocations
+		float acmr;			//average cache miss ratio: misses per triangle (0.5 is the best possible on big meshes, 3 the worst)
+		float atvr;			//average transformed vertex ratio: misses per referenced vertex (1 is perfect)
+	};
+
+	//default cache size used for optimizing and measuring, close to the effective size of current hardware
+	static const unsigned defaultCacheSize = 16;
+
+	static VertexCacheStats analyzeVertexCache(const uint32_t* pIndices, size_t pIndexCount, size_t pVertexCount, unsigned pCacheSize = defaultCacheSize);
+
+	static void optimizeVertexCache(uint32_t* pIndices, size_t pIndexCount, size_t pVertexCount, unsigned pCacheSize = defaultCacheSize);
+
+	//pPositions points to the first float3 position, pStride is the number of bytes between positions.
+	//pThreshold is how much worse (1.05 = 5%) the cache miss ratio of a cluster may get to allow smaller clusters.
+	//returns the number of clusters
+	static size_t optimizeOverdraw(uint32_t* pIndices, size_t pIndexCount, const void* pPositions, size_t pStride, size_t pVertexCount, float pThreshold = 1.05f, unsigned pCacheSize = defaultCacheSize);
+
+	//reorders pVertices (pVertexCount vertices of pStride bytes) and rewrites pIndices to match.
+	//unreferenced vertices are moved to the end.
+	static void optimizeVertexFetch(void* pVertices, size_t pVertexCount, size_t pStride, uint32_t* pIndices, size_t pIndexCount);
+};
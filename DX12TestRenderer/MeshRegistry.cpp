@@ -0,0 +1,201 @@
+#include "MeshRegistry.h"
+#include <chrono>
+#include <cctype>
+#include <iostream>
+#include <algorithm>
+
+using namespace std;
+
+MeshRegistry::MeshRegistry(ID3D12Device* pDevice, ID3D12GraphicsCommandList* pCommandList)
+	: _device(pDevice), _commandList(pCommandList), _loads(0), _pathHits(0), _contentHits(0), _loadSeconds(0), _savedSeconds(0)
+{
+}
+
+MeshRegistry::~MeshRegistry()
+{
+	for (auto i = _byMesh.begin(); i != _byMesh.end(); ++i) {
+		delete i->second->mesh;
+		delete i->second;
+	}
+}
+
+Mesh* MeshRegistry::acquire(const string& pFileName)
+{
+	Mesh* loaded = acquireLoaded(pFileName);
+	if (loaded != NULL)
+		return loaded;
+
+	//loaded without its buffers like on an AssetLoader thread, a duplicate is deleted by adopt before anything is recorded
+	//on the command list for it
+	auto loadStart = chrono::high_resolution_clock::now();
+	Mesh* mesh = Mesh::load(pFileName, _device, _commandList, false);
+	double seconds = chrono::duration<double>(chrono::high_resolution_clock::now() - loadStart).count();
+	if (mesh == NULL)
+		return NULL;
+
+	Mesh* shared = adopt(pFileName, mesh, seconds);
+	if (shared == mesh)
+		mesh->Upload(_device, _commandList);
+	return shared;
+}
+
+Mesh* MeshRegistry::acquireLoaded(const string& pFileName)
+{
+	auto found = _byPath.find(normalizePath(pFileName));
+	if (found == _byPath.end())
+		return NULL;
+
+	Entry* entry = found->second;
+	entry->references++;
+	_pathHits++;
+	_savedSeconds += entry->loadSeconds;
+	return entry->mesh;
+}
+
+Mesh* MeshRegistry::adopt(const string& pFileName, Mesh* pMesh, double pLoadSeconds)
+{
+	string path = normalizePath(pFileName);
+	_loads++;
+	_loadSeconds += pLoadSeconds;
+
+	//the same path was loaded in the meantime (two loads in flight), keep the mesh we already have
+	auto samePath = _byPath.find(path);
+	if (samePath != _byPath.end()) {
+		Entry* entry = samePath->second;
+		delete pMesh;
+		entry->references++;
+		return entry->mesh;
+	}
+
+	//a different path with the same content, keep the mesh we already have
+	auto sameContent = _byContent.find(pMesh->getContentHash());
+	if (sameContent != _byContent.end()) {
+		Entry* entry = sameContent->second;
+		delete pMesh;
+		_contentHits++;
+		entry->references++;
+		entry->paths.push_back(path);
+		_byPath[path] = entry;
+		return entry->mesh;
+	}
+
+	Entry* entry = new Entry();
+	entry->mesh = pMesh;
+	entry->references = 1;
+	entry->loadSeconds = pLoadSeconds;
+	entry->paths.push_back(path);
+
+	_byPath[path] = entry;
+	_byContent[pMesh->getContentHash()] = entry;
+	_byMesh[pMesh] = entry;
+	_pendingUploads.push_back(pMesh);
+	return pMesh;
+}
+
+void MeshRegistry::release(Mesh* pMesh)
+{
+	if (pMesh == NULL)
+		return;
+
+	auto found = _byMesh.find(pMesh);
+	if (found == _byMesh.end()) {
+		cout << "Releasing a mesh that is not in the registry" << endl;
+		return;
+	}
+
+	Entry* entry = found->second;
+	if (--entry->references > 0)
+		return;
+
+	for (size_t i = 0; i < entry->paths.size(); ++i)
+		_byPath.erase(entry->paths[i]);
+	_byContent.erase(pMesh->getContentHash());
+	_byMesh.erase(found);
+	_pendingUploads.erase(remove(_pendingUploads.begin(), _pendingUploads.end(), pMesh), _pendingUploads.end());
+
+	delete entry->mesh;
+	delete entry;
+}
+
+void MeshRegistry::setUploadFence(ID3D12Fence* pFence, UINT64 pFenceValue)
+{
+	for (size_t i = 0; i < _pendingUploads.size(); ++i)
+		_pendingUploads[i]->SetUploadFence(pFence, pFenceValue);
+}
+
+unsigned MeshRegistry::releaseUploadData()
+{
+	unsigned released = 0;
+	for (size_t i = 0; i < _pendingUploads.size();) {
+		if (_pendingUploads[i]->ReleaseUploadData()) {
+			_pendingUploads[i] = _pendingUploads.back();
+			_pendingUploads.pop_back();
+			released++;
+		}
+		else {
+			++i;
+		}
+	}
+	return released;
+}
+
+MeshRegistry::Stats MeshRegistry::getStats() const
+{
+	Stats stats = {};
+	stats.loads = _loads;
+	stats.pathHits = _pathHits;
+	stats.contentHits = _contentHits;
+	stats.loadSeconds = _loadSeconds;
+	stats.savedSeconds = _savedSeconds;
+
+	for (auto i = _byMesh.begin(); i != _byMesh.end(); ++i) {
+		const Entry* entry = i->second;
+		size_t bytes = entry->mesh->getGpuBytes();
+		stats.meshes++;
+		stats.references += entry->references;
+		stats.gpuBytes += bytes;
+		stats.savedGpuBytes += bytes * (entry->references - 1);
+		stats.cpuBytes += entry->mesh->getCpuBytes();
+	}
+	stats.pendingUploads = (unsigned)_pendingUploads.size();
+	return stats;
+}
+
+string MeshRegistry::normalizePath(const string& pFileName)
+{
+	//windows paths are case insensitive and accept both slashes
+	string path = pFileName;
+	for (size_t i = 0; i < path.size(); ++i) {
+		if (path[i] == '\\')
+			path[i] = '/';
+		else
+			path[i] = (char)tolower((unsigned char)path[i]);
+	}
+
+	//split in segments and drop the . and resolvable .. ones
+	bool absolute = !path.empty() && path[0] == '/';
+	vector<string> segments;
+	size_t start = 0;
+	while (start <= path.size()) {
+		size_t end = path.find('/', start);
+		if (end == string::npos)
+			end = path.size();
+		string segment = path.substr(start, end - start);
+		start = end + 1;
+
+		if (segment.empty() || segment == ".")
+			continue;
+		if (segment == ".." && !segments.empty() && segments.back() != "..")
+			segments.pop_back();
+		else
+			segments.push_back(segment);
+	}
+
+	string normalized = absolute ? "/" : "";
+	for (size_t i = 0; i < segments.size(); ++i) {
+		if (i > 0)
+			normalized += '/';
+		normalized += segments[i];
+	}
+	return normalized;
+}
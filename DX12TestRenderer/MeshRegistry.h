@@ -0,0 +1,85 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "Mesh.h"
+
+/**
+ * Shares meshes between everything that uses them.
+ * A mesh is looked up by its normalized path first, so a path that was loaded before is never
+ * parsed or uploaded again. A new path whose content turns out to be identical to an already
+ * loaded mesh (same content hash) gets the existing mesh as well, and its own copy is dropped.
+ *
+ * Every acquire has to be matched by a release. When the last reference is released the mesh
+ * and its gpu buffers are deleted, so only release once the gpu is done with the mesh.
+ */
+class MeshRegistry
+{
+public:
+	struct Stats {
+		unsigned meshes;		//unique meshes currently loaded
+		unsigned references;	//handles currently handed out
+		unsigned loads;			//meshes actually loaded from disk
+		unsigned pathHits;		//acquires served without loading
+		unsigned contentHits;	//loads that turned out to be a duplicate of a loaded mesh
+		double loadSeconds;		//time spent loading
+		double savedSeconds;	//load time saved by path hits (based on how long the first load took)
+		size_t gpuBytes;		//gpu memory used by the loaded meshes
+		size_t savedGpuBytes;	//gpu memory the extra references would have used without sharing
+		size_t cpuBytes;		//cpu memory held by the loaded meshes, see Mesh::getCpuBytes
+		unsigned pendingUploads;	//meshes that still hold their upload data
+	};
+
+	MeshRegistry(ID3D12Device* pDevice, ID3D12GraphicsCommandList* pCommandList);
+	~MeshRegistry();
+
+	//get a shared mesh, loading and uploading it if needed. returns NULL if the mesh could not be loaded
+	Mesh* acquire(const std::string& pFileName);
+
+	//get a shared mesh if its path was loaded before, without loading it. returns NULL otherwise
+	Mesh* acquireLoaded(const std::string& pFileName);
+
+	//register a mesh that was loaded elsewhere, for example on an AssetLoader thread, under pFileName.
+	//the registry takes ownership and returns the shared mesh, which is a different one if the path or content was already
+	//loaded (pMesh is deleted then). adopt before Mesh::Upload, so a duplicate is never uploaded
+	Mesh* adopt(const std::string& pFileName, Mesh* pMesh, double pLoadSeconds);
+
+	//give back a mesh gotten from acquire, acquireLoaded or adopt
+	void release(Mesh* pMesh);
+
+	//the uploads of all meshes loaded so far are done once pFence reaches pFenceValue, see Mesh::SetUploadFence
+	void setUploadFence(ID3D12Fence* pFence, UINT64 pFenceValue);
+
+	//let every mesh whose upload is done release its upload data (see Mesh::ReleaseUploadData).
+	//cheap enough to call every frame, returns the number of meshes that released it this call
+	unsigned releaseUploadData();
+
+	Stats getStats() const;
+
+	//lower case, forward slashes, no . or .. segments
+	static std::string normalizePath(const std::string& pFileName);
+
+private:
+	struct Entry {
+		Mesh* mesh;
+		unsigned references;
+		double loadSeconds;
+		std::vector<std::string> paths; //all normalized paths that resolve to this mesh
+	};
+
+	ID3D12Device* _device;
+	ID3D12GraphicsCommandList* _commandList;
+
+	std::unordered_map<std::string, Entry*> _byPath;
+	std::unordered_map<uint64_t, Entry*> _byContent;
+	std::unordered_map<Mesh*, Entry*> _byMesh;
+
+	std::vector<Mesh*> _pendingUploads;
+
+	unsigned _loads;
+	unsigned _pathHits;
+	unsigned _contentHits;
+	double _loadSeconds;
+	double _savedSeconds;
+};
@@ -0,0 +1,330 @@
+#include "MeshSimplifier.h"
+#include "glm.h"
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+
+namespace {
+	//the symmetric 4x4 matrix of a sum of squared plane distances, and the total weight (area) of the planes
+	struct Quadric {
+		double a2, b2, c2, ab, ac, bc, ad, bd, cd, d2;
+		double weight;
+	};
+
+	void addPlane(Quadric& pQuadric, const glm::dvec3& pNormal, double pDistance, double pWeight) {
+		double a = pNormal.x, b = pNormal.y, c = pNormal.z, d = pDistance;
+		pQuadric.a2 += a * a * pWeight;
+		pQuadric.b2 += b * b * pWeight;
+		pQuadric.c2 += c * c * pWeight;
+		pQuadric.ab += a * b * pWeight;
+		pQuadric.ac += a * c * pWeight;
+		pQuadric.bc += b * c * pWeight;
+		pQuadric.ad += a * d * pWeight;
+		pQuadric.bd += b * d * pWeight;
+		pQuadric.cd += c * d * pWeight;
+		pQuadric.d2 += d * d * pWeight;
+		pQuadric.weight += pWeight;
+	}
+
+	void addQuadric(Quadric& pQuadric, const Quadric& pOther) {
+		pQuadric.a2 += pOther.a2;
+		pQuadric.b2 += pOther.b2;
+		pQuadric.c2 += pOther.c2;
+		pQuadric.ab += pOther.ab;
+		pQuadric.ac += pOther.ac;
+		pQuadric.bc += pOther.bc;
+		pQuadric.ad += pOther.ad;
+		pQuadric.bd += pOther.bd;
+		pQuadric.cd += pOther.cd;
+		pQuadric.d2 += pOther.d2;
+		pQuadric.weight += pOther.weight;
+	}
+
+	//weighted mean squared distance of pPosition to the planes
+	double evaluate(const Quadric& pQuadric, const glm::vec3& pPosition) {
+		double x = pPosition.x, y = pPosition.y, z = pPosition.z;
+		double error = pQuadric.a2 * x * x + pQuadric.b2 * y * y + pQuadric.c2 * z * z
+			+ 2.0 * (pQuadric.ab * x * y + pQuadric.ac * x * z + pQuadric.bc * y * z)
+			+ 2.0 * (pQuadric.ad * x + pQuadric.bd * y + pQuadric.cd * z) + pQuadric.d2;
+		error = max(error, 0.0);
+		return (pQuadric.weight > 0.0) ? error / pQuadric.weight : error;
+	}
+
+	struct PositionKey {
+		uint32_t bits[3];
+		bool operator==(const PositionKey& pOther) const { return memcmp(bits, pOther.bits, sizeof(bits)) == 0; }
+	};
+
+	struct PositionKeyHash {
+		size_t operator()(const PositionKey& pKey) const {
+			uint64_t hash = pKey.bits[0] * 0x9E3779B97F4A7C15ull;
+			hash = (hash ^ pKey.bits[1]) * 0xC2B2AE3D27D4EB4Full;
+			hash = (hash ^ pKey.bits[2]) * 0x165667B19E3779F9ull;
+			return (size_t)(hash ^ (hash >> 32));
+		}
+	};
+
+	struct Collapse {
+		uint32_t from;
+		uint32_t to;
+		double cost;
+	};
+
+	inline uint64_t edgeKey(uint32_t pFrom, uint32_t pTo) {
+		return ((uint64_t)pFrom << 32) | pTo;
+	}
+
+	//vertex -> triangles: the triangles of vertex v are pList[pOffsets[v]] up to pList[pOffsets[v + 1]]
+	void buildTriangleLists(const vector<uint32_t>& pIndices, size_t pVertexCount, vector<unsigned>& pOffsets, vector<unsigned>& pList) {
+		pOffsets.assign(pVertexCount + 1, 0);
+		for (size_t i = 0; i < pIndices.size(); ++i)
+			pOffsets[pIndices[i] + 1]++;
+		for (size_t v = 0; v < pVertexCount; ++v)
+			pOffsets[v + 1] += pOffsets[v];
+		pList.resize(pIndices.size());
+		vector<unsigned> fill(pOffsets.begin(), pOffsets.end() - 1);
+		for (size_t i = 0; i < pIndices.size(); ++i)
+			pList[fill[pIndices[i]]++] = (unsigned)(i / 3);
+	}
+
+	//distance of pPoint to the triangle pA pB pC, from the closest point on it (Ericson, Real-Time Collision Detection 5.1.5)
+	float triangleDistance(const glm::vec3& pPoint, const glm::vec3& pA, const glm::vec3& pB, const glm::vec3& pC) {
+		glm::vec3 ab = pB - pA, ac = pC - pA, ap = pPoint - pA;
+		float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+		if (d1 <= 0.0f && d2 <= 0.0f)
+			return glm::length(pPoint - pA);
+
+		glm::vec3 bp = pPoint - pB;
+		float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+		if (d3 >= 0.0f && d4 <= d3)
+			return glm::length(pPoint - pB);
+
+		float vc = d1 * d4 - d3 * d2;
+		if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+			return glm::length(pPoint - (pA + ab * (d1 / (d1 - d3))));
+
+		glm::vec3 cp = pPoint - pC;
+		float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+		if (d6 >= 0.0f && d5 <= d6)
+			return glm::length(pPoint - pC);
+
+		float vb = d5 * d2 - d1 * d6;
+		if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+			return glm::length(pPoint - (pA + ac * (d2 / (d2 - d6))));
+
+		float va = d3 * d6 - d5 * d4;
+		if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+			return glm::length(pPoint - (pB + (pC - pB) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)))));
+
+		float denominator = va + vb + vc;
+		if (!(denominator > 0.0f))
+			return glm::length(pPoint - pA);	//degenerate triangle
+		return glm::length(pPoint - (pA + ab * (vb / denominator) + ac * (vc / denominator)));
+	}
+}
+
+size_t MeshSimplifier::simplify(uint32_t* pDestination, const uint32_t* pIndices, size_t pIndexCount, const void* pPositions, size_t pStride, size_t pVertexCount,
+	size_t pTargetIndexCount, float& pError)
+{
+	pError = 0.0f;
+	vector<uint32_t> indices(pIndices, pIndices + pIndexCount - pIndexCount % 3);
+
+	vector<glm::vec3> positions(pVertexCount);
+	const unsigned char* position = (const unsigned char*)pPositions;
+	for (size_t v = 0; v < pVertexCount; ++v, position += pStride)
+		memcpy(&positions[v], position, sizeof(glm::vec3));
+
+	//vertices that share a position with another vertex sit on a uv (or normal) seam, lock them
+	vector<char> locked(pVertexCount, 0);
+	{
+		unordered_map<PositionKey, uint32_t, PositionKeyHash> firstVertex;
+		firstVertex.reserve(pVertexCount);
+		for (size_t v = 0; v < pVertexCount; ++v) {
+			PositionKey key;
+			memcpy(key.bits, &positions[v], sizeof(key.bits));
+			auto inserted = firstVertex.insert(make_pair(key, (uint32_t)v));
+			if (!inserted.second) {
+				locked[v] = 1;
+				locked[inserted.first->second] = 1;
+			}
+		}
+	}
+
+	//an edge without a twin going the other way is on an open border, lock its vertices
+	{
+		unordered_set<uint64_t> edges;
+		edges.reserve(indices.size());
+		for (size_t t = 0; t < indices.size(); t += 3) {
+			for (int e = 0; e < 3; ++e)
+				edges.insert(edgeKey(indices[t + e], indices[t + (e + 1) % 3]));
+		}
+		for (size_t t = 0; t < indices.size(); t += 3) {
+			for (int e = 0; e < 3; ++e) {
+				uint32_t a = indices[t + e], b = indices[t + (e + 1) % 3];
+				if (edges.find(edgeKey(b, a)) == edges.end())
+					locked[a] = locked[b] = 1;
+			}
+		}
+	}
+
+	//the planes of all triangles around a vertex, weighted by triangle area
+	vector<Quadric> quadrics(pVertexCount, Quadric());
+	for (size_t t = 0; t < indices.size(); t += 3) {
+		glm::dvec3 p0 = positions[indices[t]], p1 = positions[indices[t + 1]], p2 = positions[indices[t + 2]];
+		glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+		double length = glm::length(normal);
+		if (!(length > 0.0))
+			continue;
+		normal /= length;
+		double distance = -glm::dot(normal, p0);
+		for (int c = 0; c < 3; ++c)
+			addPlane(quadrics[indices[t + c]], normal, distance, length * 0.5);
+	}
+
+	size_t targetTriangles = pTargetIndexCount / 3;
+	//where every vertex ended up, to measure the error against the input at the end
+	vector<uint32_t> collapsedTo(pVertexCount);
+	for (size_t v = 0; v < pVertexCount; ++v)
+		collapsedTo[v] = (uint32_t)v;
+	vector<unsigned> triangleOffsets, triangleList;
+	vector<Collapse> collapses;
+	vector<uint32_t> bestTarget;
+	vector<double> bestCost;
+	vector<char> touched;
+	vector<uint32_t> remap;
+
+	while (indices.size() / 3 > targetTriangles) {
+		size_t triangleCount = indices.size() / 3;
+
+		buildTriangleLists(indices, pVertexCount, triangleOffsets, triangleList);
+
+		//every edge can collapse either way as long as the vertex that moves is not locked, keep the cheapest per vertex
+		const uint32_t none = 0xffffffffu;
+		bestTarget.assign(pVertexCount, none);
+		bestCost.assign(pVertexCount, 0.0);
+		for (size_t t = 0; t < indices.size(); t += 3) {
+			for (int e = 0; e < 3; ++e) {
+				uint32_t ends[2] = { indices[t + e], indices[t + (e + 1) % 3] };
+				for (int i = 0; i < 2; ++i) {
+					uint32_t from = ends[i], to = ends[1 - i];
+					if (locked[from])
+						continue;
+					double cost = evaluate(quadrics[from], positions[to]);
+					if (bestTarget[from] == none || cost < bestCost[from]) {
+						bestTarget[from] = to;
+						bestCost[from] = cost;
+					}
+				}
+			}
+		}
+
+		collapses.clear();
+		for (size_t v = 0; v < pVertexCount; ++v) {
+			if (bestTarget[v] != none) {
+				Collapse collapse = { (uint32_t)v, bestTarget[v], bestCost[v] };
+				collapses.push_back(collapse);
+			}
+		}
+		if (collapses.empty())
+			break;
+		sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+		//collapse the cheapest edges whose neighbourhoods did not change yet this pass
+		touched.assign(pVertexCount, 0);
+		remap.resize(pVertexCount);
+		for (size_t v = 0; v < pVertexCount; ++v)
+			remap[v] = (uint32_t)v;
+		size_t removedTriangles = 0;
+		size_t collapseCount = 0;
+
+		for (size_t c = 0; c < collapses.size() && triangleCount - removedTriangles > targetTriangles; ++c) {
+			uint32_t from = collapses[c].from, to = collapses[c].to;
+			if (touched[from] || touched[to])
+				continue;
+
+			bool allowed = true;
+			size_t removed = 0;
+			for (unsigned k = triangleOffsets[from]; k < triangleOffsets[from + 1] && allowed; ++k) {
+				const uint32_t* triangle = &indices[triangleList[k] * 3];
+				if (touched[triangle[0]] || touched[triangle[1]] || touched[triangle[2]]) {
+					allowed = false;
+					break;
+				}
+				if (triangle[0] == to || triangle[1] == to || triangle[2] == to) {
+					removed++;
+					continue;
+				}
+
+				//the triangle may not flip when from moves to the position of to
+				glm::vec3 before[3], after[3];
+				for (int i = 0; i < 3; ++i) {
+					before[i] = positions[triangle[i]];
+					after[i] = (triangle[i] == from) ? positions[to] : before[i];
+				}
+				glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+				glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+				if (glm::dot(normalBefore, normalAfter) <= 0.0f)
+					allowed = false;
+			}
+			if (!allowed)
+				continue;
+
+			remap[from] = to;
+			addQuadric(quadrics[to], quadrics[from]);
+			collapsedTo[from] = to;
+			removedTriangles += removed;
+			collapseCount++;
+
+			for (unsigned k = triangleOffsets[from]; k < triangleOffsets[from + 1]; ++k) {
+				const uint32_t* triangle = &indices[triangleList[k] * 3];
+				touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = 1;
+			}
+		}
+		if (collapseCount == 0)
+			break;
+
+		//apply the collapses and drop the triangles that became degenerate
+		size_t write = 0;
+		for (size_t t = 0; t < indices.size(); t += 3) {
+			uint32_t a = remap[indices[t]], b = remap[indices[t + 1]], c = remap[indices[t + 2]];
+			if (a == b || b == c || a == c)
+				continue;
+			indices[write++] = a;
+			indices[write++] = b;
+			indices[write++] = c;
+		}
+		indices.resize(write);
+	}
+
+	//the error is the largest distance of a collapsed vertex to the triangles around the vertex it ended up in. the quadric
+	//cost orders the collapses but is an area weighted mean, it understates what a single vertex moved
+	buildTriangleLists(indices, pVertexCount, triangleOffsets, triangleList);
+	float maxError = 0.0f;
+	for (size_t v = 0; v < pVertexCount; ++v) {
+		uint32_t target = collapsedTo[v];
+		if (target == v)
+			continue;
+		while (collapsedTo[target] != target)
+			target = collapsedTo[target];
+		collapsedTo[v] = target;
+
+		float distance = -1.0f;
+		for (unsigned k = triangleOffsets[target]; k < triangleOffsets[target + 1]; ++k) {
+			const uint32_t* triangle = &indices[triangleList[k] * 3];
+			float triangleError = triangleDistance(positions[v], positions[triangle[0]], positions[triangle[1]], positions[triangle[2]]);
+			if (distance < 0.0f || triangleError < distance)
+				distance = triangleError;
+		}
+		maxError = max(maxError, distance);
+	}
+
+	if (!indices.empty())
+		memcpy(pDestination, &indices[0], indices.size() * sizeof(uint32_t));
+	pError = maxError;
+	return indices.size();
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * Reduces the triangle count of an indexed triangle list by collapsing edges, cheapest first,
+ * where the cost is the quadric error (Garland and Heckbert 1997): the squared distance of the
+ * new position to the planes of the triangles that were merged into the vertex.
+ *
+ * A vertex is only ever collapsed onto one of its neighbours, so no new vertices are made and the
+ * result indexes the same vertex buffer. Vertices on uv seams (several vertices sharing a position)
+ * and on open borders are locked, so seams don't tear and borders don't shrink. Collapses that
+ * would flip a triangle are skipped.
+ */
+class MeshSimplifier
+{
+public:
+	//simplify pIndices to at most pTargetIndexCount indices (if possible without moving locked vertices),
+	//the result is written to pDestination which needs room for pIndexCount indices and may be pIndices.
+	//pPositions points to the first float3 position, pStride is the number of bytes between positions.
+	//pError is set to the geometric error of the result against pIndices: the largest distance, in mesh units, between
+	//a collapsed vertex and the triangles around the vertex it was collapsed onto. returns the number of indices written
+	static size_t simplify(uint32_t* pDestination, const uint32_t* pIndices, size_t pIndexCount, const void* pPositions, size_t pStride, size_t pVertexCount,
+		size_t pTargetIndexCount, float& pError);
+};
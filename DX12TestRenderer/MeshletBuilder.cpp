@@ -0,0 +1,164 @@
+#include "MeshletBuilder.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+
+namespace {
+	inline glm::vec3 loadPosition(const unsigned char* pPositions, size_t pStride, uint32_t pIndex) {
+		glm::vec3 position;
+		memcpy(&position, pPositions + pStride * pIndex, sizeof(position));
+		return position;
+	}
+
+	//bounding sphere and normal cone of the meshlet that was just filled
+	//pNormals is scratch space for the triangle normals
+	void computeBounds(MeshletBuilder::Meshlet& pMeshlet, const MeshletBuilder::MeshletData& pData, const unsigned char* pPositions, size_t pStride, vector<glm::vec3>& pNormals) {
+		const uint32_t* vertices = &pData.vertices[pMeshlet.vertexOffset];
+		const uint8_t* triangles = &pData.triangles[pMeshlet.triangleOffset];
+
+		//sphere around the center of the bounding box
+		glm::vec3 boundsMin = loadPosition(pPositions, pStride, vertices[0]);
+		glm::vec3 boundsMax = boundsMin;
+		for (uint32_t v = 1; v < pMeshlet.vertexCount; ++v) {
+			glm::vec3 position = loadPosition(pPositions, pStride, vertices[v]);
+			boundsMin = glm::min(boundsMin, position);
+			boundsMax = glm::max(boundsMax, position);
+		}
+		pMeshlet.center = (boundsMin + boundsMax) * 0.5f;
+		float radiusSquared = 0.0f;
+		for (uint32_t v = 0; v < pMeshlet.vertexCount; ++v) {
+			glm::vec3 offset = loadPosition(pPositions, pStride, vertices[v]) - pMeshlet.center;
+			radiusSquared = max(radiusSquared, glm::dot(offset, offset));
+		}
+		pMeshlet.radius = sqrtf(radiusSquared);
+
+		//the axis is the average of the unit triangle normals, the cone has to contain all of them
+		pNormals.clear();
+		glm::vec3 axis(0.0f);
+		for (uint32_t t = 0; t < pMeshlet.triangleCount; ++t) {
+			glm::vec3 p0 = loadPosition(pPositions, pStride, vertices[triangles[t * 3]]);
+			glm::vec3 p1 = loadPosition(pPositions, pStride, vertices[triangles[t * 3 + 1]]);
+			glm::vec3 p2 = loadPosition(pPositions, pStride, vertices[triangles[t * 3 + 2]]);
+			glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+			float length = glm::length(normal);
+			if (!(length > 0.0f))
+				continue;	//degenerate triangles are never rasterized
+			normal /= length;
+			pNormals.push_back(normal);
+			axis += normal;
+		}
+
+		pMeshlet.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+		pMeshlet.coneCutoff = 1.0f;
+		float axisLength = glm::length(axis);
+		if (pNormals.empty() || !(axisLength > 0.0f))
+			return;
+		axis /= axisLength;
+
+		float minimumDot = 1.0f;
+		for (size_t i = 0; i < pNormals.size(); ++i)
+			minimumDot = min(minimumDot, glm::dot(axis, pNormals[i]));
+
+		pMeshlet.coneAxis = axis;
+		//normals more than 90 degrees apart can always be seen from somewhere
+		if (minimumDot > 0.0f)
+			pMeshlet.coneCutoff = sqrtf(1.0f - minimumDot * minimumDot);
+	}
+}
+
+void MeshletBuilder::MeshletData::clear()
+{
+	meshlets.clear();
+	vertices.clear();
+	triangles.clear();
+}
+
+void MeshletBuilder::build(const uint32_t* pIndices, size_t pIndexCount, const void* pPositions, size_t pStride, size_t pVertexCount,
+	MeshletData& pData, unsigned pMaxVertices, unsigned pMaxTriangles)
+{
+	pData.clear();
+	size_t triangleCount = pIndexCount / 3;
+	if (triangleCount == 0 || pMaxTriangles == 0 || pMaxVertices < 3)
+		return;
+	pMaxVertices = min(pMaxVertices, 256u);
+
+	const unsigned char* positions = (const unsigned char*)pPositions;
+	pData.meshlets.reserve(triangleCount / pMaxTriangles + 1);
+	pData.triangles.reserve(triangleCount * 3);
+	pData.vertices.reserve(triangleCount);
+
+	//mesh vertex -> local vertex in the meshlet being filled
+	const uint32_t unused = 0xffffffffu;
+	vector<uint32_t> localVertex(pVertexCount, unused);
+	vector<glm::vec3> normals;
+
+	Meshlet meshlet = {};
+	for (size_t t = 0; t < triangleCount; ++t) {
+		uint32_t a = pIndices[t * 3], b = pIndices[t * 3 + 1], c = pIndices[t * 3 + 2];
+
+		unsigned newVertices = (localVertex[a] == unused) + (localVertex[b] == unused && b != a) + (localVertex[c] == unused && c != a && c != b);
+		if (meshlet.vertexCount + newVertices > pMaxVertices || meshlet.triangleCount + 1 > pMaxTriangles) {
+			computeBounds(meshlet, pData, positions, pStride, normals);
+			pData.meshlets.push_back(meshlet);
+			for (uint32_t v = 0; v < meshlet.vertexCount; ++v)
+				localVertex[pData.vertices[meshlet.vertexOffset + v]] = unused;
+
+			meshlet = Meshlet();
+			meshlet.vertexOffset = (uint32_t)pData.vertices.size();
+			meshlet.triangleOffset = (uint32_t)pData.triangles.size();
+		}
+
+		uint32_t corners[3] = { a, b, c };
+		for (int i = 0; i < 3; ++i) {
+			uint32_t& local = localVertex[corners[i]];
+			if (local == unused) {
+				local = meshlet.vertexCount++;
+				pData.vertices.push_back(corners[i]);
+			}
+			pData.triangles.push_back((uint8_t)local);
+		}
+		meshlet.triangleCount++;
+	}
+
+	computeBounds(meshlet, pData, positions, pStride, normals);
+	pData.meshlets.push_back(meshlet);
+}
+
+void MeshletBuilder::extractFrustumPlanes(const glm::mat4& pViewProjection, glm::vec4 pPlanes[6])
+{
+	//rows of the matrix, glm stores columns
+	glm::vec4 rows[4];
+	for (int r = 0; r < 4; ++r)
+		rows[r] = glm::vec4(pViewProjection[0][r], pViewProjection[1][r], pViewProjection[2][r], pViewProjection[3][r]);
+
+	pPlanes[0] = rows[3] + rows[0];	//left
+	pPlanes[1] = rows[3] - rows[0];	//right
+	pPlanes[2] = rows[3] + rows[1];	//bottom
+	pPlanes[3] = rows[3] - rows[1];	//top
+	pPlanes[4] = rows[2];			//near, depth goes from 0 to 1
+	pPlanes[5] = rows[3] - rows[2];	//far
+
+	for (int p = 0; p < 6; ++p) {
+		float length = glm::length(glm::vec3(pPlanes[p]));
+		if (length > 0.0f)
+			pPlanes[p] /= length;
+	}
+}
+
+bool MeshletBuilder::isOutsideFrustum(const Meshlet& pMeshlet, const glm::vec4 pPlanes[6])
+{
+	for (int p = 0; p < 6; ++p) {
+		if (glm::dot(glm::vec3(pPlanes[p]), pMeshlet.center) + pPlanes[p].w < -pMeshlet.radius)
+			return true;
+	}
+	return false;
+}
+
+bool MeshletBuilder::isBackfacing(const Meshlet& pMeshlet, const glm::vec3& pCameraPosition)
+{
+	//the view direction to every point of the sphere has to be within 90 degrees of every normal in the cone
+	glm::vec3 toCenter = pMeshlet.center - pCameraPosition;
+	return glm::dot(toCenter, pMeshlet.coneAxis) >= pMeshlet.coneCutoff * glm::length(toCenter) + pMeshlet.radius;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "glm.h"
+
+/**
+ * Splits an indexed triangle list into meshlets: small clusters of at most maxVertices vertices and
+ * maxTriangles triangles that can be culled as a whole.
+ * Triangles are added in index buffer order, a new meshlet is started when the next triangle does not fit.
+ * Run it on a vertex cache optimized index buffer (see MeshOptimizer), those triangles are already
+ * local so the meshlets come out compact.
+ *
+ * Every meshlet gets a bounding sphere for frustum culling and a cone around the normals of its
+ * triangles for backface culling. The normal of a triangle is cross(p1 - p0, p2 - p0).
+ * Everything here is cpu only and device independent.
+ */
+class MeshletBuilder
+{
+public:
+	struct Meshlet {
+		uint32_t vertexOffset;		//first entry in MeshletData::vertices
+		uint32_t triangleOffset;	//first entry in MeshletData::triangles (3 per triangle)
+		uint32_t vertexCount;
+		uint32_t triangleCount;
+
+		glm::vec3 center;			//bounding sphere
+		float radius;
+
+		glm::vec3 coneAxis;			//average normal direction
+		float coneCutoff;			//sine of the cone half angle, 1 if the normals are too spread out to ever cull
+	};
+
+	struct MeshletData {
+		std::vector<Meshlet> meshlets;
+		std::vector<uint32_t> vertices;		//meshlet local vertex -> mesh vertex
+		std::vector<uint8_t> triangles;		//3 meshlet local vertices per triangle
+
+		void clear();
+	};
+
+	//the limits of mesh shader friendly meshlets (124 triangles keeps the primitive data within 128 * 3 bytes)
+	static const unsigned defaultMaxVertices = 64;
+	static const unsigned defaultMaxTriangles = 124;
+
+	//pPositions points to the first float3 position, pStride is the number of bytes between positions.
+	//pMaxVertices can be at most 256
+	static void build(const uint32_t* pIndices, size_t pIndexCount, const void* pPositions, size_t pStride, size_t pVertexCount,
+		MeshletData& pData, unsigned pMaxVertices = defaultMaxVertices, unsigned pMaxTriangles = defaultMaxTriangles);
+
+	//the 6 planes (left, right, bottom, top, near, far) of a view projection matrix with 0..1 depth,
+	//normals point inward and are normalized so plane distances are in world units
+	static void extractFrustumPlanes(const glm::mat4& pViewProjection, glm::vec4 pPlanes[6]);
+
+	//true if the bounding sphere is completely outside one of the planes
+	static bool isOutsideFrustum(const Meshlet& pMeshlet, const glm::vec4 pPlanes[6]);
+
+	//true if every triangle in the meshlet faces away from the camera, so none of them can be visible
+	static bool isBackfacing(const Meshlet& pMeshlet, const glm::vec3& pCameraPosition);
+};
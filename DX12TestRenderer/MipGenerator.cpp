@@ -0,0 +1,280 @@
+#include "MipGenerator.h"
+#include <algorithm>
+#include <cmath>
+#include "ParallelFor.h"
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MIP_SSE2
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+namespace {
+	const double pi = 3.14159265358979323846;
+	const float kaiserWidth = 3.0f;	//in texels of the smaller level
+	const float kaiserAlpha = 4.0f;
+
+	//levels below this many pixels are filtered on the calling thread only, starting threads costs more than it saves
+	const size_t parallelPixels = 64 * 1024;
+
+	float srgbToLinear(float pValue) {
+		return (pValue <= 0.04045f) ? pValue / 12.92f : powf((pValue + 0.055f) / 1.055f, 2.4f);
+	}
+
+	float linearToSrgb(float pValue) {
+		return (pValue <= 0.0031308f) ? pValue * 12.92f : 1.055f * powf(pValue, 1.0f / 2.4f) - 0.055f;
+	}
+
+	//8 bit srgb to linear, and linear quantized to 16 bits back to 8 bit srgb. 1/65535 steps are well below
+	//half an 8 bit step everywhere on the srgb curve, so the table gives the same result as the exact conversion
+	struct SrgbTables {
+		float toLinear[256];
+		float unorm[256];
+		uint8_t fromLinear[65536];
+
+		SrgbTables() {
+			for (int i = 0; i < 256; ++i) {
+				toLinear[i] = srgbToLinear(i / 255.0f);
+				unorm[i] = i / 255.0f;
+			}
+			for (int i = 0; i < 65536; ++i)
+				fromLinear[i] = (uint8_t)(linearToSrgb(i / 65535.0f) * 255.0f + 0.5f);
+		}
+	};
+
+	const SrgbTables& srgbTables() {
+		static const SrgbTables tables;
+		return tables;
+	}
+
+	//the taps of one output texel along one axis
+	struct Taps {
+		vector<uint32_t> first;		//first input texel per output texel
+		vector<uint32_t> count;
+		vector<size_t> offset;		//into weights
+		vector<float> weights;
+	};
+
+	double besselI0(double pX) {
+		//power series, converges quickly for the small arguments of the kaiser window
+		double sum = 1.0;
+		double term = 1.0;
+		for (int k = 1; k < 32; ++k) {
+			term *= (pX / (2.0 * k)) * (pX / (2.0 * k));
+			sum += term;
+		}
+		return sum;
+	}
+
+	double kaiser(double pT) {
+		if (fabs(pT) >= kaiserWidth)
+			return 0.0;
+		double sinc = (pT == 0.0) ? 1.0 : sin(pi * pT) / (pi * pT);
+		double x = pT / kaiserWidth;
+		return sinc * besselI0(kaiserAlpha * sqrt(1.0 - x * x)) / besselI0(kaiserAlpha);
+	}
+
+	Taps buildTaps(uint32_t pInputSize, uint32_t pOutputSize, MipGenerator::Filter pFilter) {
+		Taps taps;
+		double scale = (double)pInputSize / pOutputSize;
+		vector<double> weights;
+		for (uint32_t x = 0; x < pOutputSize; ++x) {
+			//the output texel covers [x, x + 1) * scale of the input
+			double low = x * scale;
+			double high = (x + 1) * scale;
+			int firstTap, lastTap;
+			if (pFilter == MipGenerator::FilterBox) {
+				firstTap = (int)floor(low);
+				lastTap = (int)ceil(high) - 1;
+			}
+			else {
+				double center = (low + high) * 0.5;
+				firstTap = (int)floor(center - kaiserWidth * scale);
+				lastTap = (int)ceil(center + kaiserWidth * scale);
+			}
+
+			//taps outside the image repeat the edge texel
+			int first = max(0, firstTap);
+			int last = min((int)pInputSize - 1, lastTap);
+			weights.assign(last - first + 1, 0.0);
+			for (int i = firstTap; i <= lastTap; ++i) {
+				double weight;
+				if (pFilter == MipGenerator::FilterBox)
+					weight = max(0.0, min((double)i + 1.0, high) - max((double)i, low));
+				else
+					weight = kaiser((i + 0.5 - (low + high) * 0.5) / scale);
+				weights[min(max(i, first), last) - first] += weight;
+			}
+
+			double sum = 0.0;
+			for (size_t i = 0; i < weights.size(); ++i)
+				sum += weights[i];
+			taps.first.push_back(first);
+			taps.count.push_back((uint32_t)weights.size());
+			taps.offset.push_back(taps.weights.size());
+			for (size_t i = 0; i < weights.size(); ++i)
+				taps.weights.push_back((float)(weights[i] / sum));
+		}
+		return taps;
+	}
+
+	//pixel pTarget = sum of pWeights[k] * pixel pSources[k * pStride]
+	inline void filterPixel(float* pTarget, const float* pSource, size_t pStride, const float* pWeights, uint32_t pCount) {
+#ifdef MIP_SSE2
+		__m128 sum = _mm_setzero_ps();
+		for (uint32_t k = 0; k < pCount; ++k)
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(pSource + k * pStride), _mm_set1_ps(pWeights[k])));
+		_mm_storeu_ps(pTarget, sum);
+#else
+		float sum[4] = {};
+		for (uint32_t k = 0; k < pCount; ++k) {
+			for (int c = 0; c < 4; ++c)
+				sum[c] += pSource[k * pStride + c] * pWeights[k];
+		}
+		for (int c = 0; c < 4; ++c)
+			pTarget[c] = sum[c];
+#endif
+	}
+
+	//row pTarget = sum of pWeights[k] * row k of pSource, rows are pFloats floats long (a multiple of 4). walking whole
+	//rows reads the input sequentially instead of striding down a column per pixel
+	void filterRows(float* pTarget, const float* pSource, size_t pFloats, const float* pWeights, uint32_t pCount) {
+		for (uint32_t k = 0; k < pCount; ++k) {
+			const float* row = pSource + k * pFloats;
+#ifdef MIP_SSE2
+			__m128 weight = _mm_set1_ps(pWeights[k]);
+			for (size_t i = 0; i < pFloats; i += 4) {
+				__m128 product = _mm_mul_ps(_mm_loadu_ps(row + i), weight);
+				_mm_storeu_ps(pTarget + i, (k == 0) ? product : _mm_add_ps(_mm_loadu_ps(pTarget + i), product));
+			}
+#else
+			for (size_t i = 0; i < pFloats; ++i)
+				pTarget[i] = (k == 0) ? row[i] * pWeights[k] : pTarget[i] + row[i] * pWeights[k];
+#endif
+		}
+	}
+
+	//a row of 8 bit pixels to linear float
+	void decodeRow(const uint8_t* pSource, float* pTarget, uint32_t pWidth, bool pSrgb) {
+		const SrgbTables& tables = srgbTables();
+		const float* colorTable = pSrgb ? tables.toLinear : tables.unorm;
+		for (uint32_t x = 0; x < pWidth; ++x, pSource += 4, pTarget += 4) {
+			pTarget[0] = colorTable[pSource[0]];
+			pTarget[1] = colorTable[pSource[1]];
+			pTarget[2] = colorTable[pSource[2]];
+			pTarget[3] = tables.unorm[pSource[3]];
+		}
+	}
+
+	//a row of float pixels to 8 bit, clamped since the kaiser lobes overshoot
+	void encodeRow(const float* pSource, uint8_t* pTarget, uint32_t pWidth, bool pSrgb) {
+		const SrgbTables& tables = srgbTables();
+		for (uint32_t x = 0; x < pWidth; ++x) {
+			const float* pixel = pSource + x * 4;
+			uint8_t* target = pTarget + x * 4;
+#ifdef MIP_SSE2
+			//colors quantized to 16 bits for the srgb table, or straight to 8 bits
+			__m128 clamped = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(pixel), _mm_setzero_ps()), _mm_set1_ps(1.0f));
+			__m128 scale = pSrgb ? _mm_setr_ps(65535.0f, 65535.0f, 65535.0f, 255.0f) : _mm_set1_ps(255.0f);
+			__m128i quantized = _mm_cvtps_epi32(_mm_mul_ps(clamped, scale));
+			int values[4];
+			_mm_storeu_si128((__m128i*)values, quantized);
+#else
+			int values[4];
+			for (int c = 0; c < 4; ++c) {
+				float scale = (pSrgb && c < 3) ? 65535.0f : 255.0f;
+				values[c] = (int)(min(max(pixel[c], 0.0f), 1.0f) * scale + 0.5f);
+			}
+#endif
+			for (int c = 0; c < 3; ++c)
+				target[c] = pSrgb ? tables.fromLinear[values[c]] : (uint8_t)values[c];
+			target[3] = (uint8_t)values[3];
+		}
+	}
+}
+
+uint32_t MipGenerator::levelCount(uint32_t pWidth, uint32_t pHeight)
+{
+	uint32_t levels = 1;
+	uint32_t size = max(pWidth, pHeight);
+	while (size > 1) {
+		size >>= 1;
+		levels++;
+	}
+	return levels;
+}
+
+vector<MipGenerator::Level> MipGenerator::levels(uint32_t pWidth, uint32_t pHeight, uint32_t pLevelCount)
+{
+	vector<Level> levels(pLevelCount);
+	size_t offset = 0;
+	for (uint32_t i = 0; i < pLevelCount; ++i) {
+		levels[i].width = max(1u, pWidth >> i);
+		levels[i].height = max(1u, pHeight >> i);
+		levels[i].offset = offset;
+		offset += (size_t)levels[i].width * levels[i].height * 4;
+	}
+	return levels;
+}
+
+uint32_t MipGenerator::generate(vector<uint8_t>& pPixels, uint32_t pWidth, uint32_t pHeight, const Settings& pSettings)
+{
+	uint32_t levelTotal = levelCount(pWidth, pHeight);
+	vector<Level> chain = levels(pWidth, pHeight, levelTotal);
+	const Level& lastLevel = chain.back();
+	pPixels.resize(lastLevel.offset + (size_t)lastLevel.width * lastLevel.height * 4);
+	if (levelTotal == 1)
+		return 1;
+
+	unsigned threads = parallelThreadCount(pSettings.threads);
+	bool srgb = pSettings.srgb;
+
+	//level 0 is decoded to float a row at a time in the first horizontal pass, the later levels read the float level above
+	vector<float> source;
+	vector<float> horizontal;
+	vector<float> target;
+	for (uint32_t level = 1; level < levelTotal; ++level) {
+		uint32_t inputWidth = chain[level - 1].width;
+		uint32_t inputHeight = chain[level - 1].height;
+		uint32_t width = chain[level].width;
+		uint32_t height = chain[level].height;
+		unsigned levelThreads = ((size_t)inputWidth * inputHeight >= parallelPixels) ? threads : 1;
+
+		Taps columns = buildTaps(inputWidth, width, pSettings.filter);
+		Taps rows = buildTaps(inputHeight, height, pSettings.filter);
+
+		//horizontal pass over every input row
+		horizontal.resize((size_t)width * inputHeight * 4);
+		parallelFor(inputHeight, levelThreads, [&](size_t pBegin, size_t pEnd) {
+			vector<float> decoded((level == 1) ? (size_t)inputWidth * 4 : 0);
+			for (size_t y = pBegin; y < pEnd; ++y) {
+				const float* input;
+				if (level == 1) {
+					decodeRow(&pPixels[y * inputWidth * 4], &decoded[0], inputWidth, srgb);
+					input = &decoded[0];
+				}
+				else
+					input = &source[y * inputWidth * 4];
+				float* output = &horizontal[y * width * 4];
+				for (uint32_t x = 0; x < width; ++x)
+					filterPixel(output + x * 4, input + columns.first[x] * 4, 4, &columns.weights[columns.offset[x]], columns.count[x]);
+			}
+		});
+
+		//vertical pass, each finished row is stored as 8 bit right away
+		target.resize((size_t)width * height * 4);
+		uint8_t* levelPixels = &pPixels[chain[level].offset];
+		parallelFor(height, levelThreads, [&](size_t pBegin, size_t pEnd) {
+			for (size_t y = pBegin; y < pEnd; ++y) {
+				const float* input = &horizontal[(size_t)rows.first[y] * width * 4];
+				float* output = &target[y * width * 4];
+				filterRows(output, input, (size_t)width * 4, &rows.weights[rows.offset[y]], rows.count[y]);
+				encodeRow(output, levelPixels + y * width * 4, width, srgb);
+			}
+		});
+
+		source.swap(target);
+	}
+	return levelTotal;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * Builds the mip chain of an 8 bit, 4 channel image (rgba8 or bgra8, the channel order doesn't matter) on the cpu.
+ * Every level is filtered from the level above it in linear float space: with srgb set the color channels are decoded
+ * from srgb first and encoded again after filtering, so dark and bright texels average like light does. alpha is always linear.
+ * The filter is separable, a horizontal pass and a vertical pass that work on whole float4 pixels (one sse register each)
+ * and are split over threads by rows. Level sizes follow d3d: every level halves, rounding down, until 1x1.
+ */
+class MipGenerator
+{
+public:
+	enum Filter {
+		FilterBox,		//average of the texels a level texel covers, cheap and a little blurry
+		FilterKaiser	//kaiser windowed sinc over 3 texels of the smaller level each side, sharper with less aliasing
+	};
+
+	struct Settings {
+		Filter filter;
+		bool srgb;			//the color channels are srgb encoded
+		unsigned threads;	//0 uses all hardware threads
+	};
+
+	struct Level {
+		uint32_t width;
+		uint32_t height;
+		size_t offset;		//byte offset of the level in the chain, rows are tightly packed (width * 4 bytes)
+	};
+
+	//number of levels down to 1x1
+	static uint32_t levelCount(uint32_t pWidth, uint32_t pHeight);
+
+	//size and offset of every level of a tightly packed chain of 4 byte pixels
+	static std::vector<Level> levels(uint32_t pWidth, uint32_t pHeight, uint32_t pLevelCount);
+
+	//pPixels holds level 0 (tightly packed), the smaller levels are appended to it. returns the number of levels
+	static uint32_t generate(std::vector<uint8_t>& pPixels, uint32_t pWidth, uint32_t pHeight, const Settings& pSettings);
+};
@@ -0,0 +1,332 @@
+#include "ObjParser.h"
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+#include <iostream>
+#include <thread>
+#include <algorithm>
+
+using namespace std;
+
+namespace {
+	//powers of ten that are exactly representable as a double
+	const double exactPowersOfTen[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+		1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	inline bool isBlank(char c) {
+		return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+	}
+
+	inline bool isDigit(char c) {
+		return (unsigned)(c - '0') < 10u;
+	}
+
+	inline bool isAlpha(char c) {
+		return (unsigned)((c | 0x20) - 'a') < 26u;
+	}
+
+	//below this size starting threads costs more than it saves
+	const size_t minimumChunkSize = 1024 * 1024;
+
+	template <class T>
+	void append(std::vector<T>& pTarget, const std::vector<T>& pSource) {
+		pTarget.insert(pTarget.end(), pSource.begin(), pSource.end());
+	}
+
+	inline const char* skipBlanks(const char* p, const char* end) {
+		while (p < end && isBlank(*p)) ++p;
+		return p;
+	}
+}
+
+void ObjData::clear()
+{
+	vertices.clear();
+	uvs.clear();
+	normals.clear();
+	faces.clear();
+}
+
+bool ObjParser::parse(const char* pBegin, const char* pEnd, ObjData& pData)
+{
+	const char* p = pBegin;
+
+	while (p < pEnd) {
+		//find the end of this line, memchr is a lot faster than checking char by char
+		const char* lineEnd = (const char*)memchr(p, '\n', pEnd - p);
+		if (lineEnd == nullptr)
+			lineEnd = pEnd;
+
+		p = skipBlanks(p, lineEnd);
+
+		//the command (v, vt, vn, f) has to be followed by a blank, just like sscanf("%s") would split it
+		if (p < lineEnd && *p == 'v') {
+			if (p + 1 == lineEnd || isBlank(p[1])) {
+				glm::vec3 vertex(0.0f);
+				const char* q = p + 1;
+				for (int i = 0; i < 3 && q != nullptr; ++i)
+					q = parseFloat(q, lineEnd, vertex[i]);
+				pData.vertices.push_back(vertex);
+			}
+			else if (p[1] == 't' && (p + 2 == lineEnd || isBlank(p[2]))) {
+				glm::vec2 uv(0.0f);
+				const char* q = p + 2;
+				for (int i = 0; i < 2 && q != nullptr; ++i)
+					q = parseFloat(q, lineEnd, uv[i]);
+
+				//TODO this is a fix for the convertion from opengl to directX, might be a better solution for this
+				uv.y = 1 - uv.y;
+				pData.uvs.push_back(uv);
+			}
+			else if (p[1] == 'n' && (p + 2 == lineEnd || isBlank(p[2]))) {
+				glm::vec3 normal(0.0f);
+				const char* q = p + 2;
+				for (int i = 0; i < 3 && q != nullptr; ++i)
+					q = parseFloat(q, lineEnd, normal[i]);
+				pData.normals.push_back(normal);
+			}
+		}
+		else if (p < lineEnd && *p == 'f' && (p + 1 == lineEnd || isBlank(p[1]))) {
+			ObjFace face = {};
+			if (!parseFace(p + 1, lineEnd, face)) {
+				//If we read a different amount, something is wrong
+				cout << "Error reading obj, needing v,vn,vt" << endl;
+				return false;
+			}
+			pData.faces.push_back(face);
+		}
+
+		p = (lineEnd < pEnd) ? lineEnd + 1 : pEnd;
+	}
+
+	return true;
+}
+
+bool ObjParser::parseParallel(const char* pBegin, const char* pEnd, ObjData& pData, unsigned pThreadCount)
+{
+	size_t size = pEnd - pBegin;
+	if (pThreadCount == 0)
+		pThreadCount = std::max(1u, std::thread::hardware_concurrency());
+	pThreadCount = (unsigned)std::min<size_t>(pThreadCount, std::max<size_t>(1, size / minimumChunkSize));
+
+	if (pThreadCount <= 1)
+		return parse(pBegin, pEnd, pData);
+
+	//split the range in roughly equal chunks and move every split to the start of the next line,
+	//so no line is ever cut in two. obj face indices are absolute, so chunks can be parsed independently.
+	std::vector<const char*> splits(pThreadCount + 1);
+	splits[0] = pBegin;
+	splits[pThreadCount] = pEnd;
+	for (unsigned i = 1; i < pThreadCount; ++i) {
+		const char* split = std::max(splits[i - 1], pBegin + size / pThreadCount * i);
+		const char* newline = (const char*)memchr(split, '\n', pEnd - split);
+		splits[i] = (newline != nullptr) ? newline + 1 : pEnd;
+	}
+
+	std::vector<ObjData> chunks(pThreadCount);
+	std::vector<char> results(pThreadCount, 0);
+	std::vector<std::thread> workers;
+	workers.reserve(pThreadCount - 1);
+
+	for (unsigned i = 1; i < pThreadCount; ++i) {
+		workers.push_back(std::thread([&, i]() {
+			results[i] = parse(splits[i], splits[i + 1], chunks[i]);
+		}));
+	}
+	//the calling thread takes the first chunk
+	results[0] = parse(splits[0], splits[1], chunks[0]);
+
+	for (size_t i = 0; i < workers.size(); ++i)
+		workers[i].join();
+
+	for (unsigned i = 0; i < pThreadCount; ++i) {
+		if (!results[i])
+			return false;
+	}
+
+	//merge in file order
+	size_t vertexCount = pData.vertices.size(), uvCount = pData.uvs.size(), normalCount = pData.normals.size(), faceCount = pData.faces.size();
+	for (unsigned i = 0; i < pThreadCount; ++i) {
+		vertexCount += chunks[i].vertices.size();
+		uvCount += chunks[i].uvs.size();
+		normalCount += chunks[i].normals.size();
+		faceCount += chunks[i].faces.size();
+	}
+	pData.vertices.reserve(vertexCount);
+	pData.uvs.reserve(uvCount);
+	pData.normals.reserve(normalCount);
+	pData.faces.reserve(faceCount);
+
+	for (unsigned i = 0; i < pThreadCount; ++i) {
+		append(pData.vertices, chunks[i].vertices);
+		append(pData.uvs, chunks[i].uvs);
+		append(pData.normals, chunks[i].normals);
+		append(pData.faces, chunks[i].faces);
+		chunks[i] = ObjData(); //free the chunk right away, big files have big chunks
+	}
+
+	return true;
+}
+
+bool ObjParser::parseFace(const char* pBegin, const char* pEnd, ObjFace& pFace)
+{
+	//an f line looks like
+	//f v1/u1/n1 v2/u2/n2 v3/u3/n3 (v4/u4/n4)
+	//a triplet that is started but not finished is an error, anything after the fourth triplet is ignored
+	const char* p = pBegin;
+	int count = 0;
+	while (count < 4) {
+		const char* q = parseInt(p, pEnd, pFace.v[count]);
+		if (q == nullptr)
+			break;
+		if (q == pEnd || *q != '/')
+			return false;
+		q = parseInt(q + 1, pEnd, pFace.uv[count]);
+		if (q == nullptr || q == pEnd || *q != '/')
+			return false;
+		q = parseInt(q + 1, pEnd, pFace.n[count]);
+		if (q == nullptr)
+			return false;
+		p = q;
+		++count;
+	}
+
+	pFace.count = count;
+	return count >= 3;
+}
+
+const char* ObjParser::parseInt(const char* pBegin, const char* pEnd, int& pValue)
+{
+	const char* p = skipBlanks(pBegin, pEnd);
+	bool negative = false;
+	if (p < pEnd && (*p == '-' || *p == '+')) {
+		negative = *p == '-';
+		++p;
+	}
+	if (p == pEnd || !isDigit(*p))
+		return nullptr;
+
+	int value = 0;
+	while (p < pEnd && isDigit(*p)) {
+		value = value * 10 + (*p - '0');
+		++p;
+	}
+
+	pValue = negative ? -value : value;
+	return p;
+}
+
+const char* ObjParser::parseFloat(const char* pBegin, const char* pEnd, float& pValue)
+{
+	const char* start = skipBlanks(pBegin, pEnd);
+	const char* p = start;
+
+	bool negative = false;
+	if (p < pEnd && (*p == '-' || *p == '+')) {
+		negative = *p == '-';
+		++p;
+	}
+
+	//collect up to 19 significant digits into a 64 bit mantissa and keep track of the decimal exponent
+	uint64_t mantissa = 0;
+	int significantDigits = 0;
+	int exponent = 0;
+	bool anyDigits = false;
+	bool truncated = false;
+
+	while (p < pEnd && isDigit(*p)) {
+		anyDigits = true;
+		if (significantDigits < 19) {
+			mantissa = mantissa * 10 + (*p - '0');
+			if (mantissa != 0) ++significantDigits;
+		}
+		else {
+			truncated = true;
+		}
+		++p;
+	}
+
+	if (p < pEnd && *p == '.') {
+		++p;
+		while (p < pEnd && isDigit(*p)) {
+			anyDigits = true;
+			if (significantDigits < 19) {
+				mantissa = mantissa * 10 + (*p - '0');
+				if (mantissa != 0) ++significantDigits;
+				--exponent;
+			}
+			else {
+				truncated = true;
+			}
+			++p;
+		}
+	}
+
+	if (!anyDigits)
+		return parseFloatFallback(start, pEnd, pValue);
+
+	if (p < pEnd && (*p == 'e' || *p == 'E')) {
+		const char* q = p + 1;
+		bool negativeExponent = false;
+		if (q < pEnd && (*q == '-' || *q == '+')) {
+			negativeExponent = *q == '-';
+			++q;
+		}
+		if (q < pEnd && isDigit(*q)) {
+			int value = 0;
+			while (q < pEnd && isDigit(*q)) {
+				if (value < 10000) value = value * 10 + (*q - '0');
+				++q;
+			}
+			exponent += negativeExponent ? -value : value;
+			p = q;
+		}
+	}
+
+	//things like 0x1p3 or 1.5f, let the crt decide how much of it is a number
+	if (p < pEnd && (isAlpha(*p) || isDigit(*p) || *p == '.'))
+		return parseFloatFallback(start, pEnd, pValue);
+
+	if (mantissa == 0) {
+		pValue = negative ? -0.0f : 0.0f;
+		return p;
+	}
+
+	//fast path: a mantissa of at most 53 bits times an exact power of ten is rounded correctly by a single double operation
+	if (!truncated && mantissa <= (1ull << 53) && exponent >= -22 && exponent <= 22) {
+		double value = (double)mantissa;
+		value = (exponent < 0) ? value / exactPowersOfTen[-exponent] : value * exactPowersOfTen[exponent];
+
+		//rounding the double to float could round differently than rounding the exact decimal would, but only
+		//if the double sits exactly halfway between two floats. those rare cases go through the crt.
+		uint64_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+		if ((bits & 0x1FFFFFFFull) != 0x10000000ull) {
+			pValue = (float)(negative ? -value : value);
+			return p;
+		}
+	}
+
+	return parseFloatFallback(start, pEnd, pValue);
+}
+
+const char* ObjParser::parseFloatFallback(const char* pBegin, const char* pEnd, float& pValue)
+{
+	//copy the token to a zero terminated stack buffer, the mapped file is not zero terminated
+	char buffer[64];
+	size_t length = 0;
+	while (pBegin + length < pEnd && length < sizeof(buffer) - 1 && !isBlank(pBegin[length]) && pBegin[length] != '/' && pBegin[length] != '\n')
+		++length;
+	memcpy(buffer, pBegin, length);
+	buffer[length] = 0;
+
+	char* parsedEnd;
+	float value = strtof(buffer, &parsedEnd);
+	if (parsedEnd == buffer)
+		return nullptr;
+
+	pValue = value;
+	return pBegin + (parsedEnd - buffer);
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include "glm.h"
+
+//a single f line from an .obj file. The indices are 1 based, just like in the file.
+//count is 3 for a triangle and 4 for a quad.
+struct ObjFace
+{
+	int v[4];
+	int uv[4];
+	int n[4];
+	int count;
+};
+
+//the raw data of an .obj file, in the order it was encountered in the file
+struct ObjData
+{
+	std::vector<glm::vec3> vertices;
+	std::vector<glm::vec2> uvs;
+	std::vector<glm::vec3> normals;
+	std::vector<ObjFace> faces;
+
+	void clear();
+};
+
+/**
+ * Tokenizes .obj text in place. It works directly on a (memory mapped) character range,
+ * so there is no getline/std::string per line and no sscanf with its locale lookups.
+ * Only v, vt, vn and f (v/vt/vn triplets) lines are used, everything else is skipped.
+ * See Mesh::load for more information on the format.
+ */
+class ObjParser
+{
+public:
+	//parse all lines in [pBegin, pEnd) and append them to pData.
+	//returns false if a face line does not have 3 or 4 v/vt/vn triplets.
+	static bool parse(const char* pBegin, const char* pEnd, ObjData& pData);
+
+	//same as parse, but splits the range in newline aligned chunks that are parsed on pThreadCount threads.
+	//the chunks are appended in file order, so the result is identical to parse for any thread count.
+	//pThreadCount 0 uses one thread per hardware thread.
+	static bool parseParallel(const char* pBegin, const char* pEnd, ObjData& pData, unsigned pThreadCount = 0);
+
+	//parse a float the way sscanf("%f") would, returns the position after the number or nullptr if there is no number
+	static const char* parseFloat(const char* pBegin, const char* pEnd, float& pValue);
+
+	//parse a (signed) decimal integer, returns the position after the number or nullptr if there is no number
+	static const char* parseInt(const char* pBegin, const char* pEnd, int& pValue);
+
+private:
+	//slow path for numbers the fast path can not round exactly (long mantissas, inf, nan, hex)
+	static const char* parseFloatFallback(const char* pBegin, const char* pEnd, float& pValue);
+
+	static bool parseFace(const char* pBegin, const char* pEnd, ObjFace& pFace);
+};
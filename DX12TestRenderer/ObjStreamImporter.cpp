@@ -0,0 +1,361 @@
+#include "ObjStreamImporter.h"
+#include "ObjParser.h"
+#include "TripletHashMap.h"
+#include "MeshOptimizer.h"
+#include "VertexQuantizer.h"
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN             // Exclude rarely-used stuff from Windows headers.
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "glm.h"
+
+using namespace std;
+
+namespace {
+	//the first pass reads chunks of budget / readChunkDivisor bytes, parsing a chunk takes a few times its size
+	//(faces are 52 bytes in memory for about 20 characters of text) and parsing it in parallel doubles that
+	const size_t readChunkDivisor = 8;
+	const size_t minimumReadChunk = 1024 * 1024;
+
+	//what a face costs in the second pass: the face, its indices, up to 4 new vertices with their triplet map slots
+	//and gathered attributes, and the scratch memory of the optimizers
+	const size_t windowBytesPerFace = 1280;
+	const size_t minimumWindowFaces = 1024;
+
+	//attributes that are at most this many elements apart are read with one read, up to maxGatherRun elements at a time
+	const uint32_t maxGatherGap = 256;
+	const uint32_t maxGatherRun = 64 * 1024;
+
+	bool seekFile(FILE* pFile, uint64_t pOffset) {
+#ifdef _WIN32
+		return _fseeki64(pFile, (long long)pOffset, SEEK_SET) == 0;
+#else
+		return fseeko(pFile, (off_t)pOffset, SEEK_SET) == 0;
+#endif
+	}
+
+	//a temporary file that is written front to back and then read back at any offset, it is removed when closed
+	class SpillFile {
+	public:
+		SpillFile() : _file(nullptr), _size(0) {}
+		~SpillFile() { close(); }
+
+		bool create(const string& pFileName) {
+			close();
+			_fileName = pFileName;
+			_file = fopen(pFileName.c_str(), "w+b");
+			return _file != nullptr;
+		}
+
+		template <class T>
+		bool append(const vector<T>& pValues) {
+			if (pValues.empty())
+				return true;
+			_size += sizeof(T) * pValues.size();
+			return fwrite(&pValues[0], sizeof(T) * pValues.size(), 1, _file) == 1;
+		}
+
+		//every read seeks, which is also what stdio needs between a write and a read
+		bool read(uint64_t pOffset, void* pData, size_t pSize) {
+			return pSize == 0 || (seekFile(_file, pOffset) && fread(pData, pSize, 1, _file) == 1);
+		}
+
+		uint64_t size() const { return _size; }
+
+		void close() {
+			if (_file == nullptr)
+				return;
+			fclose(_file);
+			remove(_fileName.c_str());
+			_file = nullptr;
+			_size = 0;
+		}
+
+	private:
+		SpillFile(const SpillFile&) = delete;
+		SpillFile& operator=(const SpillFile&) = delete;
+
+		string _fileName;
+		FILE* _file;
+		uint64_t _size;
+	};
+
+	template <class T>
+	size_t capacityBytes(const vector<T>& pValues) {
+		return sizeof(T) * pValues.capacity();
+	}
+
+	void sortUnique(vector<uint32_t>& pIds) {
+		sort(pIds.begin(), pIds.end());
+		pIds.erase(unique(pIds.begin(), pIds.end()), pIds.end());
+	}
+
+	//position of pId in the sorted, unique pIds
+	inline size_t lookup(const vector<uint32_t>& pIds, uint32_t pId) {
+		return lower_bound(pIds.begin(), pIds.end(), pId) - pIds.begin();
+	}
+
+	//read the elements with the sorted, unique pIds from pFile into pValues, ids that are close together share a read
+	template <class T>
+	bool gather(SpillFile& pFile, const vector<uint32_t>& pIds, vector<T>& pValues, vector<unsigned char>& pScratch) {
+		pValues.resize(pIds.size());
+		size_t first = 0;
+		while (first < pIds.size()) {
+			size_t last = first;
+			while (last + 1 < pIds.size() && pIds[last + 1] - pIds[last] <= maxGatherGap && pIds[last + 1] - pIds[first] < maxGatherRun)
+				++last;
+
+			pScratch.resize((size_t)(pIds[last] - pIds[first] + 1) * sizeof(T));
+			if (!pFile.read((uint64_t)pIds[first] * sizeof(T), &pScratch[0], pScratch.size()))
+				return false;
+			for (size_t i = first; i <= last; ++i)
+				memcpy(&pValues[i], &pScratch[(size_t)(pIds[i] - pIds[first]) * sizeof(T)], sizeof(T));
+			first = last + 1;
+		}
+		return true;
+	}
+
+	//like XMVector3Normalize, a zero vector stays zero
+	inline glm::vec3 normalizeOrZero(const glm::vec3& pVector) {
+		float length = glm::length(pVector);
+		return (length > 0.0f) ? pVector / length : glm::vec3(0.0f);
+	}
+}
+
+bool ObjStreamImporter::import(const string& pObjFileName, const string& pCookedFileName, const MeshBinary::SourceStamp& pSource, uint32_t pFlags, uint32_t pLodSettings,
+	size_t pMemoryBudget, unsigned pThreadCount, Stats& pStats)
+{
+	auto importStart = chrono::high_resolution_clock::now();
+	pStats = Stats();
+
+	FILE* file = fopen(pObjFileName.c_str(), "rb");
+	if (file == nullptr) {
+		cout << "Could not read " << pObjFileName << endl;
+		return false;
+	}
+
+	SpillFile positionSpill, uvSpill, normalSpill, faceSpill;
+	if (!positionSpill.create(pCookedFileName + ".v.tmp") || !uvSpill.create(pCookedFileName + ".vt.tmp") ||
+		!normalSpill.create(pCookedFileName + ".vn.tmp") || !faceSpill.create(pCookedFileName + ".f.tmp")) {
+		cout << "Could not create spill files for " << pCookedFileName << endl;
+		fclose(file);
+		return false;
+	}
+
+	//first pass: parse the file a chunk at a time and spill everything, the chunks end on a newline
+	//so no line is cut in two. the part after the last newline moves to the front for the next read
+	vector<char> buffer(max(minimumReadChunk, pMemoryBudget / readChunkDivisor));
+	ObjData data;
+	size_t filled = 0;
+	bool endOfFile = false;
+	bool parsed = true;
+	while (parsed && !endOfFile) {
+		filled += fread(&buffer[filled], 1, buffer.size() - filled, file);
+		endOfFile = filled < buffer.size();
+
+		size_t parseSize = filled;
+		if (!endOfFile) {
+			while (parseSize > 0 && buffer[parseSize - 1] != '\n')
+				--parseSize;
+			if (parseSize == 0) {
+				cout << "Error reading obj: a line is longer than the " << buffer.size() << " byte read chunk" << endl;
+				parsed = false;
+				break;
+			}
+		}
+
+		data.clear();
+		parsed = ObjParser::parseParallel(&buffer[0], &buffer[0] + parseSize, data, pThreadCount) &&
+			positionSpill.append(data.vertices) && uvSpill.append(data.uvs) && normalSpill.append(data.normals) && faceSpill.append(data.faces);
+		pStats.bufferPeakBytes = max(pStats.bufferPeakBytes, buffer.size() + capacityBytes(data.vertices) + capacityBytes(data.uvs) + capacityBytes(data.normals) + capacityBytes(data.faces));
+
+		memmove(&buffer[0], &buffer[parseSize], filled - parseSize);
+		filled -= parseSize;
+	}
+	parsed = parsed && !ferror(file);
+	fclose(file);
+	buffer = vector<char>();
+	data = ObjData();
+	if (!parsed)
+		return false;
+
+	uint64_t positionCount = positionSpill.size() / sizeof(glm::vec3);
+	uint64_t uvCount = uvSpill.size() / sizeof(glm::vec2);
+	uint64_t normalCount = normalSpill.size() / sizeof(glm::vec3);
+	pStats.faces = faceSpill.size() / sizeof(ObjFace);
+	pStats.spilledBytes = positionSpill.size() + uvSpill.size() + normalSpill.size() + faceSpill.size();
+	auto spillEnd = chrono::high_resolution_clock::now();
+
+	MeshBinary::Writer writer;
+	if (!writer.open(pCookedFileName, sizeof(VertexQuantizer::FloatVertex))) {
+		cout << "Could not write " << pCookedFileName << endl;
+		return false;
+	}
+
+	//second pass: turn windows of faces into vertices and indices
+	size_t windowFaces = max(minimumWindowFaces, pMemoryBudget / windowBytesPerFace);
+	vector<ObjFace> faces;
+	vector<uint32_t> positionIds, uvIds, normalIds;
+	vector<glm::vec3> positions, normals;
+	vector<glm::vec2> uvs;
+	vector<unsigned char> scratch;
+	TripletHashMap triplets(windowFaces);
+	vector<VertexQuantizer::FloatVertex> vertices;
+	vector<uint32_t> indices;
+
+	//a quad is split into the triangles 0,1,2 and 0,2,3
+	static const int cornerOrder[6] = { 0, 1, 2, 0, 2, 3 };
+
+	for (uint64_t firstFace = 0; firstFace < pStats.faces; firstFace += windowFaces) {
+		size_t faceCount = (size_t)min<uint64_t>(windowFaces, pStats.faces - firstFace);
+		faces.resize(faceCount);
+		if (!faceSpill.read(firstFace * sizeof(ObjFace), &faces[0], sizeof(ObjFace) * faceCount)) {
+			cout << "Could not read the spilled faces of " << pObjFileName << endl;
+			return false;
+		}
+
+		//the attributes this window uses, 0 based
+		positionIds.clear();
+		uvIds.clear();
+		normalIds.clear();
+		for (size_t f = 0; f < faceCount; ++f) {
+			const ObjFace& face = faces[f];
+			for (int i = 0; i < face.count; ++i) {
+				if (face.v[i] < 1 || (uint64_t)face.v[i] > positionCount ||
+					face.uv[i] < 1 || (uint64_t)face.uv[i] > uvCount ||
+					face.n[i] < 1 || (uint64_t)face.n[i] > normalCount) {
+					cout << "Error reading obj: cannot work with negative indices" << endl;
+					return false;
+				}
+				positionIds.push_back((uint32_t)face.v[i] - 1);
+				uvIds.push_back((uint32_t)face.uv[i] - 1);
+				normalIds.push_back((uint32_t)face.n[i] - 1);
+			}
+		}
+		sortUnique(positionIds);
+		sortUnique(uvIds);
+		sortUnique(normalIds);
+		if (!gather(positionSpill, positionIds, positions, scratch) || !gather(uvSpill, uvIds, uvs, scratch) || !gather(normalSpill, normalIds, normals, scratch)) {
+			cout << "Could not read the spilled attributes of " << pObjFileName << endl;
+			return false;
+		}
+
+		//the same vertices and tangents Mesh::_build makes, with triplets shared within the window
+		triplets.clear();
+		vertices.clear();
+		indices.clear();
+		for (size_t f = 0; f < faceCount; ++f) {
+			const ObjFace& face = faces[f];
+			int vertCount = (face.count == 4) ? 6 : 3;
+
+			glm::vec3 p[3];
+			glm::vec2 uv[3];
+			for (int i = 0; i < 3; ++i) {
+				p[i] = positions[lookup(positionIds, (uint32_t)face.v[i] - 1)];
+				uv[i] = uvs[lookup(uvIds, (uint32_t)face.uv[i] - 1)];
+			}
+			glm::vec3 edge1 = p[1] - p[0], edge2 = p[2] - p[0];
+			glm::vec2 deltaUV1 = uv[1] - uv[0], deltaUV2 = uv[2] - uv[0];
+			float r = 1.0f / (deltaUV1.x * deltaUV2.y - deltaUV2.x * deltaUV1.y);
+			glm::vec3 tangent = normalizeOrZero(r * (deltaUV2.y * edge1 - deltaUV1.y * edge2));
+			glm::vec3 bitangent = normalizeOrZero(r * (-deltaUV2.x * edge1 + deltaUV1.x * edge2));
+
+			for (int i = 0; i < vertCount; ++i) {
+				int corner = cornerOrder[i];
+				bool isNew;
+				unsigned index = triplets.findOrInsert(face.v[corner], face.uv[corner], face.n[corner], (unsigned)triplets.size(), isNew);
+				indices.push_back(index);
+
+				if (isNew) {
+					glm::vec3 position = positions[lookup(positionIds, (uint32_t)face.v[corner] - 1)];
+					glm::vec2 texCoord = uvs[lookup(uvIds, (uint32_t)face.uv[corner] - 1)];
+					glm::vec3 normal = normals[lookup(normalIds, (uint32_t)face.n[corner] - 1)];
+					VertexQuantizer::FloatVertex vertex;
+					memcpy(vertex.pos, &position, sizeof(vertex.pos));
+					memcpy(vertex.uv, &texCoord, sizeof(vertex.uv));
+					memcpy(vertex.normal, &normal, sizeof(vertex.normal));
+					memcpy(vertex.tangent, &tangent, sizeof(vertex.tangent));
+					memcpy(vertex.bitangent, &bitangent, sizeof(vertex.bitangent));
+					vertices.push_back(vertex);
+				}
+			}
+		}
+
+		//the same steps Mesh::_optimize takes, on the window
+		if ((pFlags & MeshBinary::FlagVertexCacheOptimized) && !indices.empty()) {
+			MeshOptimizer::optimizeVertexCache(&indices[0], indices.size(), vertices.size());
+			MeshOptimizer::optimizeOverdraw(&indices[0], indices.size(), vertices[0].pos, sizeof(VertexQuantizer::FloatVertex), vertices.size());
+			MeshOptimizer::optimizeVertexFetch(&vertices[0], vertices.size(), sizeof(VertexQuantizer::FloatVertex), &indices[0], indices.size());
+		}
+
+		//the window indices start at the first vertex of the window
+		uint32_t firstVertex = writer.vertexCount();
+		if ((uint64_t)firstVertex + vertices.size() > UINT32_MAX) {
+			cout << "Error reading obj: " << pObjFileName << " has more than " << UINT32_MAX << " vertices" << endl;
+			return false;
+		}
+		for (size_t i = 0; i < indices.size(); ++i)
+			indices[i] += firstVertex;
+		if (!(vertices.empty() || writer.appendVertices(&vertices[0], (uint32_t)vertices.size())) || !(indices.empty() || writer.appendIndices(&indices[0], (uint32_t)indices.size()))) {
+			cout << "Could not write " << pCookedFileName << endl;
+			return false;
+		}
+
+		pStats.windows++;
+		pStats.bufferPeakBytes = max(pStats.bufferPeakBytes, capacityBytes(faces) + capacityBytes(positionIds) + capacityBytes(uvIds) + capacityBytes(normalIds) +
+			capacityBytes(positions) + capacityBytes(uvs) + capacityBytes(normals) + capacityBytes(scratch) + triplets.size() * 4 * sizeof(unsigned) +
+			capacityBytes(vertices) + capacityBytes(indices));
+	}
+
+	pStats.vertices = writer.vertexCount();
+	pStats.indices = writer.indexCount();
+	MeshBinary::Lod lod = { 0, pStats.indices, 0.0f };
+	if (!writer.finish(pSource, pFlags, &lod, 1, pLodSettings)) {
+		cout << "Could not write " << pCookedFileName << endl;
+		return false;
+	}
+
+	pStats.processPeakBytes = peakProcessMemory();
+	auto importEnd = chrono::high_resolution_clock::now();
+	pStats.seconds = chrono::duration<double>(importEnd - importStart).count();
+	double spillSeconds = chrono::duration<double>(spillEnd - importStart).count();
+
+	cout << "Streamed " << pObjFileName << " into " << pCookedFileName << " in " << pStats.seconds * 1000.0 << " ms (spilling " << pStats.spilledBytes / (1024.0 * 1024.0)
+		<< " MB took " << spillSeconds * 1000.0 << " ms): " << pStats.faces << " faces, " << pStats.vertices << " vertices, " << pStats.indices << " indices in " << pStats.windows
+		<< " windows. buffer peak " << pStats.bufferPeakBytes / (1024.0 * 1024.0) << " MB, process peak " << pStats.processPeakBytes / (1024.0 * 1024.0)
+		<< " MB, budget " << pMemoryBudget / (1024.0 * 1024.0) << " MB" << endl;
+	if (pStats.bufferPeakBytes > pMemoryBudget)
+		cout << "Warning: the import buffers of " << pObjFileName << " went over the memory budget" << endl;
+	return true;
+}
+
+size_t ObjStreamImporter::peakProcessMemory()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return 0;
+	return counters.PeakWorkingSetSize;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+	return (size_t)usage.ru_maxrss * 1024;	//kilobytes on linux
+#endif
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include "MeshBinary.h"
+
+/**
+ * Cooks an .obj file straight into a .meshbin within a fixed memory budget, for meshes that are too big to
+ * load with Mesh::load (photogrammetry exports of many GB). The memory used depends on the budget, not on the file size.
+ *
+ * The first pass reads the file in newline aligned chunks and spills the v, vt and vn lines and the faces to
+ * temporary files next to the cooked file. The second pass reads the faces back in windows: the attributes a
+ * window uses are gathered from the spill files, its v/vt/vn triplets become vertices (with the same tangents
+ * as Mesh::load), the window is optimized like Mesh::load optimizes a whole mesh and it is appended to a
+ * MeshBinary::Writer. Triplets are only shared within a window, so the vertices on the seams between windows
+ * are duplicated. Faces in obj exports are local, so with windows of 100k+ faces that is a few percent of the vertices.
+ * Streamed meshes have no simplified lods, a single level covers the whole index buffer.
+ */
+class ObjStreamImporter
+{
+public:
+	struct Stats {
+		uint64_t faces;
+		uint32_t vertices;
+		uint32_t indices;
+		unsigned windows;
+		uint64_t spilledBytes;		//bytes written to the spill files
+		size_t bufferPeakBytes;		//most memory held in the buffers of the importer at once
+		size_t processPeakBytes;	//peak working set of the whole process after the import, 0 if unknown
+		double seconds;
+	};
+
+	//cook pObjFileName into pCookedFileName, sizing the read chunks and face windows so the buffers stay within pMemoryBudget bytes.
+	//pFlags (see MeshBinary::Flags) selects the processing, pSource and pLodSettings are stored in the header.
+	//pThreadCount is the number of parse threads, see ObjParser::parseParallel
+	static bool import(const std::string& pObjFileName, const std::string& pCookedFileName, const MeshBinary::SourceStamp& pSource, uint32_t pFlags, uint32_t pLodSettings,
+		size_t pMemoryBudget, unsigned pThreadCount, Stats& pStats);
+
+	//peak working set (resident memory) of this process in bytes, 0 if it can't be queried
+	static size_t peakProcessMemory();
+};
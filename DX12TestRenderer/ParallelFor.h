@@ -0,0 +1,35 @@
+#pragma once
+
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+
+/**
+ * Runs pFunction(begin, end) over [0, pCount) split in pThreads contiguous ranges, one per thread.
+ * The calling thread takes the first range, so a single thread runs without starting any.
+ * Used by the cpu texture processing (mips, block compression) to split images by rows.
+ */
+template<typename Function>
+void parallelFor(size_t pCount, unsigned pThreads, Function pFunction)
+{
+	unsigned threads = (unsigned)std::min((size_t)pThreads, pCount);
+	if (threads <= 1) {
+		pFunction((size_t)0, pCount);
+		return;
+	}
+	std::vector<std::thread> workers;
+	for (unsigned i = 1; i < threads; ++i)
+		workers.push_back(std::thread(pFunction, pCount * i / threads, pCount * (i + 1) / threads));
+	pFunction((size_t)0, pCount / threads);
+	for (size_t i = 0; i < workers.size(); ++i)
+		workers[i].join();
+}
+
+//the thread count to use for pThreads, 0 means all hardware threads
+inline unsigned parallelThreadCount(unsigned pThreads)
+{
+	if (pThreads != 0)
+		return pThreads;
+	return std::max(1u, std::thread::hardware_concurrency());
+}
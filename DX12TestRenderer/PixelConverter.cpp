@@ -0,0 +1,433 @@
+#include "PixelConverter.h"
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__x86_64__)
+#define PIXEL_SIMD
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+//msvc compiles the intrinsics of any instruction set anywhere, gcc and clang only in functions that target it
+#if defined(PIXEL_SIMD) && defined(__GNUC__)
+#define PIXEL_TARGET(pInstructions) __attribute__((target(pInstructions)))
+#else
+#define PIXEL_TARGET(pInstructions)
+#endif
+
+using namespace std;
+
+namespace {
+	/////////////////////////////////////////////////////////////////////////////////////
+	// scalar
+
+	void expandScalar(const uint8_t* pSource, uint8_t* pTarget, size_t pCount, bool pSwap) {
+		int red = pSwap ? 2 : 0;
+		for (size_t i = 0; i < pCount; ++i) {
+			const uint8_t* source = pSource + i * 3;
+			uint8_t* target = pTarget + i * 4;
+			target[0] = source[red];
+			target[1] = source[1];
+			target[2] = source[2 - red];
+			target[3] = 255;
+		}
+	}
+
+	void swapScalar(const uint8_t* pSource, uint8_t* pTarget, size_t pCount) {
+		for (size_t i = 0; i < pCount; ++i) {
+			//read the whole pixel first, the conversion may be in place
+			uint8_t red = pSource[i * 4];
+			uint8_t blue = pSource[i * 4 + 2];
+			pTarget[i * 4] = blue;
+			pTarget[i * 4 + 1] = pSource[i * 4 + 1];
+			pTarget[i * 4 + 2] = red;
+			pTarget[i * 4 + 3] = pSource[i * 4 + 3];
+		}
+	}
+
+	//the simd kernels do the same float operations in the same order, so every kernel gives the same bytes
+	inline uint8_t unpremultiplyChannel(uint8_t pChannel, float pScale) {
+		float value = pChannel * pScale + 0.5f;
+		return (value >= 255.0f) ? 255 : (uint8_t)value;
+	}
+
+	void unpremultiplyScalar(const uint8_t* pSource, uint8_t* pTarget, size_t pCount, bool pSwap) {
+		int red = pSwap ? 2 : 0;
+		for (size_t i = 0; i < pCount; ++i) {
+			const uint8_t* source = pSource + i * 4;
+			uint8_t* target = pTarget + i * 4;
+			uint8_t pixel[4] = { source[red], source[1], source[2 - red], source[3] };
+			if (pixel[3] == 0) {
+				target[0] = target[1] = target[2] = target[3] = 0;
+				continue;
+			}
+			float scale = 255.0f / pixel[3];
+			target[0] = unpremultiplyChannel(pixel[0], scale);
+			target[1] = unpremultiplyChannel(pixel[1], scale);
+			target[2] = unpremultiplyChannel(pixel[2], scale);
+			target[3] = pixel[3];
+		}
+	}
+
+	//round(sample / 257) of the little endian 16 bit sample at pSample, exact for every value. rows of odd widths
+	//don't keep the samples aligned
+	inline uint8_t narrow16(const uint8_t* pSample) {
+		unsigned sample = pSample[0] | ((unsigned)pSample[1] << 8);
+		return (uint8_t)((sample * 255u + 32895u) >> 16);
+	}
+
+	void narrowScalar(const uint8_t* pSource, uint8_t* pTarget, size_t pSamples) {
+		for (size_t i = 0; i < pSamples; ++i)
+			pTarget[i] = narrow16(pSource + i * 2);
+	}
+
+	void grayScalar(const uint8_t* pSource, uint8_t* pTarget, size_t pCount, bool pWide) {
+		for (size_t i = 0; i < pCount; ++i) {
+			uint8_t gray = pWide ? narrow16(pSource + i * 2) : pSource[i];
+			uint8_t* target = pTarget + i * 4;
+			target[0] = target[1] = target[2] = gray;
+			target[3] = 255;
+		}
+	}
+
+	void convertScalar(PixelConverter::Conversion pConversion, const uint8_t* pSource, uint8_t* pTarget, size_t pCount) {
+		switch (pConversion) {
+		case PixelConverter::ConversionRGBToRGBA: expandScalar(pSource, pTarget, pCount, false); break;
+		case PixelConverter::ConversionBGRToRGBA: expandScalar(pSource, pTarget, pCount, true); break;
+		case PixelConverter::ConversionBGRAToRGBA: swapScalar(pSource, pTarget, pCount); break;
+		case PixelConverter::ConversionPRGBAToRGBA: unpremultiplyScalar(pSource, pTarget, pCount, false); break;
+		case PixelConverter::ConversionPBGRAToRGBA: unpremultiplyScalar(pSource, pTarget, pCount, true); break;
+		case PixelConverter::ConversionRGBA16ToRGBA8: narrowScalar(pSource, pTarget, pCount * 4); break;
+		case PixelConverter::ConversionGray8ToRGBA: grayScalar(pSource, pTarget, pCount, false); break;
+		case PixelConverter::ConversionGray16ToRGBA: grayScalar(pSource, pTarget, pCount, true); break;
+		default: break;
+		}
+	}
+
+#ifdef PIXEL_SIMD
+	/////////////////////////////////////////////////////////////////////////////////////
+	// sse4.1, every kernel returns the number of pixels it converted, the scalar kernel does the rest
+
+	//the bytes of 4 pixels of 3 bytes in the first 12 bytes, spread to 4 bytes each. -1 leaves the alpha byte 0
+	const int8_t expandShuffle[2][16] = {
+		{ 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1 },
+		{ 2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1 }
+	};
+	const int8_t swapShuffle[16] = { 2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15 };
+
+	PIXEL_TARGET("sse4.1") size_t expandSSE4(const uint8_t* pSource, uint8_t* pTarget, size_t pCount, bool pSwap) {
+		const __m128i shuffle = _mm_loadu_si128((const __m128i*)expandShuffle[pSwap ? 1 : 0]);
+		const __m128i alpha = _mm_set1_epi32((int)0xff000000);
+		size_t i = 0;
+		//4 pixels from a 16 byte load, the last 4 bytes belong to the next pixels
+		for (; i * 3 + 16 <= pCount * 3; i += 4) {
+			__m128i pixels = _mm_loadu_si128((const __m128i*)(pSource + i * 3));
+			_mm_storeu_si128((__m128i*)(pTarget + i * 4), _mm_or_si128(_mm_shuffle_epi8(pixels, shuffle), alpha));
+		}
+		return i;
+	}
+
+	PIXEL_TARGET("sse4.1") size_t swapSSE4(const uint8_t* pSource, uint8_t* pTarget, size_t pCount) {
+		const __m128i shuffle = _mm_loadu_si128((const __m128i*)swapShuffle);
+		size_t i = 0;
+		for (; i + 4 <= pCount; i += 4) {
+			__m128i pixels = _mm_loadu_si128((const __m128i*)(pSource + i * 4));
+			_mm_storeu_si128((__m128i*)(pTarget + i * 4), _mm_shuffle_epi8(pixels, shuffle));
+		}
+		return i;
+	}
+
+	//one pixel in the low 4 bytes of pPixel, as 4 32 bit channels
+	PIXEL_TARGET("sse4.1") inline __m128i unpremultiplyPixelSSE4(__m128i pPixel, bool pSwap) {
+		const __m128 full = _mm_set1_ps(255.0f);
+		__m128i channels = _mm_cvtepu8_epi32(pPixel);
+		__m128 values = _mm_cvtepi32_ps(channels);
+		__m128 alpha = _mm_shuffle_ps(values, values, _MM_SHUFFLE(3, 3, 3, 3));
+		__m128 scale = _mm_div_ps(full, alpha);
+		__m128 result = _mm_min_ps(_mm_add_ps(_mm_mul_ps(values, scale), _mm_set1_ps(0.5f)), full);
+		//transparent pixels become black, and alpha stays as it is
+		result = _mm_and_ps(result, _mm_cmpneq_ps(alpha, _mm_setzero_ps()));
+		__m128i unpremultiplied = _mm_blend_epi16(_mm_cvttps_epi32(result), channels, 0xc0);
+		return pSwap ? _mm_shuffle_epi32(unpremultiplied, _MM_SHUFFLE(3, 0, 1, 2)) : unpremultiplied;
+	}
+
+	PIXEL_TARGET("sse4.1") size_t unpremultiplySSE4(const uint8_t* pSource, uint8_t* pTarget, size_t pCount, bool pSwap) {
+		size_t i = 0;
+		for (; i + 4 <= pCount; i += 4) {
+			__m128i pixels = _mm_loadu_si128((const __m128i*)(pSource + i * 4));
+			__m128i p0 = unpremultiplyPixelSSE4(pixels, pSwap);
+			__m128i p1 = unpremultiplyPixelSSE4(_mm_srli_si128(pixels, 4), pSwap);
+			__m128i p2 = unpremultiplyPixelSSE4(_mm_srli_si128(pixels, 8), pSwap);
+			__m128i p3 = unpremultiplyPixelSSE4(_mm_srli_si128(pixels, 12), pSwap);
+			_mm_storeu_si128((__m128i*)(pTarget + i * 4), _mm_packus_epi16(_mm_packus_epi32(p0, p1), _mm_packus_epi32(p2, p3)));
+		}
+		return i;
+	}
+
+	//4 16 bit samples in the low 8 bytes of pSamples to 4 32 bit values, narrow16 of each
+	PIXEL_TARGET("sse4.1") inline __m128i narrowSSE4(__m128i pSamples) {
+		__m128i wide = _mm_cvtepu16_epi32(pSamples);
+		return _mm_srli_epi32(_mm_add_epi32(_mm_mullo_epi32(wide, _mm_set1_epi32(255)), _mm_set1_epi32(32895)), 16);
+	}
+
+	PIXEL_TARGET("sse4.1") size_t narrowSamplesSSE4(const uint8_t* pSource, uint8_t* pTarget, size_t pSamples) {
+		size_t i = 0;
+		for (; i + 16 <= pSamples; i += 16) {
+			__m128i low = _mm_loadu_si128((const __m128i*)(pSource + i * 2));
+			__m128i high = _mm_loadu_si128((const __m128i*)(pSource + i * 2 + 16));
+			__m128i lowBytes = _mm_packus_epi32(narrowSSE4(low), narrowSSE4(_mm_srli_si128(low, 8)));
+			__m128i highBytes = _mm_packus_epi32(narrowSSE4(high), narrowSSE4(_mm_srli_si128(high, 8)));
+			_mm_storeu_si128((__m128i*)(pTarget + i), _mm_packus_epi16(lowBytes, highBytes));
+		}
+		return i;
+	}
+
+	//4 grays in 32 bit lanes to 4 opaque gray pixels
+	PIXEL_TARGET("sse4.1") inline __m128i grayPixelsSSE4(__m128i pGrays) {
+		return _mm_or_si128(_mm_mullo_epi32(pGrays, _mm_set1_epi32(0x010101)), _mm_set1_epi32((int)0xff000000));
+	}
+
+	PIXEL_TARGET("sse4.1") size_t graySSE4(const uint8_t* pSource, uint8_t* pTarget, size_t pCount, bool pWide) {
+		size_t i = 0;
+		if (pWide) {
+			for (; i + 8 <= pCount; i += 8) {
+				__m128i samples = _mm_loadu_si128((const __m128i*)(pSource + i * 2));
+				_mm_storeu_si128((__m128i*)(pTarget + i * 4), grayPixelsSSE4(narrowSSE4(samples)));
+				_mm_storeu_si128((__m128i*)(pTarget + i * 4 + 16), grayPixelsSSE4(narrowSSE4(_mm_srli_si128(samples, 8))));
+			}
+		}
+		else {
+			for (; i + 16 <= pCount; i += 16) {
+				__m128i grays = _mm_loadu_si128((const __m128i*)(pSource + i));
+				for (int quarter = 0; quarter < 4; ++quarter) {
+					__m128i shifted = (quarter == 0) ? grays : (quarter == 1) ? _mm_srli_si128(grays, 4) : (quarter == 2) ? _mm_srli_si128(grays, 8) : _mm_srli_si128(grays, 12);
+					_mm_storeu_si128((__m128i*)(pTarget + i * 4 + quarter * 16), grayPixelsSSE4(_mm_cvtepu8_epi32(shifted)));
+				}
+			}
+		}
+		return i;
+	}
+
+	size_t convertSSE4(PixelConverter::Conversion pConversion, const uint8_t* pSource, uint8_t* pTarget, size_t pCount) {
+		switch (pConversion) {
+		case PixelConverter::ConversionRGBToRGBA: return expandSSE4(pSource, pTarget, pCount, false);
+		case PixelConverter::ConversionBGRToRGBA: return expandSSE4(pSource, pTarget, pCount, true);
+		case PixelConverter::ConversionBGRAToRGBA: return swapSSE4(pSource, pTarget, pCount);
+		case PixelConverter::ConversionPRGBAToRGBA: return unpremultiplySSE4(pSource, pTarget, pCount, false);
+		case PixelConverter::ConversionPBGRAToRGBA: return unpremultiplySSE4(pSource, pTarget, pCount, true);
+		case PixelConverter::ConversionRGBA16ToRGBA8: return narrowSamplesSSE4(pSource, pTarget, pCount * 4) / 4;
+		case PixelConverter::ConversionGray8ToRGBA: return graySSE4(pSource, pTarget, pCount, false);
+		case PixelConverter::ConversionGray16ToRGBA: return graySSE4(pSource, pTarget, pCount, true);
+		default: return 0;
+		}
+	}
+
+	/////////////////////////////////////////////////////////////////////////////////////
+	// avx2, the byte shuffles and packs work within each 128 bit lane
+
+	PIXEL_TARGET("avx2") size_t expandAVX2(const uint8_t* pSource, uint8_t* pTarget, size_t pCount, bool pSwap) {
+		__m128i laneShuffle = _mm_loadu_si128((const __m128i*)expandShuffle[pSwap ? 1 : 0]);
+		const __m256i shuffle = _mm256_broadcastsi128_si256(laneShuffle);
+		const __m256i alpha = _mm256_set1_epi32((int)0xff000000);
+		//bytes 0-15 to the low lane and 12-27 to the high lane, so every lane starts at a pixel
+		const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 3, 4, 5, 6);
+		size_t i = 0;
+		for (; i * 3 + 32 <= pCount * 3; i += 8) {
+			__m256i pixels = _mm256_permutevar8x32_epi32(_mm256_loadu_si256((const __m256i*)(pSource + i * 3)), lanes);
+			_mm256_storeu_si256((__m256i*)(pTarget + i * 4), _mm256_or_si256(_mm256_shuffle_epi8(pixels, shuffle), alpha));
+		}
+		return i;
+	}
+
+	PIXEL_TARGET("avx2") size_t swapAVX2(const uint8_t* pSource, uint8_t* pTarget, size_t pCount) {
+		const __m256i shuffle = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)swapShuffle));
+		size_t i = 0;
+		for (; i + 8 <= pCount; i += 8) {
+			__m256i pixels = _mm256_loadu_si256((const __m256i*)(pSource + i * 4));
+			_mm256_storeu_si256((__m256i*)(pTarget + i * 4), _mm256_shuffle_epi8(pixels, shuffle));
+		}
+		return i;
+	}
+
+	//two pixels in the low 8 bytes of pPixels, one per lane
+	PIXEL_TARGET("avx2") inline __m256i unpremultiplyPixelsAVX2(__m128i pPixels, bool pSwap) {
+		const __m256 full = _mm256_set1_ps(255.0f);
+		__m256i channels = _mm256_cvtepu8_epi32(pPixels);
+		__m256 values = _mm256_cvtepi32_ps(channels);
+		__m256 alpha = _mm256_shuffle_ps(values, values, _MM_SHUFFLE(3, 3, 3, 3));
+		__m256 scale = _mm256_div_ps(full, alpha);
+		__m256 result = _mm256_min_ps(_mm256_add_ps(_mm256_mul_ps(values, scale), _mm256_set1_ps(0.5f)), full);
+		result = _mm256_and_ps(result, _mm256_cmp_ps(alpha, _mm256_setzero_ps(), _CMP_NEQ_UQ));
+		__m256i unpremultiplied = _mm256_blend_epi32(_mm256_cvttps_epi32(result), channels, 0x88);
+		return pSwap ? _mm256_shuffle_epi32(unpremultiplied, _MM_SHUFFLE(3, 0, 1, 2)) : unpremultiplied;
+	}
+
+	PIXEL_TARGET("avx2") size_t unpremultiplyAVX2(const uint8_t* pSource, uint8_t* pTarget, size_t pCount, bool pSwap) {
+		//the lane wise packs leave the even pixels in the low lane and the odd ones in the high lane
+		const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+		size_t i = 0;
+		for (; i + 8 <= pCount; i += 8) {
+			__m128i low = _mm_loadu_si128((const __m128i*)(pSource + i * 4));
+			__m128i high = _mm_loadu_si128((const __m128i*)(pSource + i * 4 + 16));
+			__m256i p01 = unpremultiplyPixelsAVX2(low, pSwap);
+			__m256i p23 = unpremultiplyPixelsAVX2(_mm_srli_si128(low, 8), pSwap);
+			__m256i p45 = unpremultiplyPixelsAVX2(high, pSwap);
+			__m256i p67 = unpremultiplyPixelsAVX2(_mm_srli_si128(high, 8), pSwap);
+			__m256i packed = _mm256_packus_epi16(_mm256_packus_epi32(p01, p23), _mm256_packus_epi32(p45, p67));
+			_mm256_storeu_si256((__m256i*)(pTarget + i * 4), _mm256_permutevar8x32_epi32(packed, order));
+		}
+		return i;
+	}
+
+	//8 16 bit samples to 8 32 bit values, narrow16 of each
+	PIXEL_TARGET("avx2") inline __m256i narrowAVX2(__m128i pSamples) {
+		__m256i wide = _mm256_cvtepu16_epi32(pSamples);
+		return _mm256_srli_epi32(_mm256_add_epi32(_mm256_mullo_epi32(wide, _mm256_set1_epi32(255)), _mm256_set1_epi32(32895)), 16);
+	}
+
+	PIXEL_TARGET("avx2") size_t narrowSamplesAVX2(const uint8_t* pSource, uint8_t* pTarget, size_t pSamples) {
+		size_t i = 0;
+		for (; i + 32 <= pSamples; i += 32) {
+			const __m128i* source = (const __m128i*)(pSource + i * 2);
+			//the packs interleave the lanes, the permutes put the samples back in order
+			__m256i low = _mm256_permute4x64_epi64(_mm256_packus_epi32(narrowAVX2(_mm_loadu_si128(source)), narrowAVX2(_mm_loadu_si128(source + 1))), _MM_SHUFFLE(3, 1, 2, 0));
+			__m256i high = _mm256_permute4x64_epi64(_mm256_packus_epi32(narrowAVX2(_mm_loadu_si128(source + 2)), narrowAVX2(_mm_loadu_si128(source + 3))), _MM_SHUFFLE(3, 1, 2, 0));
+			__m256i bytes = _mm256_permute4x64_epi64(_mm256_packus_epi16(low, high), _MM_SHUFFLE(3, 1, 2, 0));
+			_mm256_storeu_si256((__m256i*)(pTarget + i), bytes);
+		}
+		return i;
+	}
+
+	PIXEL_TARGET("avx2") inline __m256i grayPixelsAVX2(__m256i pGrays) {
+		return _mm256_or_si256(_mm256_mullo_epi32(pGrays, _mm256_set1_epi32(0x010101)), _mm256_set1_epi32((int)0xff000000));
+	}
+
+	PIXEL_TARGET("avx2") size_t grayAVX2(const uint8_t* pSource, uint8_t* pTarget, size_t pCount, bool pWide) {
+		size_t i = 0;
+		if (pWide) {
+			for (; i + 8 <= pCount; i += 8)
+				_mm256_storeu_si256((__m256i*)(pTarget + i * 4), grayPixelsAVX2(narrowAVX2(_mm_loadu_si128((const __m128i*)(pSource + i * 2)))));
+		}
+		else {
+			for (; i + 16 <= pCount; i += 16) {
+				__m128i grays = _mm_loadu_si128((const __m128i*)(pSource + i));
+				_mm256_storeu_si256((__m256i*)(pTarget + i * 4), grayPixelsAVX2(_mm256_cvtepu8_epi32(grays)));
+				_mm256_storeu_si256((__m256i*)(pTarget + i * 4 + 32), grayPixelsAVX2(_mm256_cvtepu8_epi32(_mm_srli_si128(grays, 8))));
+			}
+		}
+		return i;
+	}
+
+	size_t convertAVX2(PixelConverter::Conversion pConversion, const uint8_t* pSource, uint8_t* pTarget, size_t pCount) {
+		switch (pConversion) {
+		case PixelConverter::ConversionRGBToRGBA: return expandAVX2(pSource, pTarget, pCount, false);
+		case PixelConverter::ConversionBGRToRGBA: return expandAVX2(pSource, pTarget, pCount, true);
+		case PixelConverter::ConversionBGRAToRGBA: return swapAVX2(pSource, pTarget, pCount);
+		case PixelConverter::ConversionPRGBAToRGBA: return unpremultiplyAVX2(pSource, pTarget, pCount, false);
+		case PixelConverter::ConversionPBGRAToRGBA: return unpremultiplyAVX2(pSource, pTarget, pCount, true);
+		case PixelConverter::ConversionRGBA16ToRGBA8: return narrowSamplesAVX2(pSource, pTarget, pCount * 4) / 4;
+		case PixelConverter::ConversionGray8ToRGBA: return grayAVX2(pSource, pTarget, pCount, false);
+		case PixelConverter::ConversionGray16ToRGBA: return grayAVX2(pSource, pTarget, pCount, true);
+		default: return 0;
+		}
+	}
+
+	/////////////////////////////////////////////////////////////////////////////////////
+	// cpu features
+
+	void cpuid(int pLeaf, int pSubleaf, unsigned pRegisters[4]) {
+#ifdef _MSC_VER
+		int registers[4];
+		__cpuidex(registers, pLeaf, pSubleaf);
+		for (int i = 0; i < 4; ++i)
+			pRegisters[i] = (unsigned)registers[i];
+#else
+		__cpuid_count(pLeaf, pSubleaf, pRegisters[0], pRegisters[1], pRegisters[2], pRegisters[3]);
+#endif
+	}
+
+	//the register state the os saves on a context switch
+	uint64_t enabledState() {
+#ifdef _MSC_VER
+		return _xgetbv(0);
+#else
+		unsigned low, high;
+		__asm__("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+		return ((uint64_t)high << 32) | low;
+#endif
+	}
+
+	PixelConverter::Instructions detectInstructions() {
+		unsigned registers[4];
+		cpuid(0, 0, registers);
+		unsigned maxLeaf = registers[0];
+		cpuid(1, 0, registers);
+		bool sse41 = (registers[2] & (1u << 19)) != 0;
+		bool ssse3 = (registers[2] & (1u << 9)) != 0;
+		bool osxsave = (registers[2] & (1u << 27)) != 0;
+		bool avx = (registers[2] & (1u << 28)) != 0;
+		if (!sse41 || !ssse3)
+			return PixelConverter::InstructionsScalar;
+		//avx2 also needs the os to save the sse and avx registers
+		if (maxLeaf >= 7 && osxsave && avx && (enabledState() & 6) == 6) {
+			cpuid(7, 0, registers);
+			if (registers[1] & (1u << 5))
+				return PixelConverter::InstructionsAVX2;
+		}
+		return PixelConverter::InstructionsSSE4;
+	}
+#endif
+}
+
+PixelConverter::Instructions PixelConverter::supportedInstructions()
+{
+#ifdef PIXEL_SIMD
+	//thread safe initialization, the loader threads convert too
+	static const Instructions supported = detectInstructions();
+	return supported;
+#else
+	return InstructionsScalar;
+#endif
+}
+
+const char* PixelConverter::name(Instructions pInstructions)
+{
+	switch (pInstructions) {
+	case InstructionsSSE4: return "sse4.1";
+	case InstructionsAVX2: return "avx2";
+	default: return "scalar";
+	}
+}
+
+uint32_t PixelConverter::sourceBytes(Conversion pConversion)
+{
+	switch (pConversion) {
+	case ConversionRGBToRGBA:
+	case ConversionBGRToRGBA: return 3;
+	case ConversionRGBA16ToRGBA8: return 8;
+	case ConversionGray8ToRGBA: return 1;
+	case ConversionGray16ToRGBA: return 2;
+	default: return 4;
+	}
+}
+
+void PixelConverter::convert(Conversion pConversion, const void* pSource, void* pTarget, size_t pPixels)
+{
+	convert(pConversion, pSource, pTarget, pPixels, supportedInstructions());
+}
+
+void PixelConverter::convert(Conversion pConversion, const void* pSource, void* pTarget, size_t pPixels, Instructions pInstructions)
+{
+	const uint8_t* source = (const uint8_t*)pSource;
+	uint8_t* target = (uint8_t*)pTarget;
+	size_t converted = 0;
+#ifdef PIXEL_SIMD
+	if (pInstructions == InstructionsAVX2)
+		converted = convertAVX2(pConversion, source, target, pPixels);
+	else if (pInstructions == InstructionsSSE4)
+		converted = convertSSE4(pConversion, source, target, pPixels);
+#endif
+	convertScalar(pConversion, source + converted * sourceBytes(pConversion), target + converted * 4, pPixels - converted);
+}
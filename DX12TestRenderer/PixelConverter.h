@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * Converts decoded pixels to the 8 bit, 4 channel layouts the mip generator and the block compressor work on, in place of
+ * the WIC format converter for the common formats. Every conversion has a scalar kernel and sse4.1 and avx2 kernels that
+ * give the same bytes, the best instruction set the cpu supports is picked at runtime (the simd kernels are compiled for
+ * every x64 build, they are only called on cpus that have the instructions). The scalar kernels are the reference and
+ * convert the pixels at the end of a row the simd loops leave.
+ * Device independent, so it runs on the loader threads and headless.
+ */
+class PixelConverter
+{
+public:
+	enum Conversion {
+		ConversionRGBToRGBA,	//24 bit rgb to rgba8, opaque
+		ConversionBGRToRGBA,	//24 bit bgr to rgba8, opaque
+		ConversionBGRAToRGBA,	//swap the red and blue byte of 32 bit pixels, bgra8 to rgba8 and back
+		ConversionPRGBAToRGBA,	//premultiplied rgba8 to straight alpha, transparent pixels become transparent black
+		ConversionPBGRAToRGBA,	//premultiplied bgra8 to straight rgba8
+		ConversionRGBA16ToRGBA8,	//16 bit channels to 8 bit, rounded to nearest
+		ConversionGray8ToRGBA,	//8 bit gray to rgba8, opaque
+		ConversionGray16ToRGBA,	//16 bit gray to rgba8, opaque
+		ConversionCount
+	};
+
+	enum Instructions {
+		InstructionsScalar,
+		InstructionsSSE4,	//sse4.1, with the ssse3 byte shuffles
+		InstructionsAVX2
+	};
+
+	//the best instruction set of this cpu (and os, avx2 needs it to save the ymm registers), detected once
+	static Instructions supportedInstructions();
+	static const char* name(Instructions pInstructions);
+
+	//bytes of a source pixel, the target pixels are always 4 bytes
+	static uint32_t sourceBytes(Conversion pConversion);
+
+	//convert pPixels pixels with the instructions of supportedInstructions. pSource and pTarget may be the same for the
+	//conversions that keep the pixel size, otherwise they must not overlap
+	static void convert(Conversion pConversion, const void* pSource, void* pTarget, size_t pPixels);
+	//the same with the given instructions, which the cpu has to support. for comparing the kernels
+	static void convert(Conversion pConversion, const void* pSource, void* pTarget, size_t pPixels, Instructions pInstructions);
+};
@@ -3,11 +3,20 @@ struct VS_OUTPUT{
 	float2 uv : TEXCOORD;
 };
 
+#ifdef TEXTURE_ARRAY
+//arrays and cubemaps (TextureRegistry::isArray), their first slice is sampled
+Texture2DArray _MainTex : register(t0);
+#else
 Texture2D _MainTex : register(t0);
+#endif
 SamplerState _SampleState :register(s0);
 
 float4 main(VS_OUTPUT i) : SV_TARGET
 {
     // return vertex color
+#ifdef TEXTURE_ARRAY
+    return _MainTex.Sample(_SampleState, float3(i.uv, 0));
+#else
     return _MainTex.Sample(_SampleState, i.uv);
+#endif
 }
\ No newline at end of file
@@ -0,0 +1,812 @@
+#include "PngDecoder.h"
+#include "MappedFile.h"
+#include "PixelConverter.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PNG_SSE2
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+namespace {
+	const uint8_t pngSignature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+
+	inline uint32_t readBigEndian32(const uint8_t* pData) {
+		return ((uint32_t)pData[0] << 24) | ((uint32_t)pData[1] << 16) | ((uint32_t)pData[2] << 8) | pData[3];
+	}
+
+	/////////////////////////////////////////////////////////////////////////////////////
+	// inflate
+
+	const int fastBits = 10;	//codes up to this length are decoded with a single table lookup
+	const int maxCodeLength = 15;
+
+	//a canonical huffman code, see rfc 1951 3.2.2
+	struct Huffman {
+		uint16_t fast[1 << fastBits];	//symbol | length << 9 for every code of fastBits or less, 0 for longer codes
+		uint32_t maxCode[maxCodeLength + 2];	//first code past the codes of a length, left aligned to 16 bits
+		uint16_t firstCode[maxCodeLength + 1];
+		uint16_t firstSymbol[maxCodeLength + 1];	//index in symbols of the first code of a length
+		uint16_t symbols[288];
+
+		bool build(const uint8_t* pLengths, int pCount) {
+			int counts[maxCodeLength + 1] = {};
+			for (int i = 0; i < pCount; ++i)
+				counts[pLengths[i]]++;
+			counts[0] = 0;
+			memset(fast, 0, sizeof(fast));
+
+			int code = 0;
+			int symbol = 0;
+			int nextCode[maxCodeLength + 1];
+			for (int length = 1; length <= maxCodeLength; ++length) {
+				nextCode[length] = code;
+				firstCode[length] = (uint16_t)code;
+				firstSymbol[length] = (uint16_t)symbol;
+				code += counts[length];
+				//over subscribed
+				if (counts[length] != 0 && code - 1 >= (1 << length))
+					return false;
+				maxCode[length] = (uint32_t)code << (16 - length);
+				code <<= 1;
+				symbol += counts[length];
+			}
+			maxCode[maxCodeLength + 1] = 0x10000;
+
+			for (int i = 0; i < pCount; ++i) {
+				int length = pLengths[i];
+				if (length == 0)
+					continue;
+				int index = firstSymbol[length] + (nextCode[length] - firstCode[length]);
+				symbols[index] = (uint16_t)i;
+				if (length <= fastBits) {
+					//the bit stream holds codes starting with their most significant bit, so the table is indexed by the reversed code
+					int reversed = 0;
+					for (int bit = 0; bit < length; ++bit)
+						reversed |= ((nextCode[length] >> bit) & 1) << (length - 1 - bit);
+					for (int fill = reversed; fill < (1 << fastBits); fill += 1 << length)
+						fast[fill] = (uint16_t)(i | (length << 9));
+				}
+				nextCode[length]++;
+			}
+			return true;
+		}
+	};
+
+	const uint16_t lengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+	const uint8_t lengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	const uint16_t distanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+	const uint8_t distanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+	const uint8_t codeLengthOrder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+	class Inflater {
+	public:
+		Inflater(const uint8_t* pData, size_t pSize, uint8_t* pOutput, size_t pOutputSize)
+			: _input(pData), _inputEnd(pData + pSize), _output(pOutput), _outputStart(pOutput), _outputEnd(pOutput + pOutputSize), _bits(0), _bitCount(0), _padding(0) {
+		}
+
+		bool run() {
+			bool last = false;
+			while (!last) {
+				last = _read(1) != 0;
+				unsigned type = _read(2);
+				bool ok;
+				if (type == 0)
+					ok = _stored();
+				else if (type == 1)
+					ok = _fixed() && _codes();
+				else if (type == 2)
+					ok = _dynamic() && _codes();
+				else
+					ok = false;
+				//reading into the zero padding behind the input means the stream was cut off
+				if (!ok || _padding * 8 > _bitCount)
+					return false;
+			}
+			return _output == _outputEnd;
+		}
+
+	private:
+		const uint8_t* _input;
+		const uint8_t* _inputEnd;
+		uint8_t* _output;
+		uint8_t* _outputStart;
+		uint8_t* _outputEnd;
+		uint64_t _bits;
+		unsigned _bitCount;
+		unsigned _padding;	//zero bytes added to the bit buffer past the end of the input
+		Huffman _literals;
+		Huffman _distances;
+
+		//make sure there are at least 56 bits in the buffer
+		inline void _refill() {
+			if (_inputEnd - _input >= 8) {
+				uint64_t next;
+				memcpy(&next, _input, 8);
+				_bits |= next << _bitCount;
+				_input += (63 - _bitCount) >> 3;
+				_bitCount |= 56;
+				return;
+			}
+			while (_bitCount <= 56) {
+				if (_input < _inputEnd)
+					_bits |= (uint64_t)*_input++ << _bitCount;
+				else
+					_padding++;
+				_bitCount += 8;
+			}
+		}
+
+		inline unsigned _read(unsigned pCount) {
+			if (_bitCount < pCount)
+				_refill();
+			unsigned value = (unsigned)(_bits & ((1ull << pCount) - 1));
+			_bits >>= pCount;
+			_bitCount -= pCount;
+			return value;
+		}
+
+		inline int _decode(const Huffman& pHuffman) {
+			if (_bitCount < 16)
+				_refill();
+			unsigned entry = pHuffman.fast[_bits & ((1 << fastBits) - 1)];
+			int length;
+			int symbol;
+			if (entry != 0) {
+				length = entry >> 9;
+				symbol = entry & 511;
+			}
+			else {
+				//longer code: compare the next 16 bits, most significant bit first, against the code ranges per length
+				unsigned reversed = (unsigned)(_bits & 0xffff);
+				reversed = ((reversed & 0xaaaa) >> 1) | ((reversed & 0x5555) << 1);
+				reversed = ((reversed & 0xcccc) >> 2) | ((reversed & 0x3333) << 2);
+				reversed = ((reversed & 0xf0f0) >> 4) | ((reversed & 0x0f0f) << 4);
+				reversed = ((reversed & 0xff00) >> 8) | ((reversed & 0x00ff) << 8);
+				for (length = fastBits + 1; length <= maxCodeLength; ++length) {
+					if (reversed < pHuffman.maxCode[length])
+						break;
+				}
+				if (length > maxCodeLength)
+					return -1;
+				int index = (int)(reversed >> (16 - length)) - pHuffman.firstCode[length] + pHuffman.firstSymbol[length];
+				if (index >= 288)
+					return -1;
+				symbol = pHuffman.symbols[index];
+			}
+			_bits >>= length;
+			_bitCount -= length;
+			return symbol;
+		}
+
+		bool _stored() {
+			//drop the bits up to the byte boundary and give back the whole bytes still in the buffer
+			_read(_bitCount & 7);
+			unsigned buffered = _bitCount >> 3;
+			_input -= (buffered > _padding) ? buffered - _padding : 0;
+			_bits = 0;
+			_bitCount = 0;
+			_padding = 0;
+
+			if (_inputEnd - _input < 4)
+				return false;
+			unsigned length = _input[0] | (_input[1] << 8);
+			unsigned inverse = _input[2] | (_input[3] << 8);
+			_input += 4;
+			if ((length ^ 0xffff) != inverse || (size_t)(_inputEnd - _input) < length || (size_t)(_outputEnd - _output) < length)
+				return false;
+			memcpy(_output, _input, length);
+			_output += length;
+			_input += length;
+			return true;
+		}
+
+		bool _fixed() {
+			uint8_t lengths[288 + 32];
+			memset(lengths, 8, 144);
+			memset(lengths + 144, 9, 112);
+			memset(lengths + 256, 7, 24);
+			memset(lengths + 280, 8, 8);
+			memset(lengths + 288, 5, 32);
+			return _literals.build(lengths, 288) && _distances.build(lengths + 288, 32);
+		}
+
+		bool _dynamic() {
+			unsigned literalCount = _read(5) + 257;
+			unsigned distanceCount = _read(5) + 1;
+			unsigned codeLengthCount = _read(4) + 4;
+
+			uint8_t codeLengthLengths[19] = {};
+			for (unsigned i = 0; i < codeLengthCount; ++i)
+				codeLengthLengths[codeLengthOrder[i]] = (uint8_t)_read(3);
+			Huffman codeLengths;
+			if (!codeLengths.build(codeLengthLengths, 19))
+				return false;
+
+			//literal/length and distance code lengths are one sequence, repeats can cross from one into the other
+			uint8_t lengths[286 + 32];
+			unsigned total = literalCount + distanceCount;
+			unsigned count = 0;
+			while (count < total) {
+				int symbol = _decode(codeLengths);
+				if (symbol < 0)
+					return false;
+				if (symbol < 16) {
+					lengths[count++] = (uint8_t)symbol;
+					continue;
+				}
+				unsigned repeat;
+				uint8_t value = 0;
+				if (symbol == 16) {
+					if (count == 0)
+						return false;
+					value = lengths[count - 1];
+					repeat = 3 + _read(2);
+				}
+				else if (symbol == 17) {
+					repeat = 3 + _read(3);
+				}
+				else {
+					repeat = 11 + _read(7);
+				}
+				if (count + repeat > total)
+					return false;
+				memset(lengths + count, value, repeat);
+				count += repeat;
+			}
+			if (lengths[256] == 0)
+				return false;
+			return _literals.build(lengths, literalCount) && _distances.build(lengths + literalCount, distanceCount);
+		}
+
+		bool _codes() {
+			for (;;) {
+				int symbol = _decode(_literals);
+				if (symbol < 256) {
+					if (symbol < 0 || _output == _outputEnd)
+						return false;
+					*_output++ = (uint8_t)symbol;
+					continue;
+				}
+				if (symbol == 256)
+					return true;
+
+				symbol -= 257;
+				if (symbol >= 29)
+					return false;
+				unsigned length = lengthBase[symbol] + _read(lengthExtra[symbol]);
+				int distanceSymbol = _decode(_distances);
+				if (distanceSymbol < 0 || distanceSymbol >= 30)
+					return false;
+				size_t distance = distanceBase[distanceSymbol] + _read(distanceExtra[distanceSymbol]);
+				if (distance > (size_t)(_output - _outputStart) || length > (size_t)(_outputEnd - _output))
+					return false;
+
+				const uint8_t* source = _output - distance;
+				if (distance >= 8 && (size_t)(_outputEnd - _output) >= length + 8) {
+					//8 bytes at a time, the chunks never overlap what they read and may write up to 7 bytes past the match
+					uint8_t* target = _output;
+					uint8_t* end = _output + length;
+					do {
+						uint64_t chunk;
+						memcpy(&chunk, source, 8);
+						memcpy(target, &chunk, 8);
+						source += 8;
+						target += 8;
+					} while (target < end);
+				}
+				else {
+					for (unsigned i = 0; i < length; ++i)
+						_output[i] = source[i];
+				}
+				_output += length;
+			}
+		}
+	};
+
+	/////////////////////////////////////////////////////////////////////////////////////
+	// unfilter
+
+	enum FilterType { FilterNone, FilterSub, FilterUp, FilterAverage, FilterPaeth };
+
+	inline uint8_t paethPredictor(int pA, int pB, int pC) {
+		int p = pA + pB - pC;
+		int pa = abs(p - pA);
+		int pb = abs(p - pB);
+		int pc = abs(p - pC);
+		if (pa <= pb && pa <= pc)
+			return (uint8_t)pA;
+		return (uint8_t)((pb <= pc) ? pB : pC);
+	}
+
+	//one row, pPrior is the unfiltered row above or all zeros for the first row
+	bool unfilterRowScalar(int pType, uint8_t* pRow, const uint8_t* pPrior, size_t pRowBytes, uint32_t pBytesPerPixel) {
+		size_t bpp = pBytesPerPixel;
+		switch (pType) {
+		case FilterNone:
+			return true;
+		case FilterSub:
+			for (size_t i = bpp; i < pRowBytes; ++i)
+				pRow[i] = (uint8_t)(pRow[i] + pRow[i - bpp]);
+			return true;
+		case FilterUp:
+			for (size_t i = 0; i < pRowBytes; ++i)
+				pRow[i] = (uint8_t)(pRow[i] + pPrior[i]);
+			return true;
+		case FilterAverage:
+			for (size_t i = 0; i < pRowBytes; ++i) {
+				int left = (i >= bpp) ? pRow[i - bpp] : 0;
+				pRow[i] = (uint8_t)(pRow[i] + ((left + pPrior[i]) >> 1));
+			}
+			return true;
+		case FilterPaeth:
+			for (size_t i = 0; i < pRowBytes; ++i) {
+				int left = (i >= bpp) ? pRow[i - bpp] : 0;
+				int upLeft = (i >= bpp) ? pPrior[i - bpp] : 0;
+				pRow[i] = (uint8_t)(pRow[i] + paethPredictor(left, pPrior[i], upLeft));
+			}
+			return true;
+		default:
+			return false;
+		}
+	}
+
+#ifdef PNG_SSE2
+	//the pixels of 3 and 4 byte formats are loaded in the low lanes of a register, 3 byte loads never read past the pixel.
+	//the pixel size is a template argument so the copies compile to plain loads and stores
+	template<int BytesPerPixel>
+	inline __m128i loadPixel(const uint8_t* pPixel) {
+		int value = 0;
+		memcpy(&value, pPixel, BytesPerPixel);
+		return _mm_cvtsi32_si128(value);
+	}
+
+	template<int BytesPerPixel>
+	inline void storePixel(uint8_t* pPixel, __m128i pValue) {
+		int value = _mm_cvtsi128_si32(pValue);
+		memcpy(pPixel, &value, BytesPerPixel);
+	}
+
+	void unfilterUp(uint8_t* pRow, const uint8_t* pPrior, size_t pRowBytes) {
+		size_t i = 0;
+		for (; i + 16 <= pRowBytes; i += 16) {
+			__m128i row = _mm_loadu_si128((const __m128i*)(pRow + i));
+			__m128i prior = _mm_loadu_si128((const __m128i*)(pPrior + i));
+			_mm_storeu_si128((__m128i*)(pRow + i), _mm_add_epi8(row, prior));
+		}
+		for (; i < pRowBytes; ++i)
+			pRow[i] = (uint8_t)(pRow[i] + pPrior[i]);
+	}
+
+	//Sub, Avg and Paeth depend on the pixel to the left, so these go one pixel at a time with all its channels in parallel
+	template<int BytesPerPixel>
+	void unfilterSub(uint8_t* pRow, size_t pRowBytes) {
+		__m128i left = _mm_setzero_si128();
+		for (size_t i = 0; i < pRowBytes; i += BytesPerPixel) {
+			left = _mm_add_epi8(loadPixel<BytesPerPixel>(pRow + i), left);
+			storePixel<BytesPerPixel>(pRow + i, left);
+		}
+	}
+
+	template<int BytesPerPixel>
+	void unfilterAverage(uint8_t* pRow, const uint8_t* pPrior, size_t pRowBytes) {
+		const __m128i one = _mm_set1_epi8(1);
+		__m128i left = _mm_setzero_si128();
+		for (size_t i = 0; i < pRowBytes; i += BytesPerPixel) {
+			__m128i up = loadPixel<BytesPerPixel>(pPrior + i);
+			//avg_epu8 rounds up, take the rounding back off where the sum was odd
+			__m128i average = _mm_sub_epi8(_mm_avg_epu8(left, up), _mm_and_si128(_mm_xor_si128(left, up), one));
+			left = _mm_add_epi8(loadPixel<BytesPerPixel>(pRow + i), average);
+			storePixel<BytesPerPixel>(pRow + i, left);
+		}
+	}
+
+	inline __m128i abs16(__m128i pValue) {
+		return _mm_max_epi16(pValue, _mm_sub_epi16(_mm_setzero_si128(), pValue));
+	}
+
+	inline __m128i select(__m128i pMask, __m128i pIf, __m128i pElse) {
+		return _mm_or_si128(_mm_and_si128(pMask, pIf), _mm_andnot_si128(pMask, pElse));
+	}
+
+	template<int BytesPerPixel>
+	void unfilterPaeth(uint8_t* pRow, const uint8_t* pPrior, size_t pRowBytes) {
+		//the predictor works on 16 bit lanes, a + b - c doesn't fit in 8 bits
+		const __m128i zero = _mm_setzero_si128();
+		__m128i left = zero;	//a
+		__m128i upLeft = zero;	//c
+		for (size_t i = 0; i < pRowBytes; i += BytesPerPixel) {
+			__m128i up = _mm_unpacklo_epi8(loadPixel<BytesPerPixel>(pPrior + i), zero);	//b
+
+			//p = a + b - c, so pa = |b - c|, pb = |a - c| and pc = |a + b - 2c|
+			__m128i pa = _mm_sub_epi16(up, upLeft);
+			__m128i pb = _mm_sub_epi16(left, upLeft);
+			__m128i pc = abs16(_mm_add_epi16(pa, pb));
+			pa = abs16(pa);
+			pb = abs16(pb);
+
+			//ties go to a, then b, then c
+			__m128i smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+			__m128i predictor = select(_mm_cmpeq_epi16(smallest, pa), left, select(_mm_cmpeq_epi16(smallest, pb), up, upLeft));
+
+			__m128i pixel = _mm_add_epi8(loadPixel<BytesPerPixel>(pRow + i), _mm_packus_epi16(predictor, predictor));
+			storePixel<BytesPerPixel>(pRow + i, pixel);
+			left = _mm_unpacklo_epi8(pixel, zero);
+			upLeft = up;
+		}
+	}
+
+	template<int BytesPerPixel>
+	bool unfilterRows(uint8_t* pScanlines, size_t pRowBytes, size_t pRowCount) {
+		vector<uint8_t> zeros(pRowBytes, 0);
+		const uint8_t* prior = zeros.data();
+		for (size_t y = 0; y < pRowCount; ++y) {
+			uint8_t* row = pScanlines + y * (pRowBytes + 1);
+			int type = row[0];
+			row++;
+			switch (type) {
+			case FilterNone: break;
+			case FilterSub: unfilterSub<BytesPerPixel>(row, pRowBytes); break;
+			case FilterUp: unfilterUp(row, prior, pRowBytes); break;
+			case FilterAverage: unfilterAverage<BytesPerPixel>(row, prior, pRowBytes); break;
+			case FilterPaeth: unfilterPaeth<BytesPerPixel>(row, prior, pRowBytes); break;
+			default: return false;
+			}
+			prior = row;
+		}
+		return true;
+	}
+#endif
+
+	/////////////////////////////////////////////////////////////////////////////////////
+	// pixel conversion
+
+	enum ColorType { ColorGray = 0, ColorRGB = 2, ColorPalette = 3, ColorGrayAlpha = 4, ColorRGBA = 6 };
+
+	struct Header {
+		uint32_t width;
+		uint32_t height;
+		int bitDepth;
+		int colorType;
+		bool interlaced;
+		int channels;
+		uint8_t palette[256][4];	//rgba, the alpha comes from the tRNS chunk
+	};
+
+	PngDecoder::Format outputFormat(const Header& pHeader) {
+		if (pHeader.colorType == ColorGray)
+			return (pHeader.bitDepth == 16) ? PngDecoder::FormatR16 : PngDecoder::FormatR8;
+		if (pHeader.bitDepth == 16)
+			return PngDecoder::FormatRGBA16;
+		if (pHeader.colorType == ColorRGB || pHeader.colorType == ColorPalette)
+			return PngDecoder::FormatRGBA8;
+		return PngDecoder::FormatBGRA8;
+	}
+
+	//sample pIndex of a row of 1, 2 or 4 bit samples, most significant bits first
+	inline unsigned packedSample(const uint8_t* pRow, size_t pIndex, int pBitDepth) {
+		size_t bit = pIndex * pBitDepth;
+		return (pRow[bit >> 3] >> (8 - pBitDepth - (bit & 7))) & ((1 << pBitDepth) - 1);
+	}
+
+	//16 bit png samples are big endian, the output is little endian
+	inline void store16(uint8_t* pTarget, const uint8_t* pSample) {
+		pTarget[0] = pSample[1];
+		pTarget[1] = pSample[0];
+	}
+
+	//one unfiltered row to pWidth pixels in the output format
+	void convertRow(const Header& pHeader, const uint8_t* pSource, uint8_t* pTarget, uint32_t pWidth) {
+		int depth = pHeader.bitDepth;
+		switch (pHeader.colorType) {
+		case ColorGray:
+			if (depth == 16) {
+				for (uint32_t i = 0; i < pWidth; ++i)
+					store16(pTarget + i * 2, pSource + i * 2);
+			}
+			else if (depth == 8) {
+				memcpy(pTarget, pSource, pWidth);
+			}
+			else {
+				//scale to the full 8 bit range, 1 becomes 255 for 1 bit images
+				unsigned scale = 255 / ((1 << depth) - 1);
+				for (uint32_t i = 0; i < pWidth; ++i)
+					pTarget[i] = (uint8_t)(packedSample(pSource, i, depth) * scale);
+			}
+			break;
+		case ColorPalette:
+			for (uint32_t i = 0; i < pWidth; ++i) {
+				unsigned index = (depth == 8) ? pSource[i] : packedSample(pSource, i, depth);
+				memcpy(pTarget + i * 4, pHeader.palette[index], 4);
+			}
+			break;
+		case ColorRGB:
+			if (depth == 16) {
+				for (uint32_t i = 0; i < pWidth; ++i) {
+					uint8_t* target = pTarget + i * 8;
+					store16(target, pSource + i * 6);
+					store16(target + 2, pSource + i * 6 + 2);
+					store16(target + 4, pSource + i * 6 + 4);
+					target[6] = target[7] = 255;
+				}
+			}
+			else {
+				for (uint32_t i = 0; i < pWidth; ++i) {
+					uint8_t* target = pTarget + i * 4;
+					target[0] = pSource[i * 3];
+					target[1] = pSource[i * 3 + 1];
+					target[2] = pSource[i * 3 + 2];
+					target[3] = 255;
+				}
+			}
+			break;
+		case ColorGrayAlpha:
+			if (depth == 16) {
+				for (uint32_t i = 0; i < pWidth; ++i) {
+					uint8_t* target = pTarget + i * 8;
+					store16(target, pSource + i * 4);
+					store16(target + 2, pSource + i * 4);
+					store16(target + 4, pSource + i * 4);
+					store16(target + 6, pSource + i * 4 + 2);
+				}
+			}
+			else {
+				for (uint32_t i = 0; i < pWidth; ++i) {
+					uint8_t* target = pTarget + i * 4;
+					target[0] = target[1] = target[2] = pSource[i * 2];
+					target[3] = pSource[i * 2 + 1];
+				}
+			}
+			break;
+		case ColorRGBA:
+			if (depth == 16) {
+				for (uint32_t i = 0; i < pWidth * 4; ++i)
+					store16(pTarget + i * 2, pSource + i * 2);
+			}
+			else {
+				PixelConverter::convert(PixelConverter::ConversionBGRAToRGBA, pSource, pTarget, pWidth);
+			}
+			break;
+		}
+	}
+
+	inline size_t rowBytes(const Header& pHeader, uint32_t pWidth) {
+		return ((size_t)pWidth * pHeader.channels * pHeader.bitDepth + 7) / 8;
+	}
+
+	//the 7 passes of Adam7 interlacing: first column and row, column and row step
+	const uint32_t adam7[7][4] = { { 0, 0, 8, 8 }, { 4, 0, 8, 8 }, { 0, 4, 4, 8 }, { 2, 0, 4, 4 }, { 0, 2, 2, 4 }, { 1, 0, 2, 2 }, { 0, 1, 1, 2 } };
+
+	inline uint32_t passSize(uint32_t pSize, uint32_t pStart, uint32_t pStep) {
+		return (pSize > pStart) ? (pSize - pStart + pStep - 1) / pStep : 0;
+	}
+
+	//read the chunks up to IEND: the header, palette and transparency, and the compressed data of all IDAT chunks
+	//if pCompressed isn't NULL. false if the file is broken or uses something that isn't supported
+	bool readChunks(const uint8_t* pData, size_t pSize, Header& pHeader, vector<uint8_t>* pCompressed) {
+		bool hasHeader = false;
+		for (int i = 0; i < 256; ++i)
+			pHeader.palette[i][3] = 255;
+		int paletteSize = 0;
+
+		//the crcs are not checked
+		size_t position = sizeof(pngSignature);
+		bool ended = false;
+		while (!ended && pSize - position >= 12) {
+			uint32_t length = readBigEndian32(pData + position);
+			const uint8_t* type = pData + position + 4;
+			const uint8_t* chunk = pData + position + 8;
+			if (length > pSize - position - 12)
+				return false;
+			position += 12 + (size_t)length;
+
+			if (memcmp(type, "IHDR", 4) == 0) {
+				if (length < 13)
+					return false;
+				pHeader.width = readBigEndian32(chunk);
+				pHeader.height = readBigEndian32(chunk + 4);
+				pHeader.bitDepth = chunk[8];
+				pHeader.colorType = chunk[9];
+				pHeader.interlaced = chunk[12] == 1;
+				if (chunk[10] != 0 || chunk[11] != 0 || chunk[12] > 1)
+					return false;
+				hasHeader = true;
+			}
+			else if (memcmp(type, "PLTE", 4) == 0) {
+				paletteSize = min(256u, length / 3);
+				for (int i = 0; i < paletteSize; ++i)
+					memcpy(pHeader.palette[i], chunk + i * 3, 3);
+			}
+			else if (memcmp(type, "tRNS", 4) == 0) {
+				if (pHeader.colorType == ColorPalette) {
+					for (uint32_t i = 0; i < length && i < 256; ++i)
+						pHeader.palette[i][3] = chunk[i];
+				}
+			}
+			else if (memcmp(type, "IDAT", 4) == 0) {
+				if (pCompressed)
+					pCompressed->insert(pCompressed->end(), chunk, chunk + length);
+			}
+			else if (memcmp(type, "IEND", 4) == 0) {
+				ended = true;
+			}
+		}
+		if (!hasHeader || (pCompressed && pCompressed->size() < 2) || pHeader.width == 0 || pHeader.height == 0)
+			return false;
+
+		int depth = pHeader.bitDepth;
+		switch (pHeader.colorType) {
+		case ColorGray: pHeader.channels = 1; break;
+		case ColorRGB: pHeader.channels = 3; break;
+		case ColorPalette: pHeader.channels = 1; break;
+		case ColorGrayAlpha: pHeader.channels = 2; break;
+		case ColorRGBA: pHeader.channels = 4; break;
+		default: return false;
+		}
+		bool validDepth = (pHeader.colorType == ColorGray) ? (depth == 1 || depth == 2 || depth == 4 || depth == 8 || depth == 16)
+			: (pHeader.colorType == ColorPalette) ? (depth == 1 || depth == 2 || depth == 4 || depth == 8)
+			: (depth == 8 || depth == 16);
+		return validDepth && (pHeader.colorType != ColorPalette || paletteSize != 0);
+	}
+}
+
+bool PngDecoder::isPng(const void* pData, size_t pSize)
+{
+	return pSize >= sizeof(pngSignature) && memcmp(pData, pngSignature, sizeof(pngSignature)) == 0;
+}
+
+bool PngDecoder::load(const string& pFileName, Image& pImage)
+{
+	MappedFile file;
+	if (!file.open(pFileName))
+		return false;
+	return decode(file.data(), file.size(), pImage);
+}
+
+uint32_t PngDecoder::bytesPerPixel(Format pFormat)
+{
+	switch (pFormat) {
+	case FormatR8: return 1;
+	case FormatR16: return 2;
+	case FormatRGBA16: return 8;
+	default: return 4;
+	}
+}
+
+bool PngDecoder::readHeader(const void* pData, size_t pSize, Image& pImage)
+{
+	Header header = {};
+	if (!isPng(pData, pSize) || !readChunks((const uint8_t*)pData, pSize, header, NULL))
+		return false;
+
+	pImage.width = header.width;
+	pImage.height = header.height;
+	pImage.format = outputFormat(header);
+	pImage.bytesPerRow = header.width * bytesPerPixel(pImage.format);
+	return true;
+}
+
+bool PngDecoder::decode(const void* pData, size_t pSize, Image& pImage)
+{
+	if (!readHeader(pData, pSize, pImage))
+		return false;
+	pImage.pixels.resize((size_t)pImage.bytesPerRow * pImage.height);
+	return decode(pData, pSize, pImage.pixels.data(), pImage.bytesPerRow);
+}
+
+bool PngDecoder::decode(const void* pData, size_t pSize, uint8_t* pPixels, size_t pRowPitch)
+{
+	const uint8_t* data = (const uint8_t*)pData;
+	if (!isPng(data, pSize))
+		return false;
+
+	//gather the compressed data of all IDAT chunks
+	Header header = {};
+	vector<uint8_t> compressed;
+	if (!readChunks(data, pSize, header, &compressed))
+		return false;
+
+	int depth = header.bitDepth;
+
+	//filters work on whole bytes, sub byte pixels count as 1 byte
+	uint32_t filterBytesPerPixel = max(1, header.channels * depth / 8);
+
+	//size of the decompressed scanlines, each with its filter type byte
+	size_t scanlineBytes = 0;
+	if (header.interlaced) {
+		for (int pass = 0; pass < 7; ++pass) {
+			uint32_t passWidth = passSize(header.width, adam7[pass][0], adam7[pass][2]);
+			uint32_t passHeight = passSize(header.height, adam7[pass][1], adam7[pass][3]);
+			if (passWidth != 0)
+				scanlineBytes += (rowBytes(header, passWidth) + 1) * passHeight;
+		}
+	}
+	else {
+		scanlineBytes = (rowBytes(header, header.width) + 1) * header.height;
+	}
+
+	//zlib header: deflate, no preset dictionary. the adler32 at the end is not checked
+	if ((compressed[0] & 15) != 8 || (compressed[1] & 32) != 0 || ((compressed[0] << 8) | compressed[1]) % 31 != 0)
+		return false;
+	vector<uint8_t> scanlines(scanlineBytes);
+	if (!inflate(compressed.data(), compressed.size(), scanlines.data(), scanlines.size()))
+		return false;
+	vector<uint8_t>().swap(compressed);
+
+	uint32_t pixelBytes = bytesPerPixel(outputFormat(header));
+
+	if (!header.interlaced) {
+		size_t bytes = rowBytes(header, header.width);
+		if (!unfilter(scanlines.data(), bytes, header.height, filterBytesPerPixel))
+			return false;
+		for (uint32_t y = 0; y < header.height; ++y)
+			convertRow(header, scanlines.data() + y * (bytes + 1) + 1, pPixels + y * pRowPitch, header.width);
+		return true;
+	}
+
+	//every pass is a small image of its own, its rows are converted and then spread over the pixels they cover.
+	//the pixels are put together in memory first, writing single pixels all over pPixels is slow if it is write
+	//combined memory like a mapped upload heap
+	size_t packedRowBytes = (size_t)header.width * pixelBytes;
+	vector<uint8_t> pixels(packedRowBytes * header.height);
+	vector<uint8_t> passRow(packedRowBytes);
+	uint8_t* passScanlines = scanlines.data();
+	for (int pass = 0; pass < 7; ++pass) {
+		uint32_t passWidth = passSize(header.width, adam7[pass][0], adam7[pass][2]);
+		uint32_t passHeight = passSize(header.height, adam7[pass][1], adam7[pass][3]);
+		if (passWidth == 0 || passHeight == 0)
+			continue;
+		size_t bytes = rowBytes(header, passWidth);
+		if (!unfilter(passScanlines, bytes, passHeight, filterBytesPerPixel))
+			return false;
+		for (uint32_t y = 0; y < passHeight; ++y) {
+			convertRow(header, passScanlines + y * (bytes + 1) + 1, passRow.data(), passWidth);
+			uint8_t* target = pixels.data() + (size_t)(adam7[pass][1] + y * adam7[pass][3]) * packedRowBytes;
+			for (uint32_t x = 0; x < passWidth; ++x)
+				memcpy(target + (size_t)(adam7[pass][0] + x * adam7[pass][2]) * pixelBytes, passRow.data() + (size_t)x * pixelBytes, pixelBytes);
+		}
+		passScanlines += (bytes + 1) * passHeight;
+	}
+	for (uint32_t y = 0; y < header.height; ++y)
+		memcpy(pPixels + y * pRowPitch, pixels.data() + y * packedRowBytes, packedRowBytes);
+	return true;
+}
+
+bool PngDecoder::inflate(const void* pData, size_t pSize, uint8_t* pOutput, size_t pOutputSize)
+{
+	//skip the 2 byte zlib header
+	if (pSize < 2)
+		return false;
+	Inflater inflater((const uint8_t*)pData + 2, pSize - 2, pOutput, pOutputSize);
+	return inflater.run();
+}
+
+bool PngDecoder::unfilter(uint8_t* pScanlines, size_t pRowBytes, size_t pRowCount, uint32_t pBytesPerPixel)
+{
+#ifdef PNG_SSE2
+	if (pBytesPerPixel == 4)
+		return unfilterRows<4>(pScanlines, pRowBytes, pRowCount);
+	if (pBytesPerPixel == 3)
+		return unfilterRows<3>(pScanlines, pRowBytes, pRowCount);
+	return unfilterScalar(pScanlines, pRowBytes, pRowCount, pBytesPerPixel);
+#else
+	return unfilterScalar(pScanlines, pRowBytes, pRowCount, pBytesPerPixel);
+#endif
+}
+
+bool PngDecoder::unfilterScalar(uint8_t* pScanlines, size_t pRowBytes, size_t pRowCount, uint32_t pBytesPerPixel)
+{
+	vector<uint8_t> zeros(pRowBytes, 0);
+	const uint8_t* prior = zeros.data();
+	for (size_t y = 0; y < pRowCount; ++y) {
+		uint8_t* row = pScanlines + y * (pRowBytes + 1);
+		if (!unfilterRowScalar(row[0], row + 1, prior, pRowBytes, pBytesPerPixel))
+			return false;
+		prior = row + 1;
+	}
+	return true;
+}
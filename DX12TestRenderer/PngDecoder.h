@@ -0,0 +1,62 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * Decodes png files without WIC, so textures can be loaded and the asset pipeline measured on any platform.
+ * The zlib stream is inflated with table driven huffman decoding into one buffer of filtered scanlines, the scanlines
+ * are unfiltered in place (Sub, Up, Avg and Paeth use sse2 for 3 and 4 byte pixels where available) and converted to
+ * the pixel layout the WIC decoder (plus the conversions in TextureMaterial) gives for the same file:
+ * - 8 bit rgba and gray + alpha become bgra8, WIC decodes those to 32bppBGRA
+ * - 8 bit rgb and palette images become rgba8, 24bppBGR and the indexed formats of WIC are converted to 32bppRGBA
+ * - 1 to 8 bit gray becomes r8 and 16 bit gray r16
+ * - 16 bit rgb, rgba and gray + alpha become rgba16
+ * Rows are tightly packed like the WIC path (bytesPerRow is width * bytes per pixel), or written at the row pitch of
+ * the caller straight into its memory, a mapped upload heap for example, without a copy in between. Interlaced images are supported,
+ * color keys of gray and rgb images, gamma and color profiles are ignored like the WIC path ignores them.
+ */
+class PngDecoder
+{
+public:
+	enum Format {
+		FormatR8,		//DXGI_FORMAT_R8_UNORM
+		FormatR16,		//DXGI_FORMAT_R16_UNORM
+		FormatRGBA8,	//DXGI_FORMAT_R8G8B8A8_UNORM
+		FormatBGRA8,	//DXGI_FORMAT_B8G8R8A8_UNORM
+		FormatRGBA16	//DXGI_FORMAT_R16G16B16A16_UNORM
+	};
+
+	struct Image {
+		uint32_t width;
+		uint32_t height;
+		Format format;
+		uint32_t bytesPerRow;
+		std::vector<uint8_t> pixels;
+	};
+
+	//true if pData starts with the png signature
+	static bool isPng(const void* pData, size_t pSize);
+
+	static bool load(const std::string& pFileName, Image& pImage);
+	static bool decode(const void* pData, size_t pSize, Image& pImage);
+
+	//the size and format decode gives, from the chunks before the pixel data. pImage.pixels is left as it is
+	static bool readHeader(const void* pData, size_t pSize, Image& pImage);
+
+	//decode into pPixels, rows of bytesPerRow (see readHeader) pRowPitch apart. rows are written once, top to bottom
+	static bool decode(const void* pData, size_t pSize, uint8_t* pPixels, size_t pRowPitch);
+
+	static uint32_t bytesPerPixel(Format pFormat);
+
+	//inflate a zlib stream (rfc 1950/1951) into pOutput, which has to be exactly the size of the decompressed data
+	static bool inflate(const void* pData, size_t pSize, uint8_t* pOutput, size_t pOutputSize);
+
+	//undo the filters of pRowCount scanlines of pRowBytes bytes, each preceded by its filter type byte, in place
+	static bool unfilter(uint8_t* pScanlines, size_t pRowBytes, size_t pRowCount, uint32_t pBytesPerPixel);
+
+	//scalar only version of unfilter, the reference for the simd path
+	static bool unfilterScalar(uint8_t* pScanlines, size_t pRowBytes, size_t pRowCount, uint32_t pBytesPerPixel);
+};
@@ -136,6 +136,8 @@ bool Renderer::InitD3D() {
 	HRESULT hr;
 	IDXGIFactory4* dxgiFactory;
 
+	initStart = std::chrono::high_resolution_clock::now();
+
 	// create the device //
 	{
 		hr = CreateDXGIFactory1(IID_PPV_ARGS(&dxgiFactory));
@@ -298,15 +300,37 @@ bool Renderer::InitD3D() {
 	}
 
 	//create root signature
-	mat1 = new TextureMaterial(device, commandList, L"dive_scooter_Base1k.png");
-	mat2 = new TextureMaterial(device, commandList, L"MantaRay_Base.png");
+	depthMaterial = new DepthMaterial(device, commandList);
 
 	///////////
 
-	// Load the mesh data //
+	// Load the mesh and texture data //
 	{
-		diveScooterMesh = Mesh::load("dive_scooter.obj", device, commandList);
-		mantaMesh = Mesh::load("MantaRay.obj", device, commandList);
+		//the files are read and decoded on worker threads, UpdatePipeline uploads them when they are done
+		meshBufferHeap = new ResourceHeap(device, D3D12_HEAP_TYPE_DEFAULT, D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS, 64ull * 1024 * 1024);
+		meshUploadHeap = new ResourceHeap(device, D3D12_HEAP_TYPE_UPLOAD, D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS, 64ull * 1024 * 1024);
+		Mesh::bufferHeap = meshBufferHeap;
+		Mesh::uploadHeap = meshUploadHeap;
+		meshRegistry = new MeshRegistry(device, commandList);
+		textureRegistry = new TextureRegistry(device, commandList);
+		TextureStreamer::Settings streaming = textureRegistry->getStreamingSettings();
+		streaming.budgetBytes = textureBudget;
+		textureRegistry->setStreamingSettings(streaming);
+		assetLoader = new AssetLoader(meshRegistry, textureRegistry);
+		std::cout << "Texture pixel conversion with " << PixelConverter::name(PixelConverter::supportedInstructions()) << std::endl;
+		diveScooterTexture = assetLoader->loadTexture(L"dive_scooter_Base1k.png");
+		mantaTexture = assetLoader->loadTexture(L"MantaRay_Base.png");
+		diveScooterMesh = assetLoader->loadMesh("dive_scooter.obj");
+		mantaMesh = assetLoader->loadMesh("MantaRay.obj");
+
+		//wait for everything and upload it with the initial command list. images go back to the workers once
+		//their upload heap is created, so it takes a few rounds
+		if (!asyncAssetLoading) {
+			while (!assetLoader->isIdle()) {
+				assetLoader->waitIdle();
+				assetLoader->processUploads(device, commandList);
+			}
+		}
 	}
 
 	//create a depth stencil descriptor heap so we can get a pointer to the depth stencil buffer
@@ -345,50 +369,18 @@ bool Renderer::InitD3D() {
 
 	device->CreateDepthStencilView(depthStencilBuffer, &depthStencilDesc, dsDescriptorHeap->GetCPUDescriptorHandleForHeapStart());
 
-	//create a constant buffer resource heap
-	//unlike the other upload buffers this one is not temporary
-	//since the data in this buffer will likely be updated every frame there is no point in copying the data to a default heap
+	//the mesh and material are set once they are loaded
 	go1 = new GameObject("", vec3(0,0,0));
-	go1->SetMesh(diveScooterMesh);
-	go1->SetMaterial(mat1);
 
 	go2 = new GameObject("", vec3(1.5f, 0, 0));
 	go2->scale(vec3(0.02f));
-	go2->SetMesh(mantaMesh);
-	go2->SetMaterial(mat2);
-
-	//create a resource heap, descriptor heap, and pointer to cbv for every framebuffer
-	for (int i = 0; i < frameBufferCount; i++)
-	{
-		hr = device->CreateCommittedResource(
-			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
-			D3D12_HEAP_FLAG_NONE,
-			&CD3DX12_RESOURCE_DESC::Buffer(1024 * 64), //must be a multiple of 64kb thus 64 bytes * 1024 (4mb multiple for multi-sampled textures)
-			D3D12_RESOURCE_STATE_GENERIC_READ,
-			nullptr,
-			IID_PPV_ARGS(&constantBufferUploadHeaps[i])
-		);
-		if (FAILED(hr)) {
-			Running = false;
-			return false;
-		}
-
-		constantBufferUploadHeaps[i]->SetName(L"Constant Buffer Upload Resource Heap");
+	//go2 moves along with go1
+	go1->Add(go2);
+	AssignLoadedAssets();
 
-		//this shouldn't need te be done inside the loop
-		ZeroMemory(&cbPerObject, sizeof(cbPerObject));
-
-		CD3DX12_RANGE readRange(0, 0); //read range is less then 0, indicates that we will not be reading this resource from the cpu
-
-		//map the resource heap to get a gpu virtual address to the beginning of the heap
-		hr = constantBufferUploadHeaps[i]->Map(0, &readRange, reinterpret_cast<void**>(&cbvGPUAddress[i]));
-
-		//because of the constant read alignment requirements, constant buffer views must be 256 byte aligned. since our buffers are smaller than 256 bits
-		//we just need to add the spacing between the two buffers, so the second buffer starts 256 byte from the beginning of the heap
-		//
-		//memcpy(cbvGPUAddress[i], &cbPerObject, sizeof(cbPerObject)); //cube1's constant buffer data
-		//memcpy(cbvGPUAddress[i] + ConstantBufferPerObjectAlignedSize, &cbPerObject, sizeof(cbPerObject)); //cube2's constant buffer data
-	}
+	//the constants are written to a ring of upload memory every frame. unlike the other upload buffers this one is
+	//not temporary, since the data will be updated every frame there is no point in copying it to a default heap
+	constantRing = new UploadRing(device, constantRingSize);
 
 	//new we execute the command list and upload the initial assets (triangle data)
 	commandList->Close();
@@ -402,9 +394,9 @@ bool Renderer::InitD3D() {
 		Running = false;
 		return false;
 	}
-
-	////we are done with the image data. it's uploaded to the gpu now. we can free up the (ram) memory
-	//delete imageData; TODO
+	//the meshes and textures can let go of their upload data once this fence value is reached
+	meshRegistry->setUploadFence(fence[frameIndex], fenceValue[frameIndex]);
+	textureRegistry->setUploadFence(fence[frameIndex], fenceValue[frameIndex]);
 
 	//setup viewport and scene objects //
 	{
@@ -423,7 +415,7 @@ bool Renderer::InitD3D() {
 		scissorRect.bottom = Height;
 
 		//build projection and view matrix
-		cameraProjMat = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+		cameraProjMat = glm::perspective(glm::radians(cameraFieldOfView), 16.0f / 9.0f, 0.1f, 1000.0f);
 
 		//set starting camera state
 		camPos = glm::vec3(0, 2, -4);
@@ -442,21 +434,30 @@ bool Renderer::InitD3D() {
 void Renderer::Update() {
 	//update app logic
 
-	// update constant buffer for cube1
-	// create the wvp matrix and store in constant buffer
-	go1->SetTransform(glm::rotate(go1->GetTransform(), .0001f, glm::vec3(1, 2, 3)));
+	//drop the mesh and texture upload data as soon as the gpu copied it, getStats tells what is left
+	meshRegistry->releaseUploadData();
+	textureRegistry->releaseUploadData();
 
-	glm::mat4 cb = glm::transpose(cameraProjMat * cameraViewMat * go1->GetTransform());
-													  // copy our ConstantBuffer instance to the mapped constant buffer resource
-	memcpy(cbvGPUAddress[frameIndex] + ConstantBufferPerObjectAlignedSize * go1->_constantBufferID, &cb, sizeof(cb));
+	// update the transform of cube1, UpdatePipeline writes the constant buffers
+	go1->SetTransform(glm::rotate(go1->GetTransform(), .0001f, glm::vec3(1, 2, 3)));
 
 	// now do cube2's world matrix
 	// create rotation matrices for cube2
 	go2->SetTransform(glm::rotate(go2->GetTransform(), .0001f, glm::vec3(3, 2, 1)));
-	cb = glm::transpose(cameraProjMat * cameraViewMat * go1->GetTransform() * go2->GetTransform());
 
-	// copy our ConstantBuffer instance to the mapped constant buffer resource
-	memcpy(cbvGPUAddress[frameIndex] + ConstantBufferPerObjectAlignedSize * go2->_constantBufferID, &cb, sizeof(cb));
+	//pick the level of detail from the screen space error
+	float pixelsPerUnit = Height / (2.0f * tanf(glm::radians(cameraFieldOfView) * 0.5f));
+	go1->SelectLod(camPos, pixelsPerUnit, lodMaxPixelError);
+	go2->SelectLod(camPos, pixelsPerUnit, lodMaxPixelError);
+
+	//ask for the texture mips the objects need on screen, the streamer loads them in UpdatePipeline
+	GameObject* objects[] = { go1, go2 };
+	for (size_t i = 0; i < _countof(objects); ++i) {
+		if (objects[i]->GetMesh() == NULL || objects[i]->GetMaterial() == NULL)
+			continue;
+		UINT texture = objects[i]->GetMaterial()->GetTexture();
+		textureRegistry->requestMip(texture, objects[i]->SelectTextureMip(camPos, pixelsPerUnit, textureRegistry->getSize(texture)));
+	}
 }
 
 void Renderer::UpdatePipeline() {
@@ -478,6 +479,45 @@ void Renderer::UpdatePipeline() {
 	if (FAILED(hr))
 		Running = false;
 
+	//create the gpu resources of the assets that finished loading, their uploads are recorded before this frame's draws
+	if (assetLoader->processUploads(device, commandList) > 0 || !assetsLoaded)
+		AssignLoadedAssets();
+
+	//load and evict texture mips for the requests of this frame, also recorded before the draws
+	if (textureRegistry->updateStreaming() > 0) {
+		streamedMips += textureRegistry->getStreamingStats().loads;
+		evictedMips += textureRegistry->getStreamingStats().evictions;
+	}
+
+	//pack the textures once they are all on the gpu, the copies are recorded before the draws that sample the pages
+	GameObject* objects[] = { go1, go2 };
+	if (packTextures && assetsLoaded && !texturesPacked && textureRegistry->getStats().pendingUploads == 0) {
+		texturesPacked = true;
+		std::vector<TextureRegistry::Handle> sceneTextures;
+		for (size_t i = 0; i < _countof(objects); ++i) {
+			if (objects[i]->GetMaterial() != NULL)
+				sceneTextures.push_back(objects[i]->GetMaterial()->GetTexture());
+		}
+		unsigned bindingsBefore = textureRegistry->countBindings(sceneTextures);
+		unsigned packed = textureRegistry->packAtlases(atlasSettings);
+		TextureRegistry::Stats textureStats = textureRegistry->getStats();
+		std::cout << "Texture atlases: " << packed << " textures packed into " << textureStats.atlases << " pages, the scene binds "
+			<< textureRegistry->countBindings(sceneTextures) << " descriptor tables (" << bindingsBefore << " before)" << std::endl;
+	}
+
+	//the constants of every object go to the ring, the frames the gpu is done with are free again.
+	//the uv transforms are written here and not in Update, packing changes them for the draws of this frame
+	constantRing->reclaim();
+	D3D12_GPU_VIRTUAL_ADDRESS constants[_countof(objects)];
+	for (size_t i = 0; i < _countof(objects); ++i) {
+		ConstantBufferPerObject cb;
+		cb.wvpMat = glm::transpose(cameraProjMat * cameraViewMat * objects[i]->GetWorldTransform());
+		cb.uvTransform = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f);
+		if (objects[i]->GetMaterial() != NULL)
+			textureRegistry->getUvTransform(objects[i]->GetMaterial()->GetTexture(), &cb.uvTransform[0]);
+		constants[i] = constantRing->write(&cb, sizeof(cb));
+	}
+
 	// this is where the commands are recorded into the command list //
 
 	//transition the 'frameIndex' render target from the present state to the render target state so the command list drawas to it starting from here
@@ -504,14 +544,24 @@ void Renderer::UpdatePipeline() {
 	commandList->RSSetScissorRects(1, &scissorRect);
 	commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
-	//first cube
-	mat1->Render(diveScooterMesh, constantBufferUploadHeaps[frameIndex]->GetGPUVirtualAddress() + ConstantBufferPerObjectAlignedSize * go1->_constantBufferID);
+	//depth prepass, positions only and no render target
+	if (depthPrepass) {
+		commandList->OMSetRenderTargets(0, nullptr, FALSE, &dsvHandle);
+		for (size_t i = 0; i < _countof(objects); ++i) {
+			if (objects[i]->GetMesh() != NULL)
+				depthMaterial->Render(objects[i]->GetMesh(), constants[i], objects[i]->GetLod());
+		}
+		commandList->OMSetRenderTargets(1, &rtvHandle, FALSE, &dsvHandle);
+	}
 
-	//second cube
+	//the command list was reset, and the depth prepass set its own pipeline
+	TextureMaterial::ResetBindings();
 
-	//set cube2's constant buffer. we add the size of the ConstantBufferPerObject (256 bits) to the constatn buffer address.
-	//this is because cube2's constant buffer data is stored after the first one(256 bits from the start of the heap)	
-	mat2->Render(mantaMesh, constantBufferUploadHeaps[frameIndex]->GetGPUVirtualAddress() + ConstantBufferPerObjectAlignedSize * go2->_constantBufferID);
+	//objects are drawn once their mesh and texture are loaded, each with the constant buffer it got from the ring
+	for (size_t i = 0; i < _countof(objects); ++i) {
+		if (objects[i]->GetMesh() != NULL && objects[i]->GetMaterial() != NULL)
+			objects[i]->GetMaterial()->Render(objects[i]->GetMesh(), constants[i], objects[i]->GetLod());
+	}
 
 	//transition the 'frameIndex' render target from the render target state to the present state.
 	//if the debug layer is enabled you will receive an error if present is called on a render target that is not in present state
@@ -523,6 +573,45 @@ void Renderer::UpdatePipeline() {
 		Running = false;
 }
 
+void Renderer::AssignLoadedAssets() {
+	if (go1->GetMesh() == NULL && diveScooterMesh->isReady())
+		go1->SetMesh(diveScooterMesh->mesh);
+	if (go1->GetMaterial() == NULL && diveScooterTexture->isReady())
+		go1->SetMaterial(diveScooterTexture->material);
+	if (go2->GetMesh() == NULL && mantaMesh->isReady())
+		go2->SetMesh(mantaMesh->mesh);
+	if (go2->GetMaterial() == NULL && mantaTexture->isReady())
+		go2->SetMaterial(mantaTexture->material);
+
+	if (assetsLoaded || !assetLoader->isIdle())
+		return;
+	assetsLoaded = true;
+
+	double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - initStart).count();
+	AssetLoader::Stats loadStats = assetLoader->getStats();
+	std::cout << "Assets loaded after " << seconds * 1000.0 << " ms: " << loadStats.ready << " ready, " << loadStats.failed << " failed, "
+		<< loadStats.loadSeconds * 1000.0 << " ms loading on the workers" << std::endl;
+
+	MeshRegistry::Stats meshStats = meshRegistry->getStats();
+	std::cout << "Meshes: " << meshStats.meshes << " unique, " << meshStats.references << " references, "
+		<< meshStats.loadSeconds * 1000.0 << " ms loading (" << meshStats.savedSeconds * 1000.0 << " ms saved), "
+		<< meshStats.gpuBytes / 1024 << " KB gpu memory (" << meshStats.savedGpuBytes / 1024 << " KB saved), " << meshStats.cpuBytes / 1024 << " KB cpu memory" << std::endl;
+
+	TextureRegistry::Stats textureStats = textureRegistry->getStats();
+	std::cout << "Textures: " << textureStats.textures << " unique, " << textureStats.references << " references, " << textureStats.loads << " loaded ("
+		<< textureStats.pathHits << " shared by path, " << textureStats.contentHits << " by content), " << textureStats.loadSeconds * 1000.0 << " ms loading ("
+		<< textureStats.savedSeconds * 1000.0 << " ms saved), " << textureStats.gpuBytes / 1024 << " KB gpu memory (" << textureStats.savedGpuBytes / 1024 << " KB saved)" << std::endl;
+
+	LogHeapStats("Mesh buffer heap", meshBufferHeap->getStats());
+	LogHeapStats("Texture heap", textureRegistry->getTextureHeapStats());
+}
+
+void Renderer::LogHeapStats(const char* pName, const ResourceHeap::Stats& pStats) {
+	std::cout << pName << ": " << pStats.resources << " placed resources in " << pStats.blocks << " blocks, " << pStats.usedBytes / 1024 << " of "
+		<< pStats.blockBytes / 1024 << " KB used, " << pStats.committed << " committed, largest free range " << pStats.largestFree / 1024
+		<< " KB (fragmentation " << pStats.fragmentation << ")" << std::endl;
+}
+
 void Renderer::Render() {
 	HRESULT hr;
 
@@ -538,11 +627,22 @@ void Renderer::Render() {
 	hr = commandQueue->Signal(fence[frameIndex], fenceValue[frameIndex]);
 	if (FAILED(hr))
 		Running = false;
+	//meshes and textures uploaded this frame can let go of their upload data once this fence value is reached
+	meshRegistry->setUploadFence(fence[frameIndex], fenceValue[frameIndex]);
+	textureRegistry->setUploadFence(fence[frameIndex], fenceValue[frameIndex]);
+	//and the constants of this frame are free again once it is reached
+	constantRing->finishFrame(fence[frameIndex], fenceValue[frameIndex]);
 
 	//present the current backbuffer
 	hr = swapChain->Present(0, 0);
 	if (FAILED(hr))
 		Running = false;
+
+	if (frameCount == 0) {
+		double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - initStart).count();
+		std::cout << "First frame after " << seconds * 1000.0 << " ms (" << (asyncAssetLoading ? "assets loading in the background" : "waited for the assets") << ")" << std::endl;
+	}
+	frameCount++;
 }
 
 void Renderer::Cleanup() {
@@ -558,6 +658,59 @@ void Renderer::Cleanup() {
 	if (swapChain->GetFullscreenState(&fs, NULL))
 		swapChain->SetFullscreenState(false, NULL);
 
+	if (frameCount > 0) {
+		std::cout << "Vertex fetch: " << Mesh::fetchStats.draws / frameCount << " draws, " << Mesh::fetchStats.bytes / frameCount / 1024 << " KB per frame ("
+			<< Mesh::fetchStats.interleavedBytes / frameCount / 1024 << " KB with interleaved full vertices)" << std::endl;
+		const TextureMaterial::BindStats& bindStats = TextureMaterial::bindStats;
+		std::cout << "Material bindings: " << bindStats.draws / frameCount << " draws, " << bindStats.rootSignatures / frameCount << " root signatures, "
+			<< bindStats.pipelineStates / frameCount << " pipeline states, " << bindStats.descriptorHeaps / frameCount << " descriptor heaps, "
+			<< bindStats.descriptorTables / frameCount << " descriptor tables per frame" << std::endl;
+		RingAllocator::Stats ringStats = constantRing->getStats();
+		std::cout << "Constant ring: " << ringStats.capacity / 1024 << " KB (grown " << ringStats.grows << " times), " << ringStats.highWater / 1024
+			<< " KB high water, " << ringStats.frameHighWater << " bytes in a frame at most, " << ringStats.allocations / frameCount << " allocations per frame" << std::endl;
+		const TextureStreamer::Stats& streamStats = textureRegistry->getStreamingStats();
+		std::cout << "Texture streaming: " << streamedMips << " mips loaded, " << evictedMips << " evicted, " << streamStats.residentBytes / 1024 << " KB of "
+			<< streamStats.budgetBytes / 1024 << " KB budget resident at the end (" << streamStats.starved << " textures starved)" << std::endl;
+		//the gpu is idle, every upload is done and the meshes keep only what Mesh::cpuResidency says
+		meshRegistry->releaseUploadData();
+		MeshRegistry::Stats meshStats = meshRegistry->getStats();
+		std::cout << "Mesh memory: " << meshStats.cpuBytes / 1024 << " KB cpu, " << meshStats.gpuBytes / 1024 << " KB gpu at the end (cpu residency "
+			<< Mesh::cpuResidency << ", " << meshStats.pendingUploads << " uploads pending)" << std::endl;
+	}
+	delete constantRing;
+	constantRing = nullptr;
+
+	delete depthMaterial;
+	depthMaterial = nullptr;
+
+	//stop the workers before anything they load into goes away
+	delete assetLoader;
+	assetLoader = nullptr;
+
+	//the gpu is idle now, so the meshes and textures can be released
+	if (meshRegistry) {
+		if (diveScooterMesh && diveScooterMesh->isReady())
+			meshRegistry->release(diveScooterMesh->mesh);
+		if (mantaMesh && mantaMesh->isReady())
+			meshRegistry->release(mantaMesh->mesh);
+		delete meshRegistry;
+		meshRegistry = nullptr;
+	}
+	diveScooterMesh.reset();
+	mantaMesh.reset();
+	//every mesh is gone, and with it everything placed in the heaps
+	Mesh::bufferHeap = nullptr;
+	Mesh::uploadHeap = nullptr;
+	delete meshBufferHeap;
+	meshBufferHeap = nullptr;
+	delete meshUploadHeap;
+	meshUploadHeap = nullptr;
+	//the materials give their textures back to the registry
+	diveScooterTexture.reset();
+	mantaTexture.reset();
+	delete textureRegistry;
+	textureRegistry = nullptr;
+
 	SAFE_RELEASE(device);
 	SAFE_RELEASE(swapChain);
 	SAFE_RELEASE(commandQueue);
@@ -573,7 +726,6 @@ void Renderer::Cleanup() {
 		SAFE_RELEASE(renderTargets[i]);
 		SAFE_RELEASE(commandAllocator[i]);
 		SAFE_RELEASE(fence[i]);
-		//SAFE_RELEASE(constantBufferUploadHeaps[i]);
 	}
 }
 
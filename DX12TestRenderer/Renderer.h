@@ -12,10 +12,16 @@
 #include "d3dx12.h"
 #include <string>
 #include <iostream>
+#include <chrono>
 #include "Mesh.h"
+#include "MeshRegistry.h"
+#include "TextureRegistry.h"
+#include "AssetLoader.h"
 #include "TextureMaterial.h"
+#include "DepthMaterial.h"
 #include "Debug.h"
 #include "GameObject.h"
+#include "UploadRing.h"
 #include "glm.h"
 
 // this will only call release if an object exists (prevents exceptions calling release on non existant objects)
@@ -79,16 +85,14 @@ public:
 
 	int rtvDescriptorSize; //size of the rtv descriptor on the device (all front and back buffers will be the same size)
 
-	ID3D12Resource* constantBufferUploadHeaps[frameBufferCount]; //this is the memory where the constant buffer will be placed TODO
+	UploadRing* constantRing = nullptr; //the constants of the objects are written to it every frame, it grows with the scene
+	UINT64 constantRingSize = 64 * 1024; //to start with, a multiple of 64 KB
 
-	UINT8* cbvGPUAddress[frameBufferCount]; // pointers to the memory locations we get when we map the constant buffers
-											//constant buffers must be 256 byte aligned
+	//constant buffers must be 256 byte aligned, the ring aligns every object
 	struct ConstantBufferPerObject {
 		mat4 wvpMat;
+		glm::vec4 uvTransform; //into the atlas page of the texture, TextureRegistry::getUvTransform
 	};
-	int ConstantBufferPerObjectAlignedSize = (sizeof(ConstantBufferPerObject) + 255) & ~255;
-
-	ConstantBufferPerObject cbPerObject;
 
 	D3D12_VIEWPORT viewport; //area that the rasterizer will be streched to.
 
@@ -98,15 +102,40 @@ public:
 
 	ID3D12DescriptorHeap* dsDescriptorHeap; //this is a heap fo the depth/stencil descriptor
 
-	Mesh* diveScooterMesh;
-	Mesh* mantaMesh;
+	MeshRegistry* meshRegistry = nullptr; //shares meshes that are used by more than one object
+	TextureRegistry* textureRegistry = nullptr; //shares textures between materials, owns the texture descriptor heap
+	ResourceHeap* meshBufferHeap = nullptr; //the vertex and index buffers are placed in it, see Mesh::bufferHeap
+	ResourceHeap* meshUploadHeap = nullptr; //and their upload buffers in this one
+
+	AssetLoader* assetLoader = nullptr; //loads the meshes and textures on worker threads
+	bool asyncAssetLoading = true; //start rendering while the assets load, otherwise InitD3D waits for them
+
+	AssetLoader::MeshHandle diveScooterMesh;
+	AssetLoader::MeshHandle mantaMesh;
+
+	AssetLoader::TextureHandle diveScooterTexture;
+	AssetLoader::TextureHandle mantaTexture;
+
+	std::chrono::high_resolution_clock::time_point initStart; //for the time to first frame and until all assets are loaded
+	bool assetsLoaded = false;
 
-	TextureMaterial* mat1;
-	TextureMaterial* mat2;
+	DepthMaterial* depthMaterial = nullptr; //position only pipeline for the depth prepass
+	bool depthPrepass = false; //lay down depth first so the color pass only shades visible pixels
+
+	unsigned frameCount = 0;
 
 	GameObject* go1;
 	GameObject* go2;
 
+	float cameraFieldOfView = 45.0f; //vertical, in degrees
+	float lodMaxPixelError = 1.0f; //lods are picked so their error stays below this many pixels
+	UINT64 textureBudget = 256ull * 1024 * 1024; //gpu memory the streamed texture mips may use
+	unsigned streamedMips = 0; //mips the streamer loaded and evicted over the run, logged in Cleanup
+	unsigned evictedMips = 0;
+	bool packTextures = true; //pack the small textures into atlas pages once they are loaded, so the materials share descriptor tables
+	TextureRegistry::AtlasSettings atlasSettings = { 2048, 1024, 16 };
+	bool texturesPacked = false;
+
 	glm::mat4 cameraProjMat;
 	glm::mat4 cameraViewMat;
 
@@ -132,6 +161,12 @@ public:
 	//update the direct3d pipeline (update the command list)
 	void UpdatePipeline();
 
+	//give the game objects the meshes and textures that are ready
+	void AssignLoadedAssets();
+
+	//how full and fragmented the blocks of a resource heap are
+	static void LogHeapStats(const char* pName, const ResourceHeap::Stats& pStats);
+
 	//execute the command list
 	void Render();
 
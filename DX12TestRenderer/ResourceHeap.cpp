@@ -0,0 +1,145 @@
+#include "ResourceHeap.h"
+
+using namespace std;
+
+ResourceHeap::ResourceHeap(ID3D12Device* pDevice, D3D12_HEAP_TYPE pType, D3D12_HEAP_FLAGS pFlags, uint64_t pBlockSize)
+	: _device(pDevice), _type(pType), _flags(pFlags), _blockSize(pBlockSize)
+{
+}
+
+ResourceHeap::~ResourceHeap()
+{
+	for (size_t i = 0; i < _blocks.size(); ++i) {
+		if (_blocks[i].heap) _blocks[i].heap->Release();
+		delete _blocks[i].allocator;
+	}
+}
+
+ID3D12Resource* ResourceHeap::create(const D3D12_RESOURCE_DESC& pDesc, D3D12_RESOURCE_STATES pInitialState)
+{
+	//textures of at most 64 KB that aren't render targets can be placed at 4 KB, the driver says if this one can
+	D3D12_RESOURCE_DESC desc = pDesc;
+	D3D12_RESOURCE_ALLOCATION_INFO info = {};
+	bool smallAlignment = desc.Dimension != D3D12_RESOURCE_DIMENSION_BUFFER && desc.SampleDesc.Count <= 1 &&
+		(desc.Flags & (D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL)) == 0;
+	if (smallAlignment) {
+		desc.Alignment = D3D12_SMALL_RESOURCE_PLACEMENT_ALIGNMENT;
+		info = _device->GetResourceAllocationInfo(0, 1, &desc);
+		smallAlignment = info.Alignment == D3D12_SMALL_RESOURCE_PLACEMENT_ALIGNMENT;
+	}
+	if (!smallAlignment) {
+		desc.Alignment = 0;
+		info = _device->GetResourceAllocationInfo(0, 1, &desc);
+	}
+
+	lock_guard<mutex> lock(_mutex);
+	ID3D12Resource* resource;
+	Placement placement = { HeapAllocator::invalidHandle, HeapAllocator::invalidHandle };
+	if (info.SizeInBytes > _blockSize)
+		return _createCommitted(pDesc, pInitialState);
+
+	//the first block it fits in, a new one if it fits nowhere
+	uint32_t unused = HeapAllocator::invalidHandle;
+	for (uint32_t i = 0; i < (uint32_t)_blocks.size() && placement.block == HeapAllocator::invalidHandle; ++i) {
+		if (_blocks[i].heap == NULL) {
+			unused = i;
+			continue;
+		}
+		placement.allocation = _blocks[i].allocator->allocate(info.SizeInBytes, info.Alignment);
+		if (placement.allocation != HeapAllocator::invalidHandle)
+			placement.block = i;
+	}
+	if (placement.block == HeapAllocator::invalidHandle) {
+		//allocated before the heap is created, what doesn't fit an empty block (with its alignment) is committed
+		Block block = { NULL, new HeapAllocator(_blockSize, D3D12_SMALL_RESOURCE_PLACEMENT_ALIGNMENT) };
+		placement.allocation = block.allocator->allocate(info.SizeInBytes, info.Alignment);
+		if (placement.allocation == HeapAllocator::invalidHandle) {
+			delete block.allocator;
+			return _createCommitted(pDesc, pInitialState);
+		}
+
+		CD3DX12_HEAP_DESC heapDesc(_blockSize, _type, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT, _flags);
+		HRESULT hr = _device->CreateHeap(&heapDesc, IID_PPV_ARGS(&block.heap));
+		if (FAILED(hr)) {
+			delete block.allocator;
+			ThrowIfFailed(hr);
+		}
+		if (unused == HeapAllocator::invalidHandle) {
+			unused = (uint32_t)_blocks.size();
+			_blocks.push_back(block);
+		}
+		else {
+			_blocks[unused] = block;
+		}
+		placement.block = unused;
+	}
+
+	Block& block = _blocks[placement.block];
+	HRESULT hr = _device->CreatePlacedResource(block.heap, block.allocator->getOffset(placement.allocation), &desc, pInitialState, nullptr, IID_PPV_ARGS(&resource));
+	if (FAILED(hr)) {
+		block.allocator->release(placement.allocation);
+		ThrowIfFailed(hr);
+	}
+	_placements[resource] = placement;
+	return resource;
+}
+
+ID3D12Resource* ResourceHeap::_createCommitted(const D3D12_RESOURCE_DESC& pDesc, D3D12_RESOURCE_STATES pInitialState)
+{
+	ID3D12Resource* resource;
+	ThrowIfFailed(_device->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(_type),
+		D3D12_HEAP_FLAG_NONE,
+		&pDesc,
+		pInitialState,
+		nullptr,
+		IID_PPV_ARGS(&resource)));
+	Placement placement = { HeapAllocator::invalidHandle, HeapAllocator::invalidHandle };
+	_placements[resource] = placement;
+	return resource;
+}
+
+void ResourceHeap::release(ID3D12Resource* pResource)
+{
+	lock_guard<mutex> lock(_mutex);
+	pResource->Release();
+	auto found = _placements.find(pResource);
+	if (found == _placements.end())
+		return;
+	Placement placement = found->second;
+	_placements.erase(found);
+	if (placement.block == HeapAllocator::invalidHandle)
+		return;
+
+	Block& block = _blocks[placement.block];
+	block.allocator->release(placement.allocation);
+	//the first block is kept, so a heap that keeps being emptied and filled again doesn't create a block every time
+	if (block.allocator->empty() && placement.block > 0) {
+		block.heap->Release();
+		delete block.allocator;
+		block.heap = NULL;
+		block.allocator = NULL;
+	}
+}
+
+ResourceHeap::Stats ResourceHeap::getStats() const
+{
+	lock_guard<mutex> lock(_mutex);
+	Stats stats = {};
+	uint64_t freeBytes = 0;
+	for (size_t i = 0; i < _blocks.size(); ++i) {
+		if (_blocks[i].heap == NULL)
+			continue;
+		HeapAllocator::Stats blockStats = _blocks[i].allocator->getStats();
+		stats.blocks++;
+		stats.resources += blockStats.allocations;
+		stats.blockBytes += blockStats.size;
+		stats.usedBytes += blockStats.usedBytes;
+		freeBytes += blockStats.size - blockStats.usedBytes;
+		if (blockStats.largestFree > stats.largestFree)
+			stats.largestFree = blockStats.largestFree;
+	}
+	stats.committed = (unsigned)(_placements.size() - stats.resources);
+	stats.fragmentation = (freeBytes > 0) ? 1.0 - (double)stats.largestFree / freeBytes : 0.0;
+	return stats;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <cstdint>
+#include <windows.h>
+#include "d3dx12.h"
+#include <d3d12.h>
+#include "Debug.h"
+#include "HeapAllocator.h"
+
+/**
+ * Places resources in a few large ID3D12Heap blocks instead of giving every one a committed resource, which is a heap
+ * of its own. Each block is suballocated with a HeapAllocator, resources are placed at the size and alignment
+ * GetResourceAllocationInfo gives. Textures that are small enough get the 4 KB alignment instead of 64 KB. A new block
+ * is created when a resource fits none of them, a block is released again once it is empty (the first one stays).
+ * Resources that don't fit an empty block still get a committed resource.
+ * A heap holds one kind of resource, as with resource heap tier 1 buffers, render targets and other textures can't
+ * share a heap: pass D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS or D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES.
+ * Placed resources are not zeroed like committed ones, they start with whatever was in their memory before.
+ * create and release can be called from any thread. Only release once the gpu is done with the resource, its memory
+ * is handed out again right away.
+ */
+class ResourceHeap
+{
+public:
+	struct Stats {
+		unsigned blocks;
+		unsigned resources;		//placed in the blocks
+		unsigned committed;		//too big for a block
+		uint64_t blockBytes;	//of all blocks
+		uint64_t usedBytes;		//placed in them, with their alignment
+		uint64_t largestFree;	//the largest free range of a block
+		double fragmentation;	//1 - largestFree / free bytes of the blocks
+	};
+
+	//pBlockSize is a multiple of 64 KB
+	ResourceHeap(ID3D12Device* pDevice, D3D12_HEAP_TYPE pType, D3D12_HEAP_FLAGS pFlags, uint64_t pBlockSize);
+	//releases the blocks, every resource has to be released before
+	~ResourceHeap();
+
+	//create a resource in pInitialState like CreateCommittedResource would
+	ID3D12Resource* create(const D3D12_RESOURCE_DESC& pDesc, D3D12_RESOURCE_STATES pInitialState);
+	//release a resource of create and free its range. resources that weren't created here are just released
+	void release(ID3D12Resource* pResource);
+
+	Stats getStats() const;
+
+private:
+	struct Block {
+		ID3D12Heap* heap;	//NULL for a block that was released, its entry is reused
+		HeapAllocator* allocator;
+	};
+
+	struct Placement {
+		uint32_t block;		//invalidHandle for a committed resource
+		HeapAllocator::Handle allocation;
+	};
+
+	//a committed resource for what can't be placed in a block, with _mutex held
+	ID3D12Resource* _createCommitted(const D3D12_RESOURCE_DESC& pDesc, D3D12_RESOURCE_STATES pInitialState);
+
+	ID3D12Device* _device;
+	D3D12_HEAP_TYPE _type;
+	D3D12_HEAP_FLAGS _flags;
+	uint64_t _blockSize;
+
+	mutable std::mutex _mutex;
+	std::vector<Block> _blocks;
+	std::unordered_map<ID3D12Resource*, Placement> _placements;
+};
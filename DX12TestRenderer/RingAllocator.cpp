@@ -0,0 +1,89 @@
+#include "RingAllocator.h"
+
+using namespace std;
+
+RingAllocator::RingAllocator(uint64_t pCapacity)
+	: _capacity(pCapacity), _head(0), _tail(0), _frameAllocated(0), _highWater(0), _frameBytes(0), _frameHighWater(0), _allocations(0), _grows(0)
+{
+}
+
+uint64_t RingAllocator::allocate(uint64_t pSize, uint64_t pAlignment)
+{
+	if (pSize > _capacity)
+		return invalidOffset;
+
+	//an allocation doesn't wrap around, it goes to the start of the ring and the end is skipped
+	uint64_t start = (_head + pAlignment - 1) & ~(pAlignment - 1);
+	if (start % _capacity + pSize > _capacity)
+		start = (start / _capacity + 1) * _capacity;
+	if (start + pSize - _tail > _capacity)
+		return invalidOffset;
+
+	_frameAllocated += start + pSize - _head;
+	_head = start + pSize;
+	if (_head - _tail > _highWater)
+		_highWater = _head - _tail;
+	_allocations++;
+	return start % _capacity;
+}
+
+void RingAllocator::finishFrame(uint64_t pFenceValue)
+{
+	Frame frame = { pFenceValue, _head };
+	_frames.push_back(frame);
+	_frameBytes = _frameAllocated;
+	if (_frameAllocated > _frameHighWater)
+		_frameHighWater = _frameAllocated;
+	_frameAllocated = 0;
+}
+
+void RingAllocator::reclaim(uint64_t pCompletedValue)
+{
+	while (!_frames.empty() && _frames.front().fenceValue <= pCompletedValue)
+		releaseOldestFrame();
+}
+
+unsigned RingAllocator::getFramesInFlight() const
+{
+	return (unsigned)_frames.size();
+}
+
+uint64_t RingAllocator::getOldestFrameFence() const
+{
+	return _frames.front().fenceValue;
+}
+
+void RingAllocator::releaseOldestFrame()
+{
+	_tail = _frames.front().end;
+	_frames.pop_front();
+}
+
+void RingAllocator::grow(uint64_t pCapacity)
+{
+	//the part of the current frame that is in the old ring is kept with the frames before it
+	_frames.clear();
+	_capacity = pCapacity;
+	_head = 0;
+	_tail = 0;
+	_grows++;
+}
+
+uint64_t RingAllocator::getCapacity() const
+{
+	return _capacity;
+}
+
+RingAllocator::Stats RingAllocator::getStats() const
+{
+	Stats stats = {};
+	stats.capacity = _capacity;
+	stats.usedBytes = _head - _tail;
+	stats.highWater = _highWater;
+	stats.frameBytes = _frameBytes;
+	stats.frameHighWater = _frameHighWater;
+	stats.framesInFlight = (unsigned)_frames.size();
+	stats.allocations = _allocations;
+	stats.grows = _grows;
+	return stats;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <deque>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * Hands out offsets in a ring buffer for data that is written every frame, like the constants of the objects.
+ * Allocating just moves the head forward (to the start of the ring when the rest of the ring is too small), nothing
+ * is freed on its own: finishFrame tags everything allocated since the last call with the fence value the gpu
+ * signals after that frame, and reclaim moves the tail past the frames whose fence value was reached.
+ * When the ring is full, allocate fails and grow starts over with a bigger ring, all frames in flight stay in the
+ * old one (see UploadRing, which keeps the old buffer until their fence is reached).
+ * The high water marks say how big the ring needs to be for a scene.
+ * Device independent.
+ */
+class RingAllocator
+{
+public:
+	static const uint64_t invalidOffset = ~0ull;
+
+	struct Stats {
+		uint64_t capacity;
+		uint64_t usedBytes;			//between the tail and the head, with the alignment and the end skipped by a wrap
+		uint64_t highWater;			//the most usedBytes was, in any ring
+		uint64_t frameBytes;		//allocated in the last finished frame, with the alignment
+		uint64_t frameHighWater;	//the most allocated in one frame
+		unsigned framesInFlight;
+		unsigned allocations;		//in total
+		unsigned grows;
+	};
+
+	//pCapacity is a multiple of every alignment that is allocated with
+	RingAllocator(uint64_t pCapacity);
+
+	//pSize bytes at a multiple of pAlignment (a power of 2), invalidOffset if the ring is full
+	uint64_t allocate(uint64_t pSize, uint64_t pAlignment);
+
+	//the allocations since the last finishFrame are used by the gpu until pFenceValue is reached
+	void finishFrame(uint64_t pFenceValue);
+	//free the frames whose fence value is at most pCompletedValue, for fence values of one timeline
+	void reclaim(uint64_t pCompletedValue);
+
+	//frames in flight oldest first, for fences that aren't one timeline: check the oldest one and release it when it is done
+	unsigned getFramesInFlight() const;
+	uint64_t getOldestFrameFence() const;
+	void releaseOldestFrame();
+
+	//start over with an empty ring of pCapacity. the frames in flight are forgotten, whatever they were allocated in
+	//has to be kept until they are done. the current frame goes on in the new ring
+	void grow(uint64_t pCapacity);
+
+	uint64_t getCapacity() const;
+	Stats getStats() const;
+
+private:
+	struct Frame {
+		uint64_t fenceValue;
+		uint64_t end;		//the head when it was finished
+	};
+
+	//head and tail only grow, the offset in the ring is the position modulo the capacity
+	uint64_t _capacity;
+	uint64_t _head;
+	uint64_t _tail;
+	uint64_t _frameAllocated;	//this frame with its alignment, over all rings
+
+	std::deque<Frame> _frames;
+
+	uint64_t _highWater;
+	uint64_t _frameBytes;
+	uint64_t _frameHighWater;
+	unsigned _allocations;
+	unsigned _grows;
+};
@@ -0,0 +1,289 @@
+#include "TextureContainer.h"
+#include <cstring>
+
+using namespace std;
+
+namespace {
+	const uint8_t ktx2Identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+	//the "DDS " magic and the header, the DX10 header follows if the four cc says so
+	const size_t ddsHeaderSize = 4 + 124;
+	const size_t ddsDX10HeaderSize = 20;
+
+	const uint32_t ddsPixelFlagAlpha = 0x1;
+	const uint32_t ddsPixelFlagFourCC = 0x4;
+	const uint32_t ddsPixelFlagRGB = 0x40;
+	const uint32_t ddsPixelFlagLuminance = 0x20000;
+	const uint32_t ddsCaps2Cubemap = 0x200;
+	const uint32_t ddsCaps2AllFaces = 0xFC00;
+	const uint32_t ddsCaps2Volume = 0x200000;
+	const uint32_t ddsDimensionTexture2D = 3;
+	const uint32_t ddsMiscTextureCube = 0x4;
+
+	//the ktx2 header up to and including the index, the level index follows
+	const size_t ktx2HeaderSize = 80;
+	const size_t ktx2LevelSize = 24;
+
+	uint32_t read32(const uint8_t* pData) {
+		uint32_t value;
+		memcpy(&value, pData, 4);
+		return value;
+	}
+
+	uint64_t read64(const uint8_t* pData) {
+		uint64_t value;
+		memcpy(&value, pData, 8);
+		return value;
+	}
+
+	uint32_t fourCC(char a, char b, char c, char d) {
+		return (uint32_t)(uint8_t)a | ((uint32_t)(uint8_t)b << 8) | ((uint32_t)(uint8_t)c << 16) | ((uint32_t)(uint8_t)d << 24);
+	}
+
+	//DXGI_FORMAT of a dds file without the DX10 header, 0 if it isn't supported
+	uint32_t legacyDDSFormat(uint32_t pFlags, uint32_t pFourCC, uint32_t pBitCount, uint32_t pRed, uint32_t pGreen, uint32_t pBlue, uint32_t pAlpha) {
+		if (pFlags & ddsPixelFlagFourCC) {
+			if (pFourCC == fourCC('D', 'X', 'T', '1')) return 71;	//BC1_UNORM
+			if (pFourCC == fourCC('D', 'X', 'T', '2')) return 74;	//BC2_UNORM, premultiplied alpha isn't tracked
+			if (pFourCC == fourCC('D', 'X', 'T', '3')) return 74;
+			if (pFourCC == fourCC('D', 'X', 'T', '4')) return 77;	//BC3_UNORM
+			if (pFourCC == fourCC('D', 'X', 'T', '5')) return 77;
+			if (pFourCC == fourCC('A', 'T', 'I', '1')) return 80;	//BC4_UNORM
+			if (pFourCC == fourCC('B', 'C', '4', 'U')) return 80;
+			if (pFourCC == fourCC('B', 'C', '4', 'S')) return 81;	//BC4_SNORM
+			if (pFourCC == fourCC('A', 'T', 'I', '2')) return 83;	//BC5_UNORM
+			if (pFourCC == fourCC('B', 'C', '5', 'U')) return 83;
+			if (pFourCC == fourCC('B', 'C', '5', 'S')) return 84;	//BC5_SNORM
+			//D3DFORMAT values stored as the four cc
+			if (pFourCC == 36) return 11;	//A16B16G16R16 -> R16G16B16A16_UNORM
+			if (pFourCC == 113) return 10;	//A16B16G16R16F -> R16G16B16A16_FLOAT
+			if (pFourCC == 116) return 2;	//A32B32G32R32F -> R32G32B32A32_FLOAT
+			return 0;
+		}
+		if ((pFlags & ddsPixelFlagRGB) && pBitCount == 32) {
+			if (pRed == 0xff && pGreen == 0xff00 && pBlue == 0xff0000 && pAlpha == 0xff000000) return 28;	//R8G8B8A8_UNORM
+			if (pRed == 0xff0000 && pGreen == 0xff00 && pBlue == 0xff && pAlpha == 0xff000000) return 87;	//B8G8R8A8_UNORM
+			if (pRed == 0xff0000 && pGreen == 0xff00 && pBlue == 0xff && !(pFlags & ddsPixelFlagAlpha)) return 88;	//B8G8R8X8_UNORM
+			return 0;
+		}
+		if ((pFlags & ddsPixelFlagLuminance) && pBitCount == 8 && pRed == 0xff)
+			return 61;	//R8_UNORM
+		return 0;
+	}
+
+	//DXGI_FORMAT of a VkFormat, 0 if there is none or it isn't supported
+	uint32_t formatFromVulkan(uint32_t pFormat) {
+		switch (pFormat) {
+		case 9: return 61;		//R8_UNORM
+		case 16: return 49;		//R8G8_UNORM
+		case 37: return 28;		//R8G8B8A8_UNORM
+		case 43: return 29;		//R8G8B8A8_SRGB
+		case 44: return 87;		//B8G8R8A8_UNORM
+		case 50: return 91;		//B8G8R8A8_SRGB
+		case 70: return 56;		//R16_UNORM
+		case 91: return 11;		//R16G16B16A16_UNORM
+		case 97: return 10;		//R16G16B16A16_SFLOAT
+		case 109: return 2;		//R32G32B32A32_SFLOAT
+		case 131: case 133: return 71;	//BC1_RGB(A)_UNORM
+		case 132: case 134: return 72;	//BC1_RGB(A)_SRGB
+		case 135: return 74;	//BC2_UNORM
+		case 136: return 75;	//BC2_SRGB
+		case 137: return 77;	//BC3_UNORM
+		case 138: return 78;	//BC3_SRGB
+		case 139: return 80;	//BC4_UNORM
+		case 140: return 81;	//BC4_SNORM
+		case 141: return 83;	//BC5_UNORM
+		case 142: return 84;	//BC5_SNORM
+		case 143: return 95;	//BC6H_UFLOAT
+		case 144: return 96;	//BC6H_SFLOAT
+		case 145: return 98;	//BC7_UNORM
+		case 146: return 99;	//BC7_SRGB
+		default: return 0;
+		}
+	}
+
+	//the size checks shared by both containers
+	//sides up to D3D12_REQ_TEXTURE2D_U_OR_V_DIMENSION, which also keeps the row sizes of TextureLayout within 32 bits
+	bool validDescription(const TextureContainer::Description& pDescription) {
+		return pDescription.width > 0 && pDescription.height > 0 && pDescription.width <= 16384 && pDescription.height <= 16384
+			&& pDescription.arraySize > 0 && pDescription.arraySize <= 2048
+			&& pDescription.mipLevels <= TextureLayout::maxMipLevels(pDescription.width, pDescription.height)
+			&& TextureLayout::elementBytes(pDescription.format) != 0;
+	}
+
+	void setSubresource(TextureContainer::Subresource& pSubresource, const TextureContainer::Description& pDescription, uint32_t pMip, uint64_t pOffset) {
+		pSubresource.offset = pOffset;
+		pSubresource.width = ((pDescription.width >> pMip) > 0) ? pDescription.width >> pMip : 1;
+		pSubresource.height = ((pDescription.height >> pMip) > 0) ? pDescription.height >> pMip : 1;
+		TextureLayout::surfaceSize(pDescription.format, pSubresource.width, pSubresource.height, pSubresource.rowBytes, pSubresource.rows);
+	}
+
+	bool parseDDS(const uint8_t* pData, size_t pSize, TextureContainer::Description& pDescription) {
+		if (pSize < ddsHeaderSize || read32(pData + 4) != 124)
+			return false;
+
+		pDescription.height = read32(pData + 12);
+		pDescription.width = read32(pData + 16);
+		uint32_t mipCount = read32(pData + 28);
+		uint32_t pixelFlags = read32(pData + 80);
+		uint32_t pixelFourCC = read32(pData + 84);
+		uint32_t caps2 = read32(pData + 112);
+
+		//many writers leave out the mip count flag, so a count is used without it too
+		pDescription.mipLevels = (mipCount > 0) ? mipCount : 1;
+		pDescription.arraySize = 1;
+		pDescription.cubemap = false;
+
+		uint64_t offset = ddsHeaderSize;
+		if ((pixelFlags & ddsPixelFlagFourCC) && pixelFourCC == fourCC('D', 'X', '1', '0')) {
+			if (pSize < ddsHeaderSize + ddsDX10HeaderSize)
+				return false;
+			pDescription.format = read32(pData + ddsHeaderSize);
+			uint32_t dimension = read32(pData + ddsHeaderSize + 4);
+			uint32_t misc = read32(pData + ddsHeaderSize + 8);
+			pDescription.arraySize = read32(pData + ddsHeaderSize + 12);
+			if (dimension != ddsDimensionTexture2D)
+				return false;
+			if (misc & ddsMiscTextureCube) {
+				//the count is of cubes, checked before it is multiplied so a huge one can't wrap around
+				if (pDescription.arraySize > 2048 / 6)
+					return false;
+				pDescription.cubemap = true;
+				pDescription.arraySize *= 6;
+			}
+			offset += ddsDX10HeaderSize;
+		}
+		else {
+			pDescription.format = legacyDDSFormat(pixelFlags, pixelFourCC, read32(pData + 88), read32(pData + 92), read32(pData + 96), read32(pData + 100), read32(pData + 104));
+			if (caps2 & ddsCaps2Volume)
+				return false;
+			if (caps2 & ddsCaps2Cubemap) {
+				//cubemaps with some of the faces left out can't be a d3d cube
+				if ((caps2 & ddsCaps2AllFaces) != ddsCaps2AllFaces)
+					return false;
+				pDescription.cubemap = true;
+				pDescription.arraySize = 6;
+			}
+		}
+		if (!validDescription(pDescription))
+			return false;
+
+		//every slice has all its mips, one after another, without padding
+		pDescription.subresources.resize((size_t)pDescription.mipLevels * pDescription.arraySize);
+		for (uint32_t slice = 0; slice < pDescription.arraySize; ++slice) {
+			for (uint32_t mip = 0; mip < pDescription.mipLevels; ++mip) {
+				TextureContainer::Subresource& subresource = pDescription.subresources[mip + slice * pDescription.mipLevels];
+				setSubresource(subresource, pDescription, mip, offset);
+				offset += (uint64_t)subresource.rowBytes * subresource.rows;
+			}
+		}
+		return offset <= pSize;
+	}
+
+	bool parseKTX2(const uint8_t* pData, size_t pSize, TextureContainer::Description& pDescription) {
+		if (pSize < ktx2HeaderSize)
+			return false;
+
+		uint32_t vkFormat = read32(pData + 12);
+		pDescription.width = read32(pData + 20);
+		pDescription.height = read32(pData + 24);
+		uint32_t depth = read32(pData + 28);
+		uint32_t layers = read32(pData + 32);
+		uint32_t faces = read32(pData + 36);
+		uint32_t levels = read32(pData + 40);
+		uint32_t supercompression = read32(pData + 44);
+
+		if (supercompression != 0 || depth > 1 || (faces != 1 && faces != 6) || layers > 2048)
+			return false;
+		//1d textures have no height, they load as a single row
+		if (pDescription.height == 0)
+			pDescription.height = 1;
+		pDescription.format = formatFromVulkan(vkFormat);
+		//0 levels asks for the mips to be generated at load time, only the base level is in the file then
+		pDescription.mipLevels = (levels > 0) ? levels : 1;
+		pDescription.arraySize = ((layers > 0) ? layers : 1) * faces;
+		pDescription.cubemap = (faces == 6);
+		if (!validDescription(pDescription) || pSize < ktx2HeaderSize + ktx2LevelSize * pDescription.mipLevels)
+			return false;
+
+		//a level holds all its layers and faces, one after another without padding
+		pDescription.subresources.resize((size_t)pDescription.mipLevels * pDescription.arraySize);
+		for (uint32_t mip = 0; mip < pDescription.mipLevels; ++mip) {
+			const uint8_t* level = pData + ktx2HeaderSize + ktx2LevelSize * mip;
+			uint64_t levelOffset = read64(level);
+			uint64_t levelBytes = read64(level + 8);
+			if (levelOffset > pSize || levelBytes > pSize - levelOffset)
+				return false;
+
+			for (uint32_t slice = 0; slice < pDescription.arraySize; ++slice) {
+				TextureContainer::Subresource& subresource = pDescription.subresources[mip + slice * pDescription.mipLevels];
+				setSubresource(subresource, pDescription, mip, 0);
+				uint64_t imageBytes = (uint64_t)subresource.rowBytes * subresource.rows;
+				subresource.offset = levelOffset + imageBytes * slice;
+				if (imageBytes * (slice + 1) > levelBytes)
+					return false;
+			}
+		}
+		return true;
+	}
+}
+
+TextureContainer::Type TextureContainer::identify(const void* pData, size_t pSize)
+{
+	if (pSize >= 4 && memcmp(pData, "DDS ", 4) == 0)
+		return TypeDDS;
+	if (pSize >= sizeof(ktx2Identifier) && memcmp(pData, ktx2Identifier, sizeof(ktx2Identifier)) == 0)
+		return TypeKTX2;
+	return TypeNone;
+}
+
+bool TextureContainer::parse(const void* pData, size_t pSize, Description& pDescription)
+{
+	pDescription = Description();
+	pDescription.type = identify(pData, pSize);
+	bool parsed = false;
+	if (pDescription.type == TypeDDS)
+		parsed = parseDDS((const uint8_t*)pData, pSize, pDescription);
+	else if (pDescription.type == TypeKTX2)
+		parsed = parseKTX2((const uint8_t*)pData, pSize, pDescription);
+	if (!parsed)
+		pDescription.subresources.clear();
+	return parsed;
+}
+
+bool TextureContainer::copySubresources(const void* pData, const Description& pDescription, const TextureLayout::Footprint* pFootprints, uint8_t* pBuffer)
+{
+	return copyMips(pData, pDescription, 0, pDescription.mipLevels, pFootprints, pBuffer);
+}
+
+bool TextureContainer::copyMips(const void* pData, const Description& pDescription, uint32_t pFirstMip, uint32_t pMipCount, const TextureLayout::Footprint* pFootprints, uint8_t* pBuffer)
+{
+	if (pFirstMip + pMipCount > pDescription.mipLevels)
+		return false;
+
+	const uint8_t* data = (const uint8_t*)pData;
+	for (uint32_t slice = 0; slice < pDescription.arraySize; ++slice) {
+		for (uint32_t mip = 0; mip < pMipCount; ++mip) {
+			const Subresource& subresource = pDescription.subresources[pFirstMip + mip + slice * pDescription.mipLevels];
+			const TextureLayout::Footprint& footprint = pFootprints[mip + slice * pMipCount];
+			if (footprint.rowBytes != subresource.rowBytes || footprint.rows != subresource.rows)
+				return false;
+			TextureLayout::copyRows(data + subresource.offset, subresource.rowBytes, footprint, pBuffer);
+		}
+	}
+	return true;
+}
+
+void TextureContainer::payloadRange(const Description& pDescription, uint64_t& pBegin, uint64_t& pEnd)
+{
+	pBegin = 0;
+	pEnd = 0;
+	for (size_t i = 0; i < pDescription.subresources.size(); ++i) {
+		const Subresource& subresource = pDescription.subresources[i];
+		uint64_t end = subresource.offset + (uint64_t)subresource.rowBytes * subresource.rows;
+		if (i == 0 || subresource.offset < pBegin)
+			pBegin = subresource.offset;
+		if (end > pEnd)
+			pEnd = end;
+	}
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "TextureLayout.h"
+
+/**
+ * Reads the headers of dds and ktx2 files, the containers for textures that are compressed and mipmapped offline.
+ * parse only looks at the header and finds where every subresource is in the file, the payload is copied once, straight
+ * from the (memory mapped) file into the upload buffer at the footprints the device gives (copySubresources).
+ * - dds: the legacy header (DXT1 to DXT5, ATI1/ATI2, BC4/BC5, 8 bit rgba/bgra/luminance masks and the float formats) and
+ *   the DX10 header with any format TextureLayout knows. cubemaps are read as 6 array slices
+ * - ktx2: without supercompression, vkFormats that have a dxgi equivalent. faces and layers become array slices
+ * Volume textures are not supported, the renderer only samples 2d textures.
+ */
+class TextureContainer
+{
+public:
+	enum Type {
+		TypeNone,
+		TypeDDS,
+		TypeKTX2
+	};
+
+	//where a subresource is in the file, its rows are tightly packed
+	struct Subresource {
+		uint64_t offset;
+		uint32_t width;
+		uint32_t height;
+		uint32_t rowBytes;
+		uint32_t rows;
+	};
+
+	struct Description {
+		Type type;
+		uint32_t format;		//DXGI_FORMAT
+		uint32_t width;
+		uint32_t height;
+		uint32_t mipLevels;
+		uint32_t arraySize;		//6 per cube for cubemaps
+		bool cubemap;
+		std::vector<Subresource> subresources;	//in d3d order, mip + slice * mipLevels
+	};
+
+	//which container pData starts with, TypeNone if it is neither
+	static Type identify(const void* pData, size_t pSize);
+
+	//read the header and locate every subresource. false if the file is not a container, uses something that isn't
+	//supported or is too small for the payload its header describes
+	static bool parse(const void* pData, size_t pSize, Description& pDescription);
+
+	//copy every subresource of the file into pBuffer at pFootprints (one per subresource, in the same order). false if
+	//a footprint doesn't have the size of its subresource
+	static bool copySubresources(const void* pData, const Description& pDescription, const TextureLayout::Footprint* pFootprints, uint8_t* pBuffer);
+
+	//the same for pMipCount levels from pFirstMip of every array slice, pFootprints are those of a texture that only has
+	//these levels (mip + slice * pMipCount). lets TextureStreamer load the top levels of a texture later
+	static bool copyMips(const void* pData, const Description& pDescription, uint32_t pFirstMip, uint32_t pMipCount, const TextureLayout::Footprint* pFootprints, uint8_t* pBuffer);
+
+	//first and last byte of the payload, the part of the file the content hash covers
+	static void payloadRange(const Description& pDescription, uint64_t& pBegin, uint64_t& pEnd);
+};
@@ -0,0 +1,129 @@
+#include "TextureLayout.h"
+#include <cstring>
+
+namespace {
+	uint64_t alignUp(uint64_t pValue, uint64_t pAlignment) {
+		return (pValue + pAlignment - 1) & ~(pAlignment - 1);
+	}
+
+	uint64_t layoutFootprints(uint32_t pFormat, uint32_t pWidth, uint32_t pHeight, uint32_t pMipLevels, uint32_t pArraySize, uint32_t pRowPitchAlignment,
+		uint32_t pPlacementAlignment, TextureLayout::Footprint* pFootprints) {
+		if (TextureLayout::elementBytes(pFormat) == 0)
+			return 0;
+
+		uint64_t offset = 0;
+		uint64_t end = 0;
+		for (uint32_t slice = 0; slice < pArraySize; ++slice) {
+			for (uint32_t mip = 0; mip < pMipLevels; ++mip) {
+				TextureLayout::Footprint& footprint = pFootprints[mip + slice * pMipLevels];
+				footprint.width = ((pWidth >> mip) > 0) ? pWidth >> mip : 1;
+				footprint.height = ((pHeight >> mip) > 0) ? pHeight >> mip : 1;
+				TextureLayout::surfaceSize(pFormat, footprint.width, footprint.height, footprint.rowBytes, footprint.rows);
+				footprint.rowPitch = (uint32_t)alignUp(footprint.rowBytes, pRowPitchAlignment);
+				footprint.offset = alignUp(offset, pPlacementAlignment);
+
+				//like d3d the last row isn't padded, the next subresource is placed after the aligned end of this one
+				end = footprint.offset + (uint64_t)footprint.rowPitch * (footprint.rows - 1) + footprint.rowBytes;
+				offset = end;
+			}
+		}
+		return end;
+	}
+}
+
+uint32_t TextureLayout::elementBytes(uint32_t pFormat)
+{
+	switch (pFormat) {
+	case 2:		//R32G32B32A32_FLOAT
+		return 16;
+	case 10:	//R16G16B16A16_FLOAT
+	case 11:	//R16G16B16A16_UNORM
+		return 8;
+	case 24:	//R10G10B10A2_UNORM
+	case 28:	//R8G8B8A8_UNORM
+	case 29:	//R8G8B8A8_UNORM_SRGB
+	case 41:	//R32_FLOAT
+	case 87:	//B8G8R8A8_UNORM
+	case 88:	//B8G8R8X8_UNORM
+	case 89:	//R10G10B10_XR_BIAS_A2_UNORM
+	case 91:	//B8G8R8A8_UNORM_SRGB
+		return 4;
+	case 49:	//R8G8_UNORM
+	case 54:	//R16_FLOAT
+	case 56:	//R16_UNORM
+	case 85:	//B5G6R5_UNORM
+	case 86:	//B5G5R5A1_UNORM
+		return 2;
+	case 61:	//R8_UNORM
+	case 65:	//A8_UNORM
+		return 1;
+	case 71:	//BC1_UNORM
+	case 72:	//BC1_UNORM_SRGB
+	case 80:	//BC4_UNORM
+	case 81:	//BC4_SNORM
+		return 8;
+	case 74:	//BC2_UNORM
+	case 75:	//BC2_UNORM_SRGB
+	case 77:	//BC3_UNORM
+	case 78:	//BC3_UNORM_SRGB
+	case 83:	//BC5_UNORM
+	case 84:	//BC5_SNORM
+	case 95:	//BC6H_UF16
+	case 96:	//BC6H_SF16
+	case 98:	//BC7_UNORM
+	case 99:	//BC7_UNORM_SRGB
+		return 16;
+	default:
+		return 0;
+	}
+}
+
+bool TextureLayout::isBlockCompressed(uint32_t pFormat)
+{
+	return (pFormat >= 70 && pFormat <= 84) || (pFormat >= 94 && pFormat <= 99);
+}
+
+uint32_t TextureLayout::maxMipLevels(uint32_t pWidth, uint32_t pHeight)
+{
+	uint32_t size = (pWidth > pHeight) ? pWidth : pHeight;
+	uint32_t levels = 1;
+	while (size > 1) {
+		size >>= 1;
+		levels++;
+	}
+	return levels;
+}
+
+void TextureLayout::surfaceSize(uint32_t pFormat, uint32_t pWidth, uint32_t pHeight, uint32_t& pRowBytes, uint32_t& pRows)
+{
+	if (isBlockCompressed(pFormat)) {
+		pRowBytes = ((pWidth + 3) / 4) * elementBytes(pFormat);
+		pRows = (pHeight + 3) / 4;
+	}
+	else {
+		pRowBytes = pWidth * elementBytes(pFormat);
+		pRows = pHeight;
+	}
+}
+
+uint64_t TextureLayout::copyableFootprints(uint32_t pFormat, uint32_t pWidth, uint32_t pHeight, uint32_t pMipLevels, uint32_t pArraySize, Footprint* pFootprints)
+{
+	return layoutFootprints(pFormat, pWidth, pHeight, pMipLevels, pArraySize, rowPitchAlignment, placementAlignment, pFootprints);
+}
+
+uint64_t TextureLayout::packedFootprints(uint32_t pFormat, uint32_t pWidth, uint32_t pHeight, uint32_t pMipLevels, uint32_t pArraySize, Footprint* pFootprints)
+{
+	return layoutFootprints(pFormat, pWidth, pHeight, pMipLevels, pArraySize, 1, 1, pFootprints);
+}
+
+void TextureLayout::copyRows(const uint8_t* pSource, size_t pSourceRowBytes, const Footprint& pFootprint, uint8_t* pBuffer)
+{
+	uint8_t* destination = pBuffer + pFootprint.offset;
+	//one copy if neither side has padding
+	if (pSourceRowBytes == pFootprint.rowPitch && pFootprint.rowBytes == pFootprint.rowPitch) {
+		memcpy(destination, pSource, (size_t)pFootprint.rowPitch * pFootprint.rows);
+		return;
+	}
+	for (uint32_t row = 0; row < pFootprint.rows; ++row)
+		memcpy(destination + (size_t)row * pFootprint.rowPitch, pSource + row * pSourceRowBytes, pFootprint.rowBytes);
+}
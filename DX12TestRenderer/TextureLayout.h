@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * Sizes and upload buffer layout of 2d textures, computed the way d3d12 does without needing a device.
+ * Formats are DXGI_FORMAT values, so the asset code (and its tests) don't need the d3d headers.
+ * The layout matches ID3D12Device::GetCopyableFootprints for a texture in D3D12_TEXTURE_LAYOUT_UNKNOWN: subresources in
+ * d3d order (mip + slice * mipLevels), every one starting at a 512 byte aligned offset with rows 256 bytes apart at least.
+ * Block compressed formats count rows of 4x4 blocks, levels smaller than a block still take a whole one.
+ */
+class TextureLayout
+{
+public:
+	static const uint32_t rowPitchAlignment = 256;		//D3D12_TEXTURE_DATA_PITCH_ALIGNMENT
+	static const uint32_t placementAlignment = 512;	//D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT
+
+	//where a subresource goes in an upload buffer
+	struct Footprint {
+		uint64_t offset;	//from the start of the buffer
+		uint32_t width;		//in pixels
+		uint32_t height;
+		uint32_t rowPitch;	//bytes from one row to the next
+		uint32_t rows;		//rows of pixels, or of blocks
+		uint32_t rowBytes;	//bytes of data in a row, the rest of the pitch is padding
+	};
+
+	//bytes per pixel, or per 4x4 block for the block compressed formats. 0 for formats the layout doesn't know
+	static uint32_t elementBytes(uint32_t pFormat);
+
+	//true for the BC formats
+	static bool isBlockCompressed(uint32_t pFormat);
+
+	//number of levels down to 1x1
+	static uint32_t maxMipLevels(uint32_t pWidth, uint32_t pHeight);
+
+	//tightly packed bytes per row and rows of a pWidth x pHeight surface
+	static void surfaceSize(uint32_t pFormat, uint32_t pWidth, uint32_t pHeight, uint32_t& pRowBytes, uint32_t& pRows);
+
+	//fill pFootprints (pMipLevels * pArraySize of them) like GetCopyableFootprints does. returns the total bytes the
+	//buffer needs, the last subresource ends without the padding of its last row. 0 for an unknown format
+	static uint64_t copyableFootprints(uint32_t pFormat, uint32_t pWidth, uint32_t pHeight, uint32_t pMipLevels, uint32_t pArraySize, Footprint* pFootprints);
+
+	//the same without alignment, every subresource right after the one before it with tightly packed rows, like the
+	//mip chains of TextureMaterial::TextureData. returns the total bytes
+	static uint64_t packedFootprints(uint32_t pFormat, uint32_t pWidth, uint32_t pHeight, uint32_t pMipLevels, uint32_t pArraySize, Footprint* pFootprints);
+
+	//copy tightly packed rows (pSourceRowBytes apart) into a footprint of pBuffer
+	static void copyRows(const uint8_t* pSource, size_t pSourceRowBytes, const Footprint& pFootprint, uint8_t* pBuffer);
+};
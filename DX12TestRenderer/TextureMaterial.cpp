@@ -1,9 +1,108 @@
 #include "TextureMaterial.h"
+#include "TextureRegistry.h"
+#include "PngDecoder.h"
+#include "MappedFile.h"
+#include "ContentHash.h"
+#include <chrono>
+
+bool TextureMaterial::portablePngDecoder = true;
+bool TextureMaterial::convertToRGBA8 = true;
+bool TextureMaterial::generateMips = true;
+MipGenerator::Filter TextureMaterial::mipFilter = MipGenerator::FilterKaiser;
+bool TextureMaterial::compressTextures = true;
+BlockCompressor::Format TextureMaterial::textureCompression = BlockCompressor::FormatBC7;
+BlockCompressor::Quality TextureMaterial::compressionQuality = BlockCompressor::QualityNormal;
+TextureMaterial::BindStats TextureMaterial::bindStats = {};
+ID3D12PipelineState* TextureMaterial::pipelineStateObjects[TextureMaterial::viewCount][Mesh::vertexLayoutCount] = {};
+ID3D12RootSignature* TextureMaterial::rootSignature = NULL;
+unsigned TextureMaterial::_materialCount = 0;
+TextureMaterial::Bindings TextureMaterial::_bound = {};
+
+namespace {
+	DXGI_FORMAT getDXGIFormatFromPngFormat(PngDecoder::Format pFormat) {
+		switch (pFormat) {
+		case PngDecoder::FormatR8: return DXGI_FORMAT_R8_UNORM;
+		case PngDecoder::FormatR16: return DXGI_FORMAT_R16_UNORM;
+		case PngDecoder::FormatRGBA8: return DXGI_FORMAT_R8G8B8A8_UNORM;
+		case PngDecoder::FormatBGRA8: return DXGI_FORMAT_B8G8R8A8_UNORM;
+		case PngDecoder::FormatRGBA16: return DXGI_FORMAT_R16G16B16A16_UNORM;
+		default: return DXGI_FORMAT_UNKNOWN;
+		}
+	}
+
+	DXGI_FORMAT getDXGIFormatFromBlockFormat(BlockCompressor::Format pFormat) {
+		switch (pFormat) {
+		case BlockCompressor::FormatBC1: return DXGI_FORMAT_BC1_UNORM;
+		case BlockCompressor::FormatBC3: return DXGI_FORMAT_BC3_UNORM;
+		case BlockCompressor::FormatBC5: return DXGI_FORMAT_BC5_UNORM;
+		case BlockCompressor::FormatBC7: return DXGI_FORMAT_BC7_UNORM;
+		default: return DXGI_FORMAT_UNKNOWN;
+		}
+	}
+
+	const char* blockFormatNames[] = { "BC1", "BC3", "BC5", "BC7" };
+
+	const PixelConverter::Conversion noConversion = PixelConverter::ConversionCount;
+
+	//the conversion of a decoded dxgi format to 8 bit rgba with convertToRGBA8, pFormat becomes the converted format
+	bool formatConversion(DXGI_FORMAT& pFormat, PixelConverter::Conversion& pConversion) {
+		if (!TextureMaterial::convertToRGBA8)
+			return false;
+		switch (pFormat) {
+		case DXGI_FORMAT_R8_UNORM: pConversion = PixelConverter::ConversionGray8ToRGBA; break;
+		case DXGI_FORMAT_R16_UNORM: pConversion = PixelConverter::ConversionGray16ToRGBA; break;
+		case DXGI_FORMAT_R16G16B16A16_UNORM: pConversion = PixelConverter::ConversionRGBA16ToRGBA8; break;
+		default: return false;
+		}
+		pFormat = DXGI_FORMAT_R8G8B8A8_UNORM;
+		return true;
+	}
+
+	//the WIC formats without a dxgi format that PixelConverter turns into rgba8, what the WIC converter made of them before
+	bool wicConversion(const WICPixelFormatGUID& pFormat, PixelConverter::Conversion& pConversion) {
+		if (pFormat == GUID_WICPixelFormat24bppBGR) pConversion = PixelConverter::ConversionBGRToRGBA;
+		else if (pFormat == GUID_WICPixelFormat24bppRGB) pConversion = PixelConverter::ConversionRGBToRGBA;
+		else if (pFormat == GUID_WICPixelFormat32bppPBGRA) pConversion = PixelConverter::ConversionPBGRAToRGBA;
+		else if (pFormat == GUID_WICPixelFormat32bppPRGBA) pConversion = PixelConverter::ConversionPRGBAToRGBA;
+		else return false;
+		return true;
+	}
+
+	//the mip generator works on 4 channel 8 bit pixels only
+	bool mipsGenerated(DXGI_FORMAT pFormat) {
+		return TextureMaterial::generateMips && (pFormat == DXGI_FORMAT_R8G8B8A8_UNORM || pFormat == DXGI_FORMAT_B8G8R8A8_UNORM);
+	}
+
+	//so does the compressor, and the top level of a block compressed texture has to be whole blocks
+	bool compressible(DXGI_FORMAT pFormat, UINT pWidth, UINT pHeight) {
+		return (pFormat == DXGI_FORMAT_R8G8B8A8_UNORM || pFormat == DXGI_FORMAT_B8G8R8A8_UNORM) && pWidth % 4 == 0 && pHeight % 4 == 0;
+	}
+}
 
 
 
-TextureMaterial::TextureMaterial(ID3D12Device* pDevice, ID3D12GraphicsCommandList* pCommandList, LPCWSTR pTextureFilename) : device(pDevice), commandList(pCommandList)
+TextureMaterial::TextureMaterial(ID3D12Device* pDevice, ID3D12GraphicsCommandList* pCommandList, TextureRegistry* pTextures, LPCWSTR pTextureFilename) : device(pDevice), commandList(pCommandList), _textures(pTextures)
 {
+	//load the image from file, or share it if another material loaded it already
+	_texture = _textures->acquire(pTextureFilename);
+	if (_texture == TextureRegistry::invalidHandle)
+		throw std::invalid_argument("received invalid image size");
+	_create();
+}
+
+TextureMaterial::TextureMaterial(ID3D12Device* pDevice, ID3D12GraphicsCommandList* pCommandList, TextureRegistry* pTextures, UINT pTexture) : device(pDevice), commandList(pCommandList), _textures(pTextures), _texture(pTexture)
+{
+	_create();
+}
+
+void TextureMaterial::_create()
+{
+	//the other materials created the shared pipeline already
+	if (_materialCount > 0) {
+		_materialCount++;
+		return;
+	}
+
 	//create root signature
 
 	D3D12_ROOT_DESCRIPTOR rootCBVDescriptor;
@@ -40,7 +139,7 @@ TextureMaterial::TextureMaterial(ID3D12Device* pDevice, ID3D12GraphicsCommandLis
 
 																		//create a static sampler
 	D3D12_STATIC_SAMPLER_DESC sampler = {};
-	sampler.Filter = D3D12_FILTER_MIN_MAG_MIP_POINT;
+	sampler.Filter = D3D12_FILTER_MIN_MAG_MIP_LINEAR; //trilinear, blends between the mip levels
 	sampler.AddressU = D3D12_TEXTURE_ADDRESS_MODE_BORDER;
 	sampler.AddressV = D3D12_TEXTURE_ADDRESS_MODE_BORDER;
 	sampler.AddressW = D3D12_TEXTURE_ADDRESS_MODE_BORDER;
@@ -98,36 +197,26 @@ TextureMaterial::TextureMaterial(ID3D12Device* pDevice, ID3D12GraphicsCommandLis
 	vertexShaderBytecode.BytecodeLength = vertexShader->GetBufferSize();
 	vertexShaderBytecode.pShaderBytecode = vertexShader->GetBufferPointer();
 
-	// compile pixel shader
-	ID3DBlob* pixelShader;
-	//shader file,		  defines  includes, entry,	sm		  compile flags,							efect flags, shader blob, error blob
-	hr = D3DCompileFromFile(L"PixelShader.hlsl", nullptr, nullptr, "main", "ps_5_0", D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION, 0, &pixelShader, &errorBuffer);
-	if (FAILED(hr)) {
-		OutputDebugStringA((char*)errorBuffer->GetBufferPointer());
-		ThrowIfFailed(hr);
+	// compile pixel shader, once for each texture view. TEXTURE_ARRAY makes it sample a Texture2DArray
+	const D3D_SHADER_MACRO arrayDefines[] = { { "TEXTURE_ARRAY", "1" }, { NULL, NULL } };
+	D3D12_SHADER_BYTECODE pixelShaderBytecodes[viewCount] = {};
+	for (int view = 0; view < viewCount; ++view) {
+		ID3DBlob* pixelShader;
+		//shader file,		  defines  includes, entry,	sm		  compile flags,							efect flags, shader blob, error blob
+		hr = D3DCompileFromFile(L"PixelShader.hlsl", (view == ViewTexture2DArray) ? arrayDefines : nullptr, nullptr, "main", "ps_5_0", D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION, 0, &pixelShader, &errorBuffer);
+		if (FAILED(hr)) {
+			OutputDebugStringA((char*)errorBuffer->GetBufferPointer());
+			ThrowIfFailed(hr);
+		}
+
+		// fill out shader bytecode structure for pixel shader
+		pixelShaderBytecodes[view].BytecodeLength = pixelShader->GetBufferSize();
+		pixelShaderBytecodes[view].pShaderBytecode = pixelShader->GetBufferPointer();
 	}
 
-	// fill out shader bytecode structure for pixel shader
-	D3D12_SHADER_BYTECODE pixelShaderBytecode = {};
-	pixelShaderBytecode.BytecodeLength = pixelShader->GetBufferSize();
-	pixelShaderBytecode.pShaderBytecode = pixelShader->GetBufferPointer();
-
-	//create input layout
-
 	//the input layout is used by the ia so it knows
-	//how to read the vertex data bound to it.
-
-	D3D12_INPUT_ELEMENT_DESC inputLayout[] = {
-		{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-		{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 }
-	};
-
-	//fill out an input layout description struct
-	D3D12_INPUT_LAYOUT_DESC inputLayoutDesc = {};
-
-	//we can get teh number of elements in an array by "sizeof(array)/sizeof(arrayElementType)"
-	inputLayoutDesc.NumElements = sizeof(inputLayout) / sizeof(D3D12_INPUT_ELEMENT_DESC);
-	inputLayoutDesc.pInputElementDescs = inputLayout;
+	//how to read the vertex data bound to it. meshes come in different vertex layouts (full or compact format,
+	//interleaved or split streams), so there is a pso for each, reading only the streams this material uses
 
 	// multi-sampling settings (not using it currently)
 	DXGI_SAMPLE_DESC sampleDesc = {};
@@ -141,10 +230,8 @@ TextureMaterial::TextureMaterial(ID3D12Device* pDevice, ID3D12GraphicsCommandLis
 	// the vertex shader is the only required shader for a pso
 
 	D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDesc = {}; //pso description struct
-	psoDesc.InputLayout = inputLayoutDesc;
 	psoDesc.pRootSignature = rootSignature;
 	psoDesc.VS = vertexShaderBytecode;
-	psoDesc.PS = pixelShaderBytecode;
 	psoDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
 	psoDesc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM; //format of the rtv
 	psoDesc.SampleDesc = sampleDesc;
@@ -153,149 +240,207 @@ TextureMaterial::TextureMaterial(ID3D12Device* pDevice, ID3D12GraphicsCommandLis
 	psoDesc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT); //default blend state
 	psoDesc.NumRenderTargets = 1;
 	psoDesc.DepthStencilState = CD3DX12_DEPTH_STENCIL_DESC(D3D12_DEFAULT); //default values for depth and stencil settings are alright for now.
+	psoDesc.DepthStencilState.DepthFunc = D3D12_COMPARISON_FUNC_LESS_EQUAL; //pass on the depth written by a depth prepass
 	psoDesc.DSVFormat = DXGI_FORMAT_D32_FLOAT;
 
-	// create the pso
-	ThrowIfFailed(device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&pipelineStateObject)));
-
-
-	//load the image, create a texture resource and descriptor heap
+	// create the psos
+	for (int view = 0; view < viewCount; ++view) {
+		psoDesc.PS = pixelShaderBytecodes[view];
+		for (int layout = 0; layout < Mesh::vertexLayoutCount; ++layout) {
+			D3D12_INPUT_ELEMENT_DESC inputElements[Mesh::maxInputElements];
+			psoDesc.InputLayout = Mesh::getInputLayout(layout, streams, inputElements);
+			ThrowIfFailed(device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&pipelineStateObjects[view][layout])));
+		}
+	}
+	_materialCount++;
+}
 
-	//create the descriptor heap that will store our shader resource view
-	D3D12_DESCRIPTOR_HEAP_DESC heapDesc = {};
-	heapDesc.NumDescriptors = 1;
-	heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
-	heapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-	ThrowIfFailed(device->CreateDescriptorHeap(&heapDesc, IID_PPV_ARGS(&mainDescriptorHeap)));
-	
-	//load the image from file
-	D3D12_RESOURCE_DESC textureDesc;
-	int imageBytesPerRow;
-	int imageSize = LoadImageDataFromFile(&imageData, textureDesc, pTextureFilename, imageBytesPerRow);
+void TextureMaterial::Render(Mesh* pMesh, D3D12_GPU_VIRTUAL_ADDRESS pGPUAddress, int pLod)
+{
+	//only the streams the shaders read are bound, and the pso has to match the layout the mesh was uploaded in
+	pMesh->SetVertexIndexBuffers(streams);
+
+	//only what differs from the last draw is set. all materials share the pipeline, and the ones whose textures are in the
+	//same atlas page the descriptor table, so from one draw to the next usually only the constant buffer changes
+	if (_bound.rootSignature != rootSignature) {
+		commandList->SetGraphicsRootSignature(rootSignature);
+		_bound.rootSignature = rootSignature;
+		//setting the root signature clears the root arguments
+		_bound.descriptorTable = 0;
+		bindStats.rootSignatures++;
+	}
+	View view = _textures->isArray(_texture) ? ViewTexture2DArray : ViewTexture2D;
+	ID3D12PipelineState* pipelineState = pipelineStateObjects[view][pMesh->getVertexLayout()];
+	if (_bound.pipelineState != pipelineState) {
+		commandList->SetPipelineState(pipelineState);
+		_bound.pipelineState = pipelineState;
+		bindStats.pipelineStates++;
+	}
+	//set the descriptor heap, all textures share the one of the registry
+	if (_bound.descriptorHeap != _textures->getDescriptorHeap()) {
+		ID3D12DescriptorHeap* descriptorHeaps[] = { _textures->getDescriptorHeap() };
+		commandList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
+		_bound.descriptorHeap = descriptorHeaps[0];
+		_bound.descriptorTable = 0;
+		bindStats.descriptorHeaps++;
+	}
 
-	//make sure we have data
-	if (imageSize <= 0) {
-		std::wstring wfn = AnsiToWString(__FILE__);                       
-		throw std::invalid_argument("received invalid image size");
+	//set the descriptor table to the view of our texture (parameter 1, as constant buffer root descriptor is parameter index 0)
+	D3D12_GPU_DESCRIPTOR_HANDLE descriptorTable = _textures->getDescriptor(_texture);
+	if (_bound.descriptorTable != descriptorTable.ptr) {
+		commandList->SetGraphicsRootDescriptorTable(1, descriptorTable);
+		_bound.descriptorTable = descriptorTable.ptr;
+		bindStats.descriptorTables++;
 	}
 
-	textureBuffer = CreateTextureDefaultBuffer(device, commandList, &imageData[0], imageBytesPerRow, textureDesc, textureBufferUploadHeap);
+	commandList->SetGraphicsRootConstantBufferView(0, pGPUAddress);
 
-	//transition the texture default heap to a pixel shader resource
-	commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(textureBuffer, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
+	bindStats.draws++;
+	pMesh->Draw(pLod);
 
-	//now we create a shader resource view descriptor (points to the texture and describes it)
-	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-	srvDesc.Format = textureDesc.Format;
-	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-	srvDesc.Texture2D.MipLevels = 1;
-	device->CreateShaderResourceView(textureBuffer, &srvDesc, mainDescriptorHeap->GetCPUDescriptorHandleForHeapStart());
 }
 
-void TextureMaterial::Render(Mesh* pMesh, D3D12_GPU_VIRTUAL_ADDRESS pGPUAddress)
+
+UINT TextureMaterial::GetTexture() const
 {
-	//TODO decide in material what vertex data to set
-	pMesh->SetVertexIndexBuffers();
+	return _texture;
+}
 
-	commandList->SetGraphicsRootSignature(rootSignature);
-	commandList->SetPipelineState(pipelineStateObject);
-	//set the descriptor heap
-	ID3D12DescriptorHeap* descriptorHeaps[] = { mainDescriptorHeap };
-	commandList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
+TextureMaterial::~TextureMaterial()
+{
+	_textures->release(_texture);
+	if (--_materialCount > 0)
+		return;
+	for (int view = 0; view < viewCount; ++view) {
+		for (int layout = 0; layout < Mesh::vertexLayoutCount; ++layout) {
+			if (pipelineStateObjects[view][layout]) pipelineStateObjects[view][layout]->Release();
+			pipelineStateObjects[view][layout] = NULL;
+		}
+	}
+	if (rootSignature) rootSignature->Release();
+	rootSignature = NULL;
+	ResetBindings();
+}
 
-	//set the descriptor table to the descriptor heap (parameter 1, as constant buffer root descriptor is parameter index 0)
-	commandList->SetGraphicsRootDescriptorTable(1, mainDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
-	commandList->SetPipelineState(pipelineStateObject);
+void TextureMaterial::ResetBindings()
+{
+	_bound = Bindings();
+}
 
-	commandList->SetGraphicsRootConstantBufferView(0, pGPUAddress);
+bool TextureMaterial::ReadTextureInfo(LPCWSTR filename, TextureData& pTexture) {
+	pTexture.pixels.clear();
+	pTexture.contentHash = 0;
+
+	//the file is hashed as it is, so a texture that is loaded already is found before anything is decoded
+	char narrowFilename[MAX_PATH];
+	MappedFile file;
+	if (WideCharToMultiByte(CP_ACP, 0, filename, -1, narrowFilename, MAX_PATH, NULL, NULL) <= 0 || !file.open(narrowFilename))
+		return false;
+
+	if (portablePngDecoder && PngDecoder::isPng(file.data(), file.size())) {
+		PngDecoder::Image image;
+		if (!PngDecoder::readHeader(file.data(), file.size(), image))
+			return false;
+		pTexture.width = image.width;
+		pTexture.height = image.height;
+		pTexture.format = getDXGIFormatFromPngFormat(image.format);
+		pTexture.bytesPerRow = image.bytesPerRow;
+		PixelConverter::Conversion conversion;
+		if (formatConversion(pTexture.format, conversion))
+			pTexture.bytesPerRow = image.width * 4;
+	}
+	else {
+		IWICBitmapSource* source;
+		PixelConverter::Conversion conversion;
+		if (!_openWICImage(filename, source, pTexture.format, conversion))
+			return false;
+		HRESULT hr = source->GetSize(&pTexture.width, &pTexture.height);
+		source->Release();
+		if (FAILED(hr))
+			return false;
+		pTexture.bytesPerRow = (pTexture.width * GetDXGIFormatBitsPerPixel(pTexture.format)) / 8;
+	}
+	if (pTexture.width == 0 || pTexture.height == 0 || TextureLayout::elementBytes(pTexture.format) == 0) {
+		std::cout << "Unsupported texture " << narrowFilename << std::endl;
+		return false;
+	}
 
-	pMesh->Draw();
+	//the size the texture will have once it is processed
+	pTexture.mipLevels = mipsGenerated(pTexture.format) ? MipGenerator::levelCount(pTexture.width, pTexture.height) : 1;
+	if (compressTextures && compressible(pTexture.format, pTexture.width, pTexture.height)) {
+		pTexture.format = getDXGIFormatFromBlockFormat(textureCompression);
+		pTexture.bytesPerRow = (pTexture.width / 4) * BlockCompressor::blockBytes(textureCompression);
+	}
 
+	//the same file loaded with other settings is another texture
+	uint32_t settings[6] = { generateMips, (uint32_t)mipFilter, compressTextures, (uint32_t)textureCompression, (uint32_t)compressionQuality, convertToRGBA8 };
+	pTexture.contentHash = hashContent(file.data(), file.size(), hashContent(settings, sizeof(settings)));
+	return true;
 }
 
+bool TextureMaterial::LoadTextureInto(LPCWSTR filename, const TextureData& pTexture, uint8_t* pBuffer, const TextureLayout::Footprint* pFootprints) {
+	//a texture that is neither mipmapped nor compressed is decoded straight into the buffer, at the pitch of its footprint
+	if (pTexture.mipLevels == 1 && !TextureLayout::isBlockCompressed(pTexture.format)) {
+		TextureData decoded;
+		decoded.width = pTexture.width;
+		decoded.height = pTexture.height;
+		decoded.format = pTexture.format;
+		return _decodeTextureData(filename, decoded, pBuffer + pFootprints[0].offset, pFootprints[0].rowPitch);
+	}
 
-TextureMaterial::~TextureMaterial()
-{
-}
+	//the mips are built from the whole top level, so it is decoded to memory first
+	TextureData decoded;
+	if (!_decodeTextureData(filename, decoded))
+		return false;
+	GenerateMips(decoded);
+	//the file or the settings changed since ReadTextureInfo
+	if (decoded.width != pTexture.width || decoded.height != pTexture.height || decoded.mipLevels != pTexture.mipLevels)
+		return false;
+
+	if (TextureLayout::isBlockCompressed(pTexture.format)) {
+		if (pTexture.format != getDXGIFormatFromBlockFormat(textureCompression))
+			return false;
+		return _compressLevels(decoded, textureCompression, pBuffer, pFootprints);
+	}
 
-ID3D12Resource* TextureMaterial::CreateTextureDefaultBuffer(
-	ID3D12Device* device,
-	ID3D12GraphicsCommandList* cmdList,
-	const void* initData,
-	int bytesPerRow,
-	D3D12_RESOURCE_DESC& textureDesc,
-	ID3D12Resource*& uploadBuffer)
-{
+	if (decoded.format != pTexture.format)
+		return false;
+	std::vector<MipGenerator::Level> levels = MipGenerator::levels(decoded.width, decoded.height, decoded.mipLevels);
+	for (size_t i = 0; i < levels.size(); ++i)
+		TextureLayout::copyRows(&decoded.pixels[levels[i].offset], levels[i].width * 4, pFootprints[i], pBuffer);
+	return true;
+}
 
-	UINT64 textureUploadBufferSize;
-	//this function gets the size an upload buffer needs to be to upload a texture to the gpu.
-	//each row must be 256 byte aligned except the last row, which can just be the size in bytes of the row
-	//the function below does the following calculation: 
-	//int textureHeapSize = ((((width * numBytesPerPixel) + 255) & ~255) * (height - 1)) + (width * numBytesPerPixel);
-	device->GetCopyableFootprints(&textureDesc, 0, 1, 0, nullptr, nullptr, nullptr, &textureUploadBufferSize);
-
-	ID3D12Resource* defaultBuffer;
-
-	// Create the actual default buffer resource.
-	ThrowIfFailed(device->CreateCommittedResource(
-		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
-		D3D12_HEAP_FLAG_NONE,
-		&textureDesc,
-		D3D12_RESOURCE_STATE_COMMON,
-		nullptr,
-		IID_PPV_ARGS(&defaultBuffer)));
-
-	// In order to copy CPU memory data into our default buffer, we need to create
-	// an intermediate upload heap. 
-	ThrowIfFailed(device->CreateCommittedResource(
-		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
-		D3D12_HEAP_FLAG_NONE,
-		&CD3DX12_RESOURCE_DESC::Buffer(textureUploadBufferSize),
-		D3D12_RESOURCE_STATE_GENERIC_READ,
-		nullptr,
-		IID_PPV_ARGS(&uploadBuffer)));
-
-
-	// Describe the data we want to copy into the default buffer.
-	D3D12_SUBRESOURCE_DATA subResourceData = {};
-	subResourceData.pData = initData;
-	subResourceData.RowPitch = bytesPerRow;
-	subResourceData.SlicePitch = bytesPerRow * textureDesc.Height;
-
-	// Schedule to copy the data to the default buffer resource.  At a high level, the helper function UpdateSubresources
-	// will copy the CPU memory into the intermediate upload heap.  Then, using ID3D12CommandList::CopySubresourceRegion,
-	// the intermediate upload heap data will be copied to mBuffer.
-	cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(defaultBuffer,
-		D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_COPY_DEST));
-	UpdateSubresources<1>(cmdList, defaultBuffer, uploadBuffer, 0, 0, 1, &subResourceData);
-	cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(defaultBuffer,
-		D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_GENERIC_READ));
-
-	// Note: uploadBuffer has to be kept alive after the above function calls because
-	// the command list has not been executed yet that performs the actual copy.
-	// The caller can Release the uploadBuffer after it knows the copy has been executed.
-
-
-	return defaultBuffer;
+bool TextureMaterial::LoadTextureData(LPCWSTR filename, TextureData& pTexture) {
+	if (!ReadTextureInfo(filename, pTexture))
+		return false;
+
+	//the levels tightly packed one after another
+	std::vector<TextureLayout::Footprint> footprints(pTexture.mipLevels);
+	uint64_t size = TextureLayout::packedFootprints(pTexture.format, pTexture.width, pTexture.height, pTexture.mipLevels, 1, &footprints[0]);
+	pTexture.pixels.resize((size_t)size);
+	if (LoadTextureInto(filename, pTexture, &pTexture.pixels[0], &footprints[0]))
+		return true;
+	pTexture.pixels.clear();
+	return false;
 }
 
-int TextureMaterial::LoadImageDataFromFile(BYTE** imageData, D3D12_RESOURCE_DESC& resourceDescription, LPCWSTR filename, int &bytesPerRow) {
+bool TextureMaterial::_openWICImage(LPCWSTR filename, IWICBitmapSource*& pSource, DXGI_FORMAT& pFormat, PixelConverter::Conversion& pConversion) {
 	HRESULT hr;
+	pConversion = noConversion;
 
-	//we only need one instance of the imaging factory to create decoders and frames
-	static IWICImagingFactory *wicFactory;
+	//we only need one instance of the imaging factory per thread to create decoders and frames,
+	//textures are decoded on loader threads too
+	static thread_local IWICImagingFactory *wicFactory;
 
 	//reset decoder, frame, and converter since these will be different for each image we load
 	IWICBitmapDecoder *wicDecoder = NULL;
 	IWICBitmapFrameDecode *wicFrame = NULL;
 	IWICFormatConverter *wicConverter = NULL;
 
-	bool imageConverted = false;
-
 	if (wicFactory == NULL) {
-		//initialize the COM library
-		CoInitialize(NULL);
+		//initialize the COM library for this thread
+		CoInitializeEx(NULL, COINIT_MULTITHREADED);
 
 		//create the WIC factory
 		hr = CoCreateInstance(
@@ -305,7 +450,7 @@ int TextureMaterial::LoadImageDataFromFile(BYTE** imageData, D3D12_RESOURCE_DESC
 			IID_PPV_ARGS(&wicFactory)
 		);
 		if (FAILED(hr))
-			return 0;
+			return false;
 	}
 
 	//load a decoder for the image
@@ -318,94 +463,245 @@ int TextureMaterial::LoadImageDataFromFile(BYTE** imageData, D3D12_RESOURCE_DESC
 	);
 
 	if (FAILED(hr))
-		return 0;
+		return false;
 
-	//decode the first frame
+	//decode the first frame, it keeps the decoder alive
 	hr = wicDecoder->GetFrame(0, &wicFrame);
+	wicDecoder->Release();
 	if (FAILED(hr))
-		return 0;
+		return false;
 
 	//get the wic pixel format
 	WICPixelFormatGUID pixelFormat;
 	hr = wicFrame->GetPixelFormat(&pixelFormat);
-	if (FAILED(hr))
-		return 0;
-
-	//get the size of the image
-	UINT textureWidth, textureHeight;
-	hr = wicFrame->GetSize(&textureWidth, &textureHeight);
-	if (FAILED(hr))
-		return 0;
+	if (FAILED(hr)) {
+		wicFrame->Release();
+		return false;
+	}
 
 	//convert wic pixel format to dxgi pixel format
-	DXGI_FORMAT dxgiFormat = GetDXGIFormatFromWICFormat(pixelFormat);
+	pFormat = GetDXGIFormatFromWICFormat(pixelFormat);
+	if (pFormat != DXGI_FORMAT_UNKNOWN) {
+		//no need for WIC to convert, the pixels come from the wic frame
+		formatConversion(pFormat, pConversion);
+		pSource = wicFrame;
+		return true;
+	}
+
+	//the common formats are converted by our own kernels once the pixels are copied out of the frame
+	if (wicConversion(pixelFormat, pConversion)) {
+		pFormat = DXGI_FORMAT_R8G8B8A8_UNORM;
+		pSource = wicFrame;
+		return true;
+	}
 
 	//try to convert image if the format is not suported dxgi format
-	if (dxgiFormat == DXGI_FORMAT_UNKNOWN) {
-		//get a dxgi compatible wic format from the current image format
-		WICPixelFormatGUID convertToPixelFormat = GetConvertToWICFormat(pixelFormat);
+	//get a dxgi compatible wic format from the current image format
+	WICPixelFormatGUID convertToPixelFormat = GetConvertToWICFormat(pixelFormat);
+
+	//make sure we can convert to the dxgi compatible format, and set the converter up to read from the frame
+	BOOL canConvert = FALSE;
+	if (convertToPixelFormat == GUID_WICPixelFormatDontCare
+		|| FAILED(wicFactory->CreateFormatConverter(&wicConverter))
+		|| FAILED(wicConverter->CanConvert(pixelFormat, convertToPixelFormat, &canConvert)) || !canConvert
+		|| FAILED(wicConverter->Initialize(wicFrame, convertToPixelFormat, WICBitmapDitherTypeErrorDiffusion, NULL, 0, WICBitmapPaletteTypeCustom))) {
+		if (wicConverter) wicConverter->Release();
+		wicFrame->Release();
+		return false;
+	}
+	//the converter holds on to the frame
+	wicFrame->Release();
+
+	//set the dxgi format, the image data comes from wicConverter instead of from wicFrame
+	pFormat = GetDXGIFormatFromWICFormat(convertToPixelFormat);
+	formatConversion(pFormat, pConversion);
+	pSource = wicConverter;
+	std::cout << "image converted to a dxgi format" << std::endl;
+	return true;
+}
 
-		//return if no dxgi compatible format was found
-		if (convertToPixelFormat == GUID_WICPixelFormatDontCare)
-			return 0;
+bool TextureMaterial::_decodeTextureData(LPCWSTR filename, TextureData& pTexture, uint8_t* pPixels, size_t pRowPitch) {
+	HRESULT hr;
+	pTexture.contentHash = 0;
+
+	//png files go through the portable decoder, it gives the same format and row pitch as the WIC path below
+	if (portablePngDecoder) {
+		char narrowFilename[MAX_PATH];
+		MappedFile file;
+		if (WideCharToMultiByte(CP_ACP, 0, filename, -1, narrowFilename, MAX_PATH, NULL, NULL) > 0 && file.open(narrowFilename) && PngDecoder::isPng(file.data(), file.size())) {
+			auto decodeStart = std::chrono::high_resolution_clock::now();
+			PngDecoder::Image image;
+			if (!PngDecoder::readHeader(file.data(), file.size(), image))
+				return false;
+			DXGI_FORMAT format = getDXGIFormatFromPngFormat(image.format);
+			PixelConverter::Conversion conversion = noConversion;
+			formatConversion(format, conversion);
+			if (pPixels != NULL) {
+				//the buffer was made for the image pTexture describes
+				if (image.width != pTexture.width || image.height != pTexture.height || format != pTexture.format)
+					return false;
+				if (conversion == noConversion) {
+					if (!PngDecoder::decode(file.data(), file.size(), pPixels, pRowPitch))
+						return false;
+				}
+				else if (!PngDecoder::decode(file.data(), file.size(), image))
+					return false;
+			}
+			else if (!PngDecoder::decode(file.data(), file.size(), image))
+				return false;
+
+			//to 8 bit rgba, into the caller's buffer or a tightly packed one
+			if (conversion != noConversion) {
+				std::vector<BYTE> converted;
+				uint8_t* target = pPixels;
+				size_t pitch = pRowPitch;
+				if (target == NULL) {
+					converted.resize((size_t)image.width * 4 * image.height);
+					target = &converted[0];
+					pitch = (size_t)image.width * 4;
+				}
+				for (uint32_t row = 0; row < image.height; ++row)
+					PixelConverter::convert(conversion, &image.pixels[(size_t)row * image.bytesPerRow], target + row * pitch, image.width);
+				image.pixels.swap(converted);
+				image.bytesPerRow = image.width * 4;
+			}
+			double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - decodeStart).count();
+			std::cout << "Decoded " << narrowFilename << " (" << image.width << "x" << image.height << ") in " << seconds * 1000.0 << " ms" << std::endl;
+
+			pTexture.width = image.width;
+			pTexture.height = image.height;
+			pTexture.format = format;
+			pTexture.bytesPerRow = image.bytesPerRow;
+			pTexture.mipLevels = 1;
+			if (pPixels == NULL)
+				pTexture.pixels.swap(image.pixels);
+			return true;
+		}
+	}
 
-		//set the dxgi format
-		dxgiFormat = GetDXGIFormatFromWICFormat(convertToPixelFormat);
+	IWICBitmapSource* source;
+	DXGI_FORMAT dxgiFormat;
+	PixelConverter::Conversion conversion;
+	if (!_openWICImage(filename, source, dxgiFormat, conversion))
+		return false;
 
-		//create the format converter
-		hr = wicFactory->CreateFormatConverter(&wicConverter);
-		if (FAILED(hr))
-			return 0;
+	//get the size of the image
+	UINT textureWidth, textureHeight;
+	hr = source->GetSize(&textureWidth, &textureHeight);
+	if (FAILED(hr) || textureWidth == 0 || textureHeight == 0) {
+		source->Release();
+		return false;
+	}
 
-		//make sure we can convert to the dxgi compatible format
-		BOOL canConvert = FALSE;
-		hr = wicConverter->CanConvert(pixelFormat, convertToPixelFormat, &canConvert);
-		if (FAILED(hr) || !canConvert)
-			return 0;
+	int bitsPerPixel = GetDXGIFormatBitsPerPixel(dxgiFormat); //number of bits per pixel
+	int bytesPerRow = (textureWidth * bitsPerPixel) / 8; //number of bytes in each row of the image data
+
+	//the decoded image goes straight into the caller's buffer, its rows pRowPitch apart, or into the pixels tightly packed
+	uint8_t* target = pPixels;
+	size_t pitch = pRowPitch;
+	if (pPixels != NULL) {
+		if (textureWidth != pTexture.width || textureHeight != pTexture.height || dxgiFormat != pTexture.format) {
+			source->Release();
+			return false;
+		}
+	}
+	else {
+		int imageSize = bytesPerRow * textureHeight; //total image size in bytes
 
-		//this is so we know to get the image data from wicConverter instead of from wicFrame
-		imageConverted = true;
+		//allocate enough memory for the raw image data, and copy the (decoded) raw image data into it
+		pTexture.pixels.resize(imageSize);
+		target = &pTexture.pixels[0];
+		pitch = bytesPerRow;
 	}
 
-	int bitsPerPixel = GetDXGIFormatBitsPerPixel(dxgiFormat); //number of bits per pixel
-	bytesPerRow = (textureWidth * bitsPerPixel) / 8; //number of bytes in each row of the image data
-	int imageSize = bytesPerRow * textureHeight; //total image size in bytes
+	if (conversion == noConversion) {
+		//the last row isn't padded
+		hr = source->CopyPixels(0, (UINT)pitch, (UINT)(pitch * (textureHeight - 1) + bytesPerRow), target);
+	}
+	else {
+		//a strip of rows at a time is copied out of the frame and converted into place, so the unconverted image is never whole
+		UINT sourceRowBytes = textureWidth * PixelConverter::sourceBytes(conversion);
+		UINT stripRows = (textureHeight < 64) ? textureHeight : 64;
+		std::vector<BYTE> strip((size_t)sourceRowBytes * stripRows);
+		hr = S_OK;
+		for (UINT row = 0; row < textureHeight && SUCCEEDED(hr); row += stripRows) {
+			UINT rows = (textureHeight - row < stripRows) ? textureHeight - row : stripRows;
+			WICRect rect = { 0, (INT)row, (INT)textureWidth, (INT)rows };
+			hr = source->CopyPixels(&rect, sourceRowBytes, sourceRowBytes * rows, &strip[0]);
+			for (UINT i = 0; i < rows && SUCCEEDED(hr); ++i)
+				PixelConverter::convert(conversion, &strip[(size_t)i * sourceRowBytes], target + (row + i) * pitch, textureWidth);
+		}
+	}
+	source->Release();
+	if (FAILED(hr))
+		return false;
+
+	pTexture.width = textureWidth;
+	pTexture.height = textureHeight;
+	pTexture.format = dxgiFormat;
+	pTexture.bytesPerRow = bytesPerRow;
+	pTexture.mipLevels = 1;
+	return true;
+}
 
-												 //allocate enough memory for the raw image data, and set imageData to point to that memory
-	*imageData = (BYTE*)malloc(imageSize);
+void TextureMaterial::GenerateMips(TextureData& pTexture) {
+	//the generator works on 4 channel 8 bit pixels only, other formats keep their single level
+	if (pTexture.mipLevels != 1 || !mipsGenerated(pTexture.format))
+		return;
+
+	auto mipStart = std::chrono::high_resolution_clock::now();
+	//the textures hold srgb colors (in a unorm format, so the shaders see them as they are), filter them in linear space
+	MipGenerator::Settings settings = { mipFilter, true, 0 };
+	pTexture.mipLevels = MipGenerator::generate(pTexture.pixels, pTexture.width, pTexture.height, settings);
+	double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - mipStart).count();
+	double megapixels = pTexture.width * (double)pTexture.height / 1000000.0;
+	std::cout << "Generated " << pTexture.mipLevels << " mips (" << pTexture.width << "x" << pTexture.height << ") in " << seconds * 1000.0 << " ms, "
+		<< seconds * 1000.0 / megapixels << " ms per megapixel" << std::endl;
+}
 
-	//copy (decoded) raw image data into the newly allocated memory
-	if (imageConverted) {
-		//if the imaged needed to be converted the wic converter will contain the converted image
-		hr = wicConverter->CopyPixels(0, bytesPerRow, imageSize, *imageData);
-		if (FAILED(hr))
-			return 0;
-		std::cout << "converted image loaded into memory" << std::endl;
+bool TextureMaterial::CompressTextureData(TextureData& pTexture, BlockCompressor::Format pFormat) {
+	if (!compressible(pTexture.format, pTexture.width, pTexture.height))
+		return false;
+
+	DXGI_FORMAT format = getDXGIFormatFromBlockFormat(pFormat);
+	std::vector<TextureLayout::Footprint> footprints(pTexture.mipLevels);
+	std::vector<BYTE> blocks((size_t)TextureLayout::packedFootprints(format, pTexture.width, pTexture.height, pTexture.mipLevels, 1, &footprints[0]));
+	_compressLevels(pTexture, pFormat, &blocks[0], &footprints[0]);
+
+	//quality of the top level
+	bool bgra = (pTexture.format == DXGI_FORMAT_B8G8R8A8_UNORM);
+	std::vector<BYTE> decoded((size_t)pTexture.width * pTexture.height * 4);
+	BlockCompressor::decompress(&blocks[0], pTexture.width, pTexture.height, pFormat, bgra, &decoded[0]);
+	double psnr = BlockCompressor::psnr(&pTexture.pixels[0], &decoded[0], (size_t)pTexture.width * pTexture.height, pFormat, bgra);
+	std::cout << "Top level psnr " << psnr << " dB" << std::endl;
+
+	pTexture.format = format;
+	pTexture.bytesPerRow = (pTexture.width / 4) * BlockCompressor::blockBytes(pFormat);
+	pTexture.pixels.swap(blocks);
+	return true;
+}
 
+bool TextureMaterial::_compressLevels(const TextureData& pTexture, BlockCompressor::Format pFormat, uint8_t* pBuffer, const TextureLayout::Footprint* pFootprints) {
+	if (!compressible(pTexture.format, pTexture.width, pTexture.height))
+		return false;
+
+	auto compressStart = std::chrono::high_resolution_clock::now();
+	bool bgra = (pTexture.format == DXGI_FORMAT_B8G8R8A8_UNORM);
+	std::vector<MipGenerator::Level> levels = MipGenerator::levels(pTexture.width, pTexture.height, pTexture.mipLevels);
+	double megapixels = 0.0;
+
+	//the levels are compressed one after another, each of them split over all threads. the blocks are written once,
+	//straight to their footprint. the buffer isn't read back, it can be write combined upload memory
+	BlockCompressor::Settings settings = { pFormat, compressionQuality, 0 };
+	for (size_t i = 0; i < levels.size(); ++i) {
+		BlockCompressor::compress(&pTexture.pixels[levels[i].offset], levels[i].width, levels[i].height, levels[i].width * 4, bgra,
+			pBuffer + pFootprints[i].offset, pFootprints[i].rowPitch, settings);
+		megapixels += levels[i].width * (double)levels[i].height / 1000000.0;
 	}
-	else {
-		//no need to convert, just copy the data from the wic frame
-		hr = wicFrame->CopyPixels(0, bytesPerRow, imageSize, *imageData);
-		if (FAILED(hr))
-			return 0;
-	}
-
-	//now describe the texture with the information we have obtained from the image
-	resourceDescription = {};
-	resourceDescription.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
-	resourceDescription.Alignment = 0; //let the driver decide the alignment based on the size of the image and the number of mips. could set manually for more control
-	resourceDescription.Width = textureWidth;
-	resourceDescription.Height = textureHeight;
-	resourceDescription.DepthOrArraySize = 1; //if 3d image, depth of the 3d image. otherwise size of the array of textures (we only have 1 texture in this case)
-	resourceDescription.MipLevels = 1; //not generating any mips for now
-	resourceDescription.Format = dxgiFormat;
-	resourceDescription.SampleDesc.Count = 1; //no msaa
-	resourceDescription.SampleDesc.Quality = 0; //no msaa
-	resourceDescription.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN; //the arrangement of the pixels. setting to unknown lets the driver choose the most efficient one
-	resourceDescription.Flags = D3D12_RESOURCE_FLAG_NONE;
-
-	//return the image size of the image. remember to delete the image once you're done with it (in this case, once it's uploaded to the gpu)
-	return imageSize;
+	double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - compressStart).count();
+	std::cout << "Compressed " << pTexture.mipLevels << " mips (" << pTexture.width << "x" << pTexture.height << ") to " << blockFormatNames[pFormat] << " in "
+		<< seconds * 1000.0 << " ms, " << megapixels / seconds << " megapixels per second" << std::endl;
+	return true;
 }
 
 // get the dxgi format equivilent of a wic format
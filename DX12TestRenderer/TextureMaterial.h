@@ -11,52 +11,144 @@
 #include <D3Dcompiler.h>
 #include <wincodec.h>
 #include <iostream>
+#include <vector>
 #include "Debug.h"
 #include "Mesh.h"
+#include "MipGenerator.h"
+#include "BlockCompressor.h"
+#include "TextureLayout.h"
+#include "PixelConverter.h"
+
+class TextureRegistry;
+
 class TextureMaterial
 {
 public:
-	TextureMaterial(ID3D12Device* pDevice, ID3D12GraphicsCommandList* pCommandList, LPCWSTR pTexture);
-	void Render(Mesh* pMesh, D3D12_GPU_VIRTUAL_ADDRESS pGPUAddress);
+	//decoded image, ready to be uploaded to a texture
+	struct TextureData {
+		UINT width;
+		UINT height;
+		DXGI_FORMAT format;
+		UINT bytesPerRow;		//of level 0, a row of 4x4 blocks for the block compressed formats
+		UINT mipLevels;
+		//all mip levels tightly packed one after another, rows of pixels or of blocks
+		std::vector<BYTE> pixels;
+		uint64_t contentHash;	//hash of the file and the settings it is loaded with (ReadTextureInfo), 0 if not computed
+	};
+
+	//get the texture from pTextures, loading it if it isn't loaded yet. dds and ktx2 files keep their own mips and format,
+	//only their first array slice is sampled
+	TextureMaterial(ID3D12Device* pDevice, ID3D12GraphicsCommandList* pCommandList, TextureRegistry* pTextures, LPCWSTR pTexture);
+	//use a texture of pTextures. the material takes over the reference to pTexture (a TextureRegistry::Handle)
+	//and releases it when it is deleted
+	TextureMaterial(ID3D12Device* pDevice, ID3D12GraphicsCommandList* pCommandList, TextureRegistry* pTextures, UINT pTexture);
+	//draw the given lod of the mesh
+	void Render(Mesh* pMesh, D3D12_GPU_VIRTUAL_ADDRESS pGPUAddress, int pLod = 0);
+	//the TextureRegistry::Handle of the texture the material samples
+	UINT GetTexture() const;
 	~TextureMaterial();
+
+	//the state Render set on the command list, the calls it skipped because the state was set already aren't counted
+	struct BindStats {
+		unsigned draws;
+		unsigned rootSignatures;
+		unsigned pipelineStates;
+		unsigned descriptorHeaps;
+		unsigned descriptorTables;
+	};
+	static BindStats bindStats;
+
+	//forget what Render set on the command list. call it when the command list is reset, and after anything else
+	//(like DepthMaterial) set its own root signature or pipeline state
+	static void ResetBindings();
+
+	//decode png files with PngDecoder instead of WIC
+	static bool portablePngDecoder;
+
+	//convert gray and 16 bit rgba images to 8 bit rgba when they are loaded (with PixelConverter), so they get mips and
+	//block compression too and gray images aren't sampled as red. without it they keep their format
+	static bool convertToRGBA8;
+
+	//build the mip chain of 8 bit rgba and bgra textures when they are loaded, with mipFilter in linear color space
+	static bool generateMips;
+	static MipGenerator::Filter mipFilter;
+
+	//block compress 8 bit rgba and bgra textures (after their mips are generated) when they are loaded
+	static bool compressTextures;
+	static BlockCompressor::Format textureCompression;
+	static BlockCompressor::Quality compressionQuality;
+
+	//load and decode image from file, generate its mips and block compress it. doesn't touch the device, so it can run on any thread
+	static bool LoadTextureData(LPCWSTR filename, TextureData& pTexture);
+
+	//read only the header of the image file, and fill pTexture with the size, format and mip levels it will have once it is
+	//loaded with the current settings (without pixels) and with the content hash. cheap enough to find duplicates with
+	static bool ReadTextureInfo(LPCWSTR filename, TextureData& pTexture);
+
+	//decode the image file that ReadTextureInfo gave pTexture for, process it and write every level into pBuffer at
+	//pFootprints (one per level), like the mapped upload heap of the texture. images that are neither mipmapped nor
+	//compressed are decoded straight into pBuffer. false if the file doesn't match pTexture anymore
+	static bool LoadTextureInto(LPCWSTR filename, const TextureData& pTexture, uint8_t* pBuffer, const TextureLayout::Footprint* pFootprints);
+
+	//append the mip chain to a texture with one level, if its format supports it
+	static void GenerateMips(TextureData& pTexture);
+
+	//block compress every mip level of an 8 bit rgba or bgra texture with a size of whole blocks, BC5 for normal maps.
+	//false if the texture can't be compressed, it is left as it is then
+	static bool CompressTextureData(TextureData& pTexture, BlockCompressor::Format pFormat);
 protected:
 	ID3D12Device * device;
 	ID3D12GraphicsCommandList* commandList;
 
 	// drawing objects stuff //
-	ID3D12PipelineState* pipelineStateObject; //pso containing a pipeline state (in this case the vertex data for 1 object)
+	//the vertex streams the shaders read (position and uv)
+	static const unsigned streams = Mesh::StreamPosition | Mesh::StreamUv;
+
+	//shared by all texture materials, created with the first one and released with the last, so they never switch pipelines.
+	//the pixel shader samples a Texture2D, or a Texture2DArray for array and cubemap textures (TextureRegistry::isArray)
+	enum View { ViewTexture2D, ViewTexture2DArray, viewCount };
+	static ID3D12PipelineState* pipelineStateObjects[viewCount][Mesh::vertexLayoutCount]; //pso per texture view and mesh vertex layout
+
+	static ID3D12RootSignature* rootSignature; //root signature defines data shaders will access
+	static unsigned _materialCount;
+
+	//what the last Render set on the command list
+	struct Bindings {
+		ID3D12RootSignature* rootSignature;
+		ID3D12PipelineState* pipelineState;
+		ID3D12DescriptorHeap* descriptorHeap;
+		UINT64 descriptorTable;
+	};
+	static Bindings _bound;
 
-	ID3D12RootSignature* rootSignature; //root signature defines data shaders will access
+	//the texture is shared through the registry, which owns the descriptor heap its view is in
+	TextureRegistry* _textures;
+	UINT _texture;
 
-	ID3D12DescriptorHeap* mainDescriptorHeap;
 
-	ID3D12Resource* textureBufferUploadHeap;
+	//create the root signature and pipeline states, if this is the first material
+	void _create();
 
-	BYTE* imageData;
-	
-	ID3D12Resource* textureBuffer; //the resource heap containing our texture
+	//decode the image file into its top level. with pPixels the image is decoded there, pRowPitch bytes per row, instead of
+	//into pTexture.pixels. pTexture has to hold the size and format of the image then
+	static bool _decodeTextureData(LPCWSTR filename, TextureData& pTexture, uint8_t* pPixels = NULL, size_t pRowPitch = 0);
 
+	//open the first frame of the image with WIC. pFormat is the dxgi format the image is loaded as: the pixels of pSource
+	//go through pConversion to get it, or are in it already if pConversion is PixelConverter::ConversionCount. the formats
+	//PixelConverter doesn't handle go through a WIC format converter. pSource has to be released
+	static bool _openWICImage(LPCWSTR filename, IWICBitmapSource*& pSource, DXGI_FORMAT& pFormat, PixelConverter::Conversion& pConversion);
 
-	//load and decode image from file
-	int LoadImageDataFromFile(BYTE** imageData, D3D12_RESOURCE_DESC& resourceDescription, LPCWSTR filename, int &bytesPerRow);
+	//block compress every level of an 8 bit rgba or bgra texture into pBuffer at pFootprints, without reading pBuffer
+	static bool _compressLevels(const TextureData& pTexture, BlockCompressor::Format pFormat, uint8_t* pBuffer, const TextureLayout::Footprint* pFootprints);
 
 	//get DXGI format from the WIC format GUID
-	DXGI_FORMAT GetDXGIFormatFromWICFormat(WICPixelFormatGUID& wicFormatGUID);
+	static DXGI_FORMAT GetDXGIFormatFromWICFormat(WICPixelFormatGUID& wicFormatGUID);
 
 	//converted format for dxgi unknown format
-	WICPixelFormatGUID GetConvertToWICFormat(WICPixelFormatGUID& wicFormatGUID);
+	static WICPixelFormatGUID GetConvertToWICFormat(WICPixelFormatGUID& wicFormatGUID);
 
 	//get the bit depth
-	int GetDXGIFormatBitsPerPixel(DXGI_FORMAT& dxgiFormat);
-
-	static ID3D12Resource* CreateTextureDefaultBuffer(
-		ID3D12Device* device,
-		ID3D12GraphicsCommandList* cmdList,
-		const void* initData,
-		int bytesPerRow,
-		D3D12_RESOURCE_DESC& textureDesc,
-		ID3D12Resource*& uploadBuffer
-	);
+	static int GetDXGIFormatBitsPerPixel(DXGI_FORMAT& dxgiFormat);
 
 };
 
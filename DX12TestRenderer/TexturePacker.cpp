@@ -0,0 +1,165 @@
+#include "TexturePacker.h"
+#include <algorithm>
+
+using namespace std;
+
+namespace {
+	struct Rect {
+		uint32_t x;
+		uint32_t y;
+		uint32_t width;
+		uint32_t height;
+	};
+
+	bool contains(const Rect& pOuter, const Rect& pInner) {
+		return pInner.x >= pOuter.x && pInner.y >= pOuter.y && pInner.x + pInner.width <= pOuter.x + pOuter.width && pInner.y + pInner.height <= pOuter.y + pOuter.height;
+	}
+
+	bool overlaps(const Rect& pA, const Rect& pB) {
+		return pA.x < pB.x + pB.width && pB.x < pA.x + pA.width && pA.y < pB.y + pB.height && pB.y < pA.y + pA.height;
+	}
+
+	uint32_t alignUp(uint32_t pValue, uint32_t pAlignment) {
+		return (pValue + pAlignment - 1) & ~(pAlignment - 1);
+	}
+
+	//the free rectangles of one page
+	class Page {
+	public:
+		Page(uint32_t pSize) {
+			Rect all = { 0, 0, pSize, pSize };
+			_free.push_back(all);
+		}
+
+		//the free rectangle with the shortest side left over, and that side. false if nothing fits
+		bool find(uint32_t pWidth, uint32_t pHeight, Rect& pRect, uint32_t& pShortSide) const {
+			bool found = false;
+			for (size_t i = 0; i < _free.size(); ++i) {
+				const Rect& free = _free[i];
+				if (free.width < pWidth || free.height < pHeight)
+					continue;
+				uint32_t shortSide = min(free.width - pWidth, free.height - pHeight);
+				if (!found || shortSide < pShortSide) {
+					Rect placed = { free.x, free.y, pWidth, pHeight };
+					pRect = placed;
+					pShortSide = shortSide;
+					found = true;
+				}
+			}
+			return found;
+		}
+
+		//split every free rectangle the used one overlaps into the (up to 4) maximal rectangles around it,
+		//then drop the ones another free rectangle contains
+		void use(const Rect& pUsed) {
+			vector<Rect> split;
+			for (size_t i = 0; i < _free.size(); ++i) {
+				const Rect& free = _free[i];
+				if (!overlaps(free, pUsed)) {
+					split.push_back(free);
+					continue;
+				}
+				if (pUsed.x > free.x) {
+					Rect left = { free.x, free.y, pUsed.x - free.x, free.height };
+					split.push_back(left);
+				}
+				if (pUsed.x + pUsed.width < free.x + free.width) {
+					Rect right = { pUsed.x + pUsed.width, free.y, free.x + free.width - (pUsed.x + pUsed.width), free.height };
+					split.push_back(right);
+				}
+				if (pUsed.y > free.y) {
+					Rect top = { free.x, free.y, free.width, pUsed.y - free.y };
+					split.push_back(top);
+				}
+				if (pUsed.y + pUsed.height < free.y + free.height) {
+					Rect bottom = { free.x, pUsed.y + pUsed.height, free.width, free.y + free.height - (pUsed.y + pUsed.height) };
+					split.push_back(bottom);
+				}
+			}
+
+			_free.clear();
+			for (size_t i = 0; i < split.size(); ++i) {
+				bool contained = false;
+				for (size_t j = 0; j < split.size() && !contained; ++j) {
+					//of two equal rectangles the first one stays
+					if (i != j && contains(split[j], split[i]) && (!contains(split[i], split[j]) || j < i))
+						contained = true;
+				}
+				if (!contained)
+					_free.push_back(split[i]);
+			}
+		}
+
+	private:
+		vector<Rect> _free;
+	};
+}
+
+TexturePacker::Stats TexturePacker::pack(const vector<uint32_t>& pWidths, const vector<uint32_t>& pHeights, const Settings& pSettings, vector<Placement>& pPlacements)
+{
+	Stats stats = {};
+	size_t count = pWidths.size();
+	pPlacements.assign(count, Placement());
+
+	//largest first, by the longer side and then the area, the small ones fill the gaps
+	vector<size_t> order(count);
+	for (size_t i = 0; i < count; ++i)
+		order[i] = i;
+	stable_sort(order.begin(), order.end(), [&](size_t pA, size_t pB) {
+		uint32_t sideA = max(pWidths[pA], pHeights[pA]);
+		uint32_t sideB = max(pWidths[pB], pHeights[pB]);
+		if (sideA != sideB)
+			return sideA > sideB;
+		return (uint64_t)pWidths[pA] * pHeights[pA] > (uint64_t)pWidths[pB] * pHeights[pB];
+	});
+
+	vector<Page> pages;
+	for (size_t i = 0; i < count; ++i) {
+		size_t index = order[i];
+		if (pWidths[index] > pSettings.pageSize || pHeights[index] > pSettings.pageSize)
+			continue;
+		//nothing is next to a texture that spans the page, so it doesn't need the padding
+		uint32_t width = min(alignUp(pWidths[index] + pSettings.padding, pSettings.alignment), pSettings.pageSize);
+		uint32_t height = min(alignUp(pHeights[index] + pSettings.padding, pSettings.alignment), pSettings.pageSize);
+
+		//the page where it fits best, a new one if it fits nowhere
+		Rect best = {};
+		uint32_t bestShortSide = 0;
+		size_t bestPage = pages.size();
+		for (size_t page = 0; page < pages.size(); ++page) {
+			Rect rect;
+			uint32_t shortSide;
+			if (pages[page].find(width, height, rect, shortSide) && (bestPage == pages.size() || shortSide < bestShortSide)) {
+				best = rect;
+				bestShortSide = shortSide;
+				bestPage = page;
+			}
+		}
+		if (bestPage == pages.size()) {
+			pages.push_back(Page(pSettings.pageSize));
+			pages.back().find(width, height, best, bestShortSide);
+		}
+		pages[bestPage].use(best);
+
+		Placement& placement = pPlacements[index];
+		placement.packed = true;
+		placement.page = (uint32_t)bestPage;
+		placement.x = best.x;
+		placement.y = best.y;
+		stats.packed++;
+		stats.usedTexels += (uint64_t)pWidths[index] * pHeights[index];
+	}
+
+	stats.pages = (uint32_t)pages.size();
+	stats.occupancy = pages.empty() ? 0.0 : stats.usedTexels / ((double)pSettings.pageSize * pSettings.pageSize * pages.size());
+	return stats;
+}
+
+uint32_t TexturePacker::atlasMipLevels(uint32_t pPadding)
+{
+	//padding p at level 0 is p >> m texels at level m
+	uint32_t levels = 1;
+	while ((pPadding >> levels) >= 1)
+		levels++;
+	return levels;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * Packs rectangles (textures) into square atlas pages with the MaxRects algorithm (Jylanki 2010): the free space of a
+ * page is kept as a list of maximal free rectangles that may overlap, every rectangle goes to the free rectangle that
+ * leaves the shortest side over (best short side fit), and the free rectangles it overlaps are split around it.
+ * Rectangles are packed largest first, a new page is opened when one doesn't fit any page.
+ * Every rectangle gets padding texels to its right and bottom and is placed on a multiple of the alignment, so the
+ * mips of the atlas keep the textures apart and block compressed textures start on whole blocks at every mip.
+ * Device independent, TextureRegistry::packAtlases copies the textures to where it says.
+ */
+class TexturePacker
+{
+public:
+	struct Settings {
+		uint32_t pageSize;		//width and height of a page
+		uint32_t padding;		//texels between textures
+		uint32_t alignment;		//placements and padded sizes are multiples of it, a power of 2
+	};
+
+	struct Placement {
+		bool packed;		//false if the rectangle is bigger than a page
+		uint32_t page;
+		uint32_t x;
+		uint32_t y;
+	};
+
+	struct Stats {
+		uint32_t pages;
+		uint32_t packed;
+		uint64_t usedTexels;	//of the packed rectangles, without padding
+		double occupancy;		//usedTexels over the texels of all pages
+	};
+
+	//place pWidths[i] x pHeights[i] for every i in pPlacements, pageSize has to be a multiple of the alignment
+	static Stats pack(const std::vector<uint32_t>& pWidths, const std::vector<uint32_t>& pHeights, const Settings& pSettings, std::vector<Placement>& pPlacements);
+
+	//the most mip levels an atlas can have before the textures bleed into each other: at the last level the padding
+	//is still a texel
+	static uint32_t atlasMipLevels(uint32_t pPadding);
+};
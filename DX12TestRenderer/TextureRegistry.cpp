@@ -0,0 +1,840 @@
+#include "TextureRegistry.h"
+#include "MeshRegistry.h"
+#include "ContentHash.h"
+#include <chrono>
+#include <iostream>
+#include <algorithm>
+#include <map>
+
+using namespace std;
+
+namespace {
+	D3D12_RESOURCE_DESC textureDesc(UINT pWidth, UINT pHeight, UINT pArraySize, UINT pMipLevels, DXGI_FORMAT pFormat) {
+		D3D12_RESOURCE_DESC desc = {};
+		desc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+		desc.Alignment = 0; //let the driver decide the alignment based on the size of the image and the number of mips. could set manually for more control
+		desc.Width = pWidth;
+		desc.Height = pHeight;
+		desc.DepthOrArraySize = (UINT16)pArraySize; //if 3d image, depth of the 3d image. otherwise size of the array of textures
+		desc.MipLevels = (UINT16)pMipLevels;
+		desc.Format = pFormat;
+		desc.SampleDesc.Count = 1; //no msaa
+		desc.SampleDesc.Quality = 0; //no msaa
+		desc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN; //the arrangement of the pixels. setting to unknown lets the driver choose the most efficient one
+		desc.Flags = D3D12_RESOURCE_FLAG_NONE;
+		return desc;
+	}
+
+	UINT levelSize(UINT pSize, UINT pMip) {
+		return ((pSize >> pMip) > 0) ? pSize >> pMip : 1;
+	}
+
+	//256 MB of textures, mips of 64x64 and smaller always resident, a few levels loaded per frame to spread the uploads
+	const TextureStreamer::Settings defaultStreaming = { 256ull * 1024 * 1024, 64, 4 };
+
+	//a 4k texture with its mips still fits a texture block, upload heaps only live until their copy is done
+	const uint64_t textureBlockSize = 128ull * 1024 * 1024;
+	const uint64_t uploadBlockSize = 64ull * 1024 * 1024;
+}
+
+bool TextureRegistry::streamTextures = true;
+
+TextureRegistry::Upload::~Upload()
+{
+	if (uploadHeap) {
+		if (data) uploadHeap->Unmap(0, NULL);
+		registry->_uploadBufferHeap.release(uploadHeap);
+	}
+	if (texture) registry->_textureHeap.release(texture);
+}
+
+TextureRegistry::TextureRegistry(ID3D12Device* pDevice, ID3D12GraphicsCommandList* pCommandList, UINT pMaxTextures)
+	: _device(pDevice), _commandList(pCommandList), _textureHeap(pDevice, D3D12_HEAP_TYPE_DEFAULT, D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES, textureBlockSize),
+	_uploadBufferHeap(pDevice, D3D12_HEAP_TYPE_UPLOAD, D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS, uploadBlockSize), _descriptorHeap(NULL), _descriptorSize(0), _maxTextures(pMaxTextures), _streamer(defaultStreaming),
+	_loads(0), _pathHits(0), _contentHits(0), _loadSeconds(0), _savedSeconds(0)
+{
+	//the heap every material binds, two shader resource views per texture so a streamed texture can change its view
+	//while frames in flight still read the old one
+	D3D12_DESCRIPTOR_HEAP_DESC heapDesc = {};
+	heapDesc.NumDescriptors = pMaxTextures * 2;
+	heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+	heapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+	ThrowIfFailed(_device->CreateDescriptorHeap(&heapDesc, IID_PPV_ARGS(&_descriptorHeap)));
+	_descriptorSize = _device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+
+	_byHandle.resize(pMaxTextures, NULL);
+	for (UINT i = pMaxTextures; i > 0; --i)
+		_freeHandles.push_back(i - 1);
+}
+
+TextureRegistry::~TextureRegistry()
+{
+	for (size_t i = 0; i < _byHandle.size(); ++i) {
+		if (_byHandle[i] != NULL)
+			_destroy(_byHandle[i]);
+	}
+	if (_descriptorHeap) _descriptorHeap->Release();
+}
+
+TextureRegistry::Handle TextureRegistry::acquire(const wstring& pFileName)
+{
+	Handle loaded = acquireLoaded(pFileName);
+	if (loaded != invalidHandle)
+		return loaded;
+
+	auto loadStart = chrono::high_resolution_clock::now();
+	//containers are read straight from the mapped file, without decoding
+	MappedFile file;
+	TextureContainer::Description description;
+	if (openContainer(pFileName, file, description)) {
+		uint64_t hash = contentHash(file.data(), description);
+		double seconds = chrono::duration<double>(chrono::high_resolution_clock::now() - loadStart).count();
+		return adoptContainer(pFileName, file.data(), description, hash, seconds);
+	}
+
+	//other images are decoded straight into the upload heap, unless their content is loaded already
+	TextureMaterial::TextureData texture;
+	if (!TextureMaterial::ReadTextureInfo(pFileName.c_str(), texture))
+		return invalidHandle;
+	Handle shared = acquireShared(pFileName, texture.contentHash);
+	if (shared != invalidHandle)
+		return shared;
+
+	Upload* upload = beginUpload(texture);
+	if (!TextureMaterial::LoadTextureInto(pFileName.c_str(), texture, upload->data, &upload->footprints[0])) {
+		delete upload;
+		return invalidHandle;
+	}
+	double seconds = chrono::duration<double>(chrono::high_resolution_clock::now() - loadStart).count();
+	return endUpload(pFileName, upload, texture.contentHash, seconds);
+}
+
+TextureRegistry::Handle TextureRegistry::acquireLoaded(const wstring& pFileName)
+{
+	auto found = _byPath.find(pathKey(pFileName));
+	if (found == _byPath.end())
+		return invalidHandle;
+
+	Entry* entry = found->second;
+	entry->references++;
+	_pathHits++;
+	_savedSeconds += entry->loadSeconds;
+	return entry->handle;
+}
+
+TextureRegistry::Handle TextureRegistry::acquireShared(const wstring& pFileName, uint64_t pContentHash)
+{
+	Handle loaded = acquireLoaded(pFileName);
+	if (loaded != invalidHandle)
+		return loaded;
+
+	auto sameContent = _byContent.find(pContentHash);
+	if (sameContent == _byContent.end())
+		return invalidHandle;
+
+	Entry* entry = sameContent->second;
+	string path = pathKey(pFileName);
+	entry->references++;
+	entry->paths.push_back(path);
+	_byPath[path] = entry;
+	_contentHits++;
+	_savedSeconds += entry->loadSeconds;
+	return entry->handle;
+}
+
+TextureRegistry::Handle TextureRegistry::adopt(const wstring& pFileName, const TextureMaterial::TextureData& pTexture, double pLoadSeconds)
+{
+	string path = pathKey(pFileName);
+	uint64_t hash = (pTexture.contentHash != 0) ? pTexture.contentHash : contentHash(pTexture);
+	Handle shared = _share(path, hash, pLoadSeconds);
+	if (shared != invalidHandle || pTexture.pixels.empty())
+		return shared;
+
+	//the levels are tightly packed in the pixel data, block compressed levels are rows of 4x4 blocks,
+	//so a level takes the row size of its footprint times its rows
+	Upload* upload = beginUpload(pTexture);
+	size_t levelOffset = 0;
+	for (size_t i = 0; i < upload->footprints.size(); ++i) {
+		const TextureLayout::Footprint& footprint = upload->footprints[i];
+		if (levelOffset + (size_t)footprint.rowBytes * footprint.rows > pTexture.pixels.size()) {
+			delete upload;
+			return invalidHandle;
+		}
+		TextureLayout::copyRows(&pTexture.pixels[levelOffset], footprint.rowBytes, footprint, upload->data);
+		levelOffset += (size_t)footprint.rowBytes * footprint.rows;
+	}
+	return _finishUpload(path, upload, hash, pLoadSeconds);
+}
+
+TextureRegistry::Handle TextureRegistry::adoptContainer(const wstring& pFileName, const void* pData, const TextureContainer::Description& pDescription, uint64_t pContentHash, double pLoadSeconds)
+{
+	string path = pathKey(pFileName);
+	uint64_t hash = (pContentHash != 0) ? pContentHash : contentHash(pData, pDescription);
+	Handle shared = _share(path, hash, pLoadSeconds);
+	if (shared != invalidHandle)
+		return shared;
+
+	//streamed textures start with their pinned mips only, and keep the file mapped for the others
+	MappedFile* source = NULL;
+	TextureContainer::Description sourceDescription;
+	UINT firstMip = 0;
+	if (streamTextures)
+		firstMip = TextureStreamer::pinnedMip(pDescription.format, pDescription.width, pDescription.height, pDescription.mipLevels, _streamer.getSettings().pinnedSize);
+	if (firstMip > 0) {
+		source = new MappedFile();
+		if (!openContainer(pFileName, *source, sourceDescription)) {
+			delete source;
+			source = NULL;
+			firstMip = 0;
+		}
+	}
+
+	//the payload goes straight from the mapped file to the upload heap, the only copy the cpu makes
+	UINT mipCount = pDescription.mipLevels - firstMip;
+	Upload* upload = _beginUpload(textureDesc(levelSize(pDescription.width, firstMip), levelSize(pDescription.height, firstMip), pDescription.arraySize, mipCount, (DXGI_FORMAT)pDescription.format));
+	if (!TextureContainer::copyMips(pData, pDescription, firstMip, mipCount, &upload->footprints[0], upload->data)) {
+		cout << "Could not upload texture " << path << endl;
+		delete upload;
+		delete source;
+		return invalidHandle;
+	}
+	Handle handle = _finishUpload(path, upload, hash, pLoadSeconds);
+	if (handle == invalidHandle || source == NULL) {
+		delete source;
+		return handle;
+	}
+
+	Entry* entry = _byHandle[handle];
+	entry->source = source;
+	entry->sourceDescription = sourceDescription;
+	entry->residentMip = _streamer.add(handle, pDescription.format, pDescription.width, pDescription.height, pDescription.mipLevels, pDescription.arraySize, true);
+	return handle;
+}
+
+TextureRegistry::Upload* TextureRegistry::beginUpload(const TextureMaterial::TextureData& pTexture)
+{
+	//the levels are generated on the cpu when the texture is loaded
+	return _beginUpload(textureDesc(pTexture.width, pTexture.height, 1, pTexture.mipLevels, pTexture.format));
+}
+
+TextureRegistry::Handle TextureRegistry::endUpload(const wstring& pFileName, Upload* pUpload, uint64_t pContentHash, double pLoadSeconds)
+{
+	string path = pathKey(pFileName);
+	Handle shared = _share(path, pContentHash, pLoadSeconds);
+	if (shared != invalidHandle) {
+		//nothing is recorded for it yet, so it can go right away
+		delete pUpload;
+		return shared;
+	}
+	return _finishUpload(path, pUpload, pContentHash, pLoadSeconds);
+}
+
+bool TextureRegistry::openContainer(const wstring& pFileName, MappedFile& pFile, TextureContainer::Description& pDescription)
+{
+	char narrowFilename[MAX_PATH];
+	if (WideCharToMultiByte(CP_ACP, 0, pFileName.c_str(), -1, narrowFilename, MAX_PATH, NULL, NULL) <= 0 || !pFile.open(narrowFilename))
+		return false;
+
+	if (TextureContainer::identify(pFile.data(), pFile.size()) == TextureContainer::TypeNone) {
+		pFile.close();
+		return false;
+	}
+	if (!TextureContainer::parse(pFile.data(), pFile.size(), pDescription)) {
+		cout << "Unsupported or broken texture container " << narrowFilename << endl;
+		pFile.close();
+		return false;
+	}
+	return true;
+}
+
+void TextureRegistry::release(Handle pTexture)
+{
+	if (pTexture == invalidHandle)
+		return;
+
+	Entry* entry = (pTexture < _byHandle.size()) ? _byHandle[pTexture] : NULL;
+	if (entry == NULL) {
+		cout << "Releasing a texture that is not in the registry" << endl;
+		return;
+	}
+	if (--entry->references > 0)
+		return;
+
+	for (size_t i = 0; i < entry->paths.size(); ++i)
+		_byPath.erase(entry->paths[i]);
+	//atlas pages have no content of their own
+	auto sameContent = _byContent.find(entry->contentHash);
+	if (sameContent != _byContent.end() && sameContent->second == entry)
+		_byContent.erase(sameContent);
+	_byHandle[pTexture] = NULL;
+	_freeHandles.push_back(pTexture);
+	_pendingUploads.erase(remove(_pendingUploads.begin(), _pendingUploads.end(), entry), _pendingUploads.end());
+	_streamer.remove(pTexture);
+	//a page is referenced by every texture packed into it
+	if (entry->atlas != NULL)
+		release(entry->atlas->handle);
+	_destroy(entry);
+}
+
+ID3D12DescriptorHeap* TextureRegistry::getDescriptorHeap() const
+{
+	return _descriptorHeap;
+}
+
+D3D12_GPU_DESCRIPTOR_HANDLE TextureRegistry::getDescriptor(Handle pTexture) const
+{
+	Entry* entry = (pTexture < _byHandle.size()) ? _byHandle[pTexture] : NULL;
+	if (entry != NULL && entry->atlas != NULL)
+		entry = entry->atlas;
+	return CD3DX12_GPU_DESCRIPTOR_HANDLE(_descriptorHeap->GetGPUDescriptorHandleForHeapStart(), entry ? entry->descriptor : pTexture, _descriptorSize);
+}
+
+ID3D12Resource* TextureRegistry::getResource(Handle pTexture) const
+{
+	Entry* entry = (pTexture < _byHandle.size()) ? _byHandle[pTexture] : NULL;
+	if (entry != NULL && entry->atlas != NULL)
+		entry = entry->atlas;
+	return entry ? entry->texture : NULL;
+}
+
+bool TextureRegistry::isArray(Handle pTexture) const
+{
+	//atlas pages are never arrays, arrays aren't packed
+	Entry* entry = (pTexture < _byHandle.size()) ? _byHandle[pTexture] : NULL;
+	return entry != NULL && entry->atlas == NULL && entry->array;
+}
+
+void TextureRegistry::setUploadFence(ID3D12Fence* pFence, UINT64 pFenceValue)
+{
+	//a later fence would work too, but keeps moving the release further away when it is set every frame
+	for (size_t i = 0; i < _pendingUploads.size(); ++i) {
+		if (_pendingUploads[i]->uploadFence == NULL) {
+			_pendingUploads[i]->uploadFence = pFence;
+			_pendingUploads[i]->uploadFenceValue = pFenceValue;
+		}
+	}
+}
+
+unsigned TextureRegistry::releaseUploadData()
+{
+	unsigned released = 0;
+	for (size_t i = 0; i < _pendingUploads.size();) {
+		Entry* entry = _pendingUploads[i];
+		if (entry->uploadFence != NULL && entry->uploadFence->GetCompletedValue() >= entry->uploadFenceValue) {
+			//an eviction has no upload heap, only the texture it replaced
+			if (entry->uploadHeap) _uploadBufferHeap.release(entry->uploadHeap);
+			if (entry->retiredTexture) _textureHeap.release(entry->retiredTexture);
+			entry->uploadHeap = NULL;
+			entry->retiredTexture = NULL;
+			entry->uploadFence = NULL;
+			_pendingUploads[i] = _pendingUploads.back();
+			_pendingUploads.pop_back();
+			released++;
+		}
+		else {
+			++i;
+		}
+	}
+	return released;
+}
+
+TextureRegistry::Stats TextureRegistry::getStats() const
+{
+	Stats stats = {};
+	stats.loads = _loads;
+	stats.pathHits = _pathHits;
+	stats.contentHits = _contentHits;
+	stats.loadSeconds = _loadSeconds;
+	stats.savedSeconds = _savedSeconds;
+
+	for (size_t i = 0; i < _byHandle.size(); ++i) {
+		const Entry* entry = _byHandle[i];
+		if (entry == NULL)
+			continue;
+		stats.gpuBytes += entry->gpuBytes;
+		//the references of a page are the textures packed into it
+		if (entry->paths.empty()) {
+			stats.atlases++;
+			continue;
+		}
+		stats.textures++;
+		if (entry->atlas != NULL)
+			stats.packed++;
+		stats.references += entry->references;
+		stats.savedGpuBytes += entry->gpuBytes * (entry->references - 1);
+	}
+	stats.pendingUploads = (unsigned)_pendingUploads.size();
+	return stats;
+}
+
+ResourceHeap::Stats TextureRegistry::getTextureHeapStats() const
+{
+	return _textureHeap.getStats();
+}
+
+ResourceHeap::Stats TextureRegistry::getUploadHeapStats() const
+{
+	return _uploadBufferHeap.getStats();
+}
+
+void TextureRegistry::setStreamingSettings(const TextureStreamer::Settings& pSettings)
+{
+	_streamer.setSettings(pSettings);
+}
+
+const TextureStreamer::Settings& TextureRegistry::getStreamingSettings() const
+{
+	return _streamer.getSettings();
+}
+
+void TextureRegistry::requestMip(Handle pTexture, float pMip)
+{
+	_streamer.request(pTexture, pMip);
+}
+
+UINT TextureRegistry::getSize(Handle pTexture) const
+{
+	return _streamer.getSize(pTexture);
+}
+
+unsigned TextureRegistry::updateStreaming()
+{
+	//a texture whose last change is still being copied keeps its mips, the views of both its descriptors may be in use
+	for (size_t i = 0; i < _byHandle.size(); ++i) {
+		Entry* entry = _byHandle[i];
+		if (entry != NULL && entry->source != NULL)
+			_streamer.setLocked((Handle)i, entry->uploadHeap != NULL || entry->retiredTexture != NULL);
+	}
+
+	vector<TextureStreamer::Change> changes = _streamer.update();
+	unsigned changed = 0;
+	for (size_t i = 0; i < changes.size(); ++i) {
+		if (_setResidentMip(_byHandle[changes[i].texture], changes[i].residentMip))
+			changed++;
+	}
+	return changed;
+}
+
+const TextureStreamer::Stats& TextureRegistry::getStreamingStats() const
+{
+	return _streamer.getStats();
+}
+
+unsigned TextureRegistry::packAtlases(const AtlasSettings& pSettings)
+{
+	//the textures that can share a page: the same format and the same number of mips in the page
+	UINT maxLevels = TexturePacker::atlasMipLevels(pSettings.padding);
+	map<pair<DXGI_FORMAT, UINT>, vector<Entry*>> groups;
+	for (size_t i = 0; i < _byHandle.size(); ++i) {
+		Entry* entry = _byHandle[i];
+		//streamed textures change their size, the others have to be on the gpu already
+		if (entry == NULL || entry->paths.empty() || entry->atlas != NULL || entry->source != NULL || entry->uploadHeap != NULL || entry->retiredTexture != NULL)
+			continue;
+		D3D12_RESOURCE_DESC desc = entry->texture->GetDesc();
+		if (desc.DepthOrArraySize > 1 || desc.Width > pSettings.maxSize || desc.Height > pSettings.maxSize)
+			continue;
+		UINT levels = min((UINT)desc.MipLevels, maxLevels);
+		//block compressed levels are copied as whole blocks
+		if (TextureLayout::isBlockCompressed(desc.Format)) {
+			while (levels > 0 && (((UINT)desc.Width >> (levels - 1)) % 4 != 0 || (desc.Height >> (levels - 1)) % 4 != 0))
+				levels--;
+			if (levels == 0)
+				continue;
+		}
+		groups[make_pair(desc.Format, levels)].push_back(entry);
+	}
+
+	unsigned packed = 0;
+	for (auto group = groups.begin(); group != groups.end(); ++group) {
+		const vector<Entry*>& entries = group->second;
+		if (entries.size() < 2)
+			continue;
+
+		//every level of the page has the textures on whole texels, and on whole blocks if they are block compressed
+		UINT levels = group->first.second;
+		TexturePacker::Settings settings;
+		settings.padding = pSettings.padding;
+		settings.alignment = (TextureLayout::isBlockCompressed(group->first.first) ? 4 : 1) << (levels - 1);
+		vector<uint32_t> widths(entries.size());
+		vector<uint32_t> heights(entries.size());
+		uint32_t largest = 0;
+		for (size_t i = 0; i < entries.size(); ++i) {
+			D3D12_RESOURCE_DESC desc = entries[i]->texture->GetDesc();
+			widths[i] = (uint32_t)desc.Width;
+			heights[i] = desc.Height;
+			largest = max(largest, max(widths[i], heights[i]));
+		}
+
+		//the smallest page (a power of 2) that takes them all, or as many pageSize pages as needed
+		settings.pageSize = settings.alignment;
+		while (settings.pageSize < largest && settings.pageSize < pSettings.pageSize)
+			settings.pageSize *= 2;
+		vector<TexturePacker::Placement> placements;
+		TexturePacker::Stats packStats = TexturePacker::pack(widths, heights, settings, placements);
+		while (packStats.pages > 1 && settings.pageSize < pSettings.pageSize) {
+			settings.pageSize *= 2;
+			packStats = TexturePacker::pack(widths, heights, settings, placements);
+		}
+
+		//what actually ends up in pages, the packer also counts the pages that are skipped below
+		unsigned groupPacked = 0, pages = 0;
+		uint64_t usedTexels = 0;
+		for (uint32_t page = 0; page < packStats.pages; ++page) {
+			vector<Entry*> members;
+			vector<TexturePacker::Placement> memberPlacements;
+			uint64_t pageTexels = 0;
+			for (size_t i = 0; i < entries.size(); ++i) {
+				if (placements[i].packed && placements[i].page == page) {
+					members.push_back(entries[i]);
+					memberPlacements.push_back(placements[i]);
+					pageTexels += (uint64_t)widths[i] * heights[i];
+				}
+			}
+			//a page with one texture saves no binding
+			if (members.size() < 2 || !_createAtlasPage(members, memberPlacements, settings.pageSize, levels))
+				continue;
+			groupPacked += (unsigned)members.size();
+			pages++;
+			usedTexels += pageTexels;
+		}
+		packed += groupPacked;
+		cout << "Packed " << groupPacked << " of " << entries.size() << " textures of format " << group->first.first << " into " << pages << " atlas pages of "
+			<< settings.pageSize << "x" << settings.pageSize;
+		if (pages > 0)
+			cout << " (" << 100.0 * usedTexels / ((double)pages * settings.pageSize * settings.pageSize) << "% used)";
+		cout << endl;
+	}
+	return packed;
+}
+
+void TextureRegistry::getUvTransform(Handle pTexture, float pTransform[4]) const
+{
+	Entry* entry = (pTexture < _byHandle.size()) ? _byHandle[pTexture] : NULL;
+	if (entry != NULL && entry->atlas != NULL) {
+		copy(entry->uvTransform, entry->uvTransform + 4, pTransform);
+		return;
+	}
+	pTransform[0] = 1.0f;
+	pTransform[1] = 1.0f;
+	pTransform[2] = 0.0f;
+	pTransform[3] = 0.0f;
+}
+
+unsigned TextureRegistry::countBindings(const vector<Handle>& pTextures) const
+{
+	vector<UINT64> tables;
+	for (size_t i = 0; i < pTextures.size(); ++i) {
+		if (pTextures[i] != invalidHandle)
+			tables.push_back(getDescriptor(pTextures[i]).ptr);
+	}
+	sort(tables.begin(), tables.end());
+	return (unsigned)(unique(tables.begin(), tables.end()) - tables.begin());
+}
+
+uint64_t TextureRegistry::contentHash(const TextureMaterial::TextureData& pTexture)
+{
+	uint64_t layout[4] = { pTexture.width, pTexture.height, (uint64_t)pTexture.format, pTexture.mipLevels };
+	uint64_t hash = hashContent(layout, sizeof(layout));
+	return hashContent(pTexture.pixels.data(), pTexture.pixels.size(), hash);
+}
+
+uint64_t TextureRegistry::contentHash(const void* pData, const TextureContainer::Description& pDescription)
+{
+	uint64_t layout[5] = { pDescription.width, pDescription.height, pDescription.format, pDescription.mipLevels, pDescription.arraySize };
+	uint64_t hash = hashContent(layout, sizeof(layout));
+	//the payload as it is in the file, both containers keep it in one piece after the header
+	uint64_t begin, end;
+	TextureContainer::payloadRange(pDescription, begin, end);
+	return hashContent((const char*)pData + begin, (size_t)(end - begin), hash);
+}
+
+TextureRegistry::Handle TextureRegistry::_share(const string& pPath, uint64_t pContentHash, double pLoadSeconds)
+{
+	_loads++;
+	_loadSeconds += pLoadSeconds;
+
+	//the same path was loaded in the meantime (two loads in flight), keep the texture we already have
+	auto samePath = _byPath.find(pPath);
+	if (samePath != _byPath.end()) {
+		samePath->second->references++;
+		return samePath->second->handle;
+	}
+
+	//a different path with the same pixels, keep the texture we already have
+	auto sameContent = _byContent.find(pContentHash);
+	if (sameContent != _byContent.end()) {
+		Entry* entry = sameContent->second;
+		_contentHits++;
+		entry->references++;
+		entry->paths.push_back(pPath);
+		_byPath[pPath] = entry;
+		return entry->handle;
+	}
+	return invalidHandle;
+}
+
+TextureRegistry::Upload* TextureRegistry::_beginUpload(const D3D12_RESOURCE_DESC& pDesc, bool pCreateTexture)
+{
+	Upload* upload = new Upload();
+	upload->registry = this;
+	upload->desc = pDesc;
+
+	UINT subresourceCount = pDesc.MipLevels * pDesc.DepthOrArraySize;
+	upload->layouts.resize(subresourceCount);
+	std::vector<UINT> rows(subresourceCount);
+	std::vector<UINT64> rowBytes(subresourceCount);
+	UINT64 textureUploadBufferSize;
+	//where every subresource goes in the upload heap. each row must be 256 byte aligned except the last row,
+	//which can just be the size in bytes of the row, and every subresource starts at a 512 byte aligned offset
+	_device->GetCopyableFootprints(&pDesc, 0, subresourceCount, 0, &upload->layouts[0], &rows[0], &rowBytes[0], &textureUploadBufferSize);
+
+	upload->footprints.resize(subresourceCount);
+	for (UINT i = 0; i < subresourceCount; ++i) {
+		TextureLayout::Footprint& footprint = upload->footprints[i];
+		footprint.offset = upload->layouts[i].Offset;
+		footprint.width = upload->layouts[i].Footprint.Width;
+		footprint.height = upload->layouts[i].Footprint.Height;
+		footprint.rowPitch = upload->layouts[i].Footprint.RowPitch;
+		footprint.rows = rows[i];
+		footprint.rowBytes = (uint32_t)rowBytes[i];
+	}
+
+	// Create the actual default buffer resource, ready to be copied to.
+	if (pCreateTexture)
+		upload->texture = _textureHeap.create(pDesc, D3D12_RESOURCE_STATE_COPY_DEST);
+
+	// In order to copy CPU memory data into our default buffer, we need to create
+	// an intermediate upload heap.
+	upload->uploadHeap = _uploadBufferHeap.create(CD3DX12_RESOURCE_DESC::Buffer(textureUploadBufferSize), D3D12_RESOURCE_STATE_GENERIC_READ);
+
+	//the cpu only writes, nothing is read back. the mapping stays valid on every thread until _finishUpload
+	void* mapped = NULL;
+	CD3DX12_RANGE readRange(0, 0);
+	ThrowIfFailed(upload->uploadHeap->Map(0, &readRange, &mapped));
+	upload->data = (uint8_t*)mapped;
+	return upload;
+}
+
+TextureRegistry::Handle TextureRegistry::_finishUpload(const string& pPath, Upload* pUpload, uint64_t pContentHash, double pLoadSeconds)
+{
+	if (_freeHandles.empty()) {
+		cout << "No texture descriptors left for " << pPath << endl;
+		delete pUpload;
+		return invalidHandle;
+	}
+
+	Entry* entry = new Entry();
+	entry->handle = _freeHandles.back();
+	_freeHandles.pop_back();
+	entry->references = 1;
+	entry->loadSeconds = pLoadSeconds;
+	entry->contentHash = pContentHash;
+	entry->paths.push_back(pPath);
+	entry->descriptor = entry->handle;
+	entry->retiredTexture = NULL;
+	entry->source = NULL;
+	entry->residentMip = 0;
+	entry->atlas = NULL;
+	getUvTransform(invalidHandle, entry->uvTransform);
+
+	//the entry takes over the resources
+	pUpload->uploadHeap->Unmap(0, NULL);
+	pUpload->data = NULL;
+	entry->texture = pUpload->texture;
+	entry->uploadHeap = pUpload->uploadHeap;
+	pUpload->texture = NULL;
+	pUpload->uploadHeap = NULL;
+	const D3D12_RESOURCE_DESC& desc = pUpload->desc;
+
+	// Note: the upload heap has to be kept alive until the command list that performs the copy has executed,
+	// releaseUploadData lets go of it once the upload fence is reached.
+	for (UINT i = 0; i < (UINT)pUpload->layouts.size(); ++i) {
+		CD3DX12_TEXTURE_COPY_LOCATION destination(entry->texture, i);
+		CD3DX12_TEXTURE_COPY_LOCATION source(entry->uploadHeap, pUpload->layouts[i]);
+		_commandList->CopyTextureRegion(&destination, 0, 0, 0, &source, NULL);
+	}
+	entry->uploadFence = NULL;
+	entry->uploadFenceValue = 0;
+	entry->gpuBytes = (size_t)_device->GetResourceAllocationInfo(0, 1, &desc).SizeInBytes;
+
+	//transition the texture default heap to a pixel shader resource
+	_commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(entry->texture, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
+
+	_writeView(entry, desc);
+	//fully resident until adoptContainer makes it a streamed texture, it counts to the budget either way
+	_streamer.add(entry->handle, desc.Format, (UINT)desc.Width, desc.Height, desc.MipLevels, desc.DepthOrArraySize, false);
+	delete pUpload;
+
+	_byPath[pPath] = entry;
+	_byContent[pContentHash] = entry;
+	_byHandle[entry->handle] = entry;
+	_pendingUploads.push_back(entry);
+	return entry->handle;
+}
+
+void TextureRegistry::_writeView(Entry* pEntry, const D3D12_RESOURCE_DESC& pDesc)
+{
+	//now we create a shader resource view descriptor (points to the texture and describes it).
+	//arrays and cubemaps are viewed as an array of 2d textures, the materials sample them with the array pixel shader
+	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+	srvDesc.Format = pDesc.Format;
+	pEntry->array = pDesc.DepthOrArraySize > 1;
+	if (pEntry->array) {
+		srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2DARRAY;
+		srvDesc.Texture2DArray.MipLevels = pDesc.MipLevels;
+		srvDesc.Texture2DArray.ArraySize = pDesc.DepthOrArraySize;
+	}
+	else {
+		srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+		srvDesc.Texture2D.MipLevels = pDesc.MipLevels;
+	}
+	_device->CreateShaderResourceView(pEntry->texture, &srvDesc, CD3DX12_CPU_DESCRIPTOR_HANDLE(_descriptorHeap->GetCPUDescriptorHandleForHeapStart(), pEntry->descriptor, _descriptorSize));
+}
+
+bool TextureRegistry::_setResidentMip(Entry* pEntry, UINT pMip)
+{
+	const TextureContainer::Description& source = pEntry->sourceDescription;
+	UINT previousMip = pEntry->residentMip;
+	UINT mipCount = source.mipLevels - pMip;
+	UINT previousMipCount = source.mipLevels - previousMip;
+	DXGI_FORMAT format = (DXGI_FORMAT)source.format;
+
+	//the levels above the ones that are resident come from the file, through an upload heap laid out like a texture that
+	//only has those levels
+	Upload* upload = NULL;
+	UINT loadedMips = (pMip < previousMip) ? previousMip - pMip : 0;
+	if (loadedMips > 0) {
+		upload = _beginUpload(textureDesc(levelSize(source.width, pMip), levelSize(source.height, pMip), source.arraySize, loadedMips, format), false);
+		if (!TextureContainer::copyMips(pEntry->source->data(), source, pMip, loadedMips, &upload->footprints[0], upload->data)) {
+			cout << "Could not stream texture " << pEntry->paths[0] << endl;
+			delete upload;
+			return false;
+		}
+		upload->uploadHeap->Unmap(0, NULL);
+		upload->data = NULL;
+	}
+
+	D3D12_RESOURCE_DESC desc = textureDesc(levelSize(source.width, pMip), levelSize(source.height, pMip), source.arraySize, mipCount, format);
+	ID3D12Resource* texture = _textureHeap.create(desc, D3D12_RESOURCE_STATE_COPY_DEST);
+
+	//the old texture is only read from now on, frames in flight sample it through its old view
+	_commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(pEntry->texture, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_SOURCE));
+	for (UINT slice = 0; slice < source.arraySize; ++slice) {
+		for (UINT mip = pMip; mip < source.mipLevels; ++mip) {
+			CD3DX12_TEXTURE_COPY_LOCATION destination(texture, (mip - pMip) + slice * mipCount);
+			if (mip < previousMip) {
+				CD3DX12_TEXTURE_COPY_LOCATION loaded(upload->uploadHeap, upload->layouts[(mip - pMip) + slice * loadedMips]);
+				_commandList->CopyTextureRegion(&destination, 0, 0, 0, &loaded, NULL);
+			}
+			else {
+				CD3DX12_TEXTURE_COPY_LOCATION kept(pEntry->texture, (mip - previousMip) + slice * previousMipCount);
+				_commandList->CopyTextureRegion(&destination, 0, 0, 0, &kept, NULL);
+			}
+		}
+	}
+	_commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(texture, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
+
+	//both the old texture and the upload heap go once the copies are done, like the upload heap of a new texture
+	pEntry->retiredTexture = pEntry->texture;
+	pEntry->texture = texture;
+	if (upload != NULL) {
+		pEntry->uploadHeap = upload->uploadHeap;
+		upload->uploadHeap = NULL;
+		delete upload;
+	}
+	pEntry->uploadFence = NULL;
+	pEntry->uploadFenceValue = 0;
+	_pendingUploads.push_back(pEntry);
+	pEntry->residentMip = pMip;
+	pEntry->gpuBytes = (size_t)_device->GetResourceAllocationInfo(0, 1, &desc).SizeInBytes;
+
+	//the view goes to the other descriptor of the handle
+	pEntry->descriptor = (pEntry->descriptor == pEntry->handle) ? pEntry->handle + _maxTextures : pEntry->handle;
+	_writeView(pEntry, desc);
+	return true;
+}
+
+bool TextureRegistry::_createAtlasPage(const vector<Entry*>& pMembers, const vector<TexturePacker::Placement>& pPlacements, UINT pSize, UINT pMipLevels)
+{
+	if (_freeHandles.empty()) {
+		cout << "No texture descriptors left for an atlas page" << endl;
+		return false;
+	}
+
+	Entry* page = new Entry();
+	page->handle = _freeHandles.back();
+	_freeHandles.pop_back();
+	page->references = (unsigned)pMembers.size();
+	page->descriptor = page->handle;
+	page->atlas = NULL;
+	getUvTransform(invalidHandle, page->uvTransform);
+
+	//committed resources start zeroed, so the padding is the transparent black of the sampler border, like around a texture of its own.
+	//a page isn't placed in the texture heap for that, _textureHeap.release just releases it
+	D3D12_RESOURCE_DESC desc = textureDesc(pSize, pSize, 1, pMipLevels, pMembers[0]->texture->GetDesc().Format);
+	ThrowIfFailed(_device->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+		D3D12_HEAP_FLAG_NONE,
+		&desc,
+		D3D12_RESOURCE_STATE_COPY_DEST,
+		nullptr,
+		IID_PPV_ARGS(&page->texture)));
+
+	vector<D3D12_RESOURCE_BARRIER> barriers;
+	for (size_t i = 0; i < pMembers.size(); ++i)
+		barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(pMembers[i]->texture, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_SOURCE));
+	_commandList->ResourceBarrier((UINT)barriers.size(), &barriers[0]);
+
+	for (size_t i = 0; i < pMembers.size(); ++i) {
+		Entry* member = pMembers[i];
+		const TexturePacker::Placement& placement = pPlacements[i];
+		for (UINT mip = 0; mip < pMipLevels; ++mip) {
+			CD3DX12_TEXTURE_COPY_LOCATION destination(page->texture, mip);
+			CD3DX12_TEXTURE_COPY_LOCATION source(member->texture, mip);
+			_commandList->CopyTextureRegion(&destination, placement.x >> mip, placement.y >> mip, 0, &source, NULL);
+		}
+
+		D3D12_RESOURCE_DESC memberDesc = member->texture->GetDesc();
+		member->uvTransform[0] = (float)memberDesc.Width / pSize;
+		member->uvTransform[1] = (float)memberDesc.Height / pSize;
+		member->uvTransform[2] = (float)placement.x / pSize;
+		member->uvTransform[3] = (float)placement.y / pSize;
+		member->atlas = page;
+
+		//frames in flight still sample the texture of its own, it goes once the copy is done like a streamed one
+		member->retiredTexture = member->texture;
+		member->texture = NULL;
+		member->gpuBytes = 0;
+		member->uploadFence = NULL;
+		member->uploadFenceValue = 0;
+		_pendingUploads.push_back(member);
+		_streamer.remove(member->handle);
+	}
+	_commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(page->texture, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
+
+	page->gpuBytes = (size_t)_device->GetResourceAllocationInfo(0, 1, &desc).SizeInBytes;
+	_writeView(page, desc);
+	_streamer.add(page->handle, desc.Format, pSize, pSize, pMipLevels, 1, false);
+	_byHandle[page->handle] = page;
+	return true;
+}
+
+void TextureRegistry::_destroy(Entry* pEntry)
+{
+	if (pEntry->uploadHeap) _uploadBufferHeap.release(pEntry->uploadHeap);
+	if (pEntry->retiredTexture) _textureHeap.release(pEntry->retiredTexture);
+	if (pEntry->texture) _textureHeap.release(pEntry->texture);
+	delete pEntry->source;
+	delete pEntry;
+}
+
+string TextureRegistry::pathKey(const wstring& pFileName)
+{
+	//utf-8 keeps every character, normalizePath only changes the ascii ones
+	int size = WideCharToMultiByte(CP_UTF8, 0, pFileName.c_str(), (int)pFileName.size(), NULL, 0, NULL, NULL);
+	string path(size, '\0');
+	if (size > 0)
+		WideCharToMultiByte(CP_UTF8, 0, pFileName.c_str(), (int)pFileName.size(), &path[0], size, NULL, NULL);
+	return MeshRegistry::normalizePath(path);
+}
@@ -0,0 +1,250 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "TextureMaterial.h"
+#include "TextureContainer.h"
+#include "TextureLayout.h"
+#include "MappedFile.h"
+#include "TextureStreamer.h"
+#include "TexturePacker.h"
+#include "ResourceHeap.h"
+
+/**
+ * Shares gpu textures between the materials that use them, like MeshRegistry does for meshes.
+ * A texture is looked up by its normalized path first, so a path that was loaded before is never decoded or uploaded
+ * again. A new path whose pixels turn out to be identical to a loaded texture (same size, format and content hash)
+ * gets the existing texture, and its own copy is never uploaded. Images are hashed as files, together with the settings
+ * they are loaded with (TextureMaterial::ReadTextureInfo), so their duplicates are found before they are decoded.
+ *
+ * Textures are referred to by handle. The registry owns one shader visible descriptor heap with a shader resource
+ * view per texture, the handle is the index of the view, so every material binds the same heap and only changes
+ * the descriptor table. Every acquire has to be matched by a release. When the last reference is released the
+ * texture is deleted and its view reused, so only release once the gpu is done with the texture.
+ *
+ * dds and ktx2 files keep the mips and array slices they were made with. Their payload is copied once, from the memory
+ * mapped file straight into the upload heap at the footprints of GetCopyableFootprints, without a copy in between.
+ * Arrays and cubemaps get a Texture2DArray view (isArray). Other images are decoded straight into the upload heap too, between
+ * beginUpload and endUpload (on a loader thread, see AssetLoader), a path or content that is loaded already isn't decoded.
+ *
+ * With streamTextures the mips of dds and ktx2 textures are streamed under a gpu memory budget: a TextureStreamer decides
+ * which mips are resident from the requests of the frame (requestMip), updateStreaming applies it. The file stays mapped
+ * and the texture is created again with the mips it gets, the levels it keeps are copied over on the gpu. The new texture
+ * gets its view in the other of the two descriptors of its handle, as frames in flight still use the old one, and the
+ * old texture is released with the upload heap. A texture doesn't change again until that is done.
+ *
+ * packAtlases packs the small textures that aren't streamed into atlas pages (TexturePacker), one set of pages per format
+ * and number of mips. A packed texture keeps its handle, but its descriptor is the one of its page and the shaders remap
+ * its uvs with getUvTransform, so the materials of a page bind the same descriptor table.
+ *
+ * Textures and upload heaps are placed in a ResourceHeap each instead of being committed resources, the textures that
+ * streaming keeps creating and releasing reuse the memory of the ones before them.
+ */
+class TextureRegistry
+{
+public:
+	typedef UINT Handle;
+	static const Handle invalidHandle = 0xffffffff;
+
+	struct Stats {
+		unsigned textures;		//unique textures currently loaded
+		unsigned references;	//handles currently handed out
+		unsigned loads;			//textures actually loaded from disk
+		unsigned pathHits;		//acquires served without loading
+		unsigned contentHits;	//loads that turned out to be a duplicate of a loaded texture
+		double loadSeconds;		//time spent loading
+		double savedSeconds;	//load time saved by path hits (based on how long the first load took)
+		size_t gpuBytes;		//gpu memory used by the loaded textures
+		size_t savedGpuBytes;	//gpu memory the extra references would have used without sharing
+		unsigned pendingUploads;	//textures that still hold their upload heap
+		unsigned atlases;		//atlas pages, not counted in textures
+		unsigned packed;		//textures that were packed into a page
+	};
+
+	struct AtlasSettings {
+		UINT pageSize;		//the largest page, smaller pages are used when the textures fit
+		UINT maxSize;		//only textures with no side larger than this are packed
+		UINT padding;		//texels between the textures, also limits the mips of a page (TexturePacker::atlasMipLevels)
+	};
+
+	//a texture whose subresources are written to its mapped upload heap, on any thread, see beginUpload
+	struct Upload {
+		uint8_t* data;	//the mapped upload heap
+		std::vector<TextureLayout::Footprint> footprints;	//where every subresource goes in data
+
+		//releases the resources of an upload that never got to endUpload
+		~Upload();
+
+	private:
+		friend class TextureRegistry;
+		Upload() : data(NULL), registry(NULL), texture(NULL), uploadHeap(NULL) {}
+
+		TextureRegistry* registry;	//whose heaps texture and uploadHeap are placed in
+		ID3D12Resource* texture;
+		ID3D12Resource* uploadHeap;
+		std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> layouts;
+		D3D12_RESOURCE_DESC desc;
+	};
+
+	//pMaxTextures is the number of textures that can be loaded at the same time, the descriptor heap has two views for each
+	TextureRegistry(ID3D12Device* pDevice, ID3D12GraphicsCommandList* pCommandList, UINT pMaxTextures = 256);
+	~TextureRegistry();
+
+	//get a shared texture, loading it if needed (dds and ktx2 files directly, other images with TextureMaterial::LoadTextureData).
+	//invalidHandle if it could not be loaded
+	Handle acquire(const std::wstring& pFileName);
+
+	//get a shared texture if its path was loaded before, without loading it. invalidHandle otherwise
+	Handle acquireLoaded(const std::wstring& pFileName);
+
+	//the same, and also share a texture that was loaded from another path with the same content hash under pFileName
+	Handle acquireShared(const std::wstring& pFileName, uint64_t pContentHash);
+
+	//create a texture with the size, format and mips of pTexture (pixels isn't used, see TextureMaterial::ReadTextureInfo)
+	//and a mapped upload heap for it. its subresources can then be written to the Upload on any thread
+	Upload* beginUpload(const TextureMaterial::TextureData& pTexture);
+
+	//record the copy of a written Upload and register the texture under pFileName, pUpload is deleted. if the path or
+	//content got loaded in the meantime the loaded texture is shared and the new one dropped
+	Handle endUpload(const std::wstring& pFileName, Upload* pUpload, uint64_t pContentHash, double pLoadSeconds);
+
+	//register a texture that was decoded elsewhere, for example on an AssetLoader thread, under pFileName. the gpu texture
+	//is created and its upload recorded on the command list, unless the path or content is loaded already, then the
+	//existing texture is shared. invalidHandle if all descriptors are in use
+	Handle adopt(const std::wstring& pFileName, const TextureMaterial::TextureData& pTexture, double pLoadSeconds);
+
+	//register a dds or ktx2 file that was opened with openContainer, the payload is read from pData (the mapped file)
+	//into the upload heap. pContentHash is contentHash of the file, 0 computes it here
+	Handle adoptContainer(const std::wstring& pFileName, const void* pData, const TextureContainer::Description& pDescription, uint64_t pContentHash, double pLoadSeconds);
+
+	//map pFileName and read its header if it is a dds or ktx2 file. false (with pFile closed) if it is any other file
+	//or a container that isn't supported
+	static bool openContainer(const std::wstring& pFileName, MappedFile& pFile, TextureContainer::Description& pDescription);
+
+	//the key a path is registered under, utf-8 normalized like MeshRegistry::normalizePath
+	static std::string pathKey(const std::wstring& pFileName);
+
+	//give back a handle gotten from acquire, acquireLoaded or adopt
+	void release(Handle pTexture);
+
+	//the heap every texture view is in, has to be set on the command list before binding a descriptor
+	ID3D12DescriptorHeap* getDescriptorHeap() const;
+	//the shader resource view of a texture in the heap
+	D3D12_GPU_DESCRIPTOR_HANDLE getDescriptor(Handle pTexture) const;
+	ID3D12Resource* getResource(Handle pTexture) const;
+	//true if the view of the texture is a Texture2DArray (arrays and cubemaps) instead of a Texture2D
+	bool isArray(Handle pTexture) const;
+
+	//the uploads of all textures created so far are done once pFence reaches pFenceValue
+	void setUploadFence(ID3D12Fence* pFence, UINT64 pFenceValue);
+
+	//release the upload heaps of the textures whose upload is done. cheap enough to call every frame,
+	//returns the number of upload heaps released this call
+	unsigned releaseUploadData();
+
+	Stats getStats() const;
+	//the heaps the textures and their upload heaps are placed in
+	ResourceHeap::Stats getTextureHeapStats() const;
+	ResourceHeap::Stats getUploadHeapStats() const;
+
+	//stream the mips of dds and ktx2 textures loaded from now on, other textures are always fully resident
+	static bool streamTextures;
+	void setStreamingSettings(const TextureStreamer::Settings& pSettings);
+	const TextureStreamer::Settings& getStreamingSettings() const;
+
+	//an object draws pTexture at pMip this frame, see GameObject::SelectTextureMip
+	void requestMip(Handle pTexture, float pMip);
+	//the largest side of the texture with all its mips, resident or not
+	UINT getSize(Handle pTexture) const;
+
+	//render thread: load and evict mips for the requests of this frame, the copies are recorded on the command list.
+	//returns the number of textures that changed
+	unsigned updateStreaming();
+	//residency and budget of the last updateStreaming
+	const TextureStreamer::Stats& getStreamingStats() const;
+
+	//render thread: pack the textures that are loaded, fully uploaded, not streamed and at most maxSize into atlas pages
+	//and record the copies on the command list. every page holds at least two textures, the mips beyond what the padding
+	//allows are dropped. returns the number of textures packed
+	unsigned packAtlases(const AtlasSettings& pSettings);
+	//scale (xy) and offset (zw) from the uvs of pTexture to the uvs of the texture it is sampled from, identity if it isn't packed
+	void getUvTransform(Handle pTexture, float pTransform[4]) const;
+	//the distinct descriptor tables drawing with pTextures needs
+	unsigned countBindings(const std::vector<Handle>& pTextures) const;
+
+	//identifies the pixels of a texture, its size and format are part of the hash
+	static uint64_t contentHash(const TextureMaterial::TextureData& pTexture);
+	static uint64_t contentHash(const void* pData, const TextureContainer::Description& pDescription);
+
+private:
+	struct Entry {
+		ID3D12Resource* texture;
+		ID3D12Resource* uploadHeap;		//until the upload is done
+		ID3D12Fence* uploadFence;
+		UINT64 uploadFenceValue;
+		Handle handle;
+		unsigned references;
+		double loadSeconds;
+		uint64_t contentHash;
+		size_t gpuBytes;
+		std::vector<std::string> paths;	//all normalized paths that resolve to this texture
+		UINT descriptor;				//the view in the heap, the handle or the handle + maxTextures
+		bool array;						//the view is a Texture2DArray
+		ID3D12Resource* retiredTexture;	//replaced by a streaming change, released with the upload heap
+		MappedFile* source;				//streamed textures keep their file mapped to load mips from
+		TextureContainer::Description sourceDescription;
+		UINT residentMip;
+		Entry* atlas;					//the page the texture was packed into, its own texture is released then
+		float uvTransform[4];			//into the page
+	};
+
+	//count a load of pPath and share the texture that has its path or content, invalidHandle if there is none
+	Handle _share(const std::string& pPath, uint64_t pContentHash, double pLoadSeconds);
+
+	//create the texture and an upload heap big enough for all its subresources, map it and get where every subresource goes.
+	//without pCreateTexture only the upload heap is created
+	Upload* _beginUpload(const D3D12_RESOURCE_DESC& pDesc, bool pCreateTexture = true);
+	//unmap the upload heap, record the copies into the texture, write its view and register it on a free handle.
+	//pUpload is deleted, invalidHandle if all descriptors are in use
+	Handle _finishUpload(const std::string& pPath, Upload* pUpload, uint64_t pContentHash, double pLoadSeconds);
+
+	//write the view of the texture of pEntry to its descriptor
+	void _writeView(Entry* pEntry, const D3D12_RESOURCE_DESC& pDesc);
+
+	//create the texture of a streamed entry again with the mips from pMip, and record the copies of the levels it keeps
+	//and of the ones loaded from its file
+	bool _setResidentMip(Entry* pEntry, UINT pMip);
+
+	//create an atlas page of pSize with pMipLevels levels, copy the textures of pMembers to their pPlacements on it and
+	//point them to it. false if all descriptors are in use
+	bool _createAtlasPage(const std::vector<Entry*>& pMembers, const std::vector<TexturePacker::Placement>& pPlacements, UINT pSize, UINT pMipLevels);
+
+	//release the resources of an entry and delete it
+	void _destroy(Entry* pEntry);
+
+	ID3D12Device* _device;
+	ID3D12GraphicsCommandList* _commandList;
+
+	ResourceHeap _textureHeap;
+	ResourceHeap _uploadBufferHeap;	//for the upload heaps
+
+	ID3D12DescriptorHeap* _descriptorHeap;
+	UINT _descriptorSize;
+	UINT _maxTextures;
+
+	TextureStreamer _streamer;
+
+	std::unordered_map<std::string, Entry*> _byPath;
+	std::unordered_map<uint64_t, Entry*> _byContent;
+	std::vector<Entry*> _byHandle;		//NULL for unused handles
+	std::vector<Handle> _freeHandles;
+
+	std::vector<Entry*> _pendingUploads;
+
+	unsigned _loads;
+	unsigned _pathHits;
+	unsigned _contentHits;
+	double _loadSeconds;
+	double _savedSeconds;
+};
@@ -0,0 +1,256 @@
+#include "TextureStreamer.h"
+#include "TextureLayout.h"
+#include <cmath>
+
+using namespace std;
+
+namespace {
+	const TextureStreamer::Id noTexture = 0xffffffff;
+
+	uint32_t levelSize(uint32_t pSize, uint32_t pMip) {
+		return ((pSize >> pMip) > 0) ? pSize >> pMip : 1;
+	}
+}
+
+TextureStreamer::TextureStreamer(const Settings& pSettings) : _settings(pSettings), _frame(1), _residentBytes(0), _stats()
+{
+}
+
+void TextureStreamer::setSettings(const Settings& pSettings)
+{
+	//pinned mips are decided when a texture is added, a new pinnedSize only counts for the textures added after it
+	_settings = pSettings;
+}
+
+const TextureStreamer::Settings& TextureStreamer::getSettings() const
+{
+	return _settings;
+}
+
+uint32_t TextureStreamer::add(Id pTexture, uint32_t pFormat, uint32_t pWidth, uint32_t pHeight, uint32_t pMipLevels, uint32_t pArraySize, bool pStreamed)
+{
+	remove(pTexture);
+	if (pTexture >= _textures.size())
+		_textures.resize(pTexture + 1);
+
+	Texture& texture = _textures[pTexture];
+	texture.used = true;
+	texture.streamed = pStreamed && pMipLevels > 1;
+	texture.locked = false;
+	texture.width = pWidth;
+	texture.height = pHeight;
+	texture.pinnedMip = texture.streamed ? pinnedMip(pFormat, pWidth, pHeight, pMipLevels, _settings.pinnedSize) : 0;
+	texture.residentMip = texture.pinnedMip;
+	texture.requestedMip = texture.pinnedMip;
+	texture.levelBytes.resize(pMipLevels);
+	texture.lastUsed.assign(pMipLevels, 0);
+	for (uint32_t mip = 0; mip < pMipLevels; ++mip) {
+		uint32_t rowBytes, rows;
+		TextureLayout::surfaceSize(pFormat, levelSize(pWidth, mip), levelSize(pHeight, mip), rowBytes, rows);
+		texture.levelBytes[mip] = (uint64_t)rowBytes * rows * pArraySize;
+		if (mip >= texture.residentMip)
+			_residentBytes += texture.levelBytes[mip];
+	}
+	return texture.residentMip;
+}
+
+void TextureStreamer::remove(Id pTexture)
+{
+	if (pTexture >= _textures.size() || !_textures[pTexture].used)
+		return;
+	Texture& texture = _textures[pTexture];
+	for (size_t mip = texture.residentMip; mip < texture.levelBytes.size(); ++mip)
+		_residentBytes -= texture.levelBytes[mip];
+	texture = Texture();
+}
+
+uint32_t TextureStreamer::getResidentMip(Id pTexture) const
+{
+	return (pTexture < _textures.size() && _textures[pTexture].used) ? _textures[pTexture].residentMip : 0;
+}
+
+uint32_t TextureStreamer::getSize(Id pTexture) const
+{
+	if (pTexture >= _textures.size() || !_textures[pTexture].used)
+		return 0;
+	const Texture& texture = _textures[pTexture];
+	return (texture.width > texture.height) ? texture.width : texture.height;
+}
+
+void TextureStreamer::request(Id pTexture, float pMip)
+{
+	if (pTexture >= _textures.size() || !_textures[pTexture].streamed)
+		return;
+	//the more detailed mip of the two levels pMip is between, so the texture is never blurrier than asked for
+	Texture& texture = _textures[pTexture];
+	uint32_t mip = (pMip > 0.0f) ? (uint32_t)pMip : 0;
+	if (mip < texture.requestedMip)
+		texture.requestedMip = mip;
+}
+
+void TextureStreamer::setLocked(Id pTexture, bool pLocked)
+{
+	if (pTexture < _textures.size())
+		_textures[pTexture].locked = pLocked;
+}
+
+vector<TextureStreamer::Change> TextureStreamer::update()
+{
+	_stats.loads = 0;
+	_stats.evictions = 0;
+	_stats.starved = 0;
+	_stats.pending = 0;
+
+	vector<uint32_t> previousMips(_textures.size());
+	for (size_t i = 0; i < _textures.size(); ++i) {
+		Texture& texture = _textures[i];
+		previousMips[i] = texture.residentMip;
+		//the requested levels are the recently used ones, whether they are resident or not
+		for (uint32_t mip = texture.requestedMip; mip < texture.pinnedMip; ++mip)
+			texture.lastUsed[mip] = _frame;
+	}
+
+	//the budget shrank
+	while (_residentBytes > _settings.budgetBytes && _evict(noTexture, true)) {}
+
+	vector<bool> starved(_textures.size(), false);
+	while (_settings.maxLoadsPerFrame == 0 || _stats.loads < _settings.maxLoadsPerFrame) {
+		//the texture that is furthest from its request, the one with the smaller next level if that is a tie
+		Id load = noTexture;
+		for (size_t i = 0; i < _textures.size(); ++i) {
+			const Texture& texture = _textures[i];
+			if (!texture.streamed || texture.locked || starved[i] || texture.requestedMip >= texture.residentMip)
+				continue;
+			if (load == noTexture)
+				load = (Id)i;
+			else {
+				const Texture& best = _textures[load];
+				uint32_t deficit = texture.residentMip - texture.requestedMip;
+				uint32_t bestDeficit = best.residentMip - best.requestedMip;
+				if (deficit > bestDeficit || (deficit == bestDeficit && texture.levelBytes[texture.residentMip - 1] < best.levelBytes[best.residentMip - 1]))
+					load = (Id)i;
+			}
+		}
+		if (load == noTexture)
+			break;
+
+		Texture& texture = _textures[load];
+		uint64_t bytes = texture.levelBytes[texture.residentMip - 1];
+		bool fits = true;
+		while (fits && _residentBytes + bytes > _settings.budgetBytes)
+			fits = _evict(load, false);
+		if (!fits) {
+			starved[load] = true;
+			_stats.starved++;
+			continue;
+		}
+		texture.residentMip--;
+		_residentBytes += bytes;
+		_stats.loads++;
+	}
+
+	vector<Change> changes;
+	_stats.textures = 0;
+	_stats.streamed = 0;
+	_stats.requestedBytes = 0;
+	for (size_t i = 0; i < _textures.size(); ++i) {
+		Texture& texture = _textures[i];
+		if (!texture.used)
+			continue;
+		_stats.textures++;
+		if (texture.streamed)
+			_stats.streamed++;
+		for (size_t mip = texture.requestedMip; mip < texture.levelBytes.size(); ++mip)
+			_stats.requestedBytes += texture.levelBytes[mip];
+		if (texture.requestedMip < texture.residentMip && !starved[i])
+			_stats.pending++;
+		if (texture.residentMip != previousMips[i]) {
+			Change change = { (Id)i, texture.residentMip, previousMips[i] };
+			changes.push_back(change);
+		}
+		texture.requestedMip = texture.pinnedMip;
+	}
+	_stats.residentBytes = _residentBytes;
+	_stats.budgetBytes = _settings.budgetBytes;
+	_frame++;
+	return changes;
+}
+
+const TextureStreamer::Stats& TextureStreamer::getStats() const
+{
+	return _stats;
+}
+
+bool TextureStreamer::_evict(Id pExcept, bool pAllowRequested)
+{
+	//only the top level of a texture can go, the resident levels stay one chain
+	Id evict = noTexture;
+	for (size_t i = 0; i < _textures.size(); ++i) {
+		const Texture& texture = _textures[i];
+		if (!texture.streamed || texture.locked || (Id)i == pExcept || texture.residentMip >= texture.pinnedMip)
+			continue;
+		uint32_t lastUsed = texture.lastUsed[texture.residentMip];
+		if (!pAllowRequested && lastUsed == _frame)
+			continue;
+		if (evict == noTexture)
+			evict = (Id)i;
+		else {
+			//the least recently used, the bigger level if that is a tie
+			const Texture& best = _textures[evict];
+			uint32_t bestUsed = best.lastUsed[best.residentMip];
+			if (lastUsed < bestUsed || (lastUsed == bestUsed && texture.levelBytes[texture.residentMip] > best.levelBytes[best.residentMip]))
+				evict = (Id)i;
+		}
+	}
+	if (evict == noTexture)
+		return false;
+
+	Texture& texture = _textures[evict];
+	_residentBytes -= texture.levelBytes[texture.residentMip];
+	texture.residentMip++;
+	_stats.evictions++;
+	return true;
+}
+
+float TextureStreamer::desiredMip(float pTexelsPerUnit, float pPixelsPerUnit)
+{
+	//every mip halves the texels per pixel, until one texel covers a pixel
+	if (pPixelsPerUnit <= 0.0f)
+		return 32.0f;
+	float texelsPerPixel = pTexelsPerUnit / pPixelsPerUnit;
+	return (texelsPerPixel > 1.0f) ? log2(texelsPerPixel) : 0.0f;
+}
+
+float TextureStreamer::uvDensity(const void* pVertices, size_t pStride, size_t pUvOffset, const uint32_t* pIndices, size_t pIndexCount)
+{
+	const unsigned char* vertices = (const unsigned char*)pVertices;
+	double surfaceArea = 0.0;
+	double uvArea = 0.0;
+	for (size_t i = 0; i + 2 < pIndexCount; i += 3) {
+		const float* p[3];
+		const float* uv[3];
+		for (int corner = 0; corner < 3; ++corner) {
+			p[corner] = (const float*)(vertices + pStride * pIndices[i + corner]);
+			uv[corner] = (const float*)(vertices + pStride * pIndices[i + corner] + pUvOffset);
+		}
+		//twice the area of the triangle, the halves cancel out
+		double e1[3] = { p[1][0] - p[0][0], p[1][1] - p[0][1], p[1][2] - p[0][2] };
+		double e2[3] = { p[2][0] - p[0][0], p[2][1] - p[0][1], p[2][2] - p[0][2] };
+		double cross[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+		surfaceArea += sqrt(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]);
+		uvArea += fabs((uv[1][0] - uv[0][0]) * (double)(uv[2][1] - uv[0][1]) - (uv[2][0] - uv[0][0]) * (double)(uv[1][1] - uv[0][1]));
+	}
+	return (surfaceArea > 0.0) ? (float)sqrt(uvArea / surfaceArea) : 0.0f;
+}
+
+uint32_t TextureStreamer::pinnedMip(uint32_t pFormat, uint32_t pWidth, uint32_t pHeight, uint32_t pMipLevels, uint32_t pPinnedSize)
+{
+	uint32_t mip = 0;
+	while (mip + 1 < pMipLevels && (levelSize(pWidth, mip) > pPinnedSize || levelSize(pHeight, mip) > pPinnedSize))
+		mip++;
+	if (TextureLayout::isBlockCompressed(pFormat)) {
+		while (mip > 0 && (levelSize(pWidth, mip) % 4 != 0 || levelSize(pHeight, mip) % 4 != 0))
+			mip--;
+	}
+	return mip;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * Decides which mips of every texture are resident on the gpu, under a memory budget. It only keeps the books and never
+ * touches the device, so the policy runs headless against a simulated budget. TextureRegistry applies what it decides.
+ *
+ * A texture is resident from a most detailed mip down to its smallest level. The mips of at most Settings::pinnedSize
+ * pixels are always resident, the ones above them are requested every frame with the mip the objects using the texture
+ * need on screen (desiredMip, from the texel density of the mesh and its distance). update loads the requested mips one
+ * level at a time, the texture that is furthest from its request first, so a budget that can't hold everything is shared
+ * out evenly. When a load doesn't fit the least recently used mips that weren't requested this frame are evicted, always
+ * the top level of their texture. If the budget shrinks below what is resident, even requested mips are evicted.
+ * Textures that aren't streamed (no source to load mips from later) are always fully resident but count to the budget.
+ */
+class TextureStreamer
+{
+public:
+	typedef uint32_t Id;
+
+	struct Settings {
+		uint64_t budgetBytes;		//memory the resident mips may use
+		uint32_t pinnedSize;		//mips of at most this many pixels wide and high are always resident
+		uint32_t maxLoadsPerFrame;	//mips update loads at most, 0 is unlimited
+	};
+
+	//a texture whose resident mips changed in update
+	struct Change {
+		Id texture;
+		uint32_t residentMip;	//the most detailed mip that is resident now
+		uint32_t previousMip;	//and before the update
+	};
+
+	//of the last update
+	struct Stats {
+		unsigned textures;
+		unsigned streamed;			//textures that can load and evict mips
+		uint64_t residentBytes;
+		uint64_t budgetBytes;
+		uint64_t requestedBytes;	//what the mips requested this frame (and the pinned ones) need
+		unsigned loads;				//mips loaded
+		unsigned evictions;			//mips evicted
+		unsigned starved;			//textures that didn't get their requested mip because of the budget
+		unsigned pending;			//textures still short of their request because of maxLoadsPerFrame or a lock
+	};
+
+	TextureStreamer(const Settings& pSettings);
+
+	void setSettings(const Settings& pSettings);
+	const Settings& getSettings() const;
+
+	//start keeping the books of a texture with pMipLevels levels of pArraySize slices (DXGI_FORMAT pFormat), an id that is
+	//in use already is replaced. returns the mip it is resident from, what the texture has to be created with
+	uint32_t add(Id pTexture, uint32_t pFormat, uint32_t pWidth, uint32_t pHeight, uint32_t pMipLevels, uint32_t pArraySize, bool pStreamed);
+	void remove(Id pTexture);
+
+	//the most detailed mip that is resident
+	uint32_t getResidentMip(Id pTexture) const;
+	//the largest side of the top level
+	uint32_t getSize(Id pTexture) const;
+
+	//an object wants the texture at pMip (see desiredMip) this frame. the most detailed request of the frame counts
+	void request(Id pTexture, float pMip);
+
+	//a locked texture isn't changed by update, for example while its last change is still being copied
+	void setLocked(Id pTexture, bool pLocked);
+
+	//decide the residency for the requests of this frame and start the next frame. returns the textures that changed
+	std::vector<Change> update();
+
+	const Stats& getStats() const;
+
+	//the mip that gives a texel per pixel: pTexelsPerUnit texels cover a world unit, which covers pPixelsPerUnit pixels
+	static float desiredMip(float pTexelsPerUnit, float pPixelsPerUnit);
+
+	//uv units per mesh unit of a triangle list: the square root of its uv area over its surface area. pVertices are
+	//pStride bytes apart with the float3 position first and the float2 uv pUvOffset bytes in. 0 without any area
+	static float uvDensity(const void* pVertices, size_t pStride, size_t pUvOffset, const uint32_t* pIndices, size_t pIndexCount);
+
+	//the first mip of at most pPinnedSize pixels. block compressed textures stop at the last level that is whole
+	//blocks, as the top level of a texture has to be
+	static uint32_t pinnedMip(uint32_t pFormat, uint32_t pWidth, uint32_t pHeight, uint32_t pMipLevels, uint32_t pPinnedSize);
+
+private:
+	struct Texture {
+		bool used;
+		bool streamed;
+		bool locked;
+		uint32_t width;
+		uint32_t height;
+		uint32_t pinnedMip;
+		uint32_t residentMip;
+		uint32_t requestedMip;			//pinnedMip if nothing asked for more this frame
+		std::vector<uint64_t> levelBytes;	//of every level, all slices
+		std::vector<uint32_t> lastUsed;		//frame every level was last requested in
+	};
+
+	//evict the top level of the least recently used texture that isn't pExcept, with pAllowRequested also the ones
+	//requested this frame. false if there is nothing to evict
+	bool _evict(Id pExcept, bool pAllowRequested);
+
+	Settings _settings;
+	std::vector<Texture> _textures;		//indexed by id
+	uint32_t _frame;
+	uint64_t _residentBytes;
+	Stats _stats;
+};
@@ -0,0 +1,82 @@
+#include "TripletHashMap.h"
+#include <cstdint>
+
+TripletHashMap::TripletHashMap(size_t pExpectedCount) : _mask(0), _count(0)
+{
+	//keep the load factor at or below 0.5 so probe sequences stay short
+	size_t capacity = 16;
+	while (capacity < pExpectedCount * 2)
+		capacity <<= 1;
+
+	Slot empty = { 0, 0, 0, 0 };
+	_slots.assign(capacity, empty);
+	_mask = capacity - 1;
+}
+
+size_t TripletHashMap::_hash(unsigned pV, unsigned pUV, unsigned pN)
+{
+	//combine the three indices into one 64 bit key and mix it (murmur3 finalizer)
+	uint64_t key = (uint64_t)pV * 0x9e3779b97f4a7c15ull ^ (uint64_t)pUV * 0xc2b2ae3d27d4eb4full ^ (uint64_t)pN * 0x165667b19e3779f9ull;
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdull;
+	key ^= key >> 33;
+	key *= 0xc4ceb9fe1a85ec53ull;
+	key ^= key >> 33;
+	return (size_t)key;
+}
+
+unsigned TripletHashMap::findOrInsert(unsigned pV, unsigned pUV, unsigned pN, unsigned pNewIndex, bool& pInserted)
+{
+	if ((_count + 1) * 2 > _slots.size())
+		_grow();
+
+	size_t i = _hash(pV, pUV, pN) & _mask;
+	while (true) {
+		Slot& slot = _slots[i];
+		if (slot.v == 0) {
+			slot.v = pV;
+			slot.uv = pUV;
+			slot.n = pN;
+			slot.index = pNewIndex;
+			++_count;
+			pInserted = true;
+			return pNewIndex;
+		}
+		if (slot.v == pV && slot.uv == pUV && slot.n == pN) {
+			pInserted = false;
+			return slot.index;
+		}
+		i = (i + 1) & _mask;
+	}
+}
+
+size_t TripletHashMap::size() const
+{
+	return _count;
+}
+
+void TripletHashMap::clear()
+{
+	Slot empty = { 0, 0, 0, 0 };
+	_slots.assign(_slots.size(), empty);
+	_count = 0;
+}
+
+void TripletHashMap::_grow()
+{
+	std::vector<Slot> old;
+	old.swap(_slots);
+
+	Slot empty = { 0, 0, 0, 0 };
+	_slots.assign(old.size() * 2, empty);
+	_mask = _slots.size() - 1;
+
+	for (size_t j = 0; j < old.size(); ++j) {
+		if (old[j].v == 0)
+			continue;
+		size_t i = _hash(old[j].v, old[j].uv, old[j].n) & _mask;
+		while (_slots[i].v != 0)
+			i = (i + 1) & _mask;
+		_slots[i] = old[j];
+	}
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+/**
+ * Please read the Mesh::load documentation on the .obj file format first.
+ * If we list all the unique v/vt/vn triplets under the faces section in an object file
+ * sequentially and assign them a number, this map stores that number for each triplet.
+ * Each triplet refers to an index in the originally loaded vertex, uv and normal lists
+ * and is only used while converting the faces to a single index buffer.
+ *
+ * It is an open addressing (linear probing) table stored in one flat array, so a lookup is
+ * a hash and usually a single cache line instead of a std::map node walk and allocation.
+ * Obj indices are 1 based, so a slot with v == 0 is empty.
+ */
+class TripletHashMap
+{
+public:
+	//pExpectedCount is the number of unique triplets we expect, the table grows if there are more
+	explicit TripletHashMap(size_t pExpectedCount = 0);
+
+	//returns the index stored for the triplet. if the triplet is new, pNewIndex is stored for it and pInserted is set to true
+	unsigned findOrInsert(unsigned pV, unsigned pUV, unsigned pN, unsigned pNewIndex, bool& pInserted);
+
+	//number of unique triplets in the map
+	size_t size() const;
+
+	void clear();
+
+private:
+	struct Slot {
+		unsigned v;
+		unsigned uv;
+		unsigned n;
+		unsigned index;
+	};
+
+	static size_t _hash(unsigned pV, unsigned pUV, unsigned pN);
+	void _grow();
+
+	std::vector<Slot> _slots;
+	size_t _mask;
+	size_t _count;
+};
@@ -0,0 +1,107 @@
+#include "UploadRing.h"
+#include <cstring>
+
+using namespace std;
+
+UploadRing::UploadRing(ID3D12Device* pDevice, uint64_t pCapacity)
+	: _device(pDevice), _ring(pCapacity), _buffer(NULL), _data(NULL), _gpuAddress(0)
+{
+	_createBuffer(pCapacity);
+}
+
+UploadRing::~UploadRing()
+{
+	for (size_t i = 0; i < _retired.size(); ++i) {
+		_retired[i].buffer->Unmap(0, NULL);
+		_retired[i].buffer->Release();
+	}
+	if (_buffer) {
+		_buffer->Unmap(0, NULL);
+		_buffer->Release();
+	}
+}
+
+UploadRing::Allocation UploadRing::allocate(uint64_t pSize, uint64_t pAlignment)
+{
+	uint64_t offset = _ring.allocate(pSize, pAlignment);
+	if (offset == RingAllocator::invalidOffset) {
+		//the frames in flight keep the old buffer, the ring starts over in one twice as big
+		uint64_t capacity = _ring.getCapacity() * 2;
+		while (capacity < pSize + pAlignment)
+			capacity *= 2;
+		Retired retired = { _buffer, NULL, 0 };
+		_retired.push_back(retired);
+		_frameFences.clear();
+		_ring.grow(capacity);
+		_createBuffer(capacity);
+		offset = _ring.allocate(pSize, pAlignment);
+	}
+
+	Allocation allocation = { _data + offset, _gpuAddress + offset };
+	return allocation;
+}
+
+D3D12_GPU_VIRTUAL_ADDRESS UploadRing::write(const void* pData, uint64_t pSize, uint64_t pAlignment)
+{
+	Allocation allocation = allocate(pSize, pAlignment);
+	memcpy(allocation.data, pData, (size_t)pSize);
+	return allocation.gpuAddress;
+}
+
+void UploadRing::finishFrame(ID3D12Fence* pFence, UINT64 pFenceValue)
+{
+	_ring.finishFrame(pFenceValue);
+	_frameFences.push_back(pFence);
+	for (size_t i = 0; i < _retired.size(); ++i) {
+		if (_retired[i].fence == NULL) {
+			_retired[i].fence = pFence;
+			_retired[i].fenceValue = pFenceValue;
+		}
+	}
+}
+
+void UploadRing::reclaim()
+{
+	//the frames finish in order, every frame can have its own fence
+	while (!_frameFences.empty() && _frameFences.front()->GetCompletedValue() >= _ring.getOldestFrameFence()) {
+		_ring.releaseOldestFrame();
+		_frameFences.pop_front();
+	}
+
+	for (size_t i = 0; i < _retired.size();) {
+		Retired& retired = _retired[i];
+		if (retired.fence != NULL && retired.fence->GetCompletedValue() >= retired.fenceValue) {
+			retired.buffer->Unmap(0, NULL);
+			retired.buffer->Release();
+			_retired[i] = _retired.back();
+			_retired.pop_back();
+		}
+		else {
+			++i;
+		}
+	}
+}
+
+RingAllocator::Stats UploadRing::getStats() const
+{
+	return _ring.getStats();
+}
+
+void UploadRing::_createBuffer(uint64_t pCapacity)
+{
+	ThrowIfFailed(_device->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(pCapacity),
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(&_buffer)));
+	_buffer->SetName(L"Upload Ring");
+
+	//written every frame and never read back, it stays mapped
+	void* mapped = NULL;
+	CD3DX12_RANGE readRange(0, 0);
+	ThrowIfFailed(_buffer->Map(0, &readRange, &mapped));
+	_data = (uint8_t*)mapped;
+	_gpuAddress = _buffer->GetGPUVirtualAddress();
+}
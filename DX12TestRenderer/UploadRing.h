@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <cstdint>
+#include <windows.h>
+#include "d3dx12.h"
+#include <d3d12.h>
+#include "Debug.h"
+#include "RingAllocator.h"
+
+/**
+ * A persistently mapped upload buffer for data the cpu writes every frame and the gpu reads once, like the constants
+ * of the objects, suballocated with a RingAllocator. An allocation is a cpu pointer to write to and the gpu address
+ * it is read from, valid for the frame it was allocated in.
+ * finishFrame tags the frame with the fence the queue signals after it, reclaim frees the frames that are done.
+ * When a frame needs more than is free, the ring grows to a new buffer twice as big. The old buffer is released once
+ * the frames in it are done, so the number of objects is only limited by memory.
+ * Render thread only.
+ */
+class UploadRing
+{
+public:
+	struct Allocation {
+		void* data;
+		D3D12_GPU_VIRTUAL_ADDRESS gpuAddress;
+	};
+
+	//pCapacity is a multiple of 64 KB
+	UploadRing(ID3D12Device* pDevice, uint64_t pCapacity);
+	//the gpu has to be done with every frame
+	~UploadRing();
+
+	//pSize bytes at a multiple of pAlignment, constant buffer views need 256
+	Allocation allocate(uint64_t pSize, uint64_t pAlignment = D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT);
+	//allocate and copy pData to it
+	D3D12_GPU_VIRTUAL_ADDRESS write(const void* pData, uint64_t pSize, uint64_t pAlignment = D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT);
+
+	//the gpu is done with the allocations since the last finishFrame once pFence reaches pFenceValue
+	void finishFrame(ID3D12Fence* pFence, UINT64 pFenceValue);
+	//free the frames that are done, and the buffers the ring grew out of
+	void reclaim();
+
+	RingAllocator::Stats getStats() const;
+
+private:
+	struct Retired {
+		ID3D12Resource* buffer;
+		ID3D12Fence* fence;		//NULL until the frame that was current when it was retired is finished
+		UINT64 fenceValue;
+	};
+
+	void _createBuffer(uint64_t pCapacity);
+
+	ID3D12Device* _device;
+	RingAllocator _ring;
+	ID3D12Resource* _buffer;
+	uint8_t* _data;
+	D3D12_GPU_VIRTUAL_ADDRESS _gpuAddress;
+
+	std::deque<ID3D12Fence*> _frameFences;	//of the frames in flight in _ring, oldest first
+	std::vector<Retired> _retired;
+};
@@ -0,0 +1,362 @@
+#include "VertexQuantizer.h"
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VERTEX_QUANTIZER_SSE2
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+namespace {
+	const float radiansToDegrees = 57.2957795f;
+
+	//same semantics as _mm_min_ps/_mm_max_ps, so nan ends up as 1 on both paths
+	inline float clampUnit(float pValue) {
+		pValue = (pValue < 1.0f) ? pValue : 1.0f;
+		return (pValue > -1.0f) ? pValue : -1.0f;
+	}
+
+	//project the direction on the octahedron |x|+|y|+|z| = 1 and fold the lower half over the upper half
+	inline void octEncode(const float* pDirection, float& pX, float& pY) {
+		float length = (fabsf(pDirection[0]) + fabsf(pDirection[1])) + fabsf(pDirection[2]);
+		float inverse = (length > 0.0f) ? 1.0f / length : 0.0f;
+		float x = pDirection[0] * inverse;
+		float y = pDirection[1] * inverse;
+		if (pDirection[2] < 0.0f) {
+			float foldedX = copysignf(1.0f - fabsf(y), x);
+			float foldedY = copysignf(1.0f - fabsf(x), y);
+			x = foldedX;
+			y = foldedY;
+		}
+		pX = clampUnit(x);
+		pY = clampUnit(y);
+	}
+
+	inline void octDecode(float pX, float pY, float* pDirection) {
+		float z = 1.0f - fabsf(pX) - fabsf(pY);
+		if (z < 0.0f) {
+			float unfoldedX = copysignf(1.0f - fabsf(pY), pX);
+			float unfoldedY = copysignf(1.0f - fabsf(pX), pY);
+			pX = unfoldedX;
+			pY = unfoldedY;
+		}
+		float length = sqrtf(pX * pX + pY * pY + z * z);
+		pDirection[0] = pX / length;
+		pDirection[1] = pY / length;
+		pDirection[2] = z / length;
+	}
+
+	inline float handedness(const float* pNormal, const float* pTangent, const float* pBitangent) {
+		float crossX = pNormal[1] * pTangent[2] - pNormal[2] * pTangent[1];
+		float crossY = pNormal[2] * pTangent[0] - pNormal[0] * pTangent[2];
+		float crossZ = pNormal[0] * pTangent[1] - pNormal[1] * pTangent[0];
+		float dot = crossX * pBitangent[0] + crossY * pBitangent[1] + crossZ * pBitangent[2];
+		return (dot < 0.0f) ? -1.0f : 1.0f;
+	}
+
+	inline float snormToFloat(int pValue, float pScale) {
+		return max((float)pValue / pScale, -1.0f);
+	}
+
+	//angle between two directions in degrees, returns false if the original is not a usable direction
+	inline bool angleDegrees(const float* pOriginal, const float* pDecoded, float& pDegrees) {
+		float length = sqrtf(pOriginal[0] * pOriginal[0] + pOriginal[1] * pOriginal[1] + pOriginal[2] * pOriginal[2]);
+		if (!(length > 0.0f) || !std::isfinite(length))
+			return false;
+		float dot = (pOriginal[0] * pDecoded[0] + pOriginal[1] * pDecoded[1] + pOriginal[2] * pDecoded[2]) / length;
+		pDegrees = acosf(min(max(dot, -1.0f), 1.0f)) * radiansToDegrees;
+		return true;
+	}
+
+	inline void encodeVertex(const VertexQuantizer::FloatVertex& pVertex, VertexQuantizer::PackedVertex& pPacked) {
+		memcpy(pPacked.pos, pVertex.pos, sizeof(pPacked.pos));
+		pPacked.uv[0] = VertexQuantizer::floatToHalf(pVertex.uv[0]);
+		pPacked.uv[1] = VertexQuantizer::floatToHalf(pVertex.uv[1]);
+
+		float x, y;
+		octEncode(pVertex.normal, x, y);
+		pPacked.normal[0] = (int16_t)lrintf(x * 32767.0f);
+		pPacked.normal[1] = (int16_t)lrintf(y * 32767.0f);
+
+		octEncode(pVertex.tangent, x, y);
+		pPacked.tangent[0] = (int8_t)lrintf(x * 127.0f);
+		pPacked.tangent[1] = (int8_t)lrintf(y * 127.0f);
+		pPacked.tangent[2] = 0;
+		pPacked.tangent[3] = (int8_t)(handedness(pVertex.normal, pVertex.tangent, pVertex.bitangent) * 127.0f);
+	}
+
+#ifdef VERTEX_QUANTIZER_SSE2
+	inline __m128 absPs(__m128 pValue) {
+		return _mm_andnot_ps(_mm_set1_ps(-0.0f), pValue);
+	}
+
+	inline __m128 copySignPs(__m128 pMagnitude, __m128 pSign) {
+		__m128 signBit = _mm_set1_ps(-0.0f);
+		return _mm_or_ps(_mm_andnot_ps(signBit, pMagnitude), _mm_and_ps(signBit, pSign));
+	}
+
+	inline __m128 selectPs(__m128 pMask, __m128 pIfTrue, __m128 pIfFalse) {
+		return _mm_or_ps(_mm_and_ps(pMask, pIfTrue), _mm_andnot_ps(pMask, pIfFalse));
+	}
+
+	//octEncode for 4 directions given as x, y and z lanes
+	inline void octEncode4(__m128 pX, __m128 pY, __m128 pZ, __m128& pOutX, __m128& pOutY) {
+		__m128 zero = _mm_setzero_ps();
+		__m128 one = _mm_set1_ps(1.0f);
+		__m128 length = _mm_add_ps(_mm_add_ps(absPs(pX), absPs(pY)), absPs(pZ));
+		__m128 inverse = _mm_and_ps(_mm_div_ps(one, length), _mm_cmpgt_ps(length, zero));
+		__m128 x = _mm_mul_ps(pX, inverse);
+		__m128 y = _mm_mul_ps(pY, inverse);
+
+		__m128 foldedX = copySignPs(_mm_sub_ps(one, absPs(y)), x);
+		__m128 foldedY = copySignPs(_mm_sub_ps(one, absPs(x)), y);
+		__m128 lower = _mm_cmplt_ps(pZ, zero);
+		x = selectPs(lower, foldedX, x);
+		y = selectPs(lower, foldedY, y);
+
+		__m128 minusOne = _mm_set1_ps(-1.0f);
+		pOutX = _mm_max_ps(_mm_min_ps(x, one), minusOne);
+		pOutY = _mm_max_ps(_mm_min_ps(y, one), minusOne);
+	}
+
+	//float to half with round to nearest even, 4 at a time. the result is in the low 16 bits of every lane
+	inline __m128i floatToHalf4(__m128 pValue) {
+		__m128 signMask = _mm_set1_ps(-0.0f);
+		__m128 sign = _mm_and_ps(signMask, pValue);
+		__m128 absolute = _mm_xor_ps(pValue, sign);
+		__m128i absoluteBits = _mm_castps_si128(absolute);
+
+		//everything from 65520 up rounds to infinity, nan keeps a mantissa bit
+		__m128i isRegular = _mm_cmpgt_epi32(_mm_set1_epi32(0x47800000), absoluteBits);
+		__m128i nanBit = _mm_and_si128(_mm_castps_si128(_mm_cmpunord_ps(absolute, absolute)), _mm_set1_epi32(0x200));
+		__m128i infinityOrNan = _mm_or_si128(nanBit, _mm_set1_epi32(0x7c00));
+
+		//below the smallest normal half: let the fpu round by adding a magic number that puts the bits in place
+		__m128i isSubnormal = _mm_cmpgt_epi32(_mm_set1_epi32(0x38800000), absoluteBits);
+		__m128i subnormalMagic = _mm_set1_epi32(0x3f000000);
+		__m128i subnormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(absolute, _mm_castsi128_ps(subnormalMagic))), subnormalMagic);
+
+		//normal: rebias the exponent and round the mantissa, ties to even
+		__m128i mantissaOdd = _mm_srai_epi32(_mm_slli_epi32(absoluteBits, 31 - 13), 31);
+		__m128i rounded = _mm_sub_epi32(_mm_add_epi32(absoluteBits, _mm_set1_epi32(0xfff - (112 << 23))), mantissaOdd);
+		__m128i normal = _mm_srli_epi32(rounded, 13);
+
+		__m128i finite = _mm_or_si128(_mm_and_si128(isSubnormal, subnormal), _mm_andnot_si128(isSubnormal, normal));
+		__m128i result = _mm_or_si128(_mm_and_si128(isRegular, finite), _mm_andnot_si128(isRegular, infinityOrNan));
+		return _mm_or_si128(result, _mm_srli_epi32(_mm_castps_si128(sign), 16));
+	}
+
+	//encode 4 vertices: the vertices are loaded as rows of 4 floats and transposed to one component per register
+	inline void encode4(const VertexQuantizer::FloatVertex* pVertices, VertexQuantizer::PackedVertex* pPacked) {
+		//u v nx ny
+		__m128 uv0 = _mm_loadu_ps(pVertices[0].uv), uv1 = _mm_loadu_ps(pVertices[1].uv), uv2 = _mm_loadu_ps(pVertices[2].uv), uv3 = _mm_loadu_ps(pVertices[3].uv);
+		_MM_TRANSPOSE4_PS(uv0, uv1, uv2, uv3);
+		//nx ny nz tx
+		__m128 n0 = _mm_loadu_ps(pVertices[0].normal), n1 = _mm_loadu_ps(pVertices[1].normal), n2 = _mm_loadu_ps(pVertices[2].normal), n3 = _mm_loadu_ps(pVertices[3].normal);
+		_MM_TRANSPOSE4_PS(n0, n1, n2, n3);
+		//tx ty tz bx
+		__m128 t0 = _mm_loadu_ps(pVertices[0].tangent), t1 = _mm_loadu_ps(pVertices[1].tangent), t2 = _mm_loadu_ps(pVertices[2].tangent), t3 = _mm_loadu_ps(pVertices[3].tangent);
+		_MM_TRANSPOSE4_PS(t0, t1, t2, t3);
+		//tz bx by bz, starting at tangent[2] keeps the last load inside the vertex
+		__m128 b0 = _mm_loadu_ps(pVertices[0].tangent + 2), b1 = _mm_loadu_ps(pVertices[1].tangent + 2), b2 = _mm_loadu_ps(pVertices[2].tangent + 2), b3 = _mm_loadu_ps(pVertices[3].tangent + 2);
+		_MM_TRANSPOSE4_PS(b0, b1, b2, b3);
+
+		__m128 nx = n0, ny = n1, nz = n2;
+		__m128 tx = t0, ty = t1, tz = t2;
+		__m128 bx = b1, by = b2, bz = b3;
+
+		__m128i u = floatToHalf4(uv0);
+		__m128i v = floatToHalf4(uv1);
+
+		__m128 octX, octY;
+		octEncode4(nx, ny, nz, octX, octY);
+		__m128i normalX = _mm_cvtps_epi32(_mm_mul_ps(octX, _mm_set1_ps(32767.0f)));
+		__m128i normalY = _mm_cvtps_epi32(_mm_mul_ps(octY, _mm_set1_ps(32767.0f)));
+
+		octEncode4(tx, ty, tz, octX, octY);
+		__m128i tangentX = _mm_cvtps_epi32(_mm_mul_ps(octX, _mm_set1_ps(127.0f)));
+		__m128i tangentY = _mm_cvtps_epi32(_mm_mul_ps(octY, _mm_set1_ps(127.0f)));
+
+		//handedness: sign of dot(cross(n, t), b)
+		__m128 crossX = _mm_sub_ps(_mm_mul_ps(ny, tz), _mm_mul_ps(nz, ty));
+		__m128 crossY = _mm_sub_ps(_mm_mul_ps(nz, tx), _mm_mul_ps(nx, tz));
+		__m128 crossZ = _mm_sub_ps(_mm_mul_ps(nx, ty), _mm_mul_ps(ny, tx));
+		__m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(crossX, bx), _mm_mul_ps(crossY, by)), _mm_mul_ps(crossZ, bz));
+		__m128i negative = _mm_castps_si128(_mm_cmplt_ps(dot, _mm_setzero_ps()));
+		__m128i w = _mm_or_si128(_mm_and_si128(negative, _mm_set1_epi32(-127)), _mm_andnot_si128(negative, _mm_set1_epi32(127)));
+
+		int32_t lanes[6][4];
+		_mm_storeu_si128((__m128i*)lanes[0], u);
+		_mm_storeu_si128((__m128i*)lanes[1], v);
+		_mm_storeu_si128((__m128i*)lanes[2], normalX);
+		_mm_storeu_si128((__m128i*)lanes[3], normalY);
+		_mm_storeu_si128((__m128i*)lanes[4], tangentX);
+		_mm_storeu_si128((__m128i*)lanes[5], tangentY);
+		int32_t handedness[4];
+		_mm_storeu_si128((__m128i*)handedness, w);
+
+		for (int i = 0; i < 4; ++i) {
+			VertexQuantizer::PackedVertex& packed = pPacked[i];
+			memcpy(packed.pos, pVertices[i].pos, sizeof(packed.pos));
+			packed.uv[0] = (uint16_t)lanes[0][i];
+			packed.uv[1] = (uint16_t)lanes[1][i];
+			packed.normal[0] = (int16_t)lanes[2][i];
+			packed.normal[1] = (int16_t)lanes[3][i];
+			packed.tangent[0] = (int8_t)lanes[4][i];
+			packed.tangent[1] = (int8_t)lanes[5][i];
+			packed.tangent[2] = 0;
+			packed.tangent[3] = (int8_t)handedness[i];
+		}
+	}
+#endif
+}
+
+void VertexQuantizer::encode(const FloatVertex* pVertices, size_t pVertexCount, PackedVertex* pPacked)
+{
+	size_t i = 0;
+#ifdef VERTEX_QUANTIZER_SSE2
+	for (; i + 4 <= pVertexCount; i += 4)
+		encode4(pVertices + i, pPacked + i);
+#endif
+	for (; i < pVertexCount; ++i)
+		encodeVertex(pVertices[i], pPacked[i]);
+}
+
+void VertexQuantizer::encodeScalar(const FloatVertex* pVertices, size_t pVertexCount, PackedVertex* pPacked)
+{
+	for (size_t i = 0; i < pVertexCount; ++i)
+		encodeVertex(pVertices[i], pPacked[i]);
+}
+
+void VertexQuantizer::decode(const PackedVertex& pPacked, FloatVertex& pVertex)
+{
+	memcpy(pVertex.pos, pPacked.pos, sizeof(pVertex.pos));
+	pVertex.uv[0] = halfToFloat(pPacked.uv[0]);
+	pVertex.uv[1] = halfToFloat(pPacked.uv[1]);
+	octDecode(snormToFloat(pPacked.normal[0], 32767.0f), snormToFloat(pPacked.normal[1], 32767.0f), pVertex.normal);
+	octDecode(snormToFloat(pPacked.tangent[0], 127.0f), snormToFloat(pPacked.tangent[1], 127.0f), pVertex.tangent);
+
+	float w = snormToFloat(pPacked.tangent[3], 127.0f);
+	const float* n = pVertex.normal;
+	const float* t = pVertex.tangent;
+	pVertex.bitangent[0] = (n[1] * t[2] - n[2] * t[1]) * w;
+	pVertex.bitangent[1] = (n[2] * t[0] - n[0] * t[2]) * w;
+	pVertex.bitangent[2] = (n[0] * t[1] - n[1] * t[0]) * w;
+}
+
+VertexQuantizer::Error VertexQuantizer::measureError(const FloatVertex* pVertices, const PackedVertex* pPacked, size_t pVertexCount)
+{
+	Error error = {};
+	double normalSum = 0.0, tangentSum = 0.0, bitangentSum = 0.0;
+	size_t normalCount = 0, tangentCount = 0, bitangentCount = 0;
+
+	for (size_t i = 0; i < pVertexCount; ++i) {
+		const FloatVertex& original = pVertices[i];
+		FloatVertex decoded;
+		decode(pPacked[i], decoded);
+
+		for (int c = 0; c < 2; ++c) {
+			float difference = fabsf(original.uv[c] - decoded.uv[c]);
+			if (difference > error.maxUv)
+				error.maxUv = difference;
+		}
+
+		float degrees;
+		if (angleDegrees(original.normal, decoded.normal, degrees)) {
+			error.maxNormalDegrees = max(error.maxNormalDegrees, degrees);
+			normalSum += degrees;
+			normalCount++;
+		}
+		if (angleDegrees(original.tangent, decoded.tangent, degrees)) {
+			error.maxTangentDegrees = max(error.maxTangentDegrees, degrees);
+			tangentSum += degrees;
+			tangentCount++;
+		}
+
+		//the rebuilt bitangent is unit length only for an orthogonal normal and tangent
+		float length = sqrtf(decoded.bitangent[0] * decoded.bitangent[0] + decoded.bitangent[1] * decoded.bitangent[1] + decoded.bitangent[2] * decoded.bitangent[2]);
+		if (length > 0.0f) {
+			float bitangent[3] = { decoded.bitangent[0] / length, decoded.bitangent[1] / length, decoded.bitangent[2] / length };
+			if (angleDegrees(original.bitangent, bitangent, degrees)) {
+				error.maxBitangentDegrees = max(error.maxBitangentDegrees, degrees);
+				bitangentSum += degrees;
+				bitangentCount++;
+			}
+		}
+	}
+
+	error.meanNormalDegrees = normalCount ? (float)(normalSum / normalCount) : 0.0f;
+	error.meanTangentDegrees = tangentCount ? (float)(tangentSum / tangentCount) : 0.0f;
+	error.meanBitangentDegrees = bitangentCount ? (float)(bitangentSum / bitangentCount) : 0.0f;
+	return error;
+}
+
+void VertexQuantizer::packIndices(const uint32_t* pIndices, size_t pIndexCount, uint16_t* pPacked)
+{
+	size_t i = 0;
+#ifdef VERTEX_QUANTIZER_SSE2
+	//sse2 only has a signed saturating pack, flip the sign bit around it to keep the full 0..65535 range
+	__m128i bias32 = _mm_set1_epi32(0x8000);
+	__m128i bias16 = _mm_set1_epi16((short)0x8000);
+	for (; i + 8 <= pIndexCount; i += 8) {
+		__m128i low = _mm_sub_epi32(_mm_loadu_si128((const __m128i*)(pIndices + i)), bias32);
+		__m128i high = _mm_sub_epi32(_mm_loadu_si128((const __m128i*)(pIndices + i + 4)), bias32);
+		_mm_storeu_si128((__m128i*)(pPacked + i), _mm_xor_si128(_mm_packs_epi32(low, high), bias16));
+	}
+#endif
+	for (; i < pIndexCount; ++i)
+		pPacked[i] = (uint16_t)pIndices[i];
+}
+
+uint16_t VertexQuantizer::floatToHalf(float pValue)
+{
+	uint32_t bits;
+	memcpy(&bits, &pValue, sizeof(bits));
+	uint32_t sign = bits & 0x80000000u;
+	bits ^= sign;
+
+	uint32_t half;
+	if (bits >= 0x47800000u) {
+		//too big for a half, or infinity or nan
+		half = (bits > 0x7f800000u) ? 0x7e00 : 0x7c00;
+	}
+	else if (bits < 0x38800000u) {
+		//subnormal half or zero, the fpu does the rounding when adding 0.5
+		float value;
+		memcpy(&value, &bits, sizeof(value));
+		value += 0.5f;
+		memcpy(&half, &value, sizeof(half));
+		half -= 0x3f000000u;
+	}
+	else {
+		//rebias the exponent and round the mantissa to nearest even
+		uint32_t mantissaOdd = (bits >> 13) & 1;
+		bits += 0xfff - (112u << 23) + mantissaOdd;
+		half = bits >> 13;
+	}
+	return (uint16_t)(half | (sign >> 16));
+}
+
+float VertexQuantizer::halfToFloat(uint16_t pValue)
+{
+	uint32_t sign = (uint32_t)(pValue & 0x8000) << 16;
+	uint32_t exponent = (pValue >> 10) & 0x1f;
+	uint32_t mantissa = pValue & 0x3ff;
+
+	float value;
+	if (exponent == 0) {
+		value = ldexpf((float)mantissa, -24);
+		return sign ? -value : value;
+	}
+
+	uint32_t bits;
+	if (exponent == 31)
+		bits = sign | 0x7f800000u | (mantissa << 13);
+	else
+		bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
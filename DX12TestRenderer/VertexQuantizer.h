@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * Packs full float vertices into a compact 24 byte vertex for the gpu:
+ * - position stays 3 floats
+ * - uv as 2 half floats (DXGI_FORMAT_R16G16_FLOAT)
+ * - normal octahedral encoded in 2 snorm16 (DXGI_FORMAT_R16G16_SNORM)
+ * - tangent octahedral encoded in 2 snorm8, the bitangent is replaced by its sign (handedness) in w
+ *   (DXGI_FORMAT_R8G8B8A8_SNORM), the shader rebuilds it as cross(normal, tangent) * w
+ * The encoding works on 4 vertices at a time with sse2 where available, the scalar path gives the exact same result.
+ * Device independent, so it can be used and measured without a gpu.
+ */
+class VertexQuantizer
+{
+public:
+	//the full vertex as it is built by the mesh loader
+	struct FloatVertex {
+		float pos[3];
+		float uv[2];
+		float normal[3];
+		float tangent[3];
+		float bitangent[3];
+	};
+
+	struct PackedVertex {
+		float pos[3];
+		uint16_t uv[2];
+		int16_t normal[2];
+		int8_t tangent[4];
+	};
+
+	//how far the decoded vertices are off from the originals
+	struct Error {
+		float maxUv;				//largest absolute uv difference
+		float maxNormalDegrees;		//largest angle between original and decoded normal
+		float meanNormalDegrees;
+		float maxTangentDegrees;	//largest angle between original and decoded tangent
+		float meanTangentDegrees;
+		float maxBitangentDegrees;	//largest angle between original bitangent and cross(normal, tangent) * w, big for non orthogonal frames
+		float meanBitangentDegrees;
+	};
+
+	static void encode(const FloatVertex* pVertices, size_t pVertexCount, PackedVertex* pPacked);
+
+	//scalar only version of encode, the reference for the simd path
+	static void encodeScalar(const FloatVertex* pVertices, size_t pVertexCount, PackedVertex* pPacked);
+
+	static void decode(const PackedVertex& pPacked, FloatVertex& pVertex);
+
+	static Error measureError(const FloatVertex* pVertices, const PackedVertex* pPacked, size_t pVertexCount);
+
+	//narrow 32 bit indices to 16 bit, only valid when every index is below 65536
+	static void packIndices(const uint32_t* pIndices, size_t pIndexCount, uint16_t* pPacked);
+
+	static uint16_t floatToHalf(float pValue);
+	static float halfToFloat(uint16_t pValue);
+};
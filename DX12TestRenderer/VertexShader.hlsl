@@ -11,6 +11,7 @@ struct VS_OUTPUT{
 cbuffer ConstantBuffer : register(b0)
 {
 	float4x4 wvpMat;
+	float4 uvTransform; //scale and offset into the atlas page the texture was packed into
 }
 
 VS_OUTPUT main(VS_INPUT i)
@@ -18,6 +19,6 @@ VS_OUTPUT main(VS_INPUT i)
     // just pass vertex position straight through
 	VS_OUTPUT o;
 	o.position = mul(float4(i.pos,1.0f),wvpMat);
-	o.uv = i.uv;
+	o.uv = i.uv * uvTransform.xy + uvTransform.zw;
 	return o;
 }
\ No newline at end of file